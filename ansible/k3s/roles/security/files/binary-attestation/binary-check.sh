@@ -1,5 +1,10 @@
 #!/bin/bash
 # Phase 3: Binary Integrity Checking System
+#
+# Superseded by the native binary-check (files/integrity), which
+# binary-attestation.service runs and which keeps its history in the report
+# log. This script is no longer deployed; it stays as the reference that
+# integrity/bench/bench-binary-check.sh measures against.
 set -e
 
 INTEGRITY_DIR="/etc/security/integrity"
@@ -8,7 +13,6 @@ REPORT_DIR="/var/lib/attestation"
 LOG_FILE="/var/log/integrity-check.log"
 ALERT_FILE="/var/log/integrity-alerts.log"
 STATE_FILE="/var/lib/attestation/binary-state-current.json"
-MAX_REPORTS=20
 
 # Critical binaries to monitor
 CRITICAL_BINARIES=(
@@ -195,12 +199,6 @@ EOF
     # Update current state
     cp "$report_file" "$STATE_FILE"
     
-    # Clean up old reports
-    local count=$(ls -1 "$REPORT_DIR"/binary-check-*.json 2>/dev/null | wc -l)
-    if [ $count -gt $MAX_REPORTS ]; then
-        ls -t "$REPORT_DIR"/binary-check-*.json | tail -n +$((MAX_REPORTS + 1)) | xargs rm -f
-    fi
-    
     echo "$report_file"
 }
 
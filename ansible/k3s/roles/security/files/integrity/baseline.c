@@ -0,0 +1,298 @@
+// baseline.c - Parse the sha256sum-format binary baseline
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include "integrity.h"
+
+#define SYMLINK_TAG "# Symlink: "
+
+// "<64 hex>  <path>" (sha256sum text mode) or "<64 hex> *<path>" (binary mode).
+// Returns the start of the path, or NULL if the line is not an entry.
+static const char *parse_entry(const char *line, size_t len, uint8_t digest[SHA256_LEN]) {
+    if (len <= SHA256_HEX_LEN + 2 || line[0] == '#' || !isspace((unsigned char)line[SHA256_HEX_LEN])) return NULL;
+    if (hex_decode(line, digest, SHA256_LEN) != 0) return NULL;
+    const char *p = line + SHA256_HEX_LEN + 1;
+    if (*p == ' ' || *p == '*') p++;
+    return p;
+}
+
+static int has_tag(const char *line, size_t len, const char *tag) {
+    return len > strlen(tag) && memcmp(line, tag, strlen(tag)) == 0;
+}
+
+static int add_symlink(baseline_t *baseline, const char *link, size_t link_len,
+                       const char *target, size_t target_len) {
+    if (link_len == 0) return 0;
+    baseline_symlink_t *grown = realloc(baseline->symlinks, (baseline->n_symlinks + 1) * sizeof(baseline_symlink_t));
+    if (!grown) return -1;
+    baseline->symlinks = grown;
+    char *link_copy = strndup(link, link_len), *target_copy = strndup(target, target_len);
+    if (!link_copy || !target_copy) {
+        free(link_copy);
+        free(target_copy);
+        return -1;
+    }
+    baseline->symlinks[baseline->n_symlinks].link = link_copy;
+    baseline->symlinks[baseline->n_symlinks].target = target_copy;
+    baseline->n_symlinks++;
+    return 0;
+}
+
+// "# Symlink: <link> -> <target>"
+static int parse_symlink(baseline_t *baseline, const char *line, size_t len) {
+    const char *link = line + strlen(SYMLINK_TAG), *end = line + len;
+    const char *arrow = memmem(link, end - link, " -> ", 4);
+    if (!arrow) return add_symlink(baseline, link, end - link, "", 0);
+    return add_symlink(baseline, link, arrow - link, arrow + 4, end - arrow - 4);
+}
+
+static baseline_slot_t *find_slot(const baseline_t *baseline, const char *path) {
+    size_t mask = baseline->index_capacity - 1;
+    for (size_t i = path_hash(path) & mask;; i = (i + 1) & mask) {
+        baseline_slot_t *slot = &baseline->index[i];
+        if (!slot->path || strcmp(slot->path, path) == 0) return slot;
+    }
+}
+
+static void index_path(baseline_t *baseline, const char *path) {
+    baseline_slot_t *slot = find_slot(baseline, path);
+    if (!slot->path) slot->path = path;
+}
+
+// Built once the entries array has stopped moving; load factor stays under 1/2
+static int build_index(baseline_t *baseline) {
+    size_t want = 2 * (baseline->count + 2 * baseline->n_symlinks) + 1;
+    baseline->index_capacity = 16;
+    while (baseline->index_capacity < want) baseline->index_capacity *= 2;
+    baseline->index = calloc(baseline->index_capacity, sizeof(baseline_slot_t));
+    if (!baseline->index) return -1;
+
+    for (size_t i = 0; i < baseline->count; i++) {
+        baseline_slot_t *slot = find_slot(baseline, baseline->entries[i].path);
+        // First entry wins for duplicate paths, matching a linear search
+        if (!slot->path) {
+            slot->path = baseline->entries[i].path;
+            slot->entry = &baseline->entries[i];
+        }
+    }
+    for (size_t i = 0; i < baseline->n_symlinks; i++) {
+        index_path(baseline, baseline->symlinks[i].link);
+        if (baseline->symlinks[i].target[0]) index_path(baseline, baseline->symlinks[i].target);
+    }
+    return 0;
+}
+
+// "# Verity: <alg>:<hex>  <path>" and "# Mode: <octal>  <path>" attach to the
+// entry for <path>, normally the one just before them
+static baseline_entry_t *annotated_entry(baseline_t *baseline, const char *line, size_t len,
+                                         const char *tag, const char **value, size_t *value_len) {
+    const char *p = line + strlen(tag);
+    const char *end = line + len;
+    const char *sep = memchr(p, ' ', end - p);
+    if (!sep || sep + 2 > end || sep[1] != ' ') return NULL;
+
+    const char *path = sep + 2;
+    size_t path_len = end - path;
+    for (size_t i = baseline->count; i-- > 0;) {
+        baseline_entry_t *entry = &baseline->entries[i];
+        if (strlen(entry->path) == path_len && memcmp(entry->path, path, path_len) == 0) {
+            *value = p;
+            *value_len = sep - p;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void parse_annotation(baseline_t *baseline, const char *line, size_t len) {
+    const char *value;
+    size_t value_len;
+    baseline_entry_t *entry;
+    verity_digest_t digest;
+
+    if (has_tag(line, len, VERITY_TAG)) {
+        entry = annotated_entry(baseline, line, len, VERITY_TAG, &value, &value_len);
+        if (entry && verity_parse(value, value_len, &digest) == 0) entry->verity = digest;
+    } else if (has_tag(line, len, MODE_TAG)) {
+        entry = annotated_entry(baseline, line, len, MODE_TAG, &value, &value_len);
+        if (entry && value_len < 16) {
+            char octal[16];
+            memcpy(octal, value, value_len);
+            octal[value_len] = '\0';
+            entry->mode = (uint32_t)strtoul(octal, NULL, 8);
+        }
+    }
+}
+
+static int parse_text(baseline_t *baseline) {
+    size_t cap = 64;
+    baseline->entries = malloc(cap * sizeof(baseline_entry_t));
+    if (!baseline->entries) return -1;
+
+    char *line = baseline->text;
+    char *end = baseline->text + baseline->text_len;
+    while (line < end) {
+        char *nl = memchr(line, '\n', end - line);
+        size_t len = nl ? (size_t)(nl - line) : (size_t)(end - line);
+        baseline->lines += nl ? 1 : 0;
+
+        baseline_entry_t entry = {0};
+        const char *p = parse_entry(line, len, entry.digest);
+        if (p) {
+            entry.path = strndup(p, len - (p - line));
+            if (!entry.path) return -1;
+            if (baseline->count == cap) {
+                baseline_entry_t *grown = realloc(baseline->entries, 2 * cap * sizeof(baseline_entry_t));
+                if (!grown) {
+                    free((char *)entry.path);
+                    return -1;
+                }
+                baseline->entries = grown;
+                cap *= 2;
+            }
+            baseline->entries[baseline->count++] = entry;
+        } else if (has_tag(line, len, SYMLINK_TAG)) {
+            if (parse_symlink(baseline, line, len) != 0) return -1;
+        } else {
+            parse_annotation(baseline, line, len);
+        }
+        line += len + 1;
+    }
+    return 0;
+}
+
+int baseline_load(const char *path, baseline_t *baseline) {
+    memset(baseline, 0, sizeof(*baseline));
+    if (baseline_bin_detect(path)) return baseline_bin_load(path, baseline);
+
+    baseline->text = read_text_file(path, &baseline->text_len);
+    if (!baseline->text) return -1;
+    if (parse_text(baseline) != 0 || build_index(baseline) != 0) {
+        baseline_free(baseline);
+        return -1;
+    }
+    return 0;
+}
+
+int baseline_load_preferred(const char *path, baseline_t *baseline) {
+    char bin_path[PATH_MAX];
+    struct stat text_st, bin_st;
+    baseline_bin_path(path, bin_path, sizeof(bin_path));
+    // A text baseline edited after the binary copy was written wins
+    if (strcmp(bin_path, path) != 0 && stat(bin_path, &bin_st) == 0 &&
+        (stat(path, &text_st) != 0 || bin_st.st_mtim.tv_sec > text_st.st_mtim.tv_sec ||
+         (bin_st.st_mtim.tv_sec == text_st.st_mtim.tv_sec && bin_st.st_mtim.tv_nsec >= text_st.st_mtim.tv_nsec)) &&
+        baseline_bin_load(bin_path, baseline) == 0) {
+        return 0;
+    }
+    return baseline_load(path, baseline);
+}
+
+int baseline_load_text(const char *text, size_t len, baseline_t *baseline) {
+    memset(baseline, 0, sizeof(*baseline));
+    baseline->text = malloc(len + 1);
+    if (!baseline->text) return -1;
+    memcpy(baseline->text, text, len);
+    baseline->text[len] = '\0';
+    baseline->text_len = len;
+    if (parse_text(baseline) != 0 || build_index(baseline) != 0) {
+        baseline_free(baseline);
+        return -1;
+    }
+    return 0;
+}
+
+static void write_annotations(FILE *out, const baseline_entry_t *entry) {
+    char formatted[16 + 2 * VERITY_MAX_DIGEST];
+    if (entry->mode) fprintf(out, MODE_TAG "%07o  %s\n", entry->mode, entry->path);
+    if (entry->verity.len && verity_format(&entry->verity, formatted, sizeof(formatted)) == 0) {
+        fprintf(out, VERITY_TAG "%s  %s\n", formatted, entry->path);
+    }
+}
+
+int baseline_render_text(const baseline_t *baseline, char **text, size_t *len) {
+    FILE *out = open_memstream(text, len);
+    if (!out) return -1;
+
+    char hex[SHA256_HEX_LEN + 1];
+    for (size_t i = 0; i < baseline->count; i++) {
+        const baseline_entry_t *entry = baseline_entry(baseline, i);
+        hex_encode(entry->digest, SHA256_LEN, hex);
+        fprintf(out, "%s  %s\n", hex, entry->path);
+        write_annotations(out, entry);
+    }
+    for (size_t i = 0; i < baseline->n_symlinks; i++) {
+        fprintf(out, SYMLINK_TAG "%s -> %s\n", baseline->symlinks[i].link, baseline->symlinks[i].target);
+    }
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+int baseline_save(const char *path, const baseline_t *baseline) {
+    if (baseline->map) return baseline_bin_write(path, baseline);
+
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *out = open_memstream(&text, &text_len);
+    if (!out) return -1;
+
+    const char *line = baseline->text;
+    const char *end = baseline->text + baseline->text_len;
+    size_t index = 0;
+    while (line < end) {
+        const char *nl = memchr(line, '\n', end - line);
+        size_t len = nl ? (size_t)(nl - line) : (size_t)(end - line);
+        uint8_t digest[SHA256_LEN];
+
+        if (!has_tag(line, len, VERITY_TAG) && !has_tag(line, len, MODE_TAG)) {
+            fwrite(line, 1, len, out);
+            fputc('\n', out);
+            // Entries were parsed in file order, so the n-th entry line is entries[n]
+            if (parse_entry(line, len, digest) && index < baseline->count) {
+                write_annotations(out, &baseline->entries[index++]);
+            }
+        }
+        line += len + 1;
+    }
+    fclose(out);
+
+    int rc = write_file_atomic(path, text, text_len, 0644);
+    free(text);
+    return rc;
+}
+
+void baseline_free(baseline_t *baseline) {
+    // The binary form's strings live in the mapping
+    for (size_t i = 0; !baseline->map && i < baseline->count; i++) {
+        free((char *)baseline->entries[i].path);
+    }
+    free(baseline->entries);
+    for (size_t i = 0; !baseline->map && i < baseline->n_symlinks; i++) {
+        free((char *)baseline->symlinks[i].link);
+        free((char *)baseline->symlinks[i].target);
+    }
+    free(baseline->symlinks);
+    free(baseline->index);
+    free(baseline->text);
+    baseline_bin_unmap(baseline);
+    memset(baseline, 0, sizeof(*baseline));
+}
+
+int baseline_contains(const baseline_t *baseline, const char *path) {
+    if (baseline->map) return baseline_bin_lookup(baseline, path, NULL);
+    return baseline->index && find_slot(baseline, path)->path != NULL;
+}
+
+const baseline_entry_t *baseline_find(const baseline_t *baseline, const char *path) {
+    const baseline_entry_t *entry = NULL;
+    if (baseline->map) baseline_bin_lookup(baseline, path, &entry);
+    else if (baseline->index) entry = find_slot(baseline, path)->entry;
+    return entry;
+}
+
+const baseline_entry_t *baseline_entry(const baseline_t *baseline, size_t i) {
+    if (baseline->map) baseline_bin_decode(baseline, i);
+    return &baseline->entries[i];
+}
@@ -0,0 +1,385 @@
+// baseline_bin.c - Compact binary baseline
+//
+// Layout (little-endian):
+//   header   magic, version, digest algorithm, row count, row size, string
+//            bytes and a SHA-384 over everything after the header
+//   rows     fixed-size records sorted by (path hash, path)
+//   strings  NUL terminated paths and symlink targets referenced by offset
+//
+// Every symlink target also gets a path-only row (mode 0), so lookups answer
+// the same as the text form's index, which holds links and their targets.
+//
+// The file is mmapped read-only, so lookups need no parsing and no locks.
+// Rows are found by interpolation search over the uniformly distributed path
+// hashes, which settles in a probe or two, and an entry is decoded from its
+// row only when it is first looked up or iterated. The body is canonical:
+// converting a text baseline always produces the same bytes and therefore the
+// same digest.
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <openssl/evp.h>
+
+#include "integrity.h"
+
+#define BIN_MAGIC       "S8BASELN"
+#define BIN_VERSION     2       // 2: path-only rows for symlink targets
+#define BIN_ALG_SHA256  1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t algorithm;     // file digest algorithm
+    uint32_t count;
+    uint32_t row_size;
+    uint64_t strings_len;
+    uint8_t body_digest[SHA384_LEN];
+} bin_header_t;
+
+typedef struct {
+    uint64_t path_hash;
+    uint32_t path_off;
+    uint32_t target_off;    // symlink target; 0 (the empty string) for files
+    uint32_t mode;          // S_IFLNK for symlinks, bare S_IFREG if not recorded, 0 path only
+    uint16_t verity_alg;
+    uint16_t verity_len;
+    uint8_t digest[SHA256_LEN];
+    uint8_t verity[VERITY_MAX_DIGEST];
+} bin_row_t;
+
+_Static_assert(sizeof(bin_header_t) == 80, "header layout");
+_Static_assert(sizeof(bin_row_t) == 120, "row layout");
+
+struct baseline_map {
+    void *addr;
+    size_t len;
+    const bin_row_t *rows;
+    const char *strings;
+    uint32_t count;
+    uint8_t digest[SHA384_LEN];
+    int32_t *row_entry;     // entries[] index per row, -1 for symlinks
+    uint32_t *entry_row;    // row per entries[] index
+};
+
+// ---------------------------------------------------------------------------
+// Serialisation
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t hash;
+    const char *path;
+    const char *target;
+    const baseline_entry_t *entry;  // NULL for symlinks and targets
+    size_t order;                   // input position; earlier duplicates win
+} record_t;
+
+static int record_cmp(const void *a, const void *b) {
+    const record_t *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    int c = strcmp(x->path, y->path);
+    if (c) return c;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+// Body = rows followed by strings, in canonical order
+static int serialize(const baseline_t *baseline, char **body, size_t *body_len, uint32_t *count,
+                     size_t *strings_len) {
+    size_t n = baseline->count + 2 * baseline->n_symlinks;
+    record_t *records = calloc(n ? n : 1, sizeof(record_t));
+    if (!records) return -1;
+    for (size_t i = 0; i < baseline->count; i++) {
+        const baseline_entry_t *entry = baseline_entry(baseline, i);
+        records[i] = (record_t){path_hash(entry->path), entry->path, "", entry, i};
+    }
+    for (size_t i = 0; i < baseline->n_symlinks; i++) {
+        const baseline_symlink_t *symlink = &baseline->symlinks[i];
+        records[baseline->count + i] = (record_t){path_hash(symlink->link), symlink->link, symlink->target,
+                                                  NULL, baseline->count + i};
+    }
+    // Targets sort after every file and link, so a real row for the same path wins
+    size_t targets = baseline->count + baseline->n_symlinks;
+    for (size_t i = 0; i < baseline->n_symlinks; i++) {
+        const char *target = baseline->symlinks[i].target;
+        if (!target[0]) continue;
+        records[targets] = (record_t){path_hash(target), target, NULL, NULL, targets};
+        targets++;
+    }
+    n = targets;
+    qsort(records, n, sizeof(record_t), record_cmp);
+
+    // Drop repeated paths, keeping the first occurrence
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (kept && strcmp(records[kept - 1].path, records[i].path) == 0) continue;
+        records[kept++] = records[i];
+    }
+
+    bin_row_t *rows = calloc(kept ? kept : 1, sizeof(bin_row_t));
+    char *strings = NULL;
+    size_t len = 0;
+    FILE *pool = rows ? open_memstream(&strings, &len) : NULL;
+    if (!pool) {
+        free(rows);
+        free(records);
+        return -1;
+    }
+    fputc('\0', pool);
+    for (size_t i = 0; i < kept; i++) {
+        bin_row_t *row = &rows[i];
+        const record_t *rec = &records[i];
+        row->path_hash = rec->hash;
+        fflush(pool);
+        row->path_off = (uint32_t)len;
+        fwrite(rec->path, 1, strlen(rec->path) + 1, pool);
+        if (rec->entry) {
+            row->mode = rec->entry->mode ? rec->entry->mode : S_IFREG;
+            memcpy(row->digest, rec->entry->digest, SHA256_LEN);
+            row->verity_alg = rec->entry->verity.alg;
+            row->verity_len = rec->entry->verity.len;
+            memcpy(row->verity, rec->entry->verity.digest, rec->entry->verity.len);
+        } else if (rec->target) {
+            row->mode = S_IFLNK | 0777;
+            if (rec->target[0]) {
+                fflush(pool);
+                row->target_off = (uint32_t)len;
+                fwrite(rec->target, 1, strlen(rec->target) + 1, pool);
+            }
+        }
+    }
+    fclose(pool);
+    free(records);
+
+    *body_len = kept * sizeof(bin_row_t) + len;
+    *body = malloc(*body_len ? *body_len : 1);
+    if (*body) {
+        memcpy(*body, rows, kept * sizeof(bin_row_t));
+        memcpy(*body + kept * sizeof(bin_row_t), strings, len);
+    }
+    free(rows);
+    free(strings);
+    *count = (uint32_t)kept;
+    *strings_len = len;
+    return *body ? 0 : -1;
+}
+
+static int sha384(const void *data, size_t len, uint8_t digest[SHA384_LEN]) {
+    unsigned int dlen = 0;
+    return EVP_Digest(data, len, digest, &dlen, EVP_sha384(), NULL) ? 0 : -1;
+}
+
+int baseline_digest(const baseline_t *baseline, uint8_t digest[SHA384_LEN]) {
+    if (baseline->map) {
+        memcpy(digest, baseline->map->digest, SHA384_LEN);
+        return 0;
+    }
+    char *body;
+    size_t body_len, strings_len;
+    uint32_t count;
+    if (serialize(baseline, &body, &body_len, &count, &strings_len) != 0) return -1;
+    int rc = sha384(body, body_len, digest);
+    free(body);
+    return rc;
+}
+
+int baseline_bin_write(const char *path, const baseline_t *baseline) {
+    char *body;
+    size_t body_len, strings_len;
+    uint32_t count;
+    if (serialize(baseline, &body, &body_len, &count, &strings_len) != 0) return -1;
+
+    bin_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BIN_MAGIC, 8);
+    hdr.version = BIN_VERSION;
+    hdr.algorithm = BIN_ALG_SHA256;
+    hdr.count = count;
+    hdr.row_size = sizeof(bin_row_t);
+    hdr.strings_len = strings_len;
+
+    int rc = -1;
+    char *data = malloc(sizeof(hdr) + body_len);
+    if (data && sha384(body, body_len, hdr.body_digest) == 0) {
+        memcpy(data, &hdr, sizeof(hdr));
+        memcpy(data + sizeof(hdr), body, body_len);
+        rc = write_file_atomic(path, data, sizeof(hdr) + body_len, 0644);
+    }
+    free(data);
+    free(body);
+    return rc;
+}
+
+// ---------------------------------------------------------------------------
+// Loading and lookup
+// ---------------------------------------------------------------------------
+
+void baseline_bin_path(const char *text_path, char *out, size_t len) {
+    snprintf(out, len, "%s", text_path);
+    char *ext = strrchr(out, '.');
+    if (ext && strcmp(ext, ".sha256") == 0) *ext = '\0';
+    if (strlen(out) + strlen(BASELINE_BIN_SUFFIX) < len) strcat(out, BASELINE_BIN_SUFFIX);
+}
+
+int baseline_bin_detect(const char *path) {
+    char magic[8];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, magic, sizeof(magic));
+    close(fd);
+    return n == (ssize_t)sizeof(magic) && memcmp(magic, BIN_MAGIC, 8) == 0;
+}
+
+static int validate(baseline_map_t *map) {
+    bin_header_t hdr;
+    if (map->len < sizeof(hdr)) return -1;
+    memcpy(&hdr, map->addr, sizeof(hdr));
+    if (memcmp(hdr.magic, BIN_MAGIC, 8) != 0 || hdr.version != BIN_VERSION ||
+        hdr.algorithm != BIN_ALG_SHA256 || hdr.row_size != sizeof(bin_row_t)) {
+        return -1;
+    }
+    uint64_t rows_len = (uint64_t)hdr.count * sizeof(bin_row_t);
+    if (hdr.strings_len == 0 || sizeof(hdr) + rows_len + hdr.strings_len != map->len) return -1;
+
+    const char *body = (const char *)map->addr + sizeof(hdr);
+    if (sha384(body, map->len - sizeof(hdr), map->digest) != 0 ||
+        memcmp(map->digest, hdr.body_digest, SHA384_LEN) != 0) {
+        return -1;
+    }
+
+    map->rows = (const bin_row_t *)body;
+    map->strings = body + rows_len;
+    map->count = hdr.count;
+    if (map->strings[hdr.strings_len - 1] != '\0') return -1;
+
+    // Offsets in range and rows sorted, or the search would be wrong
+    for (uint32_t i = 0; i < map->count; i++) {
+        const bin_row_t *row = &map->rows[i];
+        if (row->path_off >= hdr.strings_len || row->target_off >= hdr.strings_len ||
+            row->verity_len > VERITY_MAX_DIGEST) {
+            return -1;
+        }
+        if (i && row->path_hash < map->rows[i - 1].path_hash) return -1;
+    }
+    return 0;
+}
+
+// Index the rows: which are files, which symlinks and which only name a
+// target, and how many lines the text form would have. Paths stay in the mapping; nothing is copied.
+static int index_rows(baseline_t *baseline) {
+    baseline_map_t *map = baseline->map;
+    size_t n = map->count ? map->count : 1;
+    map->row_entry = malloc(n * sizeof(int32_t));
+    map->entry_row = malloc(n * sizeof(uint32_t));
+    // Decoded on first access by baseline_entry()
+    baseline->entries = calloc(n, sizeof(baseline_entry_t));
+    if (!map->row_entry || !map->entry_row || !baseline->entries) return -1;
+
+    for (uint32_t i = 0; i < map->count; i++) {
+        const bin_row_t *row = &map->rows[i];
+        map->row_entry[i] = -1;
+        if (!row->mode) continue;
+        if (!S_ISLNK(row->mode)) {
+            map->row_entry[i] = (int32_t)baseline->count;
+            map->entry_row[baseline->count++] = i;
+            baseline->lines += 1 + (row->mode != S_IFREG) + (row->verity_len != 0);
+            continue;
+        }
+        baseline_symlink_t *grown = realloc(baseline->symlinks, (baseline->n_symlinks + 1) * sizeof(baseline_symlink_t));
+        if (!grown) return -1;
+        baseline->symlinks = grown;
+        grown[baseline->n_symlinks].link = map->strings + row->path_off;
+        grown[baseline->n_symlinks].target = map->strings + row->target_off;
+        baseline->n_symlinks++;
+        baseline->lines++;
+    }
+    return 0;
+}
+
+int baseline_bin_load(const char *path, baseline_t *baseline) {
+    memset(baseline, 0, sizeof(*baseline));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    baseline_map_t *map = calloc(1, sizeof(baseline_map_t));
+    if (!map || fstat(fd, &st) != 0) {
+        free(map);
+        close(fd);
+        return -1;
+    }
+    map->len = st.st_size;
+    map->addr = map->len ? mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map->addr == MAP_FAILED) {
+        free(map);
+        errno = EINVAL;
+        return -1;
+    }
+    baseline->map = map;
+
+    if (validate(map) != 0) {
+        baseline_free(baseline);
+        errno = EBADMSG;
+        return -1;
+    }
+    if (index_rows(baseline) != 0) {
+        baseline_free(baseline);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+void baseline_bin_decode(const baseline_t *baseline, size_t index) {
+    const baseline_map_t *map = baseline->map;
+    baseline_entry_t *entry = &baseline->entries[index];
+    if (entry->path) return;
+    const bin_row_t *row = &map->rows[map->entry_row[index]];
+    memcpy(entry->digest, row->digest, SHA256_LEN);
+    entry->mode = row->mode == S_IFREG ? 0 : row->mode;
+    entry->verity.alg = row->verity_alg;
+    entry->verity.len = row->verity_len;
+    memcpy(entry->verity.digest, row->verity, row->verity_len);
+    entry->path = map->strings + row->path_off;
+}
+
+void baseline_bin_unmap(baseline_t *baseline) {
+    baseline_map_t *map = baseline->map;
+    if (!map) return;
+    if (map->addr && map->addr != MAP_FAILED) munmap(map->addr, map->len);
+    free(map->row_entry);
+    free(map->entry_row);
+    free(map);
+    baseline->map = NULL;
+}
+
+int baseline_bin_lookup(const baseline_t *baseline, const char *path, const baseline_entry_t **entry) {
+    const baseline_map_t *map = baseline->map;
+    uint64_t hash = path_hash(path);
+    size_t lo = 0, hi = map->count;     // search [lo, hi)
+
+    if (entry) *entry = NULL;
+    while (lo < hi) {
+        uint64_t first = map->rows[lo].path_hash, last = map->rows[hi - 1].path_hash;
+        if (hash < first || hash > last) return 0;
+        size_t mid = last == first ? lo :
+            lo + (size_t)((unsigned __int128)(hash - first) * (hi - 1 - lo) / (last - first));
+        if (map->rows[mid].path_hash < hash) {
+            lo = mid + 1;
+        } else if (map->rows[mid].path_hash > hash) {
+            hi = mid;
+        } else {
+            // Equal hashes are adjacent; compare paths across the run
+            while (mid > 0 && map->rows[mid - 1].path_hash == hash) mid--;
+            for (; mid < map->count && map->rows[mid].path_hash == hash; mid++) {
+                if (strcmp(map->strings + map->rows[mid].path_off, path) == 0) {
+                    if (entry && map->row_entry[mid] >= 0) *entry = baseline_entry(baseline, map->row_entry[mid]);
+                    return 1;
+                }
+            }
+            return 0;
+        }
+    }
+    return 0;
+}
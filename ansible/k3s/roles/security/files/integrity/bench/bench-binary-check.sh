@@ -0,0 +1,91 @@
+#!/bin/bash
+# bench-binary-check.sh - Compare binary-check.sh against the native binary-check
+# on a synthetic tree. Verifies both report the same alerts and exit status.
+#
+# Usage: bench-binary-check.sh [FILES] [SIZE_KB]
+set -e
+
+FILES=${1:-2000}
+SIZE_KB=${2:-256}
+HERE="$(cd "$(dirname "$0")" && pwd)"
+SCRIPT="$HERE/../../binary-attestation/binary-check.sh"
+NATIVE="$HERE/../binary-check"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+[ -x "$NATIVE" ] || make -C "$HERE/.." binary-check >/dev/null
+
+echo "Building synthetic tree: $FILES files x ${SIZE_KB}KB in $WORK"
+DIRS=(usr/local/bin usr/bin usr/sbin bin sbin)
+for dir in "${DIRS[@]}"; do
+    mkdir -p "$WORK/root/$dir"
+done
+head -c $((SIZE_KB * 1024)) /dev/urandom > "$WORK/seed"
+for i in $(seq 1 "$FILES"); do
+    dir=${DIRS[$((i % ${#DIRS[@]}))]}
+    # Unique content per file so hashes differ
+    { cat "$WORK/seed"; echo "$i"; } > "$WORK/root/$dir/bin$i"
+done
+# A few baselined SUID binaries and one that is not
+chmod u+s "$WORK/root/usr/bin/bin1" "$WORK/root/bin/bin3"
+mkdir -p "$WORK/etc" "$WORK/reports-script" "$WORK/reports-native"
+find "$WORK/root" -type f -exec sha256sum {} + > "$WORK/etc/binary-checksums.sha256"
+cp "$WORK/root/usr/bin/bin1" "$WORK/root/usr/sbin/rogue" && chmod g+s "$WORK/root/usr/sbin/rogue"
+
+# Tamper: modify one, remove one
+echo tampered >> "$WORK/root/usr/bin/bin6"
+rm -f "$WORK/root/usr/sbin/bin7"
+
+# Point a copy of the script at the synthetic tree; stub logger to keep syslog clean
+mkdir -p "$WORK/stub"
+printf '#!/bin/sh\nexit 0\n' > "$WORK/stub/logger" && chmod +x "$WORK/stub/logger"
+sed -e "s|^INTEGRITY_DIR=.*|INTEGRITY_DIR=\"$WORK/etc\"|" \
+    -e "s|^REPORT_DIR=.*|REPORT_DIR=\"$WORK/reports-script\"|" \
+    -e "s|^LOG_FILE=.*|LOG_FILE=\"$WORK/script.log\"|" \
+    -e "s|^ALERT_FILE=.*|ALERT_FILE=\"$WORK/script-alerts.log\"|" \
+    -e "s|^STATE_FILE=.*|STATE_FILE=\"$WORK/reports-script/binary-state-current.json\"|" \
+    -e "s|for dir in /usr/local/bin /usr/bin /usr/sbin /bin /sbin|for dir in ${DIRS[*]/#/$WORK/root/}|" \
+    "$SCRIPT" > "$WORK/binary-check.sh"
+
+scan_args=()
+for dir in "${DIRS[@]}"; do
+    scan_args+=(--scan-dir "$WORK/root/$dir")
+done
+
+run_timed() {
+    local start end
+    start=$(date +%s.%N)
+    set +e
+    "$@" > /dev/null 2>&1
+    RC=$?
+    set -e
+    end=$(date +%s.%N)
+    ELAPSED=$(awk -v s="$start" -v e="$end" 'BEGIN { print e - s }')
+}
+
+# Warm the page cache so both runs measure the same thing
+cat "$WORK"/root/*/* "$WORK"/root/usr/*/* > /dev/null 2>&1 || true
+
+run_timed env PATH="$WORK/stub:$PATH" bash "$WORK/binary-check.sh" --verify
+SCRIPT_RC=$RC SCRIPT_TIME=$ELAPSED
+
+run_timed "$NATIVE" --verify --baseline "$WORK/etc/binary-checksums.sha256" \
+    --report-dir "$WORK/reports-native" --log-file "$WORK/native.log" \
+    --alert-file "$WORK/native-alerts.log" --cache "$WORK/native.cache" "${scan_args[@]}"
+NATIVE_RC=$RC NATIVE_TIME=$ELAPSED
+
+strip() { sed 's/^\[[^]]*\] //' "$1" | sort; }
+
+echo ""
+printf "%-10s %10s %8s\n" "" "seconds" "exit"
+printf "%-10s %10.3f %8d\n" "script" "$SCRIPT_TIME" "$SCRIPT_RC"
+printf "%-10s %10.3f %8d\n" "native" "$NATIVE_TIME" "$NATIVE_RC"
+awk -v s="$SCRIPT_TIME" -v n="$NATIVE_TIME" 'BEGIN { printf "speedup: %.1fx\n", s / n }'
+echo ""
+
+if [ "$SCRIPT_RC" -eq "$NATIVE_RC" ] && diff <(strip "$WORK/script-alerts.log") <(strip "$WORK/native-alerts.log"); then
+    echo "✓ Alerts and exit status match"
+else
+    echo "✗ Output differs between script and native checker"
+    exit 1
+fi
@@ -0,0 +1,695 @@
+// binary_check.c - Native binary integrity checker (replaces binary-check.sh)
+//
+// Same modes, alert text, report layout and exit status as the script, but the
+// baseline is hashed across a thread pool and SUID/SGID discovery runs in-process.
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "integrity.h"
+
+#define LOG_FILE        "/var/log/integrity-check.log"
+#define STATE_NAME      "binary-state-current.json"
+#define CACHE_FILE      REPORT_DIR "/binary-hash.cache"
+#define RTMR3_SYSFS     "/sys/class/misc/tdx_guest/measurements/rtmr3:sha384"
+#define MAX_LIST        64
+
+// Critical binaries to monitor
+static const char *critical_binaries[] = {
+    "/usr/local/bin/k3s",
+    "/usr/bin/kubectl",
+    "/usr/bin/containerd",
+    "/usr/bin/containerd-shim",
+    "/usr/bin/containerd-shim-runc-v2",
+    "/usr/bin/runc",
+    "/usr/bin/docker",
+    "/usr/bin/dockerd",
+    "/usr/sbin/iptables",
+    "/usr/sbin/ip6tables",
+    "/usr/bin/ctr",
+    "/usr/bin/crictl",
+    "/bin/systemctl",
+    "/bin/mount",
+    "/bin/umount",
+    "/usr/bin/nsenter",
+};
+
+// k3s multi-call symlinks recorded as comments in the baseline
+static const char *baseline_symlinks[] = {
+    "/usr/local/bin/kubectl",
+    "/usr/local/bin/crictl",
+    "/usr/local/bin/ctr",
+};
+
+static const char *default_scan_dirs[] = {
+    "/usr/local/bin", "/usr/bin", "/usr/sbin", "/bin", "/sbin",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef struct {
+    const char *baseline_file;
+    const char *baseline_bin;   // binary form written alongside; NULL to skip
+    const char *convert_to;     // --to-binary / --to-text output
+    const char *report_dir;
+    const char *state_file;
+    const char *log_file;
+    const char *alert_file;
+    const char *scan_dirs[MAX_LIST];
+    size_t n_scan_dirs;
+    const char *binaries[MAX_LIST];
+    size_t n_binaries;
+    const char *cache_file;     // NULL disables the hash cache
+    int64_t rehash_interval;
+    int threads;
+} config_t;
+
+typedef struct {
+    int violations;
+    int missing;
+    size_t baseline_lines;
+    char baseline_sha384[2 * SHA384_LEN + 1];
+    size_t verity_measured;
+    suid_scan_stats_t suid;
+    hash_cache_stats_t cache;
+    char k3s[SHA256_HEX_LEN + 1];
+    char containerd[SHA256_HEX_LEN + 1];
+} verify_result_t;
+
+static void digest_or_missing(const char *path, const hash_job_t *jobs, size_t count, char *out) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(jobs[i].path, path) == 0) {
+            if (jobs[i].status == JOB_OK) hex_encode(jobs[i].digest, SHA256_LEN, out);
+            else strcpy(out, "missing");
+            return;
+        }
+    }
+    uint8_t digest[SHA256_LEN];
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && hash_file(path, digest, NULL) == 0) {
+        hex_encode(digest, SHA256_LEN, out);
+    } else {
+        strcpy(out, "missing");
+    }
+}
+
+static void digest_hex(const baseline_t *baseline, char out[2 * SHA384_LEN + 1]) {
+    uint8_t digest[SHA384_LEN];
+    if (baseline_digest(baseline, digest) == 0) hex_encode(digest, SHA384_LEN, out);
+    else strcpy(out, "unavailable");
+}
+
+// The binary form is kept next to the text baseline whenever the latter changes
+static int write_binary_baseline(const config_t *cfg, const baseline_t *baseline) {
+    char hex[2 * SHA384_LEN + 1];
+    if (!cfg->baseline_bin) return 0;
+    if (baseline_bin_write(cfg->baseline_bin, baseline) != 0) {
+        log_msg("Failed to write binary baseline %s: %s", cfg->baseline_bin, strerror(errno));
+        return 1;
+    }
+    digest_hex(baseline, hex);
+    log_msg("Binary baseline written to %s (sha384 %s)", cfg->baseline_bin, hex);
+    return 0;
+}
+
+static int create_baseline(const config_t *cfg) {
+    log_msg("Creating binary baseline...");
+
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", cfg->baseline_file);
+    char *slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = '\0';
+        make_dirs(dir);
+    }
+
+    // The baseline is always hashed from scratch
+    hash_job_t *jobs = hash_paths(cfg->binaries, cfg->n_binaries, cfg->threads, NULL);
+    if (!jobs) return 1;
+
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *out = open_memstream(&text, &text_len);
+    size_t lines = 0;
+    char hex[SHA256_HEX_LEN + 1];
+    char verity[16 + 2 * VERITY_MAX_DIGEST];
+
+    for (size_t i = 0; i < cfg->n_binaries; i++) {
+        if (jobs[i].status == JOB_OK) {
+            hex_encode(jobs[i].digest, SHA256_LEN, hex);
+            fprintf(out, "%s  %s\n", hex, jobs[i].path);
+            lines++;
+            log_msg("Baselined: %s", jobs[i].path);
+
+            struct statx stx;
+            if (stat_file(jobs[i].path, &stx) != 0) continue;
+            fprintf(out, MODE_TAG "%07o  %s\n", stx.stx_mode, jobs[i].path);
+            lines++;
+
+            // Record the measurement of files already protected by fs-verity
+            verity_digest_t digest;
+            if (verity_enabled(&stx) && verity_measure(jobs[i].path, &digest) == 0 &&
+                verity_format(&digest, verity, sizeof(verity)) == 0) {
+                fprintf(out, VERITY_TAG "%s  %s\n", verity, jobs[i].path);
+                lines++;
+            }
+        } else {
+            log_msg("Warning: Binary not found: %s", jobs[i].path);
+        }
+    }
+
+    // Also record k3s symlinks if they exist
+    for (size_t i = 0; i < COUNT(baseline_symlinks); i++) {
+        struct stat st;
+        char target[PATH_MAX];
+        if (lstat(baseline_symlinks[i], &st) == 0 && S_ISLNK(st.st_mode) &&
+            realpath(baseline_symlinks[i], target)) {
+            fprintf(out, "# Symlink: %s -> %s\n", baseline_symlinks[i], target);
+            lines++;
+        }
+    }
+    fclose(out);
+    free(jobs);
+
+    int rc = write_file_atomic(cfg->baseline_file, text, text_len, 0644);
+    if (rc != 0) {
+        log_msg("Failed to write baseline %s: %s", cfg->baseline_file, strerror(errno));
+        free(text);
+        return 1;
+    }
+    log_msg("Baseline created with %zu entries", lines);
+
+    baseline_t baseline;
+    if (baseline_load_text(text, text_len, &baseline) == 0) {
+        rc = write_binary_baseline(cfg, &baseline);
+        baseline_free(&baseline);
+    }
+    free(text);
+    return rc;
+}
+
+static int enable_verity(const config_t *cfg) {
+    baseline_t baseline;
+    if (baseline_load(cfg->baseline_file, &baseline) != 0) {
+        alert_msg("No baseline file found! Run with --create-baseline first");
+        return 1;
+    }
+
+    log_msg("Enabling fs-verity on baseline binaries...");
+
+    // Only seal files that still match the baseline; hash them fresh
+    const char **paths = malloc((baseline.count ? baseline.count : 1) * sizeof(char *));
+    hash_job_t *jobs = NULL;
+    if (paths) {
+        for (size_t i = 0; i < baseline.count; i++) paths[i] = baseline_entry(&baseline, i)->path;
+        jobs = hash_paths(paths, baseline.count, cfg->threads, NULL);
+        free(paths);
+    }
+    if (!jobs) {
+        baseline_free(&baseline);
+        return 1;
+    }
+
+    int failures = 0;
+    size_t enabled = 0;
+    char formatted[16 + 2 * VERITY_MAX_DIGEST];
+    for (size_t i = 0; i < baseline.count; i++) {
+        // Decoded above, so entries[i] can be edited in either form
+        baseline_entry_t *entry = &baseline.entries[i];
+        if (jobs[i].status != JOB_OK || memcmp(jobs[i].digest, entry->digest, SHA256_LEN) != 0) {
+            alert_msg("Not enabling fs-verity on %s: does not match baseline", entry->path);
+            failures++;
+            continue;
+        }
+        verity_digest_t digest;
+        if (verity_enable(entry->path, &digest) != 0) {
+            // Filesystems without the verity feature keep using content hashes
+            log_msg("Warning: fs-verity unavailable for %s: %s", entry->path, strerror(errno));
+            memset(&entry->verity, 0, sizeof(entry->verity));
+            continue;
+        }
+        entry->verity = digest;
+        verity_format(&digest, formatted, sizeof(formatted));
+        log_msg("fs-verity enabled: %s (%s)", entry->path, formatted);
+        enabled++;
+    }
+    free(jobs);
+
+    int rc = baseline_save(cfg->baseline_file, &baseline);
+    if (rc != 0) {
+        log_msg("Failed to write baseline %s: %s", cfg->baseline_file, strerror(errno));
+        baseline_free(&baseline);
+        return 1;
+    }
+    if (!baseline.map) write_binary_baseline(cfg, &baseline);
+    baseline_free(&baseline);
+    log_msg("fs-verity enabled on %zu binaries", enabled);
+    return failures ? 1 : 0;
+}
+
+static void log_suid_stats(const suid_scan_stats_t *stats) {
+    log_msg("SUID/SGID scan: %zu entries in %zu directories, %zu SUID/SGID, %zu not in baseline (%.1f ms)",
+            stats->entries, stats->dirs, stats->suid_sgid, stats->unknown, stats->elapsed_us / 1000.0);
+}
+
+static int convert_baseline(const config_t *cfg, int to_binary) {
+    baseline_t baseline;
+    if (baseline_load(cfg->baseline_file, &baseline) != 0) {
+        fprintf(stderr, "Failed to load baseline %s: %s\n", cfg->baseline_file, strerror(errno));
+        return 1;
+    }
+    int rc;
+    if (to_binary) {
+        rc = baseline_bin_write(cfg->convert_to, &baseline);
+    } else {
+        char *text = NULL;
+        size_t len = 0;
+        rc = baseline_render_text(&baseline, &text, &len);
+        if (rc == 0) rc = write_file_atomic(cfg->convert_to, text, len, 0644);
+        free(text);
+    }
+    char hex[2 * SHA384_LEN + 1];
+    digest_hex(&baseline, hex);
+    baseline_free(&baseline);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to write %s: %s\n", cfg->convert_to, strerror(errno));
+        return 1;
+    }
+    log_msg("Converted %s to %s (sha384 %s)", cfg->baseline_file, cfg->convert_to, hex);
+    return 0;
+}
+
+// Print the baseline digest, or extend it into RTMR3 so quotes cover the
+// baseline the node verifies against
+static int baseline_measurement(const config_t *cfg, int extend) {
+    baseline_t baseline;
+    uint8_t digest[SHA384_LEN];
+    char hex[2 * SHA384_LEN + 1];
+    if (baseline_load_preferred(cfg->baseline_file, &baseline) != 0) {
+        fprintf(stderr, "Failed to load baseline %s: %s\n", cfg->baseline_file, strerror(errno));
+        return 1;
+    }
+    int rc = baseline_digest(&baseline, digest);
+    baseline_free(&baseline);
+    if (rc != 0) return 1;
+    hex_encode(digest, SHA384_LEN, hex);
+    if (!extend) {
+        printf("%s\n", hex);
+        return 0;
+    }
+
+    int fd = open(RTMR3_SYSFS, O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || write(fd, digest, SHA384_LEN) != SHA384_LEN) {
+        log_msg("Failed to extend RTMR3 via %s: %s", RTMR3_SYSFS, strerror(errno));
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    close(fd);
+    log_msg("Extended RTMR3 with baseline sha384 %s", hex);
+    return 0;
+}
+
+static int check_suid(const config_t *cfg) {
+    baseline_t baseline;
+    if (baseline_load_preferred(cfg->baseline_file, &baseline) != 0) {
+        alert_msg("No baseline file found! Run with --create-baseline first");
+        return 1;
+    }
+    suid_scan_stats_t stats;
+    int found = scan_suid(cfg->scan_dirs, cfg->n_scan_dirs, &baseline, &stats);
+    log_suid_stats(&stats);
+    baseline_free(&baseline);
+    return found;
+}
+
+static int verify_integrity(const config_t *cfg, verify_result_t *res) {
+    baseline_t baseline;
+    memset(res, 0, sizeof(*res));
+    strcpy(res->k3s, "missing");
+    strcpy(res->containerd, "missing");
+
+    if (baseline_load_preferred(cfg->baseline_file, &baseline) != 0) {
+        alert_msg("No baseline file found! Run with --create-baseline first");
+        res->violations = 1;
+        return res->violations;
+    }
+    res->baseline_lines = baseline.lines;
+    digest_hex(&baseline, res->baseline_sha384);
+
+    log_msg("Starting binary verification...");
+
+    hash_cache_t *cache = NULL;
+    if (cfg->cache_file) {
+        cache = hash_cache_open(cfg->cache_file, cfg->rehash_interval);
+        if (!cache) log_msg("Warning: hash cache %s unusable, hashing everything", cfg->cache_file);
+    }
+
+    hash_job_t *jobs = hash_baseline(&baseline, cfg->threads, cache, &res->verity_measured);
+    if (res->verity_measured) {
+        log_msg("fs-verity: %zu of %zu binaries measured without reading", res->verity_measured, baseline.count);
+    }
+    if (cache) {
+        hash_cache_get_stats(cache, &res->cache);
+        if (hash_cache_save(cache) != 0) log_msg("Warning: failed to save hash cache: %s", strerror(errno));
+        hash_cache_close(cache);
+        log_msg("Hash cache: %llu hits, %llu misses (%llu changed, %llu expired), "
+                "%llu bytes hashed, %llu bytes avoided",
+                (unsigned long long)res->cache.hits, (unsigned long long)res->cache.misses,
+                (unsigned long long)res->cache.changed, (unsigned long long)res->cache.expired,
+                (unsigned long long)res->cache.bytes_hashed, (unsigned long long)res->cache.bytes_avoided);
+    }
+
+    // Report in baseline order regardless of completion order
+    for (size_t i = 0; jobs && i < baseline.count; i++) {
+        res->violations += check_job(&jobs[i], "Binary", &res->missing);
+    }
+
+    // Check for new suspicious binaries in critical paths
+    res->violations += scan_suid(cfg->scan_dirs, cfg->n_scan_dirs, &baseline, &res->suid);
+    log_suid_stats(&res->suid);
+
+    if (jobs) {
+        digest_or_missing("/usr/local/bin/k3s", jobs, baseline.count, res->k3s);
+        digest_or_missing("/usr/bin/containerd", jobs, baseline.count, res->containerd);
+    }
+    free(jobs);
+    baseline_free(&baseline);
+    return res->violations;
+}
+
+static int service_filter(const struct dirent *d) {
+    size_t len = strlen(d->d_name);
+    return len > 8 && strcmp(d->d_name + len - 8, ".service") == 0;
+}
+
+static int check_chroot_usage(void) {
+    static const char *unit_dirs[] = {"/etc/systemd/system", "/usr/lib/systemd/system"};
+    char path[PATH_MAX];
+
+    log_msg("Scanning for chroot usage in boot scripts...");
+    for (size_t d = 0; d < COUNT(unit_dirs); d++) {
+        struct dirent **names;
+        int n = scandir(unit_dirs[d], &names, service_filter, alphasort);
+        if (n < 0) continue;
+        for (int i = 0; i < n; i++) {
+            snprintf(path, sizeof(path), "%s/%s", unit_dirs[d], names[i]->d_name);
+            char *text = read_text_file(path, NULL);
+            if (text && (strstr(text, "chroot") || strstr(text, "RootDirectory="))) {
+                log_msg("Service may use chroot: %s", names[i]->d_name);
+            }
+            free(text);
+            free(names[i]);
+        }
+        free(names);
+    }
+    return 0;
+}
+
+// One systemctl call for every hardening property instead of one per property
+static void systemd_hardening(char *syscall_filter, char *cap_sys_chroot, char *no_new_privs, size_t len) {
+    strcpy(syscall_filter, "inactive");
+    strcpy(cap_sys_chroot, "present");
+    no_new_privs[0] = '\0';
+
+    FILE *p = popen("systemctl show k3s -p SystemCallFilter -p CapabilityBoundingSet "
+                    "-p NoNewPrivileges 2>/dev/null", "r");
+    if (!p) return;
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, p) > 0) {
+        line[strcspn(line, "\n")] = '\0';
+        if (!strncmp(line, "SystemCallFilter=", 17) && strstr(line, "~chroot")) {
+            strcpy(syscall_filter, "active");
+        } else if (!strncmp(line, "CapabilityBoundingSet=", 22) && strstr(line, "~CAP_SYS_CHROOT")) {
+            strcpy(cap_sys_chroot, "dropped");
+        } else if (!strncmp(line, "NoNewPrivileges=", 16)) {
+            snprintf(no_new_privs, len, "%s", line + 16);
+        }
+    }
+    free(line);
+    pclose(p);
+}
+
+static int generate_report(const config_t *cfg, char *report_path, size_t path_len, int *violations) {
+    verify_result_t res;
+    int integrity_status = verify_integrity(cfg, &res);
+    int chroot_status = check_chroot_usage();
+    *violations = integrity_status;
+
+    char syscall_filter[16], cap_sys_chroot[16], no_new_privs[32];
+    systemd_hardening(syscall_filter, cap_sys_chroot, no_new_privs, sizeof(no_new_privs));
+
+    char timestamp[40], hostname[256] = "";
+    iso_timestamp(timestamp, sizeof(timestamp));
+    gethostname(hostname, sizeof(hostname) - 1);
+
+    char *json = NULL;
+    size_t json_len = 0;
+    FILE *out = open_memstream(&json, &json_len);
+    fprintf(out, "{\n    \"timestamp\": \"%s\",\n    \"hostname\": ", timestamp);
+    json_string(out, hostname);
+    fprintf(out, ",\n    \"checks\": {\n");
+    fprintf(out, "        \"binary_integrity\": {\n");
+    fprintf(out, "            \"status\": \"%s\",\n", integrity_status == 0 ? "pass" : "fail");
+    fprintf(out, "            \"violations\": %d,\n", integrity_status);
+    fprintf(out, "            \"baseline_entries\": %zu,\n", res.baseline_lines);
+    fprintf(out, "            \"baseline_sha384\": \"%s\",\n", res.baseline_sha384);
+    fprintf(out, "            \"fsverity_measured\": %zu,\n", res.verity_measured);
+    fprintf(out, "            \"suid_sgid\": {\"found\": %zu, \"not_in_baseline\": %zu, \"scan_ms\": %.1f},\n",
+            res.suid.suid_sgid, res.suid.unknown, res.suid.elapsed_us / 1000.0);
+    fprintf(out, "            \"hash_cache\": {\"hits\": %llu, \"misses\": %llu, "
+                 "\"bytes_hashed\": %llu, \"bytes_avoided\": %llu}\n",
+            (unsigned long long)res.cache.hits, (unsigned long long)res.cache.misses,
+            (unsigned long long)res.cache.bytes_hashed, (unsigned long long)res.cache.bytes_avoided);
+    fprintf(out, "        },\n");
+    fprintf(out, "        \"chroot_usage\": {\n");
+    fprintf(out, "            \"boot_scripts\": %d,\n", chroot_status);
+    fprintf(out, "            \"status\": \"%s\"\n", chroot_status == 0 ? "pass" : "fail");
+    fprintf(out, "        },\n");
+    fprintf(out, "        \"systemd_hardening\": {\n");
+    fprintf(out, "            \"syscall_filter_chroot\": \"%s\",\n", syscall_filter);
+    fprintf(out, "            \"cap_sys_chroot\": \"%s\",\n", cap_sys_chroot);
+    fprintf(out, "            \"no_new_privileges\": ");
+    json_string(out, no_new_privs);
+    fprintf(out, "\n        },\n");
+    fprintf(out, "        \"critical_binaries\": {\n");
+    fprintf(out, "            \"k3s\": \"%s\",\n", res.k3s);
+    fprintf(out, "            \"containerd\": \"%s\"\n", res.containerd);
+    fprintf(out, "        }\n    }\n}\n");
+    fclose(out);
+
+    // History goes to the report log; the state file keeps the latest report
+    char log_dir[PATH_MAX];
+    uint64_t seq = 0;
+    snprintf(log_dir, sizeof(log_dir), "%s/%s", cfg->report_dir, REPORT_LOG_NAME);
+    int rc = report_log_append(log_dir, "binary-check", json, json_len, &seq);
+    if (rc == 0) rc = write_file_atomic(cfg->state_file, json, json_len, 0644);
+    free(json);
+    if (rc != 0) {
+        log_msg("Failed to write report: %s", strerror(errno));
+        return 1;
+    }
+    log_msg("Report #%llu appended to %s", (unsigned long long)seq, log_dir);
+    snprintf(report_path, path_len, "%s", cfg->state_file);
+    return 0;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [MODE] [OPTIONS]\n", prog_name);
+    printf("Modes:\n");
+    printf("  check                 Run all checks, write a report, exit with violation count (default)\n");
+    printf("  --create-baseline     Hash the critical binaries into the baseline\n");
+    printf("  --enable-verity       Enable fs-verity on baselined binaries and record their digests\n");
+    printf("  --verify              Verify binaries against the baseline\n");
+    printf("  --check-suid          Only report SUID/SGID binaries missing from the baseline\n");
+    printf("  --to-binary FILE      Convert the baseline to the binary form\n");
+    printf("  --to-text FILE        Convert the baseline to the text form\n");
+    printf("  --baseline-digest     Print the baseline SHA-384 (same for either form)\n");
+    printf("  --extend-rtmr3        Extend the baseline SHA-384 into RTMR3\n");
+    printf("  --check-chroot        Scan systemd units for chroot usage\n");
+    printf("  --report              Run all checks and write a report\n");
+    printf("Options:\n");
+    printf("  --baseline FILE       Baseline file, text or binary (default: %s)\n", BASELINE_FILE);
+    printf("                        Checks read its .bin copy instead when that is at least as new\n");
+    printf("  --binary-baseline F   Binary copy written on create (default: baseline with .bin suffix)\n");
+    printf("  --report-dir DIR      Report directory (default: %s)\n", REPORT_DIR);
+    printf("  --state-file FILE     Current state file (default: REPORT_DIR/%s)\n", STATE_NAME);
+    printf("  --log-file FILE       Log file (default: %s)\n", LOG_FILE);
+    printf("  --alert-file FILE     Alert file (default: %s)\n", ALERT_FILE);
+    printf("  --scan-dir DIR        SUID/SGID scan directory, repeatable (default: standard bin dirs)\n");
+    printf("  --binary PATH         Binary to baseline, repeatable (default: built-in critical list)\n");
+    printf("  --cache FILE          Digest cache (default: %s)\n", CACHE_FILE);
+    printf("  --no-cache            Hash every file, do not read or update the cache\n");
+    printf("  --rehash              Ignore cached digests this run and refresh the cache\n");
+    printf("  --rehash-interval S   Recompute cached digests older than S seconds (default: %d)\n", REHASH_INTERVAL);
+    printf("  --threads N           Hashing threads (default: 2x online CPUs)\n");
+    printf("  -h, --help            Show this help message\n");
+}
+
+enum {
+    OPT_CREATE_BASELINE = 256, OPT_ENABLE_VERITY, OPT_VERIFY, OPT_CHECK_SUID, OPT_CHECK_CHROOT, OPT_REPORT,
+    OPT_TO_BINARY, OPT_TO_TEXT, OPT_BASELINE_DIGEST, OPT_EXTEND_RTMR3, OPT_BINARY_BASELINE,
+    OPT_BASELINE, OPT_REPORT_DIR, OPT_STATE_FILE, OPT_LOG_FILE, OPT_ALERT_FILE,
+    OPT_SCAN_DIR, OPT_BINARY, OPT_THREADS,
+    OPT_CACHE, OPT_NO_CACHE, OPT_REHASH, OPT_REHASH_INTERVAL,
+};
+
+int main(int argc, char *argv[]) {
+    config_t cfg = {
+        .baseline_file = BASELINE_FILE,
+        .report_dir = REPORT_DIR,
+        .log_file = LOG_FILE,
+        .alert_file = ALERT_FILE,
+        .cache_file = CACHE_FILE,
+        .rehash_interval = REHASH_INTERVAL,
+    };
+    int mode = 0, custom_scan_dirs = 0, custom_binaries = 0;
+
+    static struct option long_options[] = {
+        {"create-baseline", no_argument, 0, OPT_CREATE_BASELINE},
+        {"enable-verity", no_argument, 0, OPT_ENABLE_VERITY},
+        {"verify", no_argument, 0, OPT_VERIFY},
+        {"check-suid", no_argument, 0, OPT_CHECK_SUID},
+        {"to-binary", required_argument, 0, OPT_TO_BINARY},
+        {"to-text", required_argument, 0, OPT_TO_TEXT},
+        {"baseline-digest", no_argument, 0, OPT_BASELINE_DIGEST},
+        {"extend-rtmr3", no_argument, 0, OPT_EXTEND_RTMR3},
+        {"binary-baseline", required_argument, 0, OPT_BINARY_BASELINE},
+        {"check-chroot", no_argument, 0, OPT_CHECK_CHROOT},
+        {"report", no_argument, 0, OPT_REPORT},
+        {"baseline", required_argument, 0, OPT_BASELINE},
+        {"report-dir", required_argument, 0, OPT_REPORT_DIR},
+        {"state-file", required_argument, 0, OPT_STATE_FILE},
+        {"log-file", required_argument, 0, OPT_LOG_FILE},
+        {"alert-file", required_argument, 0, OPT_ALERT_FILE},
+        {"scan-dir", required_argument, 0, OPT_SCAN_DIR},
+        {"binary", required_argument, 0, OPT_BINARY},
+        {"threads", required_argument, 0, OPT_THREADS},
+        {"cache", required_argument, 0, OPT_CACHE},
+        {"no-cache", no_argument, 0, OPT_NO_CACHE},
+        {"rehash", no_argument, 0, OPT_REHASH},
+        {"rehash-interval", required_argument, 0, OPT_REHASH_INTERVAL},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_CREATE_BASELINE:
+            case OPT_ENABLE_VERITY:
+            case OPT_VERIFY:
+            case OPT_CHECK_SUID:
+            case OPT_CHECK_CHROOT:
+            case OPT_REPORT:
+            case OPT_BASELINE_DIGEST:
+            case OPT_EXTEND_RTMR3:
+                mode = opt;
+                break;
+            case OPT_TO_BINARY:
+            case OPT_TO_TEXT:
+                mode = opt;
+                cfg.convert_to = optarg;
+                break;
+            case OPT_BINARY_BASELINE: cfg.baseline_bin = optarg; break;
+            case OPT_BASELINE: cfg.baseline_file = optarg; break;
+            case OPT_REPORT_DIR: cfg.report_dir = optarg; break;
+            case OPT_STATE_FILE: cfg.state_file = optarg; break;
+            case OPT_LOG_FILE: cfg.log_file = optarg; break;
+            case OPT_ALERT_FILE: cfg.alert_file = optarg; break;
+            case OPT_SCAN_DIR:
+                if (cfg.n_scan_dirs < MAX_LIST) cfg.scan_dirs[cfg.n_scan_dirs++] = optarg;
+                custom_scan_dirs = 1;
+                break;
+            case OPT_BINARY:
+                if (cfg.n_binaries < MAX_LIST) cfg.binaries[cfg.n_binaries++] = optarg;
+                custom_binaries = 1;
+                break;
+            case OPT_THREADS: cfg.threads = atoi(optarg); break;
+            case OPT_CACHE: cfg.cache_file = optarg; break;
+            case OPT_NO_CACHE: cfg.cache_file = NULL; break;
+            case OPT_REHASH: cfg.rehash_interval = 0; break;
+            case OPT_REHASH_INTERVAL: cfg.rehash_interval = atoll(optarg); break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!custom_scan_dirs) {
+        for (size_t i = 0; i < COUNT(default_scan_dirs); i++) cfg.scan_dirs[cfg.n_scan_dirs++] = default_scan_dirs[i];
+    }
+    if (!custom_binaries) {
+        for (size_t i = 0; i < COUNT(critical_binaries); i++) cfg.binaries[cfg.n_binaries++] = critical_binaries[i];
+    }
+    char baseline_bin[PATH_MAX];
+    if (!cfg.baseline_bin) {
+        baseline_bin_path(cfg.baseline_file, baseline_bin, sizeof(baseline_bin));
+        cfg.baseline_bin = baseline_bin;
+    }
+    char state_file[PATH_MAX];
+    if (!cfg.state_file) {
+        snprintf(state_file, sizeof(state_file), "%s/%s", cfg.report_dir, STATE_NAME);
+        cfg.state_file = state_file;
+    }
+
+    log_init("binary-check", cfg.log_file, cfg.alert_file);
+
+    int rc = 0, violations = 0;
+    char report[PATH_MAX];
+    verify_result_t res;
+
+    switch (mode) {
+        case OPT_CREATE_BASELINE:
+            rc = create_baseline(&cfg);
+            break;
+        case OPT_ENABLE_VERITY:
+            rc = enable_verity(&cfg);
+            break;
+        case OPT_VERIFY:
+            rc = verify_integrity(&cfg, &res);
+            break;
+        case OPT_CHECK_SUID:
+            rc = check_suid(&cfg);
+            break;
+        case OPT_TO_BINARY:
+        case OPT_TO_TEXT:
+            rc = convert_baseline(&cfg, mode == OPT_TO_BINARY);
+            break;
+        case OPT_BASELINE_DIGEST:
+        case OPT_EXTEND_RTMR3:
+            rc = baseline_measurement(&cfg, mode == OPT_EXTEND_RTMR3);
+            break;
+        case OPT_CHECK_CHROOT:
+            rc = check_chroot_usage();
+            break;
+        case OPT_REPORT:
+            if (generate_report(&cfg, report, sizeof(report), &violations) == 0) {
+                log_msg("Generated report: %s", report);
+            } else {
+                rc = 1;
+            }
+            break;
+        default:
+            // Default: run all checks and generate report, exit with error if violations found
+            if (generate_report(&cfg, report, sizeof(report), &violations) == 0) {
+                log_msg("Integrity check completed. Report: %s", report);
+            }
+            rc = violations;
+            break;
+    }
+
+    log_close();
+    // Exit status is the violation count; clamp so 256 violations cannot wrap to success
+    return rc > 255 ? 255 : rc;
+}
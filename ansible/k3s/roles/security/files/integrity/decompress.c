@@ -0,0 +1,209 @@
+// decompress.c - Single-pass hashing and signature extraction for compressed modules
+//
+// The file is read once: the compressed bytes go to SHA-256 (what sha256sum
+// and the module baseline see) and through a streaming zstd/xz decoder whose
+// output is only kept as a sliding tail, which is where sign-file put the
+// signature before the module was compressed. Decoder contexts and buffers
+// live per thread and are reused for every file that thread scans.
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <lzma.h>
+#include <zstd.h>
+#include <openssl/evp.h>
+
+#include "integrity.h"
+
+#define OUT_BUF_SIZE    (256 * 1024)
+#define TAIL_CAP        (2 * MODSIG_TAIL_MAX)
+
+static const uint8_t zstd_magic[] = {0x28, 0xB5, 0x2F, 0xFD};
+static const uint8_t xz_magic[] = {0xFD, '7', 'z', 'X', 'Z', 0x00};
+
+typedef struct {
+    uint8_t *out;
+    uint8_t *tail;
+    size_t tail_len;
+    ZSTD_DCtx *zstd;
+    lzma_stream xz;
+    int xz_used;
+} scan_buffers_t;
+
+static pthread_key_t buffers_key;
+static pthread_once_t buffers_once = PTHREAD_ONCE_INIT;
+
+static void free_buffers(void *p) {
+    scan_buffers_t *b = p;
+    free(b->out);
+    free(b->tail);
+    ZSTD_freeDCtx(b->zstd);
+    if (b->xz_used) lzma_end(&b->xz);
+    free(b);
+}
+
+static void make_buffers_key(void) {
+    pthread_key_create(&buffers_key, free_buffers);
+}
+
+static scan_buffers_t *scan_buffers(void) {
+    pthread_once(&buffers_once, make_buffers_key);
+    scan_buffers_t *b = pthread_getspecific(buffers_key);
+    if (b) return b;
+
+    b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->out = malloc(OUT_BUF_SIZE);
+    b->tail = malloc(TAIL_CAP);
+    b->zstd = ZSTD_createDCtx();
+    b->xz = (lzma_stream)LZMA_STREAM_INIT;
+    if (!b->out || !b->tail || !b->zstd) {
+        free_buffers(b);
+        return NULL;
+    }
+    pthread_setspecific(buffers_key, b);
+    return b;
+}
+
+// Keep the last MODSIG_TAIL_MAX bytes of the decompressed image
+static void tail_append(scan_buffers_t *b, const uint8_t *data, size_t n) {
+    if (n >= MODSIG_TAIL_MAX) {
+        memcpy(b->tail, data + n - MODSIG_TAIL_MAX, MODSIG_TAIL_MAX);
+        b->tail_len = MODSIG_TAIL_MAX;
+        return;
+    }
+    if (b->tail_len + n > TAIL_CAP) {
+        size_t keep = b->tail_len < MODSIG_TAIL_MAX ? b->tail_len : MODSIG_TAIL_MAX;
+        memmove(b->tail, b->tail + b->tail_len - keep, keep);
+        b->tail_len = keep;
+    }
+    memcpy(b->tail + b->tail_len, data, n);
+    b->tail_len += n;
+}
+
+static module_format_t detect_format(const uint8_t *buf, size_t n) {
+    if (n >= sizeof(zstd_magic) && memcmp(buf, zstd_magic, sizeof(zstd_magic)) == 0) return MODULE_ZSTD;
+    if (n >= sizeof(xz_magic) && memcmp(buf, xz_magic, sizeof(xz_magic)) == 0) return MODULE_XZ;
+    return MODULE_PLAIN;
+}
+
+// Returns 1 once the frame is complete, 0 if more input is expected, -1 on a decode error.
+// Input left in the chunk after the end of the frame is not decoded.
+static int feed_zstd(scan_buffers_t *b, const uint8_t *data, size_t n, uint64_t *image_bytes) {
+    ZSTD_inBuffer in = {data, n, 0};
+    size_t ret = 0;
+    ZSTD_outBuffer out;
+    do {
+        out = (ZSTD_outBuffer){b->out, OUT_BUF_SIZE, 0};
+        ret = ZSTD_decompressStream(b->zstd, &out, &in);
+        if (ZSTD_isError(ret)) return -1;
+        tail_append(b, b->out, out.pos);
+        *image_bytes += out.pos;
+        // 0: the frame is decoded and fully flushed
+        if (ret == 0) return 1;
+    } while (in.pos < in.size || out.pos == out.size);
+    return 0;
+}
+
+static int feed_xz(scan_buffers_t *b, const uint8_t *data, size_t n, int finish, uint64_t *image_bytes) {
+    b->xz.next_in = data;
+    b->xz.avail_in = n;
+    for (;;) {
+        b->xz.next_out = b->out;
+        b->xz.avail_out = OUT_BUF_SIZE;
+        lzma_ret ret = lzma_code(&b->xz, finish ? LZMA_FINISH : LZMA_RUN);
+        size_t produced = OUT_BUF_SIZE - b->xz.avail_out;
+        tail_append(b, b->out, produced);
+        *image_bytes += produced;
+        if (ret == LZMA_STREAM_END) return 1;
+        if (ret != LZMA_OK) return -1;
+        if (b->xz.avail_in == 0 && b->xz.avail_out != 0) return 0;
+    }
+}
+
+static int start_decoder(scan_buffers_t *b, module_format_t format) {
+    if (format == MODULE_ZSTD) {
+        return ZSTD_isError(ZSTD_DCtx_reset(b->zstd, ZSTD_reset_session_only)) ? -1 : 0;
+    }
+    if (format == MODULE_XZ) {
+        // Reinitialising an existing stream reuses its allocations. No
+        // LZMA_CONCATENATED: decoding ends with the first stream, like zstd's
+        // first frame, so trailing bytes are ignored rather than decoded
+        b->xz_used = 1;
+        return lzma_stream_decoder(&b->xz, UINT64_MAX, 0) == LZMA_OK ? 0 : -1;
+    }
+    return 0;
+}
+
+int module_scan(const char *path, module_scan_t *out) {
+    memset(out, 0, sizeof(*out));
+    scan_buffers_t *b = scan_buffers();
+    uint8_t *buf = hash_buffer();
+    if (!b || !buf) {
+        errno = ENOMEM;
+        return -1;
+    }
+    b->tail_len = 0;
+
+    int fd = open_for_hashing(path);
+    if (fd < 0) return -1;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (!ctx || !EVP_DigestInit_ex(ctx, EVP_sha256(), NULL)) {
+        EVP_MD_CTX_free(ctx);
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    int err = 0, decoded = 0, started = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf, HASH_BUF_SIZE);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            err = errno;
+            break;
+        }
+        if (!started) {
+            out->format = detect_format(buf, n);
+            if (start_decoder(b, out->format) != 0) decoded = -1;
+            started = 1;
+        }
+        if (n == 0) {
+            if (out->format == MODULE_XZ && decoded == 0) decoded = feed_xz(b, NULL, 0, 1, &out->image_bytes);
+            break;
+        }
+        EVP_DigestUpdate(ctx, buf, n);
+        out->file_bytes += n;
+
+        // Data after a completed frame is ignored, as the kernel's decompressor does
+        if (decoded != 0) continue;
+        if (out->format == MODULE_ZSTD) decoded = feed_zstd(b, buf, n, &out->image_bytes);
+        else if (out->format == MODULE_XZ) decoded = feed_xz(b, buf, n, 0, &out->image_bytes);
+        else {
+            tail_append(b, buf, n);
+            out->image_bytes += n;
+        }
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    unsigned int len = 0;
+    if (!err && !EVP_DigestFinal_ex(ctx, out->file_digest, &len)) err = EIO;
+    EVP_MD_CTX_free(ctx);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+
+    // A truncated or corrupt stream has no trustworthy trailer
+    if (out->format == MODULE_PLAIN || decoded == 1) {
+        out->sig_status = modsig_parse(b->tail, b->tail_len, out->image_bytes, &out->sig);
+    } else {
+        out->sig_status = -1;
+    }
+    return 0;
+}
@@ -0,0 +1,293 @@
+// hashcache.c - Persistent digest cache keyed by file identity and change times
+//
+// A file whose (device, inode, size, mtime, ctime, btime) is unchanged since it
+// was last hashed reuses the stored digest. Entries are rehashed anyway once
+// they are older than the configured interval so a stale cache cannot hide a
+// change forever. The cache file is a header with a SHA-256 over the body
+// followed by fixed-size records, each trailed by its path. Records are written
+// field by field, so struct padding never reaches the file and the same cache
+// always serialises to the same bytes.
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+
+#include "integrity.h"
+
+#define CACHE_MAGIC     "S8HCACHE"
+#define CACHE_VERSION   2       // 2: records without struct padding
+
+typedef struct __attribute__((packed)) {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint8_t body_digest[SHA256_LEN];
+} cache_header_t;
+
+typedef struct {
+    file_key_t key;
+    int64_t hashed_at;
+    uint8_t digest[SHA256_LEN];
+    uint16_t path_len;
+} cache_record_t;
+
+// On disk: key, hashed_at, digest, path_len, then path_len bytes of path
+#define RECORD_SIZE (sizeof(file_key_t) + sizeof(int64_t) + SHA256_LEN + sizeof(uint16_t))
+_Static_assert(sizeof(file_key_t) == 9 * sizeof(int64_t), "file key has no padding");
+
+typedef struct {
+    char *path;
+    cache_record_t rec;
+    int used;       // seen during this run; unused entries are dropped on save
+} cache_slot_t;
+
+struct hash_cache {
+    char *file;
+    cache_slot_t *slots;
+    size_t capacity;    // power of two
+    size_t count;
+    int64_t max_age;    // seconds before a cached digest must be recomputed
+    int dirty;
+    pthread_mutex_t lock;
+    hash_cache_stats_t stats;
+};
+
+static cache_slot_t *find_slot(hash_cache_t *cache, const char *path) {
+    size_t mask = cache->capacity - 1;
+    for (size_t i = path_hash(path) & mask;; i = (i + 1) & mask) {
+        cache_slot_t *slot = &cache->slots[i];
+        if (!slot->path || strcmp(slot->path, path) == 0) return slot;
+    }
+}
+
+static int grow(hash_cache_t *cache) {
+    size_t old_capacity = cache->capacity;
+    cache_slot_t *old = cache->slots;
+
+    cache->capacity = old_capacity ? old_capacity * 2 : 256;
+    cache->slots = calloc(cache->capacity, sizeof(cache_slot_t));
+    if (!cache->slots) {
+        cache->slots = old;
+        cache->capacity = old_capacity;
+        return -1;
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].path) *find_slot(cache, old[i].path) = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+static cache_slot_t *insert_slot(hash_cache_t *cache, const char *path) {
+    if ((cache->count + 1) * 2 > cache->capacity && grow(cache) != 0) return NULL;
+    cache_slot_t *slot = find_slot(cache, path);
+    if (!slot->path) {
+        slot->path = strdup(path);
+        if (!slot->path) return NULL;
+        cache->count++;
+    }
+    return slot;
+}
+
+void file_key_from_statx(const struct statx *stx, file_key_t *key) {
+    memset(key, 0, sizeof(*key));
+    key->dev = ((uint64_t)stx->stx_dev_major << 32) | stx->stx_dev_minor;
+    key->ino = stx->stx_ino;
+    key->size = stx->stx_size;
+    key->mtime_sec = stx->stx_mtime.tv_sec;
+    key->mtime_nsec = stx->stx_mtime.tv_nsec;
+    key->ctime_sec = stx->stx_ctime.tv_sec;
+    key->ctime_nsec = stx->stx_ctime.tv_nsec;
+    // Birth time catches an inode being freed and reused with identical times
+    if (stx->stx_mask & STATX_BTIME) {
+        key->btime_sec = stx->stx_btime.tv_sec;
+        key->btime_nsec = stx->stx_btime.tv_nsec;
+    }
+}
+
+static void put_record(FILE *out, const cache_record_t *rec) {
+    fwrite(&rec->key, sizeof(rec->key), 1, out);
+    fwrite(&rec->hashed_at, sizeof(rec->hashed_at), 1, out);
+    fwrite(rec->digest, SHA256_LEN, 1, out);
+    fwrite(&rec->path_len, sizeof(rec->path_len), 1, out);
+}
+
+static void get_record(const char *data, cache_record_t *rec) {
+    memcpy(&rec->key, data, sizeof(rec->key));
+    data += sizeof(rec->key);
+    memcpy(&rec->hashed_at, data, sizeof(rec->hashed_at));
+    data += sizeof(rec->hashed_at);
+    memcpy(rec->digest, data, SHA256_LEN);
+    data += SHA256_LEN;
+    memcpy(&rec->path_len, data, sizeof(rec->path_len));
+}
+
+static int load(hash_cache_t *cache) {
+    size_t len = 0;
+    char *data = read_text_file(cache->file, &len);
+    if (!data) return errno == ENOENT ? 0 : -1;
+
+    cache_header_t hdr;
+    uint8_t digest[SHA256_LEN];
+    unsigned int dlen = 0;
+    int ok = len >= sizeof(hdr);
+    if (ok) {
+        memcpy(&hdr, data, sizeof(hdr));
+        ok = memcmp(hdr.magic, CACHE_MAGIC, 8) == 0 && hdr.version == CACHE_VERSION &&
+             EVP_Digest(data + sizeof(hdr), len - sizeof(hdr), digest, &dlen, EVP_sha256(), NULL) &&
+             memcmp(digest, hdr.body_digest, SHA256_LEN) == 0;
+    }
+
+    // A corrupt or foreign cache is discarded, which just means a full rehash
+    size_t off = sizeof(hdr);
+    for (uint32_t i = 0; ok && i < hdr.count; i++) {
+        cache_record_t rec;
+        if (off + RECORD_SIZE > len) break;
+        get_record(data + off, &rec);
+        off += RECORD_SIZE;
+        if (off + rec.path_len > len) break;
+        char *path = strndup(data + off, rec.path_len);
+        off += rec.path_len;
+        cache_slot_t *slot = path ? insert_slot(cache, path) : NULL;
+        free(path);
+        if (!slot) break;
+        slot->rec = rec;
+    }
+    free(data);
+    return 0;
+}
+
+hash_cache_t *hash_cache_open(const char *file, int64_t max_age) {
+    hash_cache_t *cache = calloc(1, sizeof(hash_cache_t));
+    if (!cache) return NULL;
+    cache->file = strdup(file);
+    cache->max_age = max_age;
+    pthread_mutex_init(&cache->lock, NULL);
+    if (!cache->file || grow(cache) != 0 || load(cache) != 0) {
+        hash_cache_close(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+int hash_cache_lookup(hash_cache_t *cache, const char *path, const struct statx *stx,
+                      uint8_t digest[SHA256_LEN]) {
+    if (!cache) return 0;
+
+    file_key_t key;
+    file_key_from_statx(stx, &key);
+    int64_t now = time(NULL);
+    int hit = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    cache_slot_t *slot = find_slot(cache, path);
+    if (slot->path) {
+        slot->used = 1;
+        if (memcmp(&slot->rec.key, &key, sizeof(key)) != 0) {
+            cache->stats.changed++;
+        } else if (cache->max_age >= 0 && now - slot->rec.hashed_at >= cache->max_age) {
+            cache->stats.expired++;
+        } else {
+            memcpy(digest, slot->rec.digest, SHA256_LEN);
+            hit = 1;
+        }
+    }
+    if (hit) {
+        cache->stats.hits++;
+        cache->stats.bytes_avoided += key.size;
+    } else {
+        cache->stats.misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return hit;
+}
+
+void hash_cache_store(hash_cache_t *cache, const char *path, const struct statx *stx,
+                      const uint8_t digest[SHA256_LEN], uint64_t bytes_hashed) {
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stats.bytes_hashed += bytes_hashed;
+    cache_slot_t *slot = insert_slot(cache, path);
+    if (slot) {
+        // Key from the statx taken before reading: a write racing the hash
+        // bumps ctime and forces a rehash next time.
+        file_key_from_statx(stx, &slot->rec.key);
+        slot->rec.hashed_at = time(NULL);
+        memcpy(slot->rec.digest, digest, SHA256_LEN);
+        slot->rec.path_len = (uint16_t)strlen(path);
+        slot->used = 1;
+        cache->dirty = 1;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int hash_cache_save(hash_cache_t *cache) {
+    if (!cache) return 0;
+
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *out = open_memstream(&body, &body_len);
+    if (!out) return -1;
+
+    // Entries for files no longer checked are dropped
+    uint32_t count = 0;
+    int dropped = 0;
+    for (size_t i = 0; i < cache->capacity; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        if (!slot->path) continue;
+        if (!slot->used) {
+            dropped = 1;
+            continue;
+        }
+        put_record(out, &slot->rec);
+        fwrite(slot->path, 1, slot->rec.path_len, out);
+        count++;
+    }
+    fclose(out);
+    if (!cache->dirty && !dropped) {
+        free(body);
+        return 0;
+    }
+
+    cache_header_t hdr;
+    unsigned int dlen = 0;
+    memcpy(hdr.magic, CACHE_MAGIC, 8);
+    hdr.version = CACHE_VERSION;
+    hdr.count = count;
+    EVP_Digest(body, body_len, hdr.body_digest, &dlen, EVP_sha256(), NULL);
+
+    size_t total = sizeof(hdr) + body_len;
+    char *data = malloc(total);
+    int rc = -1;
+    if (data) {
+        memcpy(data, &hdr, sizeof(hdr));
+        memcpy(data + sizeof(hdr), body, body_len);
+        rc = write_file_atomic(cache->file, data, total, 0600);
+        if (rc == 0) cache->dirty = 0;
+    }
+    free(data);
+    free(body);
+    return rc;
+}
+
+void hash_cache_get_stats(hash_cache_t *cache, hash_cache_stats_t *stats) {
+    if (!cache) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void hash_cache_close(hash_cache_t *cache) {
+    if (!cache) return;
+    for (size_t i = 0; i < cache->capacity; i++) free(cache->slots[i].path);
+    free(cache->slots);
+    free(cache->file);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
@@ -0,0 +1,409 @@
+// integrity.h - Shared helpers for the native integrity tools
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define SHA256_LEN          32
+#define SHA256_HEX_LEN      (2 * SHA256_LEN)
+#define HASH_BUF_SIZE       (1 << 20)   // 1 MiB aligned read buffer per thread
+#define HASH_BUF_ALIGN      4096
+
+// Locations shared by the integrity tools
+#define INTEGRITY_DIR       "/etc/security/integrity"
+#define BASELINE_FILE       INTEGRITY_DIR "/binary-checksums.sha256"
+#define BASELINE_BIN_SUFFIX ".bin"          // binary-checksums.sha256 -> binary-checksums.bin
+#define MODULE_BASELINE     "/etc/module-security/module-files.sha256"
+#define MODULE_LIST         "/etc/module-security/modules.baseline"
+#define REPORT_DIR          "/var/lib/attestation"
+#define ALERT_FILE          "/var/log/integrity-alerts.log"
+#define MODULE_EVENTS       REPORT_DIR "/module-events.json"
+#define REPORT_LOG_NAME     "reports"       // report log directory under REPORT_DIR
+#define REHASH_INTERVAL     86400   // full rehash of cached digests once a day
+
+// ---------------------------------------------------------------------------
+// util.c - logging and formatting
+// ---------------------------------------------------------------------------
+
+// Open the log/alert files and syslog identity. Either file may be NULL.
+void log_init(const char *ident, const char *log_file, const char *alert_file);
+void log_close(void);
+
+// "[YYYY-MM-DD HH:MM:SS] msg" to stdout and the log file
+void log_msg(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// "[YYYY-MM-DD HH:MM:SS] ALERT: msg" to stdout, the alert file and syslog
+void alert_msg(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// ISO-8601 timestamp with seconds and numeric offset (date -Iseconds)
+void iso_timestamp(char *out, size_t len);
+
+// FNV-1a of a NUL terminated string, for the open-addressing path tables
+uint64_t path_hash(const char *s);
+
+void hex_encode(const uint8_t *in, size_t len, char *out);
+int hex_decode(const char *hex, uint8_t *out, size_t len);
+
+// Write s as a quoted, escaped JSON string
+void json_string(FILE *out, const char *s);
+
+// Write a file atomically (tmp + rename) from a memory buffer
+int write_file_atomic(const char *path, const void *data, size_t len, int mode);
+
+// Read a whole file into a NUL terminated buffer (caller frees)
+char *read_text_file(const char *path, size_t *len_out);
+
+// mkdir -p
+int make_dirs(const char *dir);
+
+// ---------------------------------------------------------------------------
+// hash.c - file hashing
+// ---------------------------------------------------------------------------
+
+// Hash a file with SHA-256 using a per-thread aligned read buffer.
+// Returns 0 on success, -1 with errno set on failure.
+int hash_file(const char *path, uint8_t digest[SHA256_LEN], uint64_t *bytes_read);
+
+// Per-thread aligned scratch buffer of HASH_BUF_SIZE bytes (freed at thread exit)
+uint8_t *hash_buffer(void);
+
+// statx() following symlinks, requesting basic stats plus birth time
+int stat_file(const char *path, struct statx *stx);
+
+// open(O_RDONLY | O_NOATIME), falling back to a plain open for files we do not own
+int open_for_hashing(const char *path);
+
+// ---------------------------------------------------------------------------
+// hashcache.c - persistent digest cache keyed by file identity
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    int64_t btime_sec;      // zero when the filesystem does not report btime
+    int64_t btime_nsec;
+} file_key_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t changed;       // misses caused by a changed file key
+    uint64_t expired;       // misses caused by the periodic rehash interval
+    uint64_t bytes_hashed;
+    uint64_t bytes_avoided;
+} hash_cache_stats_t;
+
+typedef struct hash_cache hash_cache_t;
+
+// max_age: seconds before a cached digest is recomputed (0 = always, -1 = never)
+hash_cache_t *hash_cache_open(const char *file, int64_t max_age);
+void hash_cache_close(hash_cache_t *cache);
+int hash_cache_save(hash_cache_t *cache);
+void hash_cache_get_stats(hash_cache_t *cache, hash_cache_stats_t *stats);
+void file_key_from_statx(const struct statx *stx, file_key_t *key);
+
+// All cache functions accept a NULL cache and then behave as a permanent miss.
+// Returns 1 and fills digest when the cached entry is still valid for stx.
+int hash_cache_lookup(hash_cache_t *cache, const char *path, const struct statx *stx,
+                      uint8_t digest[SHA256_LEN]);
+void hash_cache_store(hash_cache_t *cache, const char *path, const struct statx *stx,
+                      const uint8_t digest[SHA256_LEN], uint64_t bytes_hashed);
+
+// ---------------------------------------------------------------------------
+// verity.c - fs-verity file digests
+// ---------------------------------------------------------------------------
+
+#define VERITY_MAX_DIGEST   64
+#define VERITY_TAG          "# Verity: "    // baseline line: "# Verity: sha256:<hex>  <path>"
+
+typedef struct {
+    uint16_t alg;           // FS_VERITY_HASH_ALG_*; zero when unset
+    uint16_t len;
+    uint8_t digest[VERITY_MAX_DIGEST];
+} verity_digest_t;
+
+// True if statx reports fs-verity enabled on the file
+int verity_enabled(const struct statx *stx);
+int verity_measure(const char *path, verity_digest_t *out);
+
+// True if the file has fs-verity enabled and its measurement equals expected.
+// A match proves the contents are those recorded with the expected digest.
+int verity_matches(const char *path, const struct statx *stx, const verity_digest_t *expected);
+
+// Enable fs-verity (SHA-256, 4K blocks) and return the resulting measurement.
+// Already-enabled files are just measured. The file becomes read-only.
+int verity_enable(const char *path, verity_digest_t *out);
+
+// "sha256:<hex>" form used by fsverity-utils and the baseline
+int verity_format(const verity_digest_t *digest, char *out, size_t len);
+int verity_parse(const char *text, size_t len, verity_digest_t *out);
+
+// ---------------------------------------------------------------------------
+// pool.c - parallel for over an index range
+// ---------------------------------------------------------------------------
+
+typedef void (*pool_fn)(size_t index, void *arg);
+
+// Run fn(i, arg) for every i in [0, count) on up to `threads` workers.
+// threads <= 0 selects pool_default_threads().
+int pool_run(size_t count, int threads, pool_fn fn, void *arg);
+int pool_default_threads(void);
+
+// ---------------------------------------------------------------------------
+// baseline.c - sha256sum-format baseline with "# Symlink:" comments
+// ---------------------------------------------------------------------------
+
+#define MODE_TAG            "# Mode: "      // baseline line: "# Mode: 0104755  <path>"
+
+typedef struct {
+    const char *path;           // owned for the text form, in the mapping for the binary form
+    uint8_t digest[SHA256_LEN];
+    uint32_t mode;              // st_mode when baselined; zero if not recorded
+    verity_digest_t verity;     // from a following "# Verity:" line, if any
+} baseline_entry_t;
+
+typedef struct {
+    const char *link;
+    const char *target;         // empty if the line had no "-> target"
+} baseline_symlink_t;
+
+typedef struct {
+    const char *path;
+    const baseline_entry_t *entry;  // NULL for symlink paths
+} baseline_slot_t;
+
+typedef struct baseline_map baseline_map_t;
+
+typedef struct {
+    baseline_entry_t *entries;  // binary form: decoded on first access, go through baseline_entry()
+    size_t count;
+    size_t lines;           // total lines including comments (reported as baseline_entries)
+    char *text;             // raw file contents (text form only)
+    size_t text_len;
+    baseline_symlink_t *symlinks;
+    size_t n_symlinks;
+    baseline_slot_t *index; // text form: exact-path set over entries and both symlink ends
+    size_t index_capacity;  // power of two
+    baseline_map_t *map;    // binary form: the mmapped table serves lookups
+} baseline_t;
+
+// Load either form; the binary form is recognised by its magic
+int baseline_load(const char *path, baseline_t *baseline);
+
+// Load the binary companion of a text baseline (see baseline_bin_path) when
+// it is at least as new as the text, else the text itself. For readers only:
+// baseline_save() writes back in the loaded form.
+int baseline_load_preferred(const char *path, baseline_t *baseline);
+int baseline_load_text(const char *text, size_t len, baseline_t *baseline);
+void baseline_free(baseline_t *baseline);
+
+// Rewrite the baseline in the form it was loaded from. For the text form each
+// entry's "# Mode:"/"# Verity:" lines are regenerated and all else is kept.
+int baseline_save(const char *path, const baseline_t *baseline);
+
+// Canonical text form: entries with their annotations, then symlinks
+int baseline_render_text(const baseline_t *baseline, char **text, size_t *len);
+
+// True if `path` is exactly a baselined file or one end of a recorded symlink
+int baseline_contains(const baseline_t *baseline, const char *path);
+
+// Entry with exactly this path, or NULL
+const baseline_entry_t *baseline_find(const baseline_t *baseline, const char *path);
+
+// The i-th entry, i < count. Binary form entries are decoded into entries[i]
+// on first access, so resolve them on one thread before sharing them.
+const baseline_entry_t *baseline_entry(const baseline_t *baseline, size_t i);
+
+// ---------------------------------------------------------------------------
+// baseline_bin.c - compact binary baseline
+// ---------------------------------------------------------------------------
+
+#define SHA384_LEN          48
+
+int baseline_bin_detect(const char *path);
+// Companion path of a text baseline: a .sha256 suffix is replaced by .bin
+void baseline_bin_path(const char *text_path, char *out, size_t len);
+int baseline_bin_load(const char *path, baseline_t *baseline);
+int baseline_bin_write(const char *path, const baseline_t *baseline);
+void baseline_bin_unmap(baseline_t *baseline);
+void baseline_bin_decode(const baseline_t *baseline, size_t index);
+
+// Lookup in the mmapped table; sets *entry for file records (NULL for symlinks)
+int baseline_bin_lookup(const baseline_t *baseline, const char *path, const baseline_entry_t **entry);
+
+// SHA-384 over the canonical binary body. Identical for a text baseline and
+// its binary conversion, so it can be extended into RTMR3 or put in report
+// data whichever form is deployed.
+int baseline_digest(const baseline_t *baseline, uint8_t digest[SHA384_LEN]);
+
+// ---------------------------------------------------------------------------
+// scan.c - parallel hashing of baseline entries
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    JOB_OK = 0,
+    JOB_MISSING,
+    JOB_UNREADABLE,
+} job_status_t;
+
+typedef struct {
+    const char *path;
+    const baseline_entry_t *expect;     // baseline entry, for the fs-verity fast path
+    uint8_t digest[SHA256_LEN];
+    job_status_t status;
+    int err;
+} hash_job_t;
+
+// Hash jobs[0..count) in parallel through the cache; returns how many were
+// settled by an fs-verity measurement instead of a read.
+size_t hash_jobs(hash_job_t *jobs, size_t count, int threads, hash_cache_t *cache);
+hash_job_t *hash_paths(const char *const *paths, size_t count, int threads, hash_cache_t *cache);
+hash_job_t *hash_baseline(const baseline_t *baseline, int threads, hash_cache_t *cache,
+                          size_t *verity_measured);
+
+// Alert "<label> missing/modified: path" for a job that does not match its
+// baseline entry. Returns 1 for a modification (missing files only bump *missing).
+int check_job(const hash_job_t *job, const char *label, int *missing);
+
+typedef struct {
+    size_t dirs;
+    size_t entries;         // directory entries seen
+    size_t suid_sgid;       // SUID/SGID regular files found
+    size_t unknown;         // of those, not in the baseline
+    int64_t elapsed_us;
+} suid_scan_stats_t;
+
+// Alert on SUID/SGID regular files in dirs that are not in the baseline.
+// Returns the number of alerts; stats may be NULL.
+int scan_suid(const char *const *dirs, size_t n_dirs, const baseline_t *baseline, suid_scan_stats_t *stats);
+
+// ---------------------------------------------------------------------------
+// modsig.c - appended kernel module signatures
+// ---------------------------------------------------------------------------
+
+#define MODSIG_MAX_LEN      (64 * 1024)     // largest signature blob accepted
+#define MODSIG_TRAILER_LEN  40              // struct module_signature + magic
+#define MODSIG_TAIL_MAX     (MODSIG_MAX_LEN + MODSIG_TRAILER_LEN)
+
+typedef enum {
+    MODSIG_UNSIGNED = 0,
+    MODSIG_SIGNED,
+    MODSIG_UNKNOWN,         // compressed module; the trailer is not at the end of the file
+} modsig_status_t;
+
+typedef struct {
+    char id_type[16];       // "PKCS#7" as modinfo sig_id
+    char signer[128];       // issuer CN of the signing key
+    char sig_key[128];      // issuer serial (or subject key id), "AB:CD:..."
+    char hash_algo[32];
+} modsig_t;
+
+// Parse the "~Module signature appended~" trailer of a .ko. Returns a
+// modsig_status_t, or -1 with errno set if the file cannot be read.
+int modsig_read(const char *path, modsig_t *sig);
+
+// Same, for the last tail_len bytes (up to MODSIG_TAIL_MAX) of an image of
+// image_len bytes held in memory, e.g. the end of a decompressed module
+int modsig_parse(const uint8_t *tail, size_t tail_len, uint64_t image_len, modsig_t *sig);
+
+// Module name for a module file path: basename up to the first '.', '-' as '_'
+void module_name(const char *path, char *out, size_t len);
+
+// ---------------------------------------------------------------------------
+// decompress.c - one-pass hashing of compressed modules
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    MODULE_PLAIN = 0,
+    MODULE_ZSTD,
+    MODULE_XZ,
+} module_format_t;
+
+typedef struct {
+    module_format_t format;             // from the magic, not the file name
+    uint8_t file_digest[SHA256_LEN];    // bytes on disk, as sha256sum sees them
+    uint64_t file_bytes;
+    uint64_t image_bytes;               // decompressed size
+    int sig_status;                     // modsig_status_t of the decompressed image, -1 if it did not decode
+    modsig_t sig;
+} module_scan_t;
+
+// Read a module file once, hashing it and checking the signature trailer of
+// its decompressed image. Returns -1 with errno set if the file cannot be read.
+int module_scan(const char *path, module_scan_t *out);
+
+// ---------------------------------------------------------------------------
+// merkle.c - Merkle tree over relative paths and file digests
+// ---------------------------------------------------------------------------
+
+typedef struct merkle_node merkle_node_t;
+typedef struct merkle_tree merkle_tree_t;
+
+merkle_tree_t *merkle_new(void);
+void merkle_free(merkle_tree_t *tree);
+
+// Persisted form keeps every directory node's hash; NULL if missing or invalid
+merkle_tree_t *merkle_load(const char *path);
+int merkle_save(const merkle_tree_t *tree, const char *path);
+
+// Sync a tree with a fresh listing: merkle_begin(), merkle_set() for every
+// file, then merkle_end() drops whatever was not set and returns how many
+// files went. Only directories on the path to a changed leaf become dirty.
+void merkle_begin(merkle_tree_t *tree);
+int merkle_set(merkle_tree_t *tree, const char *relpath, const uint8_t digest[SHA256_LEN]);
+size_t merkle_end(merkle_tree_t *tree);
+
+// Rehash dirty directories bottom-up; returns how many were rehashed
+size_t merkle_update(merkle_tree_t *tree);
+void merkle_root(const merkle_tree_t *tree, uint8_t digest[SHA256_LEN]);
+void merkle_counts(const merkle_tree_t *tree, size_t *files, size_t *dirs);
+
+// change: '+' only in `to`, '-' only in `from`, '~' digest differs
+typedef void (*merkle_diff_fn)(const char *path, char change, void *arg);
+
+// Report file-level differences between two updated trees, descending only
+// into directories whose hashes differ. Paths are prefix + "/" + relpath.
+// Returns the number of differences.
+size_t merkle_diff(const merkle_tree_t *from, const merkle_tree_t *to, const char *prefix,
+                   merkle_diff_fn fn, void *arg, size_t *dirs_visited);
+
+// ---------------------------------------------------------------------------
+// reportlog.c - append-only report log
+// ---------------------------------------------------------------------------
+
+#define REPORT_TYPE_LEN     32
+
+typedef struct {
+    int64_t timestamp;      // epoch seconds, non-decreasing in log order
+    uint64_t seq;
+    const char *type;
+    const char *data;       // NUL terminated JSON, valid during the callback
+    size_t len;
+} report_record_t;
+
+// Return non-zero to stop the query
+typedef int (*report_fn)(const report_record_t *rec, void *arg);
+
+// Append one report under the log lock; *seq gets its sequence number.
+// Returns 0, or -1 with errno set.
+int report_log_append(const char *dir, const char *type, const void *data, size_t len, uint64_t *seq);
+
+// Visit intact reports of `type` (NULL for any) with from <= timestamp <= to,
+// oldest first. With latest > 0 only the newest `latest` matches are visited.
+// Returns how many were visited, or -1 on error.
+long report_log_query(const char *dir, const char *type, int64_t from, int64_t to, size_t latest,
+                      report_fn fn, void *arg);
+
+// Count reports of `type` (NULL for any) with from <= timestamp <= to from the
+// segment indexes alone; payloads are neither read nor checked.
+long report_log_count(const char *dir, const char *type, int64_t from, int64_t to);
+
+#endif
@@ -0,0 +1,903 @@
+// integrity_monitor.c - Event-driven integrity monitor
+//
+// Watches the critical binary directories and the running kernel's module tree
+// with fanotify and rechecks only the files that were touched, once writes have
+// settled. Alerts use the binary-check text and go to the shared alert log and
+// syslog. A periodic full scan of both baselines remains as a safety net for
+// anything fanotify cannot see (queue overflow, changes while not running).
+//
+// Module loads and unloads are followed through kernel uevents rather than by
+// polling lsmod, so a module that is loaded and removed again between checks
+// is still recorded. The current module set and recent events are written to
+// a JSON snapshot that module-state embeds in its report.
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/fanotify.h>
+#include <sys/socket.h>
+#include <sys/statfs.h>
+#include <sys/utsname.h>
+#include <linux/netlink.h>
+
+#include "integrity.h"
+
+#define LOG_FILE            "/var/log/integrity-monitor.log"
+#define CACHE_FILE          REPORT_DIR "/monitor-hash.cache"
+#define FULL_SCAN_INTERVAL  3600    // seconds between safety-net full scans
+#define SETTLE_MS           500     // quiet period before touched files are rechecked
+#define MAX_PENDING         8192    // beyond this a full scan is cheaper
+#define MAX_LIST            64
+#define PROC_MODULES        "/proc/modules"
+#define MAX_MODULE_EVENTS   256     // load/unload events kept in the snapshot
+#define SNAPSHOT_INTERVAL   60      // seconds between snapshot rewrites without events
+#define UEVENT_RCVBUF       (1 << 20)
+
+#define WATCH_MASK (FAN_MODIFY | FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_MOVED_FROM | FAN_MOVED_TO | \
+                    FAN_CREATE | FAN_DELETE | FAN_EVENT_ON_CHILD | FAN_ONDIR)
+
+static const char *default_watch_dirs[] = {
+    "/usr/local/bin", "/usr/bin", "/usr/sbin", "/bin", "/sbin",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef struct {
+    const char *baseline_file;
+    const char *module_baseline_file;
+    const char *module_dir;
+    const char *watch_dirs[MAX_LIST];
+    size_t n_watch_dirs;
+    const char *log_file;
+    const char *alert_file;
+    const char *cache_file;     // NULL disables the hash cache
+    const char *module_list_file;
+    const char *module_events_file;
+    int64_t full_scan_interval;
+    int settle_ms;
+    int threads;
+    int once;
+} config_t;
+
+// Watched directories, looked up by the file handle fanotify reports
+typedef struct {
+    char *path;
+    fsid_t fsid;
+    unsigned int handle_bytes;
+    int handle_type;
+    unsigned char handle[MAX_HANDLE_SZ];
+} watch_dir_t;
+
+// Module names, open addressing; capacity is a power of two
+typedef struct {
+    char **slots;
+    size_t capacity;
+    size_t count;
+} name_set_t;
+
+typedef struct {
+    char time[40];
+    char name[64];
+    int loaded;                 // 1 for add, 0 for remove
+    int in_baseline;
+} module_event_t;
+
+typedef struct {
+    const config_t *cfg;
+    baseline_t binaries;
+    baseline_t modules;
+    hash_cache_t *cache;
+    int fan_fd;
+    watch_dir_t *dirs;          // open addressing, capacity is a power of two
+    size_t dir_capacity;
+    size_t dir_count;
+    char **pending;
+    size_t n_pending;
+    int overflowed;             // events were lost; rescan everything
+    int uevent_fd;
+    name_set_t module_list;     // modules.baseline names
+    name_set_t loaded;          // loaded modules, kept current from uevents
+    module_event_t events[MAX_MODULE_EVENTS];   // ring of the most recent events
+    size_t next_event;
+    size_t n_events;
+    unsigned long unexpected_loads;
+    char started[40];
+} monitor_t;
+
+static volatile sig_atomic_t stop_requested;
+static volatile sig_atomic_t reload_requested;
+
+static void on_signal(int sig) {
+    if (sig == SIGHUP) reload_requested = 1;
+    else stop_requested = 1;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t handle_hash(const fsid_t *fsid, int type, const unsigned char *handle, unsigned int len) {
+    // FNV-1a over fsid, type and handle bytes
+    uint64_t h = 1469598103934665603ULL;
+    const unsigned char *parts[] = {(const unsigned char *)fsid, (const unsigned char *)&type, handle};
+    size_t lens[] = {sizeof(*fsid), sizeof(type), len};
+    for (size_t p = 0; p < 3; p++) {
+        for (size_t i = 0; i < lens[p]; i++) {
+            h ^= parts[p][i];
+            h *= 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+static watch_dir_t *find_dir(monitor_t *mon, const fsid_t *fsid, int type,
+                             const unsigned char *handle, unsigned int len) {
+    size_t mask = mon->dir_capacity - 1;
+    for (size_t i = handle_hash(fsid, type, handle, len) & mask;; i = (i + 1) & mask) {
+        watch_dir_t *dir = &mon->dirs[i];
+        if (!dir->path || (dir->handle_type == type && dir->handle_bytes == len &&
+                           memcmp(&dir->fsid, fsid, sizeof(*fsid)) == 0 &&
+                           memcmp(dir->handle, handle, len) == 0)) {
+            return dir;
+        }
+    }
+}
+
+static int grow_dirs(monitor_t *mon) {
+    size_t old_capacity = mon->dir_capacity;
+    watch_dir_t *old = mon->dirs;
+
+    mon->dir_capacity = old_capacity ? old_capacity * 2 : 256;
+    mon->dirs = calloc(mon->dir_capacity, sizeof(watch_dir_t));
+    if (!mon->dirs) {
+        mon->dirs = old;
+        mon->dir_capacity = old_capacity;
+        return -1;
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].path) {
+            *find_dir(mon, &old[i].fsid, old[i].handle_type, old[i].handle, old[i].handle_bytes) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+static int watch_dir(monitor_t *mon, const char *path) {
+    struct {
+        struct file_handle fh;
+        unsigned char bytes[MAX_HANDLE_SZ];
+    } handle;
+    struct statfs sfs;
+    int mount_id;
+
+    handle.fh.handle_bytes = MAX_HANDLE_SZ;
+    if (name_to_handle_at(AT_FDCWD, path, &handle.fh, &mount_id, 0) != 0 || statfs(path, &sfs) != 0) {
+        return -1;
+    }
+    if ((mon->dir_count + 1) * 2 > mon->dir_capacity && grow_dirs(mon) != 0) return -1;
+
+    watch_dir_t *dir = find_dir(mon, &sfs.f_fsid, handle.fh.handle_type, handle.fh.f_handle,
+                                handle.fh.handle_bytes);
+    if (dir->path) return 0;    // already watched under another name
+    if (fanotify_mark(mon->fan_fd, FAN_MARK_ADD, WATCH_MASK, AT_FDCWD, path) != 0) return -1;
+
+    dir->path = strdup(path);
+    if (!dir->path) return -1;
+    dir->fsid = sfs.f_fsid;
+    dir->handle_type = handle.fh.handle_type;
+    dir->handle_bytes = handle.fh.handle_bytes;
+    memcpy(dir->handle, handle.fh.f_handle, handle.fh.handle_bytes);
+    mon->dir_count++;
+    return 0;
+}
+
+// nftw has no user argument
+static monitor_t *tree_monitor;
+
+static int watch_tree_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (type == FTW_D && watch_dir(tree_monitor, path) != 0) {
+        log_msg("Warning: cannot watch %s: %s", path, strerror(errno));
+    }
+    return 0;
+}
+
+static void watch_tree(monitor_t *mon, const char *root) {
+    tree_monitor = mon;
+    nftw(root, watch_tree_entry, 32, FTW_PHYS | FTW_MOUNT);
+}
+
+static int under(const char *path, const char *dir) {
+    size_t len = strlen(dir);
+    return strncmp(path, dir, len) == 0 && path[len] == '/';
+}
+
+// find -name "*.ko*"
+static int is_module_file(const char *path) {
+    const char *base = strrchr(path, '/');
+    return strstr(base ? base + 1 : path, ".ko") != NULL;
+}
+
+static int in_watch_dir(const config_t *cfg, const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash) return 0;
+    size_t len = slash - path;
+    for (size_t i = 0; i < cfg->n_watch_dirs; i++) {
+        if (strlen(cfg->watch_dirs[i]) == len && strncmp(cfg->watch_dirs[i], path, len) == 0) return 1;
+    }
+    return 0;
+}
+
+static size_t name_slot(const name_set_t *set, const char *name) {
+    size_t mask = set->capacity - 1;
+    size_t i = path_hash(name) & mask;
+    while (set->slots[i] && strcmp(set->slots[i], name) != 0) i = (i + 1) & mask;
+    return i;
+}
+
+static int name_set_contains(const name_set_t *set, const char *name) {
+    return set->capacity && set->slots[name_slot(set, name)] != NULL;
+}
+
+static int name_set_add(name_set_t *set, const char *name) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        name_set_t grown = {NULL, set->capacity ? set->capacity * 2 : 256, set->count};
+        if (!(grown.slots = calloc(grown.capacity, sizeof(char *)))) return -1;
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i]) grown.slots[name_slot(&grown, set->slots[i])] = set->slots[i];
+        }
+        free(set->slots);
+        *set = grown;
+    }
+    size_t i = name_slot(set, name);
+    if (set->slots[i]) return 0;
+    if (!(set->slots[i] = strdup(name))) return -1;
+    set->count++;
+    return 0;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void name_set_remove(name_set_t *set, const char *name) {
+    if (!set->capacity) return;
+    size_t mask = set->capacity - 1, hole = name_slot(set, name);
+    if (!set->slots[hole]) return;
+    free(set->slots[hole]);
+    set->slots[hole] = NULL;
+    set->count--;
+    for (size_t j = (hole + 1) & mask; set->slots[j]; j = (j + 1) & mask) {
+        size_t home = path_hash(set->slots[j]) & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            set->slots[hole] = set->slots[j];
+            set->slots[j] = NULL;
+            hole = j;
+        }
+    }
+}
+
+static void name_set_free(name_set_t *set) {
+    for (size_t i = 0; i < set->capacity; i++) free(set->slots[i]);
+    free(set->slots);
+    memset(set, 0, sizeof(*set));
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static const char **sorted_names(const name_set_t *set) {
+    const char **names = malloc((set->count ? set->count : 1) * sizeof(char *));
+    if (!names) return NULL;
+    size_t n = 0;
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->slots[i]) names[n++] = set->slots[i];
+    }
+    qsort(names, n, sizeof(char *), compare_names);
+    return names;
+}
+
+// First word of each line: /proc/modules, or lsmod output with its header
+static int read_module_names(const char *path, name_set_t *set) {
+    char *text = read_text_file(path, NULL);
+    if (!text) return -1;
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *name = line + strspn(line, " \t");
+        name[strcspn(name, " \t")] = '\0';
+        if (*name && strcmp(name, "Module") != 0) name_set_add(set, name);
+    }
+    free(text);
+    return 0;
+}
+
+static void load_module_list(monitor_t *mon) {
+    name_set_free(&mon->module_list);
+    if (read_module_names(mon->cfg->module_list_file, &mon->module_list) != 0) {
+        log_msg("Warning: module list %s unavailable: %s", mon->cfg->module_list_file, strerror(errno));
+    }
+}
+
+static void record_module_event(monitor_t *mon, const char *name, int loaded) {
+    module_event_t *ev = &mon->events[mon->next_event];
+    mon->next_event = (mon->next_event + 1) % MAX_MODULE_EVENTS;
+    if (mon->n_events < MAX_MODULE_EVENTS) mon->n_events++;
+
+    iso_timestamp(ev->time, sizeof(ev->time));
+    snprintf(ev->name, sizeof(ev->name), "%s", name);
+    ev->loaded = loaded;
+    ev->in_baseline = name_set_contains(&mon->module_list, ev->name);
+    if (!loaded) {
+        name_set_remove(&mon->loaded, ev->name);
+        log_msg("Module unloaded: %s", ev->name);
+        return;
+    }
+    name_set_add(&mon->loaded, ev->name);
+    if (ev->in_baseline) {
+        log_msg("Module loaded: %s", ev->name);
+    } else {
+        alert_msg("Module loaded that is not in the baseline: %s", ev->name);
+        mon->unexpected_loads++;
+    }
+}
+
+// Reconciles the tracked set with /proc/modules after events may have been lost
+static void resync_modules(monitor_t *mon) {
+    name_set_t current = {0};
+    if (read_module_names(PROC_MODULES, &current) != 0) {
+        log_msg("Warning: cannot read %s: %s", PROC_MODULES, strerror(errno));
+        return;
+    }
+    const char **tracked = sorted_names(&mon->loaded);
+    const char **now = sorted_names(&current);
+    size_t n_tracked = mon->loaded.count;
+    for (size_t i = 0; now && i < current.count; i++) {
+        if (!name_set_contains(&mon->loaded, now[i])) record_module_event(mon, now[i], 1);
+    }
+    // Removal frees only the removed name, so the remaining pointers stay valid
+    for (size_t i = 0; tracked && i < n_tracked; i++) {
+        if (!name_set_contains(&current, tracked[i])) record_module_event(mon, tracked[i], 0);
+    }
+    free(tracked);
+    free(now);
+    name_set_free(&current);
+}
+
+static int open_uevent_socket(void) {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) return -1;
+    // Coldplug and driver probing burst many events at once; FORCE needs CAP_NET_ADMIN
+    int size = UEVENT_RCVBUF;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    struct sockaddr_nl addr = {.nl_family = AF_NETLINK, .nl_groups = 1};
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+// Kernel uevents are "action@devpath" followed by NUL separated KEY=value pairs
+static int handle_uevent(monitor_t *mon, const char *buf, size_t len) {
+    const char *action = NULL, *devpath = NULL, *subsystem = NULL;
+    for (size_t off = strnlen(buf, len) + 1; off < len; off += strnlen(buf + off, len - off) + 1) {
+        const char *field = buf + off;
+        if (strncmp(field, "ACTION=", 7) == 0) action = field + 7;
+        else if (strncmp(field, "DEVPATH=", 8) == 0) devpath = field + 8;
+        else if (strncmp(field, "SUBSYSTEM=", 10) == 0) subsystem = field + 10;
+    }
+    if (!action || !devpath || !subsystem || strcmp(subsystem, "module") != 0) return 0;
+
+    // DEVPATH=/module/<name>
+    const char *name = strrchr(devpath, '/');
+    name = name ? name + 1 : devpath;
+    if (!*name) return 0;
+    if (strcmp(action, "add") == 0) record_module_event(mon, name, 1);
+    else if (strcmp(action, "remove") == 0) record_module_event(mon, name, 0);
+    else return 0;
+    return 1;
+}
+
+// Returns non-zero when the module set or event log changed
+static int read_uevents(monitor_t *mon) {
+    char buf[8192];
+    int changed = 0;
+    for (;;) {
+        struct sockaddr_nl src;
+        struct iovec iov = {buf, sizeof(buf) - 1};
+        struct msghdr msg = {.msg_name = &src, .msg_namelen = sizeof(src), .msg_iov = &iov, .msg_iovlen = 1};
+        ssize_t n = recvmsg(mon->uevent_fd, &msg, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) {
+                log_msg("Uevent queue overflow, resyncing loaded modules");
+                resync_modules(mon);
+                changed = 1;
+                continue;
+            }
+            return changed;     // EAGAIN once drained
+        }
+        // Only the kernel (port 0) speaks for module loads; udev rebroadcasts on another group
+        if (src.nl_pid != 0 || (msg.msg_flags & MSG_TRUNC)) continue;
+        buf[n] = '\0';
+        changed |= handle_uevent(mon, buf, n);
+    }
+}
+
+static void write_module_snapshot(monitor_t *mon) {
+    const char **names = sorted_names(&mon->loaded);
+    if (!names) return;
+    char timestamp[40];
+    iso_timestamp(timestamp, sizeof(timestamp));
+
+    char *json = NULL;
+    size_t json_len = 0, not_in_baseline = 0;
+    FILE *out = open_memstream(&json, &json_len);
+    if (!out) {
+        free(names);
+        return;
+    }
+    fprintf(out, "{\n    \"updated\": \"%s\",\n    \"monitor_started\": \"%s\",\n", timestamp, mon->started);
+    fprintf(out, "    \"uevents\": %s,\n", mon->uevent_fd >= 0 ? "true" : "false");
+    fprintf(out, "    \"baseline_modules\": %zu,\n", mon->module_list.count);
+    fprintf(out, "    \"loaded_modules\": [");
+    for (size_t i = 0; i < mon->loaded.count; i++) {
+        if (i) fputs(", ", out);
+        json_string(out, names[i]);
+    }
+    fprintf(out, "],\n    \"not_in_baseline\": [");
+    for (size_t i = 0; i < mon->loaded.count; i++) {
+        if (name_set_contains(&mon->module_list, names[i])) continue;
+        if (not_in_baseline++) fputs(", ", out);
+        json_string(out, names[i]);
+    }
+    // Counts on their own lines so module-monitor.sh can read them with sed
+    fprintf(out, "],\n    \"not_in_baseline_count\": %zu,\n", not_in_baseline);
+    fprintf(out, "    \"unexpected_loads\": %lu,\n", mon->unexpected_loads);
+    fprintf(out, "    \"events\": [");
+    size_t first = (mon->next_event + MAX_MODULE_EVENTS - mon->n_events) % MAX_MODULE_EVENTS;
+    for (size_t k = 0; k < mon->n_events; k++) {
+        const module_event_t *ev = &mon->events[(first + k) % MAX_MODULE_EVENTS];
+        fprintf(out, "%s\n        {\"time\": \"%s\", \"action\": \"%s\", \"module\": ",
+                k ? "," : "", ev->time, ev->loaded ? "add" : "remove");
+        json_string(out, ev->name);
+        fprintf(out, ", \"in_baseline\": %s}", ev->in_baseline ? "true" : "false");
+    }
+    fprintf(out, "%s]\n}\n", mon->n_events ? "\n    " : "");
+    fclose(out);
+
+    if (json && write_file_atomic(mon->cfg->module_events_file, json, json_len, 0644) != 0) {
+        log_msg("Warning: cannot write %s: %s", mon->cfg->module_events_file, strerror(errno));
+    }
+    free(json);
+    free(names);
+}
+
+static void start_module_tracking(monitor_t *mon) {
+    iso_timestamp(mon->started, sizeof(mon->started));
+    // Subscribe before reading /proc/modules so a load in between is not missed
+    mon->uevent_fd = open_uevent_socket();
+    if (mon->uevent_fd < 0) {
+        log_msg("Warning: module uevents unavailable (%s), polling %s instead", strerror(errno), PROC_MODULES);
+    }
+    if (read_module_names(PROC_MODULES, &mon->loaded) != 0) {
+        log_msg("Warning: cannot read %s: %s", PROC_MODULES, strerror(errno));
+    }
+    for (size_t i = 0; i < mon->loaded.capacity; i++) {
+        const char *name = mon->loaded.slots[i];
+        if (name && !name_set_contains(&mon->module_list, name)) alert_msg("Loaded module not in baseline: %s", name);
+    }
+    log_msg("Tracking %zu loaded modules against %zu baseline entries", mon->loaded.count, mon->module_list.count);
+    write_module_snapshot(mon);
+}
+
+static void load_baselines(monitor_t *mon) {
+    baseline_free(&mon->binaries);
+    baseline_free(&mon->modules);
+    if (baseline_load_preferred(mon->cfg->baseline_file, &mon->binaries) != 0) {
+        log_msg("Warning: binary baseline %s unavailable: %s", mon->cfg->baseline_file, strerror(errno));
+    }
+    if (baseline_load(mon->cfg->module_baseline_file, &mon->modules) != 0) {
+        log_msg("Warning: module baseline %s unavailable: %s", mon->cfg->module_baseline_file, strerror(errno));
+    }
+    load_module_list(mon);
+}
+
+// Every baselined binary's directory is watched, as well as the SUID scan dirs
+static void watch_all(monitor_t *mon) {
+    char dir[PATH_MAX];
+    for (size_t i = 0; i < mon->cfg->n_watch_dirs; i++) {
+        if (watch_dir(mon, mon->cfg->watch_dirs[i]) != 0 && errno != ENOENT) {
+            log_msg("Warning: cannot watch %s: %s", mon->cfg->watch_dirs[i], strerror(errno));
+        }
+    }
+    for (size_t i = 0; i < mon->binaries.count; i++) {
+        snprintf(dir, sizeof(dir), "%s", baseline_entry(&mon->binaries, i)->path);
+        char *slash = strrchr(dir, '/');
+        if (slash && slash != dir) {
+            *slash = '\0';
+            watch_dir(mon, dir);
+        }
+    }
+    watch_tree(mon, mon->cfg->module_dir);
+    log_msg("Watching %zu directories", mon->dir_count);
+}
+
+static int module_walk_violations;
+static monitor_t *walk_monitor;
+
+static int new_module_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)ftw;
+    if (type == FTW_F && S_ISREG(st->st_mode) && is_module_file(path) &&
+        !baseline_find(&walk_monitor->modules, path)) {
+        alert_msg("New module file: %s", path);
+        module_walk_violations++;
+    }
+    return 0;
+}
+
+static int full_scan(monitor_t *mon) {
+    const config_t *cfg = mon->cfg;
+    int violations = 0, missing = 0;
+    int64_t start = now_ms();
+
+    hash_job_t *jobs = hash_baseline(&mon->binaries, cfg->threads, mon->cache, NULL);
+    for (size_t i = 0; jobs && i < mon->binaries.count; i++) violations += check_job(&jobs[i], "Binary", &missing);
+    free(jobs);
+    violations += scan_suid(cfg->watch_dirs, cfg->n_watch_dirs, &mon->binaries, NULL);
+
+    jobs = hash_baseline(&mon->modules, cfg->threads, mon->cache, NULL);
+    for (size_t i = 0; jobs && i < mon->modules.count; i++) violations += check_job(&jobs[i], "Module file", &missing);
+    free(jobs);
+    if (mon->modules.count) {
+        walk_monitor = mon;
+        module_walk_violations = 0;
+        nftw(cfg->module_dir, new_module_entry, 32, FTW_PHYS | FTW_MOUNT);
+        violations += module_walk_violations;
+    }
+
+    if (hash_cache_save(mon->cache) != 0) log_msg("Warning: failed to save hash cache: %s", strerror(errno));
+    log_msg("Full scan: %zu binaries, %zu module files, %d violations, %d missing (%lld ms)",
+            mon->binaries.count, mon->modules.count, violations, missing, (long long)(now_ms() - start));
+    return violations + missing;
+}
+
+static void add_pending(monitor_t *mon, const char *dir, const char *name) {
+    char path[PATH_MAX];
+    if (strcmp(name, ".") == 0) return;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    for (size_t i = 0; i < mon->n_pending; i++) {
+        if (strcmp(mon->pending[i], path) == 0) return;
+    }
+    if (mon->n_pending == MAX_PENDING) {
+        mon->overflowed = 1;
+        return;
+    }
+    char *copy = strdup(path);
+    if (copy) mon->pending[mon->n_pending++] = copy;
+    else mon->overflowed = 1;
+}
+
+static void clear_pending(monitor_t *mon) {
+    for (size_t i = 0; i < mon->n_pending; i++) free(mon->pending[i]);
+    mon->n_pending = 0;
+}
+
+static void read_events(monitor_t *mon) {
+    char buf[64 * 1024] __attribute__((aligned(__alignof__(struct fanotify_event_metadata))));
+    for (;;) {
+        ssize_t len = read(mon->fan_fd, buf, sizeof(buf));
+        if (len <= 0) return;   // EAGAIN once drained
+
+        struct fanotify_event_metadata *meta = (struct fanotify_event_metadata *)buf;
+        for (; FAN_EVENT_OK(meta, len); meta = FAN_EVENT_NEXT(meta, len)) {
+            if (meta->vers != FANOTIFY_METADATA_VERSION) continue;
+            if (meta->mask & FAN_Q_OVERFLOW) {
+                mon->overflowed = 1;
+                continue;
+            }
+
+            char *info = (char *)meta + meta->metadata_len;
+            char *end = (char *)meta + meta->event_len;
+            while (info < end) {
+                struct fanotify_event_info_header *hdr = (struct fanotify_event_info_header *)info;
+                if (hdr->len == 0) break;
+                if (hdr->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                    struct fanotify_event_info_fid *fid = (struct fanotify_event_info_fid *)info;
+                    struct file_handle *fh = (struct file_handle *)fid->handle;
+                    const char *name = (const char *)fh->f_handle + fh->handle_bytes;
+                    fsid_t fsid;
+                    memcpy(&fsid, &fid->fsid, sizeof(fsid));
+                    watch_dir_t *dir = find_dir(mon, &fsid, fh->handle_type, fh->f_handle, fh->handle_bytes);
+                    if (dir->path) {
+                        add_pending(mon, dir->path, name);
+                        // New directories under the module tree need their own marks
+                        if ((meta->mask & FAN_ONDIR) && (meta->mask & (FAN_CREATE | FAN_MOVED_TO)) &&
+                            (strcmp(dir->path, mon->cfg->module_dir) == 0 || under(dir->path, mon->cfg->module_dir))) {
+                            char path[PATH_MAX];
+                            snprintf(path, sizeof(path), "%s/%s", dir->path, name);
+                            watch_tree(mon, path);
+                        }
+                    }
+                }
+                info += hdr->len;
+            }
+        }
+    }
+}
+
+static int check_pending(monitor_t *mon) {
+    const config_t *cfg = mon->cfg;
+    hash_job_t *jobs = calloc(mon->n_pending ? mon->n_pending : 1, sizeof(hash_job_t));
+    const char **labels = calloc(mon->n_pending ? mon->n_pending : 1, sizeof(char *));
+    size_t n_jobs = 0;
+    int violations = 0, missing = 0;
+
+    for (size_t i = 0; jobs && labels && i < mon->n_pending; i++) {
+        const char *path = mon->pending[i];
+        const baseline_entry_t *entry;
+        struct stat st;
+        int exists = stat(path, &st) == 0 && S_ISREG(st.st_mode);
+
+        if ((entry = baseline_find(&mon->binaries, path))) {
+            labels[n_jobs] = "Binary";
+        } else if ((entry = baseline_find(&mon->modules, path))) {
+            labels[n_jobs] = "Module file";
+        } else {
+            if (exists && mon->modules.count && under(path, cfg->module_dir) && is_module_file(path)) {
+                alert_msg("New module file: %s", path);
+                violations++;
+            }
+        }
+        if (entry) {
+            jobs[n_jobs].path = path;
+            jobs[n_jobs].expect = entry;
+            n_jobs++;
+        }
+        if (exists && (st.st_mode & (S_ISUID | S_ISGID)) && in_watch_dir(cfg, path) &&
+            !baseline_contains(&mon->binaries, path)) {
+            alert_msg("New SUID/SGID binary detected: %s", path);
+            violations++;
+        }
+    }
+
+    hash_jobs(jobs, n_jobs, cfg->threads, mon->cache);
+    for (size_t i = 0; i < n_jobs; i++) violations += check_job(&jobs[i], labels[i], &missing);
+    log_msg("Rechecked %zu changed paths (%zu baselined): %d violations, %d missing",
+            mon->n_pending, n_jobs, violations, missing);
+
+    free(jobs);
+    free(labels);
+    clear_pending(mon);
+    return violations + missing;
+}
+
+static int run_monitor(monitor_t *mon) {
+    const config_t *cfg = mon->cfg;
+
+    mon->fan_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+                                O_RDONLY | O_CLOEXEC);
+    if (mon->fan_fd < 0) {
+        log_msg("fanotify_init failed: %s", strerror(errno));
+        return 1;
+    }
+    mon->pending = calloc(MAX_PENDING, sizeof(char *));
+    if (!mon->pending || grow_dirs(mon) != 0) return 1;
+    watch_all(mon);
+    start_module_tracking(mon);
+
+    // Changes made while the monitor was not running are only visible to a scan
+    full_scan(mon);
+    int64_t next_full = cfg->full_scan_interval > 0 ? now_ms() + cfg->full_scan_interval * 1000 : -1;
+    int64_t next_snapshot = now_ms() + SNAPSHOT_INTERVAL * 1000;
+    int64_t last_event = 0;
+
+    while (!stop_requested) {
+        int64_t now = now_ms();
+        int64_t deadline = -1;
+        if (mon->n_pending || mon->overflowed) deadline = last_event + cfg->settle_ms;
+        if (next_full >= 0 && (deadline < 0 || next_full < deadline)) deadline = next_full;
+        if (deadline < 0 || next_snapshot < deadline) deadline = next_snapshot;
+        int timeout = deadline <= now ? 0 : (int)(deadline - now);
+
+        // A negative fd is ignored by poll, so a missing uevent socket needs no special case
+        struct pollfd pfds[2] = {
+            {.fd = mon->fan_fd, .events = POLLIN},
+            {.fd = mon->uevent_fd, .events = POLLIN},
+        };
+        int ready = poll(pfds, 2, timeout);
+        if (ready < 0 && errno != EINTR) {
+            log_msg("poll failed: %s", strerror(errno));
+            return 1;
+        }
+        if (ready > 0 && (pfds[1].revents & POLLIN) && read_uevents(mon)) {
+            write_module_snapshot(mon);
+            next_snapshot = now_ms() + SNAPSHOT_INTERVAL * 1000;
+        }
+        if (ready > 0 && (pfds[0].revents & POLLIN)) {
+            read_events(mon);
+            last_event = now_ms();
+        }
+
+        now = now_ms();
+        if (reload_requested) {
+            reload_requested = 0;
+            log_msg("Reloading baselines");
+            load_baselines(mon);
+            watch_all(mon);
+            mon->overflowed = 1;
+        }
+        if (mon->overflowed && now - last_event >= cfg->settle_ms) {
+            log_msg("Event queue overflow or reload, running full scan");
+            mon->overflowed = 0;
+            clear_pending(mon);
+            full_scan(mon);
+            if (next_full >= 0) next_full = now_ms() + cfg->full_scan_interval * 1000;
+        } else if (mon->n_pending && now - last_event >= cfg->settle_ms) {
+            check_pending(mon);
+        }
+        if (next_full >= 0 && now >= next_full) {
+            full_scan(mon);
+            next_full = now_ms() + cfg->full_scan_interval * 1000;
+        }
+        // The snapshot's timestamp doubles as a liveness signal for module-state
+        if (now_ms() >= next_snapshot) {
+            if (mon->uevent_fd < 0) resync_modules(mon);
+            write_module_snapshot(mon);
+            next_snapshot = now_ms() + SNAPSHOT_INTERVAL * 1000;
+        }
+    }
+
+    log_msg("Stopping integrity monitor");
+    hash_cache_save(mon->cache);
+    return 0;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [OPTIONS]\n", prog_name);
+    printf("Options:\n");
+    printf("  --baseline FILE           Binary baseline (default: %s)\n", BASELINE_FILE);
+    printf("  --module-baseline FILE    Module file baseline (default: %s)\n", MODULE_BASELINE);
+    printf("  --module-dir DIR          Module tree (default: /lib/modules/$(uname -r))\n");
+    printf("  --watch DIR               Binary/SUID directory to watch, repeatable (default: standard bin dirs)\n");
+    printf("  --log-file FILE           Log file (default: %s)\n", LOG_FILE);
+    printf("  --alert-file FILE         Alert file (default: %s)\n", ALERT_FILE);
+    printf("  --cache FILE              Digest cache (default: %s)\n", CACHE_FILE);
+    printf("  --no-cache                Hash every file, do not read or update the cache\n");
+    printf("  --module-list FILE        Expected loaded modules, lsmod format (default: %s)\n", MODULE_LIST);
+    printf("  --module-events FILE      Module load snapshot to write (default: %s)\n", MODULE_EVENTS);
+    printf("  --full-scan-interval S    Seconds between full scans, 0 disables (default: %d)\n", FULL_SCAN_INTERVAL);
+    printf("  --settle-ms MS            Quiet period before rechecking touched files (default: %d)\n", SETTLE_MS);
+    printf("  --threads N               Hashing threads (default: 2x online CPUs)\n");
+    printf("  --once                    Run one full scan and exit with the violation count\n");
+    printf("  -h, --help                Show this help message\n");
+    printf("\nSIGHUP reloads the baselines and module list and rescans.\n");
+}
+
+enum {
+    OPT_BASELINE = 256, OPT_MODULE_BASELINE, OPT_MODULE_DIR, OPT_WATCH, OPT_LOG_FILE, OPT_ALERT_FILE,
+    OPT_CACHE, OPT_NO_CACHE, OPT_MODULE_LIST, OPT_MODULE_EVENTS, OPT_FULL_SCAN_INTERVAL, OPT_SETTLE_MS,
+    OPT_THREADS, OPT_ONCE,
+};
+
+int main(int argc, char *argv[]) {
+    config_t cfg = {
+        .baseline_file = BASELINE_FILE,
+        .module_baseline_file = MODULE_BASELINE,
+        .log_file = LOG_FILE,
+        .alert_file = ALERT_FILE,
+        .cache_file = CACHE_FILE,
+        .module_list_file = MODULE_LIST,
+        .module_events_file = MODULE_EVENTS,
+        .full_scan_interval = FULL_SCAN_INTERVAL,
+        .settle_ms = SETTLE_MS,
+    };
+
+    static struct option long_options[] = {
+        {"baseline", required_argument, 0, OPT_BASELINE},
+        {"module-baseline", required_argument, 0, OPT_MODULE_BASELINE},
+        {"module-dir", required_argument, 0, OPT_MODULE_DIR},
+        {"watch", required_argument, 0, OPT_WATCH},
+        {"log-file", required_argument, 0, OPT_LOG_FILE},
+        {"alert-file", required_argument, 0, OPT_ALERT_FILE},
+        {"cache", required_argument, 0, OPT_CACHE},
+        {"no-cache", no_argument, 0, OPT_NO_CACHE},
+        {"module-list", required_argument, 0, OPT_MODULE_LIST},
+        {"module-events", required_argument, 0, OPT_MODULE_EVENTS},
+        {"full-scan-interval", required_argument, 0, OPT_FULL_SCAN_INTERVAL},
+        {"settle-ms", required_argument, 0, OPT_SETTLE_MS},
+        {"threads", required_argument, 0, OPT_THREADS},
+        {"once", no_argument, 0, OPT_ONCE},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_BASELINE: cfg.baseline_file = optarg; break;
+            case OPT_MODULE_BASELINE: cfg.module_baseline_file = optarg; break;
+            case OPT_MODULE_DIR: cfg.module_dir = optarg; break;
+            case OPT_WATCH:
+                if (cfg.n_watch_dirs < MAX_LIST) cfg.watch_dirs[cfg.n_watch_dirs++] = optarg;
+                break;
+            case OPT_LOG_FILE: cfg.log_file = optarg; break;
+            case OPT_ALERT_FILE: cfg.alert_file = optarg; break;
+            case OPT_CACHE: cfg.cache_file = optarg; break;
+            case OPT_NO_CACHE: cfg.cache_file = NULL; break;
+            case OPT_MODULE_LIST: cfg.module_list_file = optarg; break;
+            case OPT_MODULE_EVENTS: cfg.module_events_file = optarg; break;
+            case OPT_FULL_SCAN_INTERVAL: cfg.full_scan_interval = atoll(optarg); break;
+            case OPT_SETTLE_MS: cfg.settle_ms = atoi(optarg); break;
+            case OPT_THREADS: cfg.threads = atoi(optarg); break;
+            case OPT_ONCE: cfg.once = 1; break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!cfg.n_watch_dirs) {
+        for (size_t i = 0; i < COUNT(default_watch_dirs); i++) cfg.watch_dirs[cfg.n_watch_dirs++] = default_watch_dirs[i];
+    }
+    char module_dir[PATH_MAX];
+    if (!cfg.module_dir) {
+        struct utsname uts;
+        uname(&uts);
+        snprintf(module_dir, sizeof(module_dir), "/lib/modules/%s", uts.release);
+        cfg.module_dir = module_dir;
+    }
+
+    log_init("integrity-monitor", cfg.log_file, cfg.alert_file);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;   // no SA_RESTART: signals interrupt poll()
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    monitor_t mon;
+    memset(&mon, 0, sizeof(mon));
+    mon.cfg = &cfg;
+    mon.fan_fd = -1;
+    mon.uevent_fd = -1;
+    load_baselines(&mon);
+    if (cfg.cache_file) {
+        mon.cache = hash_cache_open(cfg.cache_file, REHASH_INTERVAL);
+        if (!mon.cache) log_msg("Warning: hash cache %s unusable, hashing everything", cfg.cache_file);
+    }
+
+    int rc;
+    if (cfg.once) {
+        rc = full_scan(&mon);
+    } else {
+        log_msg("Starting integrity monitor");
+        rc = run_monitor(&mon);
+    }
+
+    hash_cache_close(mon.cache);
+    baseline_free(&mon.binaries);
+    baseline_free(&mon.modules);
+    name_set_free(&mon.module_list);
+    name_set_free(&mon.loaded);
+    log_close();
+    return rc > 255 ? 255 : rc;
+}
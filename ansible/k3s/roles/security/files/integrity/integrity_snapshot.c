@@ -0,0 +1,364 @@
+// integrity_snapshot.c - One canonical document of the node's runtime integrity
+//
+// The attestation service binds the SHA-256 of this output into the report
+// data of a single TDX quote, so the document has to be reproducible byte for
+// byte: object keys are emitted in byte order at every level, there is no
+// whitespace, numbers are integers and anything that cannot be read is null.
+// A verifier hashes the bytes exactly as received, without the final newline.
+//
+// It runs as the unprivileged attestation service user, so it only measures
+// what that user can read: the binary baseline is re-verified live (through a
+// cache of its own), /proc and /sys are read directly, and the current state
+// documents of binary-check, module-state and the monitors are embedded as
+// strings. Root-only files such as the IMA measurement count come out null.
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+
+#include "integrity.h"
+
+#define SNAPSHOT_VERSION    1
+#define CACHE_FILE          "/var/cache/attestation-service/integrity-hash.cache"
+#define PROC_MODULES        "/proc/modules"
+#define IMA_DIR             "/sys/kernel/security/ima"
+#define NONCE_HEX_LEN       64      // the first half of the TDX report data
+
+typedef struct {
+    const char *nonce;
+    const char *baseline_file;
+    const char *cache_file;     // NULL disables the hash cache
+    const char *report_dir;
+    const char *proc_modules;
+    int threads;
+} config_t;
+
+// Kept in byte order; the table is emitted as-is
+static const struct {
+    const char *name;
+    const char *path;
+} sysctls[] = {
+    {"kernel.dmesg_restrict", "/proc/sys/kernel/dmesg_restrict"},
+    {"kernel.kexec_load_disabled", "/proc/sys/kernel/kexec_load_disabled"},
+    {"kernel.kptr_restrict", "/proc/sys/kernel/kptr_restrict"},
+    {"kernel.modules_disabled", "/proc/sys/kernel/modules_disabled"},
+    {"kernel.perf_event_paranoid", "/proc/sys/kernel/perf_event_paranoid"},
+    {"kernel.randomize_va_space", "/proc/sys/kernel/randomize_va_space"},
+    {"kernel.unprivileged_bpf_disabled", "/proc/sys/kernel/unprivileged_bpf_disabled"},
+    {"kernel.unprivileged_userns_clone", "/proc/sys/kernel/unprivileged_userns_clone"},
+    {"kernel.yama.ptrace_scope", "/proc/sys/kernel/yama/ptrace_scope"},
+};
+
+// State documents embedded verbatim, also in byte order of their keys
+static const struct {
+    const char *key;
+    const char *file;
+} documents[] = {
+    {"binary_state", "binary-state-current.json"},
+    {"module_attestation", "module-attestation-current.json"},
+    {"module_events", "module-events.json"},
+    {"module_state", "module-state-current.json"},
+};
+
+static int by_string(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static void sha256_hex(const void *data, size_t len, char out[SHA256_HEX_LEN + 1]) {
+    uint8_t digest[SHA256_LEN];
+    unsigned int n = 0;
+    EVP_Digest(data, len, digest, &n, EVP_sha256(), NULL);
+    hex_encode(digest, SHA256_LEN, out);
+}
+
+// Integer sysctl/sysfs value as JSON, null when the knob is absent or unreadable
+static void json_int_file(FILE *out, const char *path) {
+    char *text = read_text_file(path, NULL);
+    char *end = NULL;
+    long long v = text ? strtoll(text, &end, 10) : 0;
+    if (text && end != text) fprintf(out, "%lld", v);
+    else fputs("null", out);
+    free(text);
+}
+
+static void json_string_list(FILE *out, char **items, size_t count) {
+    qsort(items, count, sizeof(char *), by_string);
+    fputc('[', out);
+    for (size_t i = 0; i < count; i++) {
+        if (i) fputc(',', out);
+        json_string(out, items[i]);
+    }
+    fputc(']', out);
+}
+
+static void write_binaries(FILE *out, const config_t *cfg) {
+    baseline_t baseline;
+    if (baseline_load_preferred(cfg->baseline_file, &baseline) != 0) {
+        fprintf(stderr, "Cannot load %s: %s\n", cfg->baseline_file, strerror(errno));
+        fputs("null", out);
+        return;
+    }
+
+    hash_cache_t *cache = cfg->cache_file ? hash_cache_open(cfg->cache_file, REHASH_INTERVAL) : NULL;
+    hash_job_t *jobs = hash_baseline(&baseline, cfg->threads, cache, NULL);
+    if (cache) {
+        if (hash_cache_save(cache) != 0) {
+            fprintf(stderr, "Warning: failed to save %s: %s\n", cfg->cache_file, strerror(errno));
+        }
+        hash_cache_close(cache);
+    }
+
+    uint8_t digest[SHA384_LEN];
+    char digest_hex[2 * SHA384_LEN + 1];
+    int have_digest = baseline_digest(&baseline, digest) == 0;
+    if (have_digest) hex_encode(digest, SHA384_LEN, digest_hex);
+
+    size_t n = baseline.count;
+    char **missing = calloc(n ? n : 1, sizeof(char *));
+    char **modified = calloc(n ? n : 1, sizeof(char *));
+    char **unreadable = calloc(n ? n : 1, sizeof(char *));
+    size_t n_missing = 0, n_modified = 0, n_unreadable = 0, verified = 0;
+    if (!jobs || !missing || !modified || !unreadable) {
+        fprintf(stderr, "Out of memory\n");
+        fputs("null", out);
+        goto done;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const hash_job_t *job = &jobs[i];
+        char *path = (char *)job->path;
+        if (job->status == JOB_MISSING) missing[n_missing++] = path;
+        else if (job->status == JOB_UNREADABLE) unreadable[n_unreadable++] = path;
+        else if (memcmp(job->digest, job->expect->digest, SHA256_LEN) != 0) modified[n_modified++] = path;
+        else verified++;
+    }
+
+    fprintf(out, "{\"baseline_entries\":%zu,\"baseline_sha384\":", n);
+    if (have_digest) json_string(out, digest_hex);
+    else fputs("null", out);
+    fputs(",\"missing\":", out);
+    json_string_list(out, missing, n_missing);
+    fputs(",\"modified\":", out);
+    json_string_list(out, modified, n_modified);
+    fputs(",\"unreadable\":", out);
+    json_string_list(out, unreadable, n_unreadable);
+    fprintf(out, ",\"verified\":%zu}", verified);
+
+done:
+    free(missing);
+    free(modified);
+    free(unreadable);
+    free(jobs);
+    baseline_free(&baseline);
+}
+
+static void write_ima(FILE *out) {
+    fputs("{\"runtime_measurements_count\":", out);
+    json_int_file(out, IMA_DIR "/runtime_measurements_count");
+    fputs(",\"violations\":", out);
+    json_int_file(out, IMA_DIR "/violations");
+    fputc('}', out);
+}
+
+static void write_kernel(FILE *out) {
+    struct utsname uts;
+    if (uname(&uts) != 0) uts.release[0] = '\0';
+
+    size_t len = 0;
+    char *text = read_text_file("/proc/sys/kernel/random/boot_id", &len);
+    if (text) text[strcspn(text, "\n")] = '\0';
+    fputs("{\"boot_id\":", out);
+    if (text) json_string(out, text);
+    else fputs("null", out);
+    free(text);
+
+    char cmdline_hash[SHA256_HEX_LEN + 1];
+    text = read_text_file("/proc/cmdline", &len);
+    fputs(",\"cmdline_sha256\":", out);
+    if (text) {
+        sha256_hex(text, len, cmdline_hash);
+        json_string(out, cmdline_hash);
+    } else {
+        fputs("null", out);
+    }
+    free(text);
+
+    fputs(",\"release\":", out);
+    json_string(out, uts.release);
+    fputs(",\"tainted\":", out);
+    json_int_file(out, "/proc/sys/kernel/tainted");
+    fputc('}', out);
+}
+
+static void write_modules(FILE *out, const config_t *cfg) {
+    char *text = read_text_file(cfg->proc_modules, NULL);
+    if (!text) {
+        fprintf(stderr, "Cannot read %s: %s\n", cfg->proc_modules, strerror(errno));
+        fputs("null", out);
+        return;
+    }
+
+    size_t count = 0, cap = 256;
+    char **names = malloc(cap * sizeof(char *));
+    for (char *line = text; names && *line; ) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        else next = line + strlen(line);
+        char *end = line + strcspn(line, " ");
+        *end = '\0';
+        if (*line) {
+            if (count == cap) {
+                char **grown = realloc(names, 2 * cap * sizeof(char *));
+                if (!grown) {
+                    free(names);
+                    names = NULL;
+                    break;
+                }
+                names = grown;
+                cap *= 2;
+            }
+            names[count++] = line;
+        }
+        line = next;
+    }
+
+    if (!names) {
+        fprintf(stderr, "Out of memory\n");
+        fputs("null", out);
+    } else {
+        fputs("{\"loaded\":", out);
+        json_string_list(out, names, count);
+        fprintf(out, ",\"loaded_count\":%zu}", count);
+    }
+    free(names);
+    free(text);
+}
+
+static void write_documents(FILE *out, const config_t *cfg) {
+    fputc('{', out);
+    for (size_t i = 0; i < sizeof(documents) / sizeof(documents[0]); i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", cfg->report_dir, documents[i].file);
+        if (i) fputc(',', out);
+        json_string(out, documents[i].key);
+        fputc(':', out);
+
+        size_t len = 0;
+        char *text = read_text_file(path, &len);
+        // A document with an embedded NUL cannot be carried as a JSON string
+        if (!text || strlen(text) != len) {
+            fputs("null", out);
+            free(text);
+            continue;
+        }
+        char digest[SHA256_HEX_LEN + 1];
+        sha256_hex(text, len, digest);
+        fputs("{\"document\":", out);
+        json_string(out, text);
+        fputs(",\"sha256\":", out);
+        json_string(out, digest);
+        fputc('}', out);
+        free(text);
+    }
+    fputc('}', out);
+}
+
+static int write_snapshot(FILE *out, const config_t *cfg) {
+    fputs("{\"binaries\":", out);
+    write_binaries(out, cfg);
+    fputs(",\"ima\":", out);
+    write_ima(out);
+    fputs(",\"kernel\":", out);
+    write_kernel(out);
+    fputs(",\"modules\":", out);
+    write_modules(out, cfg);
+    fputs(",\"nonce\":", out);
+    json_string(out, cfg->nonce);
+    fputs(",\"reports\":", out);
+    write_documents(out, cfg);
+    fputs(",\"sysctl\":{", out);
+    for (size_t i = 0; i < sizeof(sysctls) / sizeof(sysctls[0]); i++) {
+        if (i) fputc(',', out);
+        json_string(out, sysctls[i].name);
+        fputc(':', out);
+        json_int_file(out, sysctls[i].path);
+    }
+    fprintf(out, "},\"timestamp\":%lld,\"version\":%d}\n", (long long)time(NULL), SNAPSHOT_VERSION);
+    return fflush(out) == 0 && !ferror(out) ? 0 : -1;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s --nonce NONCE [OPTIONS]\n", prog_name);
+    printf("Print the canonical integrity snapshot that the attestation service binds into a quote.\n");
+    printf("Options:\n");
+    printf("  --nonce NONCE         Verifier nonce to embed, 64 hex characters (required)\n");
+    printf("  --baseline FILE       Binary baseline (default: %s)\n", BASELINE_FILE);
+    printf("  --cache FILE          Digest cache (default: %s)\n", CACHE_FILE);
+    printf("  --no-cache            Hash every file, do not read or update the cache\n");
+    printf("  --report-dir DIR      Directory of the current state documents (default: %s)\n", REPORT_DIR);
+    printf("  --proc-modules FILE   Loaded module list (default: %s)\n", PROC_MODULES);
+    printf("  --threads N           Hashing threads (default: 2x online CPUs)\n");
+    printf("  -h, --help            Show this help message\n");
+}
+
+enum {
+    OPT_NONCE = 256, OPT_BASELINE, OPT_CACHE, OPT_NO_CACHE, OPT_REPORT_DIR,
+    OPT_PROC_MODULES, OPT_THREADS,
+};
+
+int main(int argc, char *argv[]) {
+    config_t cfg = {
+        .baseline_file = BASELINE_FILE,
+        .cache_file = CACHE_FILE,
+        .report_dir = REPORT_DIR,
+        .proc_modules = PROC_MODULES,
+    };
+
+    static struct option long_options[] = {
+        {"nonce", required_argument, 0, OPT_NONCE},
+        {"baseline", required_argument, 0, OPT_BASELINE},
+        {"cache", required_argument, 0, OPT_CACHE},
+        {"no-cache", no_argument, 0, OPT_NO_CACHE},
+        {"report-dir", required_argument, 0, OPT_REPORT_DIR},
+        {"proc-modules", required_argument, 0, OPT_PROC_MODULES},
+        {"threads", required_argument, 0, OPT_THREADS},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_NONCE: cfg.nonce = optarg; break;
+            case OPT_BASELINE: cfg.baseline_file = optarg; break;
+            case OPT_CACHE: cfg.cache_file = optarg; break;
+            case OPT_NO_CACHE: cfg.cache_file = NULL; break;
+            case OPT_REPORT_DIR: cfg.report_dir = optarg; break;
+            case OPT_PROC_MODULES: cfg.proc_modules = optarg; break;
+            case OPT_THREADS: cfg.threads = atoi(optarg); break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!cfg.nonce || strlen(cfg.nonce) != NONCE_HEX_LEN ||
+        strspn(cfg.nonce, "0123456789abcdefABCDEF") != NONCE_HEX_LEN) {
+        fprintf(stderr, "--nonce is required (%d hex characters)\n", NONCE_HEX_LEN);
+        return 1;
+    }
+
+    if (write_snapshot(stdout, &cfg) != 0) {
+        fprintf(stderr, "Failed to write snapshot: %s\n", strerror(errno));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,411 @@
+// merkle.c - Merkle tree over a directory hierarchy of file digests
+//
+// Leaves carry the file's SHA-256. A directory hashes its children in name
+// order as SHA-256("D" || for each child: type || name || NUL || hash), with
+// type 'F' or 'D', so the root commits to every relative path and digest
+// beneath it. Setting a leaf marks only its ancestors dirty; merkle_update()
+// rehashes just those, and merkle_diff() skips subtrees whose hashes agree.
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "integrity.h"
+
+#define TREE_MAGIC      "S8MERKLE"
+#define TREE_VERSION    1
+
+struct merkle_node {
+    char *name;                 // entry name; "" for the root
+    int is_dir;
+    int dirty;                  // directory hash needs recomputing
+    int seen;                   // touched since merkle_begin()
+    uint8_t hash[SHA256_LEN];
+    merkle_node_t **children;   // sorted by name
+    size_t n_children;
+    size_t cap;
+};
+
+struct merkle_tree {
+    merkle_node_t *root;
+    size_t rehashed;            // directories rehashed by the last update
+};
+
+static merkle_node_t *new_node(const char *name, size_t len, int is_dir) {
+    merkle_node_t *node = calloc(1, sizeof(*node));
+    if (!node) return NULL;
+    node->name = strndup(name, len);
+    if (!node->name) {
+        free(node);
+        return NULL;
+    }
+    node->is_dir = is_dir;
+    node->dirty = is_dir;
+    return node;
+}
+
+static void free_node(merkle_node_t *node) {
+    if (!node) return;
+    for (size_t i = 0; i < node->n_children; i++) free_node(node->children[i]);
+    free(node->children);
+    free(node->name);
+    free(node);
+}
+
+merkle_tree_t *merkle_new(void) {
+    merkle_tree_t *tree = calloc(1, sizeof(*tree));
+    if (!tree) return NULL;
+    tree->root = new_node("", 0, 1);
+    if (!tree->root) {
+        free(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+void merkle_free(merkle_tree_t *tree) {
+    if (!tree) return;
+    free_node(tree->root);
+    free(tree);
+}
+
+static int name_cmp(const char *name, size_t len, const char *other) {
+    int c = strncmp(name, other, len);
+    if (c != 0) return c;
+    return other[len] ? -1 : 0;
+}
+
+// Index of the child called name, or the insertion point (with *found = 0)
+static size_t find_child(const merkle_node_t *dir, const char *name, size_t len, int *found) {
+    size_t lo = 0, hi = dir->n_children;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = name_cmp(name, len, dir->children[mid]->name);
+        if (c == 0) {
+            *found = 1;
+            return mid;
+        }
+        if (c < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    *found = 0;
+    return lo;
+}
+
+static merkle_node_t *insert_child(merkle_node_t *dir, size_t at, merkle_node_t *child) {
+    if (!child) return NULL;
+    if (dir->n_children == dir->cap) {
+        size_t cap = dir->cap ? dir->cap * 2 : 8;
+        merkle_node_t **grown = realloc(dir->children, cap * sizeof(merkle_node_t *));
+        if (!grown) {
+            free_node(child);
+            return NULL;
+        }
+        dir->children = grown;
+        dir->cap = cap;
+    }
+    memmove(&dir->children[at + 1], &dir->children[at], (dir->n_children - at) * sizeof(merkle_node_t *));
+    dir->children[at] = child;
+    dir->n_children++;
+    return child;
+}
+
+int merkle_set(merkle_tree_t *tree, const char *relpath, const uint8_t digest[SHA256_LEN]) {
+    merkle_node_t *path[PATH_MAX / 2];
+    size_t depth = 0;
+    merkle_node_t *dir = tree->root;
+    const char *p = relpath;
+
+    while (*p == '/') p++;
+    for (;;) {
+        size_t len = strcspn(p, "/");
+        int last = p[len] == '\0', found;
+        if (len == 0 || depth == sizeof(path) / sizeof(path[0])) return -1;
+        path[depth++] = dir;
+
+        size_t at = find_child(dir, p, len, &found);
+        merkle_node_t *child = found ? dir->children[at] : NULL;
+        if (child && child->is_dir == last) {
+            // A file replaced by a directory or the other way round
+            free_node(child);
+            memmove(&dir->children[at], &dir->children[at + 1], (dir->n_children - at - 1) * sizeof(merkle_node_t *));
+            dir->n_children--;
+            child = NULL;
+        }
+        if (!child) {
+            child = insert_child(dir, at, new_node(p, len, !last));
+            if (!child) return -1;
+            for (size_t i = 0; i < depth; i++) path[i]->dirty = 1;
+        }
+        child->seen = 1;
+        if (last) {
+            if (memcmp(child->hash, digest, SHA256_LEN) != 0) {
+                memcpy(child->hash, digest, SHA256_LEN);
+                for (size_t i = 0; i < depth; i++) path[i]->dirty = 1;
+            }
+            for (size_t i = 0; i < depth; i++) path[i]->seen = 1;
+            return 0;
+        }
+        dir = child;
+        p += len;
+        while (*p == '/') p++;
+        if (!*p) return -1;
+    }
+}
+
+static void clear_seen(merkle_node_t *node) {
+    node->seen = 0;
+    for (size_t i = 0; i < node->n_children; i++) clear_seen(node->children[i]);
+}
+
+void merkle_begin(merkle_tree_t *tree) {
+    clear_seen(tree->root);
+}
+
+static void count_leaves(const merkle_node_t *node, size_t *files, size_t *dirs) {
+    if (!node->is_dir) {
+        (*files)++;
+        return;
+    }
+    (*dirs)++;
+    for (size_t i = 0; i < node->n_children; i++) count_leaves(node->children[i], files, dirs);
+}
+
+// Drop children not set since merkle_begin(), and directories left empty
+static size_t prune(merkle_node_t *dir) {
+    size_t removed = 0, kept = 0;
+    for (size_t i = 0; i < dir->n_children; i++) {
+        merkle_node_t *child = dir->children[i];
+        if (child->is_dir && child->seen) {
+            removed += prune(child);
+            if (child->dirty) dir->dirty = 1;
+        }
+        if (!child->seen || (child->is_dir && child->n_children == 0)) {
+            size_t files = 0, dirs = 0;
+            count_leaves(child, &files, &dirs);
+            removed += files;
+            free_node(child);
+            dir->dirty = 1;
+            continue;
+        }
+        dir->children[kept++] = child;
+    }
+    dir->n_children = kept;
+    return removed;
+}
+
+size_t merkle_end(merkle_tree_t *tree) {
+    tree->root->seen = 1;
+    return prune(tree->root);
+}
+
+static void hash_dir(merkle_node_t *dir, EVP_MD_CTX *ctx, size_t *rehashed) {
+    if (!dir->dirty) return;
+    for (size_t i = 0; i < dir->n_children; i++) {
+        if (dir->children[i]->is_dir) hash_dir(dir->children[i], ctx, rehashed);
+    }
+    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+    EVP_DigestUpdate(ctx, "D", 1);
+    for (size_t i = 0; i < dir->n_children; i++) {
+        const merkle_node_t *child = dir->children[i];
+        EVP_DigestUpdate(ctx, child->is_dir ? "D" : "F", 1);
+        EVP_DigestUpdate(ctx, child->name, strlen(child->name) + 1);
+        EVP_DigestUpdate(ctx, child->hash, SHA256_LEN);
+    }
+    EVP_DigestFinal_ex(ctx, dir->hash, NULL);
+    dir->dirty = 0;
+    (*rehashed)++;
+}
+
+size_t merkle_update(merkle_tree_t *tree) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    tree->rehashed = 0;
+    if (ctx) hash_dir(tree->root, ctx, &tree->rehashed);
+    EVP_MD_CTX_free(ctx);
+    return tree->rehashed;
+}
+
+void merkle_root(const merkle_tree_t *tree, uint8_t digest[SHA256_LEN]) {
+    memcpy(digest, tree->root->hash, SHA256_LEN);
+}
+
+void merkle_counts(const merkle_tree_t *tree, size_t *files, size_t *dirs) {
+    *files = *dirs = 0;
+    count_leaves(tree->root, files, dirs);
+}
+
+// ---------------------------------------------------------------------------
+// Diff
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    merkle_diff_fn fn;
+    void *arg;
+    char path[PATH_MAX];
+    size_t changes;
+    size_t visited;
+} diff_ctx_t;
+
+static void report_subtree(diff_ctx_t *ctx, const merkle_node_t *node, size_t len, char change) {
+    if (!node->is_dir) {
+        ctx->changes++;
+        ctx->fn(ctx->path, change, ctx->arg);
+        return;
+    }
+    for (size_t i = 0; i < node->n_children; i++) {
+        int n = snprintf(ctx->path + len, sizeof(ctx->path) - len, "/%s", node->children[i]->name);
+        if (n < 0 || (size_t)n >= sizeof(ctx->path) - len) continue;
+        report_subtree(ctx, node->children[i], len + n, change);
+    }
+    ctx->path[len] = '\0';
+}
+
+static void diff_dirs(diff_ctx_t *ctx, const merkle_node_t *a, const merkle_node_t *b, size_t len) {
+    ctx->visited++;
+    size_t i = 0, j = 0;
+    while (i < a->n_children || j < b->n_children) {
+        const merkle_node_t *ca = i < a->n_children ? a->children[i] : NULL;
+        const merkle_node_t *cb = j < b->n_children ? b->children[j] : NULL;
+        int c = !ca ? 1 : !cb ? -1 : strcmp(ca->name, cb->name);
+        const char *name = c <= 0 ? ca->name : cb->name;
+        int n = snprintf(ctx->path + len, sizeof(ctx->path) - len, "/%s", name);
+        if (n < 0 || (size_t)n >= sizeof(ctx->path) - len) n = 0;
+
+        if (c < 0) {
+            report_subtree(ctx, ca, len + n, '-');
+            i++;
+        } else if (c > 0) {
+            report_subtree(ctx, cb, len + n, '+');
+            j++;
+        } else {
+            if (ca->is_dir != cb->is_dir) {
+                report_subtree(ctx, ca, len + n, '-');
+                report_subtree(ctx, cb, len + n, '+');
+            } else if (memcmp(ca->hash, cb->hash, SHA256_LEN) != 0) {
+                if (ca->is_dir) {
+                    diff_dirs(ctx, ca, cb, len + n);
+                } else {
+                    ctx->changes++;
+                    ctx->fn(ctx->path, '~', ctx->arg);
+                }
+            }
+            i++;
+            j++;
+        }
+        ctx->path[len] = '\0';
+    }
+}
+
+size_t merkle_diff(const merkle_tree_t *from, const merkle_tree_t *to, const char *prefix,
+                   merkle_diff_fn fn, void *arg, size_t *dirs_visited) {
+    diff_ctx_t ctx = {.fn = fn, .arg = arg};
+    size_t len = strlen(prefix);
+    while (len && prefix[len - 1] == '/') len--;
+    if (len >= sizeof(ctx.path)) len = 0;
+    memcpy(ctx.path, prefix, len);
+    ctx.path[len] = '\0';
+
+    if (memcmp(from->root->hash, to->root->hash, SHA256_LEN) != 0) diff_dirs(&ctx, from->root, to->root, len);
+    if (dirs_visited) *dirs_visited = ctx.visited;
+    return ctx.changes;
+}
+
+// ---------------------------------------------------------------------------
+// Persistence: magic, version, then nodes in pre-order as
+// [u8 is_dir][u16 name_len][name][hash][u32 n_children if dir]
+// ---------------------------------------------------------------------------
+
+static void write_node(FILE *out, const merkle_node_t *node) {
+    uint8_t is_dir = (uint8_t)node->is_dir;
+    uint16_t name_len = (uint16_t)strlen(node->name);
+    fwrite(&is_dir, 1, 1, out);
+    fwrite(&name_len, sizeof(name_len), 1, out);
+    fwrite(node->name, 1, name_len, out);
+    fwrite(node->hash, 1, SHA256_LEN, out);
+    if (!node->is_dir) return;
+    uint32_t n = (uint32_t)node->n_children;
+    fwrite(&n, sizeof(n), 1, out);
+    for (size_t i = 0; i < node->n_children; i++) write_node(out, node->children[i]);
+}
+
+int merkle_save(const merkle_tree_t *tree, const char *path) {
+    char *body = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&body, &len);
+    if (!out) return -1;
+    uint32_t version = TREE_VERSION;
+    fwrite(TREE_MAGIC, 1, 8, out);
+    fwrite(&version, sizeof(version), 1, out);
+    write_node(out, tree->root);
+    if (fclose(out) != 0) {
+        free(body);
+        return -1;
+    }
+    int rc = write_file_atomic(path, body, len, 0600);
+    free(body);
+    return rc;
+}
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} reader_t;
+
+static int take(reader_t *r, void *out, size_t n) {
+    if ((size_t)(r->end - r->p) < n) return -1;
+    memcpy(out, r->p, n);
+    r->p += n;
+    return 0;
+}
+
+static merkle_node_t *read_node(reader_t *r, int depth) {
+    uint8_t is_dir;
+    uint16_t name_len;
+    if (depth > PATH_MAX / 2 || take(r, &is_dir, 1) != 0 || take(r, &name_len, sizeof(name_len)) != 0 ||
+        (size_t)(r->end - r->p) < name_len) return NULL;
+    merkle_node_t *node = new_node((const char *)r->p, name_len, is_dir != 0);
+    if (!node) return NULL;
+    r->p += name_len;
+    node->dirty = 0;
+    uint32_t n = 0;
+    if (take(r, node->hash, SHA256_LEN) != 0 || (node->is_dir && take(r, &n, sizeof(n)) != 0)) {
+        free_node(node);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        merkle_node_t *child = read_node(r, depth + 1);
+        int found;
+        size_t at = child ? find_child(node, child->name, strlen(child->name), &found) : 0;
+        // Children must be stored sorted and unique for lookups and diffs to hold
+        if (!child || at != node->n_children || !insert_child(node, at, child)) {
+            if (child && at != node->n_children) free_node(child);
+            free_node(node);
+            return NULL;
+        }
+    }
+    return node;
+}
+
+merkle_tree_t *merkle_load(const char *path) {
+    size_t len = 0;
+    char *data = read_text_file(path, &len);
+    if (!data) return NULL;
+
+    merkle_tree_t *tree = NULL;
+    reader_t r = {(const uint8_t *)data, (const uint8_t *)data + len};
+    uint8_t magic[8];
+    uint32_t version;
+    if (take(&r, magic, 8) == 0 && memcmp(magic, TREE_MAGIC, 8) == 0 &&
+        take(&r, &version, sizeof(version)) == 0 && version == TREE_VERSION) {
+        merkle_node_t *root = read_node(&r, 0);
+        if (root && root->is_dir && r.p == r.end && (tree = calloc(1, sizeof(*tree)))) {
+            tree->root = root;
+        } else {
+            free_node(root);
+        }
+    }
+    free(data);
+    if (!tree) errno = EINVAL;
+    return tree;
+}
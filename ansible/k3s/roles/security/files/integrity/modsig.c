@@ -0,0 +1,159 @@
+// modsig.c - Appended kernel module signatures
+//
+// sign-file appends [PKCS#7 DER][struct module_signature][magic] to the .ko.
+// Only the tail is read: 40 bytes for the trailer, then the signature blob.
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <openssl/cms.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+
+#include "integrity.h"
+
+#define MODSIG_MAGIC        "~Module signature appended~\n"
+#define MODSIG_MAGIC_LEN    (sizeof(MODSIG_MAGIC) - 1)
+#define PKEY_ID_PKCS7       2
+
+// include/linux/module_signature.h
+struct module_signature {
+    uint8_t algo;
+    uint8_t hash;
+    uint8_t id_type;
+    uint8_t signer_len;
+    uint8_t key_id_len;
+    uint8_t pad[3];
+    uint32_t sig_len;       // big endian
+};
+
+_Static_assert(sizeof(struct module_signature) + MODSIG_MAGIC_LEN == MODSIG_TRAILER_LEN, "module signature trailer");
+
+static int ends_with(const char *s, const char *suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+void module_name(const char *path, char *out, size_t len) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t n = strcspn(base, ".");
+    if (n >= len) n = len - 1;
+    // The kernel treats '-' and '_' in module names as the same character
+    for (size_t i = 0; i < n; i++) out[i] = base[i] == '-' ? '_' : base[i];
+    out[n] = '\0';
+}
+
+// "AB:CD:..." as modinfo prints key ids and serials
+static void colon_hex(const unsigned char *in, int len, char *out, size_t out_len) {
+    static const char digits[] = "0123456789ABCDEF";
+    size_t o = 0;
+    for (int i = 0; i < len && o + 3 < out_len; i++) {
+        if (i) out[o++] = ':';
+        out[o++] = digits[in[i] >> 4];
+        out[o++] = digits[in[i] & 0xF];
+    }
+    out[o] = '\0';
+}
+
+static int parse_pkcs7(const uint8_t *der, size_t len, modsig_t *sig) {
+    const unsigned char *p = der;
+    CMS_ContentInfo *cms = d2i_CMS_ContentInfo(NULL, &p, (long)len);
+    if (!cms) return -1;
+
+    int rc = -1;
+    STACK_OF(CMS_SignerInfo) *infos = CMS_get0_SignerInfos(cms);
+    CMS_SignerInfo *si = infos && sk_CMS_SignerInfo_num(infos) > 0 ? sk_CMS_SignerInfo_value(infos, 0) : NULL;
+    ASN1_OCTET_STRING *keyid = NULL;
+    X509_NAME *issuer = NULL;
+    ASN1_INTEGER *serial = NULL;
+    X509_ALGOR *digest_alg = NULL;
+
+    if (si && CMS_SignerInfo_get0_signer_id(si, &keyid, &issuer, &serial) == 1) {
+        // sign-file identifies the key by issuer and serial, or by subject key id with -k
+        if (issuer) X509_NAME_get_text_by_NID(issuer, NID_commonName, sig->signer, sizeof(sig->signer));
+        if (serial) colon_hex(ASN1_STRING_get0_data(serial), ASN1_STRING_length(serial), sig->sig_key, sizeof(sig->sig_key));
+        else if (keyid) colon_hex(ASN1_STRING_get0_data(keyid), ASN1_STRING_length(keyid), sig->sig_key, sizeof(sig->sig_key));
+        CMS_SignerInfo_get0_algs(si, NULL, NULL, &digest_alg, NULL);
+        if (digest_alg) {
+            const char *name = OBJ_nid2ln(OBJ_obj2nid(digest_alg->algorithm));
+            snprintf(sig->hash_algo, sizeof(sig->hash_algo), "%s", name ? name : "unknown");
+        }
+        rc = 0;
+    }
+    CMS_ContentInfo_free(cms);
+    return rc;
+}
+
+// Validates the fixed trailer at the end of an image of image_len bytes and
+// returns the signature length, or 0 when there is no usable signature
+static uint32_t trailer_sig_len(const uint8_t trailer[MODSIG_TRAILER_LEN], uint64_t image_len,
+                                struct module_signature *ms) {
+    if (image_len < MODSIG_TRAILER_LEN ||
+        memcmp(trailer + sizeof(*ms), MODSIG_MAGIC, MODSIG_MAGIC_LEN) != 0) return 0;
+    memcpy(ms, trailer, sizeof(*ms));
+    uint32_t sig_len = be32toh(ms->sig_len);
+    if (sig_len == 0 || sig_len > MODSIG_MAX_LEN || sig_len > image_len - MODSIG_TRAILER_LEN) return 0;
+    return sig_len;
+}
+
+static int signature_status(const struct module_signature *ms, const uint8_t *der, uint32_t len, modsig_t *sig) {
+    if (ms->id_type != PKEY_ID_PKCS7) {
+        // Pre-4.3 X.509 form; nothing we can attribute, but it is signed
+        snprintf(sig->id_type, sizeof(sig->id_type), "X509");
+        return MODSIG_SIGNED;
+    }
+    // A trailer whose PKCS#7 does not parse would be rejected by the kernel;
+    // count it as unsigned rather than trusting the magic alone
+    if (!der || parse_pkcs7(der, len, sig) != 0) return MODSIG_UNSIGNED;
+    snprintf(sig->id_type, sizeof(sig->id_type), "PKCS#7");
+    return MODSIG_SIGNED;
+}
+
+int modsig_parse(const uint8_t *tail, size_t tail_len, uint64_t image_len, modsig_t *sig) {
+    struct module_signature ms;
+    memset(sig, 0, sizeof(*sig));
+    if (tail_len < MODSIG_TRAILER_LEN) return MODSIG_UNSIGNED;
+
+    uint32_t sig_len = trailer_sig_len(tail + tail_len - MODSIG_TRAILER_LEN, image_len, &ms);
+    if (!sig_len || sig_len > tail_len - MODSIG_TRAILER_LEN) return MODSIG_UNSIGNED;
+    return signature_status(&ms, tail + tail_len - MODSIG_TRAILER_LEN - sig_len, sig_len, sig);
+}
+
+int modsig_read(const char *path, modsig_t *sig) {
+    memset(sig, 0, sizeof(*sig));
+    // Compressed modules carry the signature inside the compressed stream
+    if (!ends_with(path, ".ko")) return MODSIG_UNKNOWN;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    int rc = MODSIG_UNSIGNED;
+    struct stat st;
+    struct module_signature ms;
+    uint8_t trailer[MODSIG_TRAILER_LEN];
+    uint8_t *der = NULL;
+    if (fstat(fd, &st) != 0) {
+        rc = -1;
+        goto out;
+    }
+    off_t end = st.st_size;
+    if (end < (off_t)MODSIG_TRAILER_LEN ||
+        pread(fd, trailer, MODSIG_TRAILER_LEN, end - MODSIG_TRAILER_LEN) != (ssize_t)MODSIG_TRAILER_LEN) goto out;
+    uint32_t sig_len = trailer_sig_len(trailer, end, &ms);
+    if (!sig_len) goto out;
+
+    off_t sig_off = end - MODSIG_TRAILER_LEN - sig_len;
+    der = malloc(sig_len);
+    if (der && pread(fd, der, sig_len, sig_off) != (ssize_t)sig_len) {
+        free(der);
+        der = NULL;
+    }
+    rc = signature_status(&ms, der, sig_len, sig);
+out:
+    free(der);
+    close(fd);
+    return rc;
+}
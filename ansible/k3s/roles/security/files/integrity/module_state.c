@@ -0,0 +1,703 @@
+// module_state.c - Native module state collector (replaces the report half of
+// collect-module-state.sh)
+//
+// Builds the same module-attestation document from one read of
+// /proc/modules and modules.dep: signatures come from the .ko trailers (of the
+// decompressed image for .ko.zst/.ko.xz) instead of a modinfo per module, and
+// the module tree is hashed on the thread pool.
+#include <errno.h>
+#include <fnmatch.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+
+#include "integrity.h"
+
+#define MONITOR_STATE       REPORT_DIR "/module-state-current.json"
+#define CACHE_FILE          REPORT_DIR "/module-hash.cache"
+#define TREE_FILE           REPORT_DIR "/module-tree.merkle"
+#define PROC_MODULES        "/proc/modules"
+#define CURRENT_REPORT      "module-attestation-current.json"
+#define MONITOR_MAX_AGE     (15 * 60)   // module-monitor data older than this is left out
+#define SIG_ENFORCE_PARAM   "/sys/module/module/parameters/sig_enforce"
+#define APPARMOR_PROFILES   "/sys/kernel/security/apparmor/profiles"
+
+static const char *critical_modules[] = {
+    "overlay", "br_netfilter", "nf_conntrack", "iptable_nat", "iptable_filter",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef struct {
+    const char *report_dir;
+    const char *module_dir;     // /lib/modules/$(uname -r)
+    const char *proc_modules;
+    const char *monitor_state;
+    const char *module_events;  // integrity-monitor's module load snapshot
+    const char *kernel_config;
+    const char *cache_file;     // NULL disables the hash cache
+    const char *tree_file;      // persisted Merkle tree; NULL to rebuild every run
+    int64_t rehash_interval;
+    int threads;
+} config_t;
+
+typedef struct {
+    char *name;
+    char *size;
+    char *refcnt;
+    char *holders;          // "a,b," or "-" as in /proc/modules
+    char *taints;           // "(OE)" or NULL
+    char *path;             // from modules.dep; NULL when not installed there
+    int status;             // modsig_status_t, or -1 if the file could not be read
+    modsig_t sig;
+} loaded_module_t;
+
+typedef struct {
+    loaded_module_t *mods;
+    size_t count;
+    char *text;             // /proc/modules contents; the fields point into it
+} module_list_t;
+
+// /proc/modules: "name size refcnt holders state address [(taints)]"
+static int read_proc_modules(const char *file, module_list_t *list) {
+    memset(list, 0, sizeof(*list));
+    list->text = read_text_file(file, NULL);
+    if (!list->text) return -1;
+
+    size_t cap = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(list->text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *field_save = NULL, *fields[7] = {0};
+        int n = 0;
+        for (char *f = strtok_r(line, " ", &field_save); f && n < 7; f = strtok_r(NULL, " ", &field_save)) {
+            fields[n++] = f;
+        }
+        if (n < 4) continue;
+        if (list->count == cap) {
+            cap = cap ? cap * 2 : 128;
+            loaded_module_t *grown = realloc(list->mods, cap * sizeof(loaded_module_t));
+            if (!grown) return -1;
+            list->mods = grown;
+        }
+        loaded_module_t *m = &list->mods[list->count++];
+        memset(m, 0, sizeof(*m));
+        m->name = fields[0];
+        m->size = fields[1];
+        m->refcnt = fields[2];
+        m->holders = fields[3];
+        m->taints = n > 6 ? fields[6] : NULL;
+    }
+    return 0;
+}
+
+static void free_modules(module_list_t *list) {
+    for (size_t i = 0; i < list->count; i++) free(list->mods[i].path);
+    free(list->mods);
+    free(list->text);
+}
+
+static int by_name(const void *a, const void *b) {
+    return strcmp((*(loaded_module_t *const *)a)->name, (*(loaded_module_t *const *)b)->name);
+}
+
+// One pass over modules.dep gives the file of every loaded module, as modinfo
+// would resolve it
+static void locate_modules(const config_t *cfg, module_list_t *list) {
+    char dep_file[PATH_MAX];
+    if (snprintf(dep_file, sizeof(dep_file), "%s/modules.dep", cfg->module_dir) >= (int)sizeof(dep_file)) return;
+    char *deps = read_text_file(dep_file, NULL);
+    loaded_module_t **sorted = calloc(list->count ? list->count : 1, sizeof(loaded_module_t *));
+    if (!deps || !sorted) {
+        free(deps);
+        free(sorted);
+        return;
+    }
+    for (size_t i = 0; i < list->count; i++) sorted[i] = &list->mods[i];
+    qsort(sorted, list->count, sizeof(loaded_module_t *), by_name);
+
+    char *save = NULL, name[256], path[PATH_MAX];
+    for (char *line = strtok_r(deps, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        module_name(line, name, sizeof(name));
+        loaded_module_t key = {.name = name}, *keyp = &key;
+        loaded_module_t **hit = bsearch(&keyp, sorted, list->count, sizeof(loaded_module_t *), by_name);
+        if (!hit || (*hit)->path) continue;
+        int n = line[0] == '/' ? snprintf(path, sizeof(path), "%s", line)
+                               : snprintf(path, sizeof(path), "%s/%s", cfg->module_dir, line);
+        if (n < (int)sizeof(path)) (*hit)->path = strdup(path);
+    }
+    free(sorted);
+    free(deps);
+}
+
+typedef struct {
+    loaded_module_t *mods;
+    hash_cache_t *cache;
+} signature_batch_t;
+
+// Uncompressed modules only need their last few KiB read. Compressed ones are
+// decoded in full; the same read yields the on-disk digest, which goes to the
+// cache so the module tree pass does not read the file again.
+static void signature_worker(size_t i, void *arg) {
+    signature_batch_t *batch = arg;
+    loaded_module_t *m = &batch->mods[i];
+    struct statx stx;
+    module_scan_t scan;
+
+    m->status = -1;
+    if (!m->path || stat_file(m->path, &stx) != 0) return;
+    m->status = modsig_read(m->path, &m->sig);
+    if (m->status != MODSIG_UNKNOWN) return;
+
+    m->status = -1;
+    if (module_scan(m->path, &scan) != 0) return;
+    m->status = scan.sig_status;
+    m->sig = scan.sig;
+    hash_cache_store(batch->cache, m->path, &stx, scan.file_digest, scan.file_bytes);
+}
+
+// modinfo without sig_ fields (including a compressed module that does not
+// decode), or the kernel tainted the module 'E' when it failed signature
+// verification at load time
+static int module_unsigned(const loaded_module_t *m) {
+    if (m->taints && strchr(m->taints, 'E')) return 1;
+    return m->status == MODSIG_UNSIGNED || m->status < 0;
+}
+
+static int module_loaded(const module_list_t *list, const char *name) {
+    for (size_t i = 0; i < list->count; i++) {
+        if (strcmp(list->mods[i].name, name) == 0) return 1;
+    }
+    return 0;
+}
+
+static void sha256_hex(const void *data, size_t len, char out[SHA256_HEX_LEN + 1]) {
+    uint8_t digest[SHA256_LEN];
+    unsigned int n = 0;
+    EVP_Digest(data, len, digest, &n, EVP_sha256(), NULL);
+    hex_encode(digest, SHA256_LEN, out);
+}
+
+// sha256 of what lsmod would print, rendered from /proc/modules
+static void lsmod_hash(const module_list_t *list, char out[SHA256_HEX_LEN + 1]) {
+    char *text = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&text, &len);
+    fprintf(f, "Module                  Size  Used by\n");
+    for (size_t i = 0; i < list->count; i++) {
+        const loaded_module_t *m = &list->mods[i];
+        fprintf(f, "%-19s %8s  %s", m->name, m->size, m->refcnt);
+        if (strcmp(m->holders, "-") != 0) {
+            size_t n = strlen(m->holders);
+            if (n && m->holders[n - 1] == ',') n--;
+            fprintf(f, " %.*s", (int)n, m->holders);
+        }
+        fputc('\n', f);
+    }
+    fclose(f);
+    sha256_hex(text, len, out);
+    free(text);
+}
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t cap;
+    hash_job_t *jobs;
+} module_files_t;
+
+static module_files_t tree_files;
+
+// find -name "*.ko*" -type f, in the same pre-order traversal
+static int collect_module_file(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    if (type != FTW_F || !S_ISREG(st->st_mode) || fnmatch("*.ko*", path + ftw->base, 0) != 0) return 0;
+    if (tree_files.count == tree_files.cap) {
+        size_t cap = tree_files.cap ? tree_files.cap * 2 : 1024;
+        char **grown = realloc(tree_files.paths, cap * sizeof(char *));
+        if (!grown) return -1;
+        tree_files.paths = grown;
+        tree_files.cap = cap;
+    }
+    if ((tree_files.paths[tree_files.count] = strdup(path))) tree_files.count++;
+    return 0;
+}
+
+static int hash_module_files(const config_t *cfg, hash_cache_t *cache, module_files_t *files) {
+    memset(&tree_files, 0, sizeof(tree_files));
+    nftw(cfg->module_dir, collect_module_file, 32, FTW_PHYS);
+    *files = tree_files;
+    memset(&tree_files, 0, sizeof(tree_files));
+    files->jobs = hash_paths((const char *const *)files->paths, files->count, cfg->threads, cache);
+    return files->jobs ? 0 : -1;
+}
+
+static void free_module_files(module_files_t *files) {
+    for (size_t i = 0; i < files->count; i++) free(files->paths[i]);
+    free(files->paths);
+    free(files->jobs);
+    memset(files, 0, sizeof(*files));
+}
+
+// sha256 over "digest  path" lines in traversal order, as the script piped
+// `find -exec sha256sum` into sha256sum; unreadable files contribute nothing
+static void module_files_hash(const module_files_t *files, char out[SHA256_HEX_LEN + 1]) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+    char line[SHA256_HEX_LEN + 3 + PATH_MAX];
+    for (size_t i = 0; i < files->count; i++) {
+        if (files->jobs[i].status != JOB_OK) continue;
+        hex_encode(files->jobs[i].digest, SHA256_LEN, line);
+        int n = snprintf(line + SHA256_HEX_LEN, sizeof(line) - SHA256_HEX_LEN, "  %s\n", files->jobs[i].path);
+        EVP_DigestUpdate(ctx, line, SHA256_HEX_LEN + n);
+    }
+    uint8_t digest[SHA256_LEN];
+    EVP_DigestFinal_ex(ctx, digest, NULL);
+    EVP_MD_CTX_free(ctx);
+    hex_encode(digest, SHA256_LEN, out);
+}
+
+// Path below the module directory, as the Merkle tree keys it
+static const char *relative_path(const config_t *cfg, const char *path) {
+    size_t len = strlen(cfg->module_dir);
+    while (len && cfg->module_dir[len - 1] == '/') len--;
+    if (strncmp(path, cfg->module_dir, len) == 0 && path[len] == '/') return path + len + 1;
+    return path;
+}
+
+// Bring the persisted tree up to date with the hashed files. Unchanged
+// directories keep their stored hashes; only ancestors of added, removed or
+// modified files are rehashed.
+static merkle_tree_t *sync_tree(const config_t *cfg, const module_files_t *files, size_t *rehashed) {
+    merkle_tree_t *tree = cfg->tree_file ? merkle_load(cfg->tree_file) : NULL;
+    if (!tree) tree = merkle_new();
+    if (!tree) return NULL;
+
+    merkle_begin(tree);
+    for (size_t i = 0; i < files->count; i++) {
+        if (files->jobs[i].status == JOB_OK) merkle_set(tree, relative_path(cfg, files->paths[i]), files->jobs[i].digest);
+    }
+    merkle_end(tree);
+    size_t n = merkle_update(tree);
+    if (rehashed) *rehashed = n;
+    if (cfg->tree_file && n > 0 && merkle_save(tree, cfg->tree_file) != 0) {
+        fprintf(stderr, "Failed to save %s: %s\n", cfg->tree_file, strerror(errno));
+    }
+    return tree;
+}
+
+// Integer sysctl/sysfs value as JSON, null when the knob does not exist
+static void json_int_file(FILE *out, const char *path) {
+    char *text = read_text_file(path, NULL);
+    char *end = NULL;
+    long long v = text ? strtoll(text, &end, 10) : 0;
+    if (text && end != text) fprintf(out, "%lld", v);
+    else fputs("null", out);
+    free(text);
+}
+
+static long long read_int_file(const char *path) {
+    char *text = read_text_file(path, NULL);
+    long long v = text ? strtoll(text, NULL, 10) : 0;
+    free(text);
+    return v;
+}
+
+static int signature_enforced(void) {
+    char *cmdline = read_text_file("/proc/cmdline", NULL);
+    char *param = read_text_file(SIG_ENFORCE_PARAM, NULL);
+    // CONFIG_MODULE_SIG_FORCE kernels enforce without the command line flag
+    int enforced = (cmdline && strstr(cmdline, "module.sig_enforce=1")) || (param && param[0] == 'Y');
+    free(cmdline);
+    free(param);
+    return enforced;
+}
+
+static int apparmor_enforced(void) {
+    char *profiles = read_text_file(APPARMOR_PROFILES, NULL);
+    int count = 0;
+    for (char *p = profiles; p && (p = strstr(p, "(enforce)")); p++) count++;
+    free(profiles);
+    return count;
+}
+
+static void file_hash_or(const char *path, const char *fallback, char *out) {
+    uint8_t digest[SHA256_LEN];
+    if (hash_file(path, digest, NULL) == 0) hex_encode(digest, SHA256_LEN, out);
+    else strcpy(out, fallback);
+}
+
+// A monitor's JSON state file, embedded verbatim while it is fresh
+static char *monitor_data(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_size == 0 || time(NULL) - st.st_mtime > MONITOR_MAX_AGE) return NULL;
+    char *text = read_text_file(path, NULL);
+    if (!text) return NULL;
+    size_t start = strspn(text, " \t\r\n"), len = strlen(text);
+    while (len > start && strchr(" \t\r\n", text[len - 1])) len--;
+    // Anything that is not an object would make the report invalid JSON
+    if (len <= start || text[start] != '{' || text[len - 1] != '}') {
+        free(text);
+        return NULL;
+    }
+    text[len] = '\0';
+    memmove(text, text + start, len - start + 1);
+    return text;
+}
+
+static void json_name_list(FILE *out, const char *const *names, size_t count) {
+    fputc('[', out);
+    for (size_t i = 0; i < count; i++) {
+        if (i) fputs(", ", out);
+        json_string(out, names[i]);
+    }
+    fputc(']', out);
+}
+
+static int by_string(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Distinct signing keys across the loaded modules
+static void json_signers(FILE *out, const module_list_t *list) {
+    const loaded_module_t **seen = calloc(list->count ? list->count : 1, sizeof(*seen));
+    size_t *counts = calloc(list->count ? list->count : 1, sizeof(size_t));
+    size_t n = 0;
+    for (size_t i = 0; seen && counts && i < list->count; i++) {
+        const loaded_module_t *m = &list->mods[i];
+        if (m->status != MODSIG_SIGNED) continue;
+        size_t j = 0;
+        while (j < n && !(strcmp(seen[j]->sig.signer, m->sig.signer) == 0 &&
+                          strcmp(seen[j]->sig.sig_key, m->sig.sig_key) == 0 &&
+                          strcmp(seen[j]->sig.hash_algo, m->sig.hash_algo) == 0)) j++;
+        if (j == n) seen[n++] = m;
+        counts[j]++;
+    }
+    fputc('[', out);
+    for (size_t j = 0; j < n; j++) {
+        fputs(j ? ", {\"signer\": " : "{\"signer\": ", out);
+        json_string(out, seen[j]->sig.signer);
+        fputs(", \"sig_key\": ", out);
+        json_string(out, seen[j]->sig.sig_key);
+        fputs(", \"sig_hashalgo\": ", out);
+        json_string(out, seen[j]->sig.hash_algo);
+        fprintf(out, ", \"modules\": %zu}", counts[j]);
+    }
+    fputc(']', out);
+    free(seen);
+    free(counts);
+}
+
+static int generate_report(const config_t *cfg, char *report_path, size_t path_len) {
+    module_list_t list;
+    if (read_proc_modules(cfg->proc_modules, &list) != 0) {
+        fprintf(stderr, "Cannot read %s: %s\n", cfg->proc_modules, strerror(errno));
+        return 1;
+    }
+    locate_modules(cfg, &list);
+
+    hash_cache_t *cache = cfg->cache_file ? hash_cache_open(cfg->cache_file, cfg->rehash_interval) : NULL;
+    signature_batch_t batch = {.mods = list.mods, .cache = cache};
+    pool_run(list.count, cfg->threads, signature_worker, &batch);
+    char modules_hash[SHA256_HEX_LEN + 1], files_hash[SHA256_HEX_LEN + 1], tree_root[SHA256_HEX_LEN + 1];
+    lsmod_hash(&list, modules_hash);
+    module_files_t files;
+    hash_module_files(cfg, cache, &files);
+    hash_cache_save(cache);
+    hash_cache_close(cache);
+    module_files_hash(&files, files_hash);
+    merkle_tree_t *tree = files.jobs ? sync_tree(cfg, &files, NULL) : NULL;
+    uint8_t root[SHA256_LEN];
+    if (tree) {
+        merkle_root(tree, root);
+        hex_encode(root, SHA256_LEN, tree_root);
+    } else {
+        strcpy(tree_root, "unavailable");
+    }
+    merkle_free(tree);
+    size_t module_files = files.count;
+    free_module_files(&files);
+
+    const char **unsigned_mods = calloc(list.count ? list.count : 1, sizeof(char *));
+    size_t n_unsigned = 0;
+    for (size_t i = 0; unsigned_mods && i < list.count; i++) {
+        if (module_unsigned(&list.mods[i])) unsigned_mods[n_unsigned++] = list.mods[i].name;
+    }
+    if (unsigned_mods) qsort(unsigned_mods, n_unsigned, sizeof(char *), by_string);
+    const char *missing[COUNT(critical_modules)];
+    size_t n_missing = 0;
+    for (size_t i = 0; i < COUNT(critical_modules); i++) {
+        if (!module_loaded(&list, critical_modules[i])) missing[n_missing++] = critical_modules[i];
+    }
+
+    struct utsname uts;
+    uname(&uts);
+    char timestamp[40], hostname[256] = "";
+    iso_timestamp(timestamp, sizeof(timestamp));
+    gethostname(hostname, sizeof(hostname) - 1);
+    long long tainted = read_int_file("/proc/sys/kernel/tainted");
+    char cmdline_hash[SHA256_HEX_LEN + 1], config_hash[SHA256_HEX_LEN + 1];
+    file_hash_or("/proc/cmdline", "unavailable", cmdline_hash);
+    file_hash_or(cfg->kernel_config, "unavailable", config_hash);
+    char *monitor = monitor_data(cfg->monitor_state);
+    char *load_events = monitor_data(cfg->module_events);
+
+    char *json = NULL;
+    size_t json_len = 0;
+    FILE *out = open_memstream(&json, &json_len);
+    fprintf(out, "{\n    \"timestamp\": \"%s\",\n    \"hostname\": ", timestamp);
+    json_string(out, hostname);
+    fprintf(out, ",\n    \"kernel_version\": ");
+    json_string(out, uts.release);
+    fprintf(out, ",\n    \"attestation_type\": \"module_security\",\n");
+    fprintf(out, "    \"module_state\": {\n");
+    // Kept as `lsmod | wc -l` reported it, header line included, so reports
+    // stay comparable with those of collect-module-state.sh
+    fprintf(out, "        \"total_modules\": %zu,\n", list.count + 1);
+    fprintf(out, "        \"modules_hash\": \"%s\",\n", modules_hash);
+    fprintf(out, "        \"module_files_hash\": \"%s\",\n", files_hash);
+    fprintf(out, "        \"kernel_tainted\": %lld,\n", tainted);
+    fprintf(out, "        \"taint_flags\": {\n");
+    fprintf(out, "            \"proprietary\": %lld,\n", tainted & 1);
+    fprintf(out, "            \"forced_module\": %lld,\n", tainted & 2);
+    fprintf(out, "            \"unsigned_module\": %lld,\n", tainted & 4096);
+    fprintf(out, "            \"out_of_tree\": %lld\n", tainted & 8192);
+    fprintf(out, "        },\n");
+    fprintf(out, "        \"signature_enforcement\": %s,\n", signature_enforced() ? "true" : "false");
+    fprintf(out, "        \"unsigned_modules\": ");
+    json_name_list(out, unsigned_mods, n_unsigned);
+    fprintf(out, ",\n        \"missing_critical\": ");
+    json_name_list(out, missing, n_missing);
+    fprintf(out, ",\n        \"module_signers\": ");
+    json_signers(out, &list);
+    fprintf(out, ",\n        \"apparmor_profiles\": %d\n", apparmor_enforced());
+    fprintf(out, "    },\n");
+    fprintf(out, "    \"measurements\": {\n");
+    fprintf(out, "        \"boot_cmdline\": \"%s\",\n", cmdline_hash);
+    fprintf(out, "        \"kernel_config\": \"%s\",\n", config_hash);
+    fprintf(out, "        \"module_directory\": \"%zu files\",\n", module_files);
+    fprintf(out, "        \"module_tree_root\": \"%s\"\n", tree_root);
+    fprintf(out, "    },\n");
+    fprintf(out, "    \"security_checks\": {\n");
+    fprintf(out, "        \"modules_disabled\": ");
+    json_int_file(out, "/proc/sys/kernel/modules_disabled");
+    fprintf(out, ",\n        \"kexec_disabled\": ");
+    json_int_file(out, "/proc/sys/kernel/kexec_load_disabled");
+    fprintf(out, ",\n        \"unprivileged_userns\": ");
+    json_int_file(out, "/proc/sys/kernel/unprivileged_userns_clone");
+    fprintf(out, ",\n        \"bpf_disabled\": ");
+    json_int_file(out, "/proc/sys/kernel/unprivileged_bpf_disabled");
+    fprintf(out, "\n    },\n");
+    fprintf(out, "    \"module_monitor_data\": %s,\n", monitor ? monitor : "{}");
+    fprintf(out, "    \"module_load_monitor\": %s\n}\n", load_events ? load_events : "{}");
+    fclose(out);
+
+    free(monitor);
+    free(load_events);
+    free(unsigned_mods);
+    free_modules(&list);
+
+    // History goes to the report log; the current file is what gets uploaded
+    char log_dir[PATH_MAX];
+    snprintf(log_dir, sizeof(log_dir), "%s/%s", cfg->report_dir, REPORT_LOG_NAME);
+    snprintf(report_path, path_len, "%s/%s", cfg->report_dir, CURRENT_REPORT);
+    int rc = report_log_append(log_dir, "module-attestation", json, json_len, NULL);
+    if (rc != 0) fprintf(stderr, "Failed to append to %s: %s\n", log_dir, strerror(errno));
+    else if ((rc = write_file_atomic(report_path, json, json_len, 0644)) != 0) {
+        fprintf(stderr, "Failed to write %s: %s\n", report_path, strerror(errno));
+    }
+    free(json);
+    return rc == 0 ? 0 : 1;
+}
+
+static merkle_tree_t *current_tree(const config_t *cfg, size_t *rehashed) {
+    hash_cache_t *cache = cfg->cache_file ? hash_cache_open(cfg->cache_file, cfg->rehash_interval) : NULL;
+    module_files_t files;
+    int rc = hash_module_files(cfg, cache, &files);
+    hash_cache_save(cache);
+    hash_cache_close(cache);
+    merkle_tree_t *tree = rc == 0 ? sync_tree(cfg, &files, rehashed) : NULL;
+    free_module_files(&files);
+    return tree;
+}
+
+static int print_tree_root(const config_t *cfg) {
+    size_t rehashed = 0, files, dirs;
+    merkle_tree_t *tree = current_tree(cfg, &rehashed);
+    if (!tree) {
+        fprintf(stderr, "Cannot hash %s: %s\n", cfg->module_dir, strerror(errno));
+        return 1;
+    }
+    uint8_t root[SHA256_LEN];
+    char hex[SHA256_HEX_LEN + 1];
+    merkle_root(tree, root);
+    hex_encode(root, SHA256_LEN, hex);
+    merkle_counts(tree, &files, &dirs);
+    printf("%s\n", hex);
+    fprintf(stderr, "%zu files, %zu directories, %zu rehashed\n", files, dirs, rehashed);
+    merkle_free(tree);
+    return 0;
+}
+
+// A saved tree, or a sha256sum list such as module-files.sha256
+static merkle_tree_t *load_reference(const config_t *cfg, const char *path) {
+    merkle_tree_t *tree = merkle_load(path);
+    if (tree) return tree;
+
+    baseline_t baseline;
+    if (baseline_load(path, &baseline) != 0) return NULL;
+    // An unparseable reference would otherwise report every module as added
+    tree = baseline.count ? merkle_new() : NULL;
+    for (size_t i = 0; tree && i < baseline.count; i++) {
+        const baseline_entry_t *entry = baseline_entry(&baseline, i);
+        merkle_set(tree, relative_path(cfg, entry->path), entry->digest);
+    }
+    baseline_free(&baseline);
+    if (tree) merkle_update(tree);
+    return tree;
+}
+
+static void print_change(const char *path, char change, void *arg) {
+    (void)arg;
+    printf("Module file %s: %s\n", change == '+' ? "added" : change == '-' ? "removed" : "modified", path);
+}
+
+static int diff_tree(const config_t *cfg, const char *reference) {
+    merkle_tree_t *base = load_reference(cfg, reference);
+    if (!base) {
+        fprintf(stderr, "Cannot load %s\n", reference);
+        return 2;
+    }
+    merkle_tree_t *tree = current_tree(cfg, NULL);
+    if (!tree) {
+        fprintf(stderr, "Cannot hash %s: %s\n", cfg->module_dir, strerror(errno));
+        merkle_free(base);
+        return 2;
+    }
+    size_t visited = 0;
+    size_t changes = merkle_diff(base, tree, cfg->module_dir, print_change, NULL, &visited);
+    fprintf(stderr, "%zu differences, %zu directories compared\n", changes, visited);
+    merkle_free(base);
+    merkle_free(tree);
+    return changes ? 1 : 0;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [MODE] [OPTIONS]\n", prog_name);
+    printf("Modes:\n");
+    printf("  (default)             Append a report to the log, write %s and print its path\n", CURRENT_REPORT);
+    printf("  --tree                Update the module Merkle tree and print its root hash\n");
+    printf("  --diff FILE           List module files that differ from FILE (a saved tree or a\n");
+    printf("                        sha256sum list); exit 1 if any do\n");
+    printf("Options:\n");
+    printf("  --report-dir DIR      Report directory (default: %s)\n", REPORT_DIR);
+    printf("  --module-dir DIR      Module tree (default: /lib/modules/$(uname -r))\n");
+    printf("  --proc-modules FILE   Loaded module list (default: %s)\n", PROC_MODULES);
+    printf("  --monitor-state FILE  module-monitor state to embed (default: %s)\n", MONITOR_STATE);
+    printf("  --module-events FILE  integrity-monitor module load snapshot to embed (default: %s)\n", MODULE_EVENTS);
+    printf("  --kernel-config FILE  Kernel config to measure (default: /boot/config-$(uname -r))\n");
+    printf("  --cache FILE          Digest cache (default: %s)\n", CACHE_FILE);
+    printf("  --no-cache            Hash every file, do not read or update the cache\n");
+    printf("  --tree-file FILE      Persisted Merkle tree (default: %s)\n", TREE_FILE);
+    printf("  --no-tree-file        Rebuild the tree from scratch, do not persist it\n");
+    printf("  --rehash-interval S   Recompute cached digests older than S seconds (default: %d)\n", REHASH_INTERVAL);
+    printf("  --threads N           Hashing threads (default: 2x online CPUs)\n");
+    printf("  -h, --help            Show this help message\n");
+}
+
+enum {
+    OPT_TREE = 256, OPT_DIFF, OPT_TREE_FILE, OPT_NO_TREE_FILE,
+    OPT_REPORT_DIR, OPT_MODULE_DIR, OPT_PROC_MODULES, OPT_MONITOR_STATE, OPT_MODULE_EVENTS,
+    OPT_KERNEL_CONFIG, OPT_CACHE, OPT_NO_CACHE, OPT_REHASH_INTERVAL, OPT_THREADS,
+};
+
+int main(int argc, char *argv[]) {
+    config_t cfg = {
+        .report_dir = REPORT_DIR,
+        .proc_modules = PROC_MODULES,
+        .monitor_state = MONITOR_STATE,
+        .module_events = MODULE_EVENTS,
+        .cache_file = CACHE_FILE,
+        .tree_file = TREE_FILE,
+        .rehash_interval = REHASH_INTERVAL,
+    };
+
+    int mode = 0;
+    const char *reference = NULL;
+
+    static struct option long_options[] = {
+        {"tree", no_argument, 0, OPT_TREE},
+        {"diff", required_argument, 0, OPT_DIFF},
+        {"tree-file", required_argument, 0, OPT_TREE_FILE},
+        {"no-tree-file", no_argument, 0, OPT_NO_TREE_FILE},
+        {"report-dir", required_argument, 0, OPT_REPORT_DIR},
+        {"module-dir", required_argument, 0, OPT_MODULE_DIR},
+        {"proc-modules", required_argument, 0, OPT_PROC_MODULES},
+        {"monitor-state", required_argument, 0, OPT_MONITOR_STATE},
+        {"module-events", required_argument, 0, OPT_MODULE_EVENTS},
+        {"kernel-config", required_argument, 0, OPT_KERNEL_CONFIG},
+        {"cache", required_argument, 0, OPT_CACHE},
+        {"no-cache", no_argument, 0, OPT_NO_CACHE},
+        {"rehash-interval", required_argument, 0, OPT_REHASH_INTERVAL},
+        {"threads", required_argument, 0, OPT_THREADS},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_TREE: mode = opt; break;
+            case OPT_DIFF:
+                mode = opt;
+                reference = optarg;
+                break;
+            case OPT_TREE_FILE: cfg.tree_file = optarg; break;
+            case OPT_NO_TREE_FILE: cfg.tree_file = NULL; break;
+            case OPT_REPORT_DIR: cfg.report_dir = optarg; break;
+            case OPT_MODULE_DIR: cfg.module_dir = optarg; break;
+            case OPT_PROC_MODULES: cfg.proc_modules = optarg; break;
+            case OPT_MONITOR_STATE: cfg.monitor_state = optarg; break;
+            case OPT_MODULE_EVENTS: cfg.module_events = optarg; break;
+            case OPT_KERNEL_CONFIG: cfg.kernel_config = optarg; break;
+            case OPT_CACHE: cfg.cache_file = optarg; break;
+            case OPT_NO_CACHE: cfg.cache_file = NULL; break;
+            case OPT_REHASH_INTERVAL: cfg.rehash_interval = atoll(optarg); break;
+            case OPT_THREADS: cfg.threads = atoi(optarg); break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    struct utsname uts;
+    uname(&uts);
+    char module_dir[PATH_MAX], kernel_config[PATH_MAX];
+    if (!cfg.module_dir) {
+        snprintf(module_dir, sizeof(module_dir), "/lib/modules/%s", uts.release);
+        cfg.module_dir = module_dir;
+    }
+    if (!cfg.kernel_config) {
+        snprintf(kernel_config, sizeof(kernel_config), "/boot/config-%s", uts.release);
+        cfg.kernel_config = kernel_config;
+    }
+
+    if (mode == OPT_TREE) return print_tree_root(&cfg);
+    if (mode == OPT_DIFF) return diff_tree(&cfg, reference);
+
+    char report[PATH_MAX];
+    if (generate_report(&cfg, report, sizeof(report)) != 0) return 1;
+    printf("%s\n", report);
+    return 0;
+}
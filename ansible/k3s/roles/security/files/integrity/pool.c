@@ -0,0 +1,59 @@
+// pool.c - Minimal parallel-for: workers pull indices from a shared counter
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "integrity.h"
+
+#define POOL_MAX_THREADS 64
+
+typedef struct {
+    atomic_size_t next;
+    size_t count;
+    pool_fn fn;
+    void *arg;
+} pool_job_t;
+
+static void *pool_worker(void *p) {
+    pool_job_t *job = p;
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) break;
+        job->fn(i, job->arg);
+    }
+    return NULL;
+}
+
+int pool_default_threads(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    // Hashing is mostly I/O bound on cold caches; a few extra workers keep the queue full
+    return cpus * 2 > POOL_MAX_THREADS ? POOL_MAX_THREADS : (int)cpus * 2;
+}
+
+int pool_run(size_t count, int threads, pool_fn fn, void *arg) {
+    pool_job_t job = {.count = count, .fn = fn, .arg = arg};
+    atomic_init(&job.next, 0);
+
+    if (threads <= 0) threads = pool_default_threads();
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+    if ((size_t)threads > count) threads = (int)count;
+    if (threads <= 1) {
+        pool_worker(&job);
+        return 0;
+    }
+
+    pthread_t tids[POOL_MAX_THREADS];
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&tids[t], NULL, pool_worker, &job) != 0) break;
+        started++;
+    }
+    // Whatever could not be handed to a thread runs here
+    pool_worker(&job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    return 0;
+}
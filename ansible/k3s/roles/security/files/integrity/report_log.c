@@ -0,0 +1,215 @@
+// report_log.c - Query and append to the attestation report log
+//
+// The shell monitors append through --append; everything that used to list
+// /var/lib/attestation/*.json reads history through the export modes, which
+// print the stored JSON documents unchanged.
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "integrity.h"
+
+typedef struct {
+    const char *log_dir;
+    const char *type;
+    const char *export_dir;
+    int64_t since;
+    int64_t until;
+    size_t limit;
+} config_t;
+
+typedef struct {
+    const char *dir;
+    long written;
+    int failed;     // set when a file could not be written; the query stops there
+} export_t;
+
+static int print_array_entry(const report_record_t *rec, void *arg) {
+    size_t *printed = arg;
+    size_t len = rec->len;
+    while (len && strchr(" \t\r\n", rec->data[len - 1])) len--;
+    fputs((*printed)++ ? ",\n" : "[\n", stdout);
+    fwrite(rec->data, 1, len, stdout);
+    return 0;
+}
+
+static int print_document(const report_record_t *rec, void *arg) {
+    (void)arg;
+    fwrite(rec->data, 1, rec->len, stdout);
+    if (rec->len && rec->data[rec->len - 1] != '\n') fputc('\n', stdout);
+    return 0;
+}
+
+static int write_legacy_file(const report_record_t *rec, void *arg) {
+    export_t *export = arg;
+    const char *dir = export->dir;
+    char path[PATH_MAX];
+    // Several reports of one type can share a second; the sequence number keeps them apart
+    snprintf(path, sizeof(path), "%s/%s-%lld-%llu.json", dir, rec->type, (long long)rec->timestamp,
+             (unsigned long long)rec->seq);
+    if (write_file_atomic(path, rec->data, rec->len, 0644) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+        export->failed = 1;
+        return 1;
+    }
+    export->written++;
+    return 0;
+}
+
+static int append_stdin(const config_t *cfg, const char *type) {
+    char *data = NULL;
+    size_t len = 0, cap = 0;
+    for (;;) {
+        if (len == cap) {
+            cap = cap ? cap * 2 : 64 * 1024;
+            char *grown = realloc(data, cap);
+            if (!grown) {
+                free(data);
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + len, 1, cap - len, stdin);
+        if (n == 0) break;
+        len += n;
+    }
+
+    // Export concatenates documents into an array, so only objects are accepted
+    size_t start = 0, end = len;
+    while (start < end && strchr(" \t\r\n", data[start])) start++;
+    while (end > start && strchr(" \t\r\n", data[end - 1])) end--;
+    if (end == start || data[start] != '{' || data[end - 1] != '}') {
+        fprintf(stderr, "Report on stdin is not a JSON object\n");
+        free(data);
+        return 1;
+    }
+
+    uint64_t seq = 0;
+    int rc = report_log_append(cfg->log_dir, type, data + start, end - start, &seq);
+    free(data);
+    if (rc != 0) {
+        fprintf(stderr, "Cannot append to %s: %s\n", cfg->log_dir, strerror(errno));
+        return 1;
+    }
+    printf("%llu\n", (unsigned long long)seq);
+    return 0;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [MODE] [OPTIONS]\n", prog_name);
+    printf("Modes:\n");
+    printf("  --export              Print matching reports as a JSON array, oldest first (default)\n");
+    printf("  --latest              Print the newest matching report\n");
+    printf("  --count               Print the number of matching reports, from the index\n");
+    printf("  --export-dir DIR      Write matching reports as DIR/<type>-<epoch>-<seq>.json\n");
+    printf("  --append TYPE         Append the JSON report on stdin and print its sequence number\n");
+    printf("Options:\n");
+    printf("  --log-dir DIR         Report log (default: %s/%s)\n", REPORT_DIR, REPORT_LOG_NAME);
+    printf("  --type TYPE           Only reports of TYPE (binary-check, module-attestation, module-state)\n");
+    printf("  --since EPOCH         Only reports at or after EPOCH\n");
+    printf("  --until EPOCH         Only reports at or before EPOCH\n");
+    printf("  --limit N             Only the newest N matching reports\n");
+    printf("  -h, --help            Show this help message\n");
+}
+
+enum {
+    OPT_EXPORT = 256, OPT_LATEST, OPT_COUNT, OPT_EXPORT_DIR, OPT_APPEND,
+    OPT_LOG_DIR, OPT_TYPE, OPT_SINCE, OPT_UNTIL, OPT_LIMIT,
+};
+
+int main(int argc, char *argv[]) {
+    config_t cfg = {
+        .log_dir = REPORT_DIR "/" REPORT_LOG_NAME,
+        .since = INT64_MIN,
+        .until = INT64_MAX,
+    };
+    int mode = OPT_EXPORT;
+    const char *append_type = NULL;
+
+    static struct option long_options[] = {
+        {"export", no_argument, 0, OPT_EXPORT},
+        {"latest", no_argument, 0, OPT_LATEST},
+        {"count", no_argument, 0, OPT_COUNT},
+        {"export-dir", required_argument, 0, OPT_EXPORT_DIR},
+        {"append", required_argument, 0, OPT_APPEND},
+        {"log-dir", required_argument, 0, OPT_LOG_DIR},
+        {"type", required_argument, 0, OPT_TYPE},
+        {"since", required_argument, 0, OPT_SINCE},
+        {"until", required_argument, 0, OPT_UNTIL},
+        {"limit", required_argument, 0, OPT_LIMIT},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_EXPORT:
+            case OPT_LATEST:
+            case OPT_COUNT:
+                mode = opt;
+                break;
+            case OPT_EXPORT_DIR:
+                mode = opt;
+                cfg.export_dir = optarg;
+                break;
+            case OPT_APPEND:
+                mode = opt;
+                append_type = optarg;
+                break;
+            case OPT_LOG_DIR: cfg.log_dir = optarg; break;
+            case OPT_TYPE: cfg.type = optarg; break;
+            case OPT_SINCE: cfg.since = atoll(optarg); break;
+            case OPT_UNTIL: cfg.until = atoll(optarg); break;
+            case OPT_LIMIT: cfg.limit = strtoull(optarg, NULL, 10); break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    long n;
+    size_t printed = 0;
+    export_t export = {.dir = cfg.export_dir};
+    switch (mode) {
+        case OPT_APPEND:
+            return append_stdin(&cfg, append_type);
+        case OPT_LATEST:
+            n = report_log_query(cfg.log_dir, cfg.type, cfg.since, cfg.until, 1, print_document, NULL);
+            return n > 0 ? 0 : 1;
+        case OPT_COUNT:
+            n = report_log_count(cfg.log_dir, cfg.type, cfg.since, cfg.until);
+            if (cfg.limit && (size_t)n > cfg.limit) n = cfg.limit;
+            printf("%ld\n", n);
+            return 0;
+        case OPT_EXPORT_DIR:
+            if (make_dirs(cfg.export_dir) != 0) {
+                fprintf(stderr, "Cannot create %s: %s\n", cfg.export_dir, strerror(errno));
+                return 1;
+            }
+            n = report_log_query(cfg.log_dir, cfg.type, cfg.since, cfg.until, cfg.limit,
+                                 write_legacy_file, &export);
+            if (n < 0) break;
+            if (export.failed) {
+                fprintf(stderr, "Export to %s stopped after %ld reports\n", cfg.export_dir, export.written);
+                return 1;
+            }
+            fprintf(stderr, "Exported %ld reports to %s\n", export.written, cfg.export_dir);
+            return 0;
+        default:
+            n = report_log_query(cfg.log_dir, cfg.type, cfg.since, cfg.until, cfg.limit, print_array_entry, &printed);
+            if (n < 0) break;
+            fputs(printed ? "\n]\n" : "[]\n", stdout);
+            return 0;
+    }
+    fprintf(stderr, "Cannot read %s: %s\n", cfg.log_dir, strerror(errno));
+    return 1;
+}
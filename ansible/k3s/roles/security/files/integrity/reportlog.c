@@ -0,0 +1,542 @@
+// reportlog.c - Append-only attestation report log
+//
+// Reports from binary-check, module-state and module-monitor go into one
+// directory of numbered segments instead of a JSON file per run.
+//
+// Segment layout (little-endian):
+//   header   magic, version, index capacity, segment number, last sync time
+//   index    REPORT_INDEX_SLOTS fixed slots (timestamp, offset, length, type
+//            hash, sequence), filled in order; offset 0 marks a free slot
+//   records  64-byte header (type, timestamp, sequence, length, CRC-32C over
+//            header and payload) followed by the JSON payload
+//
+// Appending is one pwrite of the record and one of its index slot, under an
+// flock on the directory. Timestamps never go backwards, so the entry count and
+// the time bounds of a query are binary searches over the slots. A record
+// whose slot was never written (crash in between) is indexed by the next
+// writer and a torn record is truncated away. The active segment is synced at
+// most every SYNC_INTERVAL seconds; segments rotate by size or when the index
+// is full, and only the newest MAX_SEGMENTS are kept.
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "integrity.h"
+
+#define SEG_MAGIC           "S8RPTLOG"
+#define SEG_VERSION         1
+#define SEG_PREFIX          "segment-"
+#define SEG_SUFFIX          ".log"
+#define RECORD_MAGIC        0x52523853u     // "S8RR"
+#define REPORT_INDEX_SLOTS  1024
+#define SEGMENT_MAX_BYTES   (4u << 20)
+#define MAX_SEGMENTS        8               // ~32 MiB of history at most
+#define SYNC_INTERVAL       300             // seconds between fdatasync of the active segment
+#define MAX_REPORT_BYTES    (SEGMENT_MAX_BYTES / 2)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t index_slots;
+    uint64_t segment;
+    int64_t created;
+    int64_t synced;         // last fdatasync, rewritten only after one
+    uint8_t reserved[24];
+} seg_header_t;
+
+typedef struct {
+    int64_t timestamp;
+    uint64_t offset;        // of the record header; 0 for a free slot
+    uint32_t length;        // payload bytes
+    uint32_t type_hash;
+    uint64_t seq;
+} index_slot_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;           // CRC-32C over this header with crc = 0, then the payload
+    int64_t timestamp;
+    uint64_t seq;
+    uint32_t length;
+    uint32_t reserved;
+    char type[REPORT_TYPE_LEN];
+} record_header_t;
+
+_Static_assert(sizeof(seg_header_t) == 64, "segment header layout");
+_Static_assert(sizeof(index_slot_t) == 32, "index slot layout");
+_Static_assert(sizeof(record_header_t) == 64, "record header layout");
+
+#define DATA_START  (sizeof(seg_header_t) + REPORT_INDEX_SLOTS * sizeof(index_slot_t))
+
+// ---------------------------------------------------------------------------
+// CRC-32C
+// ---------------------------------------------------------------------------
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0x82F63B78u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t record_crc(const record_header_t *hdr, const void *payload) {
+    record_header_t copy = *hdr;
+    copy.crc = 0;
+    return crc32c(crc32c(0, &copy, sizeof(copy)), payload, hdr->length);
+}
+
+static uint32_t type_hash(const char *type) {
+    return (uint32_t)path_hash(type);
+}
+
+// ---------------------------------------------------------------------------
+// Segments
+// ---------------------------------------------------------------------------
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Segment numbers in the directory, ascending
+static size_t list_segments(const char *dir, uint64_t **out) {
+    *out = NULL;
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+    size_t count = 0, cap = 0, prefix_len = strlen(SEG_PREFIX);
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        char *end;
+        if (strncmp(e->d_name, SEG_PREFIX, prefix_len) != 0) continue;
+        unsigned long long n = strtoull(e->d_name + prefix_len, &end, 10);
+        if (end == e->d_name + prefix_len || strcmp(end, SEG_SUFFIX) != 0) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            uint64_t *grown = realloc(*out, cap * sizeof(uint64_t));
+            if (!grown) break;
+            *out = grown;
+        }
+        (*out)[count++] = n;
+    }
+    closedir(d);
+    qsort(*out, count, sizeof(uint64_t), compare_u64);
+    return count;
+}
+
+static void segment_path(const char *dir, uint64_t segment, char *out, size_t len) {
+    snprintf(out, len, "%s/" SEG_PREFIX "%08llu" SEG_SUFFIX, dir, (unsigned long long)segment);
+}
+
+static int read_exact(int fd, void *buf, size_t len, uint64_t off) {
+    return pread(fd, buf, len, off) == (ssize_t)len ? 0 : -1;
+}
+
+static int write_exact(int fd, const void *buf, size_t len, uint64_t off) {
+    return pwrite(fd, buf, len, off) == (ssize_t)len ? 0 : -1;
+}
+
+static int write_slot(int fd, uint32_t i, const index_slot_t *slot) {
+    return write_exact(fd, slot, sizeof(*slot), sizeof(seg_header_t) + (uint64_t)i * sizeof(*slot));
+}
+
+static int read_slot(int fd, uint32_t i, index_slot_t *slot) {
+    return read_exact(fd, slot, sizeof(*slot), sizeof(seg_header_t) + (uint64_t)i * sizeof(*slot));
+}
+
+static int open_segment(const char *dir, uint64_t segment, int flags, seg_header_t *hdr) {
+    char path[PATH_MAX];
+    segment_path(dir, segment, path, sizeof(path));
+    int fd = open(path, flags | O_CLOEXEC);
+    if (fd < 0) return -1;
+    if (read_exact(fd, hdr, sizeof(*hdr), 0) != 0 || memcmp(hdr->magic, SEG_MAGIC, 8) != 0 ||
+        hdr->version != SEG_VERSION || hdr->index_slots != REPORT_INDEX_SLOTS) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    return fd;
+}
+
+// Slots are filled in order, so the first free one is found by bisection
+static uint32_t slot_count(int fd) {
+    uint32_t lo = 0, hi = REPORT_INDEX_SLOTS;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        index_slot_t slot;
+        if (read_slot(fd, mid, &slot) == 0 && slot.offset != 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// First slot in [0, count) whose timestamp is >= ts (after = 0) or > ts (after = 1)
+static uint32_t slot_bound(int fd, uint32_t count, int64_t ts, int after) {
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        index_slot_t slot;
+        if (read_slot(fd, mid, &slot) != 0) return mid;
+        if (slot.timestamp < ts || (after && slot.timestamp == ts)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int create_segment(const char *dir, uint64_t segment) {
+    char path[PATH_MAX];
+    segment_path(dir, segment, path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    seg_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SEG_MAGIC, 8);
+    hdr.version = SEG_VERSION;
+    hdr.index_slots = REPORT_INDEX_SLOTS;
+    hdr.segment = segment;
+    hdr.created = hdr.synced = time(NULL);
+    // The index starts out as a hole of zeros, i.e. all slots free
+    if (ftruncate(fd, DATA_START) != 0 || write_exact(fd, &hdr, sizeof(hdr), 0) != 0) {
+        int err = errno;
+        close(fd);
+        unlink(path);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+static void prune_segments(const char *dir) {
+    uint64_t *segs;
+    size_t n = list_segments(dir, &segs);
+    char path[PATH_MAX];
+    for (size_t i = 0; n > MAX_SEGMENTS && i < n - MAX_SEGMENTS; i++) {
+        segment_path(dir, segs[i], path, sizeof(path));
+        unlink(path);
+    }
+    free(segs);
+}
+
+// Reads and checks the record a slot points at. Returns a malloc'd payload
+// with a terminating NUL, or NULL if the record is damaged.
+static char *read_record(int fd, uint64_t offset, uint32_t length, record_header_t *hdr) {
+    if (read_exact(fd, hdr, sizeof(*hdr), offset) != 0 || hdr->magic != RECORD_MAGIC ||
+        hdr->length != length || length > MAX_REPORT_BYTES) return NULL;
+    char *payload = malloc(length + 1);
+    if (!payload) return NULL;
+    if (read_exact(fd, payload, length, offset + sizeof(*hdr)) != 0 || record_crc(hdr, payload) != hdr->crc ||
+        memchr(hdr->type, '\0', sizeof(hdr->type)) == NULL) {
+        free(payload);
+        return NULL;
+    }
+    payload[length] = '\0';
+    return payload;
+}
+
+// ---------------------------------------------------------------------------
+// Append
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int fd;
+    uint64_t segment;
+    seg_header_t hdr;
+    uint32_t count;
+    uint64_t end;           // end of the last indexed record
+    int64_t last_ts;
+    uint64_t last_seq;
+} active_t;
+
+// Indexes records written after the last slot and cuts off a torn tail
+static int recover_tail(active_t *a) {
+    struct stat st;
+    if (fstat(a->fd, &st) != 0) return -1;
+    while (a->end + sizeof(record_header_t) <= (uint64_t)st.st_size && a->count < REPORT_INDEX_SLOTS) {
+        record_header_t hdr;
+        if (read_exact(a->fd, &hdr, sizeof(hdr), a->end) != 0 || hdr.magic != RECORD_MAGIC ||
+            a->end + sizeof(hdr) + hdr.length > (uint64_t)st.st_size) break;
+        char *payload = read_record(a->fd, a->end, hdr.length, &hdr);
+        if (!payload) break;
+        free(payload);
+        index_slot_t slot = {hdr.timestamp, a->end, hdr.length, type_hash(hdr.type), hdr.seq};
+        if (write_slot(a->fd, a->count, &slot) != 0) break;
+        a->count++;
+        a->end += sizeof(hdr) + hdr.length;
+        a->last_ts = hdr.timestamp;
+        a->last_seq = hdr.seq;
+    }
+    return (uint64_t)st.st_size > a->end ? ftruncate(a->fd, a->end) : 0;
+}
+
+static int load_active(const char *dir, uint64_t segment, active_t *a) {
+    a->segment = segment;
+    a->fd = open_segment(dir, segment, O_RDWR, &a->hdr);
+    if (a->fd < 0) return -1;
+    a->count = slot_count(a->fd);
+    a->end = DATA_START;
+    if (a->count) {
+        index_slot_t slot;
+        if (read_slot(a->fd, a->count - 1, &slot) == 0) {
+            a->end = slot.offset + sizeof(record_header_t) + slot.length;
+            a->last_ts = slot.timestamp;
+            a->last_seq = slot.seq;
+        }
+    }
+    // A tail that cannot be cut off is simply overwritten by the next record
+    recover_tail(a);
+    return 0;
+}
+
+static int start_segment(const char *dir, uint64_t segment, active_t *a) {
+    a->fd = create_segment(dir, segment);
+    if (a->fd < 0) return -1;
+    a->segment = segment;
+    read_exact(a->fd, &a->hdr, sizeof(a->hdr), 0);
+    a->count = 0;
+    a->end = DATA_START;
+    prune_segments(dir);
+    return 0;
+}
+
+int report_log_append(const char *dir, const char *type, const void *data, size_t len, uint64_t *seq_out) {
+    if (!type || strlen(type) >= REPORT_TYPE_LEN || len > MAX_REPORT_BYTES) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (make_dirs(dir) != 0) return -1;
+    char lock_path[PATH_MAX];
+    snprintf(lock_path, sizeof(lock_path), "%s/.lock", dir);
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock_fd < 0) return -1;
+    if (flock(lock_fd, LOCK_EX) != 0) {
+        close(lock_fd);
+        return -1;
+    }
+
+    int rc = -1, err = 0;
+    uint64_t *segs;
+    size_t n = list_segments(dir, &segs);
+    active_t a;
+    memset(&a, 0, sizeof(a));
+    a.fd = -1;
+    if (n == 0) {
+        if (start_segment(dir, 1, &a) != 0) goto out;
+    } else if (load_active(dir, segs[n - 1], &a) != 0) {
+        // An unreadable newest segment is left for inspection and a new one started
+        if (start_segment(dir, segs[n - 1] + 1, &a) != 0) goto out;
+    }
+    if (a.count == 0 && n > 0) {
+        // A fresh segment continues the previous one's clock and sequence
+        seg_header_t prev_hdr;
+        for (size_t i = n; i-- > 0 && !a.last_seq;) {
+            if (segs[i] == a.segment) continue;
+            int fd = open_segment(dir, segs[i], O_RDONLY, &prev_hdr);
+            if (fd < 0) continue;
+            uint32_t count = slot_count(fd);
+            index_slot_t slot;
+            if (count && read_slot(fd, count - 1, &slot) == 0) {
+                a.last_ts = slot.timestamp;
+                a.last_seq = slot.seq;
+            }
+            close(fd);
+        }
+    }
+
+    uint64_t record_len = sizeof(record_header_t) + len;
+    if (a.count == REPORT_INDEX_SLOTS || (a.count && a.end + record_len > SEGMENT_MAX_BYTES)) {
+        fdatasync(a.fd);
+        close(a.fd);
+        if (start_segment(dir, a.segment + 1, &a) != 0) goto out;
+    }
+
+    int64_t now = time(NULL);
+    record_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = RECORD_MAGIC;
+    hdr.timestamp = now > a.last_ts ? now : a.last_ts;  // keeps the index sorted across clock steps
+    hdr.seq = a.last_seq + 1;
+    hdr.length = len;
+    snprintf(hdr.type, sizeof(hdr.type), "%s", type);
+    hdr.crc = record_crc(&hdr, data);
+
+    uint8_t *buf = malloc(record_len);
+    if (!buf) goto out;
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), data, len);
+    // A short write leaves a torn record that the next append's recovery cuts off
+    errno = 0;
+    int written = write_exact(a.fd, buf, record_len, a.end);
+    free(buf);
+    index_slot_t slot = {hdr.timestamp, a.end, hdr.length, type_hash(type), hdr.seq};
+    if (written != 0 || write_slot(a.fd, a.count, &slot) != 0) {
+        err = errno ? errno : ENOSPC;
+        goto out;
+    }
+
+    // Losing the last few minutes of reports to a power cut is acceptable;
+    // an fsync per report is not
+    if (now - a.hdr.synced >= SYNC_INTERVAL && fdatasync(a.fd) == 0) {
+        // Losing this update only makes the next sync come early
+        a.hdr.synced = now;
+        write_exact(a.fd, &a.hdr, sizeof(a.hdr), 0);
+    }
+    if (seq_out) *seq_out = hdr.seq;
+    rc = 0;
+out:
+    if (rc != 0 && !err) err = errno;
+    if (a.fd >= 0) close(a.fd);
+    free(segs);
+    close(lock_fd);
+    if (rc != 0) errno = err;
+    return rc;
+}
+
+// ---------------------------------------------------------------------------
+// Queries
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t segment;
+    index_slot_t slot;
+} match_t;
+
+typedef struct {
+    match_t *items;
+    size_t count;
+    size_t cap;
+} match_list_t;
+
+static int push_match(match_list_t *list, uint64_t segment, const index_slot_t *slot) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        match_t *grown = realloc(list->items, cap * sizeof(match_t));
+        if (!grown) return -1;
+        list->items = grown;
+        list->cap = cap;
+    }
+    list->items[list->count].segment = segment;
+    list->items[list->count].slot = *slot;
+    list->count++;
+    return 0;
+}
+
+// Collects the matching slots of one segment; backwards stops after `limit` total
+static int collect_segment(int fd, uint64_t segment, uint32_t want, int64_t from, int64_t to,
+                           size_t limit, int backwards, match_list_t *list) {
+    uint32_t count = slot_count(fd);
+    uint32_t lo = slot_bound(fd, count, from, 0), hi = slot_bound(fd, count, to, 1);
+    if (lo >= hi) return 0;
+
+    index_slot_t *slots = malloc((size_t)(hi - lo) * sizeof(index_slot_t));
+    if (!slots) return -1;
+    int rc = read_exact(fd, slots, (size_t)(hi - lo) * sizeof(index_slot_t),
+                        sizeof(seg_header_t) + (uint64_t)lo * sizeof(index_slot_t));
+    for (uint32_t k = 0; rc == 0 && k < hi - lo; k++) {
+        const index_slot_t *slot = &slots[backwards ? hi - lo - 1 - k : k];
+        if (want && slot->type_hash != want) continue;
+        if (backwards && limit && list->count == limit) break;
+        rc = push_match(list, segment, slot);
+    }
+    free(slots);
+    return rc;
+}
+
+long report_log_count(const char *dir, const char *type, int64_t from, int64_t to) {
+    uint64_t *segs;
+    size_t n = list_segments(dir, &segs);
+    uint32_t want = type ? type_hash(type) : 0;
+    seg_header_t hdr;
+    long total = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int fd = open_segment(dir, segs[i], O_RDONLY, &hdr);
+        if (fd < 0) continue;
+        uint32_t count = slot_count(fd);
+        uint32_t lo = slot_bound(fd, count, from, 0), hi = slot_bound(fd, count, to, 1);
+        if (lo < hi && !want) {
+            total += hi - lo;
+        } else if (lo < hi) {
+            index_slot_t *slots = malloc((size_t)(hi - lo) * sizeof(index_slot_t));
+            if (slots && read_exact(fd, slots, (size_t)(hi - lo) * sizeof(index_slot_t),
+                                    sizeof(seg_header_t) + (uint64_t)lo * sizeof(index_slot_t)) == 0) {
+                for (uint32_t k = 0; k < hi - lo; k++) total += slots[k].type_hash == want;
+            }
+            free(slots);
+        }
+        close(fd);
+    }
+    free(segs);
+    return total;
+}
+
+long report_log_query(const char *dir, const char *type, int64_t from, int64_t to, size_t latest,
+                      report_fn fn, void *arg) {
+    uint64_t *segs;
+    size_t n = list_segments(dir, &segs);
+    uint32_t want = type ? type_hash(type) : 0;
+    match_list_t list = {0};
+    seg_header_t hdr;
+    int rc = 0;
+
+    // Newest-first when only the latest matches are wanted, so old segments
+    // are never opened once enough have been found
+    for (size_t k = 0; rc == 0 && k < n; k++) {
+        size_t i = latest ? n - 1 - k : k;
+        if (latest && list.count == latest) break;
+        int fd = open_segment(dir, segs[i], O_RDONLY, &hdr);
+        if (fd < 0) continue;
+        rc = collect_segment(fd, segs[i], want, from, to, latest, latest > 0, &list);
+        close(fd);
+    }
+    if (latest) {
+        for (size_t i = 0; i < list.count / 2; i++) {
+            match_t tmp = list.items[i];
+            list.items[i] = list.items[list.count - 1 - i];
+            list.items[list.count - 1 - i] = tmp;
+        }
+    }
+
+    long visited = 0;
+    int fd = -1;
+    uint64_t open_seg = 0;
+    for (size_t i = 0; rc == 0 && i < list.count; i++) {
+        const match_t *m = &list.items[i];
+        if (fd < 0 || open_seg != m->segment) {
+            if (fd >= 0) close(fd);
+            fd = open_segment(dir, m->segment, O_RDONLY, &hdr);
+            open_seg = m->segment;
+            if (fd < 0) continue;
+        }
+        record_header_t rec_hdr;
+        char *payload = read_record(fd, m->slot.offset, m->slot.length, &rec_hdr);
+        if (!payload) continue;
+        if (!type || strcmp(rec_hdr.type, type) == 0) {
+            report_record_t rec = {rec_hdr.timestamp, rec_hdr.seq, rec_hdr.type, payload, rec_hdr.length};
+            visited++;
+            if (fn && fn(&rec, arg) != 0) rc = 1;
+        }
+        free(payload);
+    }
+    if (fd >= 0) close(fd);
+    free(list.items);
+    free(segs);
+    return rc < 0 ? -1 : visited;
+}
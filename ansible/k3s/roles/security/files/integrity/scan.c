@@ -0,0 +1,185 @@
+// scan.c - Parallel baseline hashing and comparison shared by the checkers
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "integrity.h"
+
+// glibc only wraps getdents64 as getdents() from 2.30 on
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct {
+    hash_job_t *jobs;
+    hash_cache_t *cache;
+    size_t verity_measured;
+} hash_batch_t;
+
+static void hash_worker(size_t i, void *arg) {
+    hash_batch_t *batch = arg;
+    hash_job_t *job = &batch->jobs[i];
+    struct statx stx;
+    uint64_t bytes = 0;
+
+    // [ -f path ] follows symlinks and requires a regular file
+    if (stat_file(job->path, &stx) != 0 || !S_ISREG(stx.stx_mode)) {
+        job->status = JOB_MISSING;
+        return;
+    }
+    // A verity file measuring as baselined has the baselined contents; anything
+    // else (no verity, different measurement) is hashed normally
+    if (job->expect && verity_matches(job->path, &stx, &job->expect->verity)) {
+        memcpy(job->digest, job->expect->digest, SHA256_LEN);
+        job->status = JOB_OK;
+        __atomic_fetch_add(&batch->verity_measured, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (hash_cache_lookup(batch->cache, job->path, &stx, job->digest)) {
+        job->status = JOB_OK;
+        return;
+    }
+    if (hash_file(job->path, job->digest, &bytes) != 0) {
+        job->status = JOB_UNREADABLE;
+        job->err = errno;
+        return;
+    }
+    hash_cache_store(batch->cache, job->path, &stx, job->digest, bytes);
+    job->status = JOB_OK;
+}
+
+size_t hash_jobs(hash_job_t *jobs, size_t count, int threads, hash_cache_t *cache) {
+    hash_batch_t batch = {.jobs = jobs, .cache = cache};
+    pool_run(count, threads, hash_worker, &batch);
+    return batch.verity_measured;
+}
+
+hash_job_t *hash_paths(const char *const *paths, size_t count, int threads, hash_cache_t *cache) {
+    hash_job_t *jobs = calloc(count ? count : 1, sizeof(hash_job_t));
+    if (!jobs) return NULL;
+    for (size_t i = 0; i < count; i++) jobs[i].path = paths[i];
+    hash_jobs(jobs, count, threads, cache);
+    return jobs;
+}
+
+hash_job_t *hash_baseline(const baseline_t *baseline, int threads, hash_cache_t *cache,
+                          size_t *verity_measured) {
+    size_t count = baseline->count;
+    hash_job_t *jobs = calloc(count ? count : 1, sizeof(hash_job_t));
+    if (!jobs) return NULL;
+    for (size_t i = 0; i < count; i++) {
+        jobs[i].expect = baseline_entry(baseline, i);
+        jobs[i].path = jobs[i].expect->path;
+    }
+    size_t measured = hash_jobs(jobs, count, threads, cache);
+    if (verity_measured) *verity_measured = measured;
+    return jobs;
+}
+
+int check_job(const hash_job_t *job, const char *label, int *missing) {
+    char expected[SHA256_HEX_LEN + 1], current[SHA256_HEX_LEN + 1];
+
+    if (job->status == JOB_MISSING) {
+        alert_msg("%s missing: %s", label, job->path);
+        if (missing) (*missing)++;
+        return 0;
+    }
+    if (job->status == JOB_OK && memcmp(job->digest, job->expect->digest, SHA256_LEN) == 0) return 0;
+
+    hex_encode(job->expect->digest, SHA256_LEN, expected);
+    if (job->status == JOB_OK) hex_encode(job->digest, SHA256_LEN, current);
+    else snprintf(current, sizeof(current), "unreadable (%s)", strerror(job->err));
+    alert_msg("%s modified: %s", label, job->path);
+    alert_msg("  Expected: %s", expected);
+    alert_msg("  Current:  %s", current);
+    return 1;
+}
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t cap;
+} path_list_t;
+
+static int collate(const void *a, const void *b) {
+    return strcoll(*(char *const *)a, *(char *const *)b);
+}
+
+// One getdents64 pass per directory; only entries that may be regular files
+// (or symlinks to them) cost a statx, and only for the mode.
+static void scan_suid_dir(const char *dir, const baseline_t *baseline, path_list_t *hits,
+                          suid_scan_stats_t *stats) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    stats->dirs++;
+
+    char buf[64 * 1024] __attribute__((aligned(8)));
+    char path[PATH_MAX];
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            off += d->d_reclen;
+            // "$dir"/* skips dotfiles
+            if (d->d_name[0] == '.') continue;
+            stats->entries++;
+            if (d->d_type != DT_REG && d->d_type != DT_LNK && d->d_type != DT_UNKNOWN) continue;
+
+            // [ -f ] and [ -u ] follow symlinks
+            struct statx stx;
+            if (statx(fd, d->d_name, 0, STATX_TYPE | STATX_MODE, &stx) != 0) continue;
+            if (!S_ISREG(stx.stx_mode) || !(stx.stx_mode & (S_ISUID | S_ISGID))) continue;
+            stats->suid_sgid++;
+
+            snprintf(path, sizeof(path), "%s/%s", dir, d->d_name);
+            if (baseline_contains(baseline, path)) continue;
+            if (hits->count == hits->cap) {
+                size_t cap = hits->cap ? hits->cap * 2 : 16;
+                char **grown = realloc(hits->paths, cap * sizeof(char *));
+                if (!grown) continue;
+                hits->paths = grown;
+                hits->cap = cap;
+            }
+            if ((hits->paths[hits->count] = strdup(path))) hits->count++;
+        }
+    }
+    close(fd);
+}
+
+int scan_suid(const char *const *dirs, size_t n_dirs, const baseline_t *baseline, suid_scan_stats_t *stats) {
+    suid_scan_stats_t local;
+    struct timespec start, end;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int found = 0;
+    for (size_t d = 0; d < n_dirs; d++) {
+        path_list_t hits = {0};
+        scan_suid_dir(dirs[d], baseline, &hits, stats);
+        // Alert in glob order, as the script did
+        if (hits.count > 1) qsort(hits.paths, hits.count, sizeof(char *), collate);
+        for (size_t i = 0; i < hits.count; i++) {
+            alert_msg("New SUID/SGID binary detected: %s", hits.paths[i]);
+            free(hits.paths[i]);
+        }
+        free(hits.paths);
+        found += hits.count;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->unknown = found;
+    stats->elapsed_us = (end.tv_sec - start.tv_sec) * 1000000LL + (end.tv_nsec - start.tv_nsec) / 1000;
+    return found;
+}
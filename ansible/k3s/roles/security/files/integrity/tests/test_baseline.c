@@ -0,0 +1,64 @@
+// test_baseline.c - text and binary baselines must answer lookups alike
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../integrity.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static const char TEXT[] =
+    "1111111111111111111111111111111111111111111111111111111111111111  /usr/bin/real\n"
+    "# Mode: 0104755  /usr/bin/real\n"
+    "2222222222222222222222222222222222222222222222222222222222222222  /usr/bin/plain\n"
+    "# Symlink: /usr/bin/link -> /usr/lib/target\n"
+    "# Symlink: /usr/bin/self -> /usr/bin/real\n"
+    "# Symlink: /usr/bin/dangling\n";
+
+static const char *const PATHS[] = {
+    "/usr/bin/real", "/usr/bin/plain", "/usr/bin/link", "/usr/lib/target",
+    "/usr/bin/self", "/usr/bin/dangling", "/usr/bin/missing", "",
+};
+
+int main(void) {
+    baseline_t text, bin;
+    char path[] = "/tmp/test-baseline-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    CHECK(baseline_load_text(TEXT, sizeof(TEXT) - 1, &text) == 0);
+    CHECK(baseline_bin_write(path, &text) == 0);
+    CHECK(baseline_load(path, &bin) == 0);
+    unlink(path);
+    if (failures) return 1;
+
+    for (size_t i = 0; i < sizeof(PATHS) / sizeof(PATHS[0]); i++) {
+        int in_text = baseline_contains(&text, PATHS[i]);
+        int in_bin = baseline_contains(&bin, PATHS[i]);
+        if (in_text != in_bin) fprintf(stderr, "%s: text=%d binary=%d\n", PATHS[i], in_text, in_bin);
+        CHECK(in_text == in_bin);
+        CHECK((baseline_find(&text, PATHS[i]) == NULL) == (baseline_find(&bin, PATHS[i]) == NULL));
+    }
+    CHECK(baseline_contains(&bin, "/usr/lib/target"));
+    CHECK(!baseline_contains(&bin, "/usr/bin/missing"));
+
+    // Target rows are lookup-only: counts, lines and digest match the text form
+    uint8_t text_digest[SHA384_LEN], bin_digest[SHA384_LEN];
+    CHECK(bin.count == text.count);
+    CHECK(bin.n_symlinks == text.n_symlinks);
+    CHECK(bin.lines == text.lines);
+    CHECK(baseline_digest(&text, text_digest) == 0);
+    CHECK(baseline_digest(&bin, bin_digest) == 0);
+    CHECK(memcmp(text_digest, bin_digest, SHA384_LEN) == 0);
+
+    baseline_free(&text);
+    baseline_free(&bin);
+    if (!failures) printf("test_baseline: ok\n");
+    return failures != 0;
+}
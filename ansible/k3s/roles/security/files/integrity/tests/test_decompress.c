@@ -0,0 +1,90 @@
+// test_decompress.c - data after the first zstd frame or xz stream is ignored
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <lzma.h>
+#include <zstd.h>
+
+#include "../integrity.h"
+
+#define IMAGE_LEN (600 * 1024)
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static const char GARBAGE[] = "trailing bytes that are not a frame";
+
+static size_t compress_zstd(const uint8_t *image, uint8_t *out, size_t cap) {
+    size_t n = ZSTD_compress(out, cap, image, IMAGE_LEN, 3);
+    return ZSTD_isError(n) ? 0 : n;
+}
+
+static size_t compress_xz(const uint8_t *image, uint8_t *out, size_t cap) {
+    size_t n = 0;
+    return lzma_easy_buffer_encode(6, LZMA_CHECK_CRC32, NULL, image, IMAGE_LEN, out, &n, cap) == LZMA_OK ? n : 0;
+}
+
+static int scan(const uint8_t *data, size_t len, module_scan_t *out) {
+    char path[] = "/tmp/test-decompress-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    int rc = write(fd, data, len) == (ssize_t)len ? 0 : -1;
+    close(fd);
+    if (rc == 0) rc = module_scan(path, out);
+    unlink(path);
+    return rc;
+}
+
+// The frame alone, then followed by garbage, then by a second whole frame
+static void check_format(const char *name, module_format_t format, const uint8_t *image,
+                         size_t (*compress)(const uint8_t *, uint8_t *, size_t)) {
+    size_t cap = 2 * IMAGE_LEN + 2 * 1024 + sizeof(GARBAGE);
+    uint8_t *buf = malloc(cap);
+    size_t frame = buf ? compress(image, buf, cap / 2) : 0;
+    CHECK(frame > 0);
+    if (!frame) {
+        free(buf);
+        return;
+    }
+
+    module_scan_t clean, garbage, second;
+    CHECK(scan(buf, frame, &clean) == 0);
+    memcpy(buf + frame, GARBAGE, sizeof(GARBAGE));
+    CHECK(scan(buf, frame + sizeof(GARBAGE), &garbage) == 0);
+    memcpy(buf + frame, buf, frame);
+    CHECK(scan(buf, 2 * frame, &second) == 0);
+    free(buf);
+
+    CHECK(clean.format == format);
+    CHECK(clean.image_bytes == IMAGE_LEN);
+    CHECK(clean.sig_status != -1);
+    const module_scan_t *trailing[] = {&garbage, &second};
+    for (size_t i = 0; i < 2; i++) {
+        if (trailing[i]->image_bytes != clean.image_bytes || trailing[i]->sig_status != clean.sig_status) {
+            fprintf(stderr, "%s %s: image %llu sig %d\n", name, i ? "second frame" : "garbage",
+                    (unsigned long long)trailing[i]->image_bytes, trailing[i]->sig_status);
+        }
+        CHECK(trailing[i]->image_bytes == clean.image_bytes);
+        CHECK(trailing[i]->sig_status == clean.sig_status);
+    }
+}
+
+int main(void) {
+    uint8_t *image = malloc(IMAGE_LEN);
+    if (!image) return 1;
+    uint32_t x = 1;
+    for (size_t i = 0; i < IMAGE_LEN; i++) {
+        x = x * 1103515245 + 12345;
+        image[i] = (x >> 16) % 16;
+    }
+
+    check_format("zstd", MODULE_ZSTD, image, compress_zstd);
+    check_format("xz", MODULE_XZ, image, compress_xz);
+    free(image);
+    if (!failures) printf("test_decompress: ok\n");
+    return failures != 0;
+}
@@ -0,0 +1,205 @@
+// util.c - Logging and formatting helpers shared by the integrity tools
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "integrity.h"
+
+static FILE *log_fp = NULL;
+static FILE *alert_fp = NULL;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void log_init(const char *ident, const char *log_file, const char *alert_file) {
+    openlog(ident, LOG_PID, LOG_AUTH);
+    if (log_file) log_fp = fopen(log_file, "a");
+    if (alert_file) alert_fp = fopen(alert_file, "a");
+}
+
+void log_close(void) {
+    if (log_fp) fclose(log_fp);
+    if (alert_fp) fclose(alert_fp);
+    log_fp = alert_fp = NULL;
+    closelog();
+}
+
+static void local_timestamp(char *out, size_t len) {
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(out, len, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+void log_msg(const char *fmt, ...) {
+    char ts[32], msg[4096];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    local_timestamp(ts, sizeof(ts));
+
+    pthread_mutex_lock(&log_lock);
+    printf("[%s] %s\n", ts, msg);
+    if (log_fp) {
+        fprintf(log_fp, "[%s] %s\n", ts, msg);
+        fflush(log_fp);
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+void alert_msg(const char *fmt, ...) {
+    char ts[32], msg[4096];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    local_timestamp(ts, sizeof(ts));
+
+    pthread_mutex_lock(&log_lock);
+    printf("[%s] ALERT: %s\n", ts, msg);
+    if (alert_fp) {
+        fprintf(alert_fp, "[%s] ALERT: %s\n", ts, msg);
+        fflush(alert_fp);
+    }
+    syslog(LOG_WARNING, "%s", msg);
+    pthread_mutex_unlock(&log_lock);
+}
+
+void iso_timestamp(char *out, size_t len) {
+    time_t now = time(NULL);
+    struct tm tm;
+    char zone[8];
+    localtime_r(&now, &tm);
+    strftime(out, len, "%Y-%m-%dT%H:%M:%S", &tm);
+    strftime(zone, sizeof(zone), "%z", &tm);
+    // date -Iseconds renders the offset as +HH:MM
+    size_t n = strlen(out);
+    snprintf(out + n, len - n, "%.3s:%.2s", zone, zone + 3);
+}
+
+uint64_t path_hash(const char *s) {
+    // FNV-1a
+    uint64_t h = 1469598103934665603ULL;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void hex_encode(const uint8_t *in, size_t len, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = digits[in[i] >> 4];
+        out[2 * i + 1] = digits[in[i] & 0xF];
+    }
+    out[2 * len] = '\0';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int hex_decode(const char *hex, uint8_t *out, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        int hi = hex_value(hex[2 * i]);
+        int lo = hi < 0 ? -1 : hex_value(hex[2 * i + 1]);
+        if (lo < 0) return -1;
+        out[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return 0;
+}
+
+void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+            case '"':  fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out); break;
+            case '\t': fputs("\\t", out); break;
+            default:
+                if (c < 0x20) fprintf(out, "\\u%04x", c);
+                else fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+int write_file_atomic(const char *path, const void *data, size_t len, int mode) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d", path, (int)getpid());
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd < 0) return -1;
+    const char *p = data;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            unlink(tmp);
+            return -1;
+        }
+        p += n;
+        left -= n;
+    }
+    if (fsync(fd) != 0 || close(fd) != 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+char *read_text_file(const char *path, size_t *len_out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    size_t cap = 8192, len = 0;
+    char *buf = malloc(cap);
+    while (buf) {
+        size_t n = fread(buf + len, 1, cap - len - 1, f);
+        len += n;
+        if (n == 0) break;
+        if (len + 1 == cap) {
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    if (!buf) return NULL;
+    buf[len] = '\0';
+    if (len_out) *len_out = len;
+    return buf;
+}
+
+int make_dirs(const char *dir) {
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s", dir);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(tmp, 0755);
+            *p = '/';
+        }
+    }
+    return mkdir(tmp, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
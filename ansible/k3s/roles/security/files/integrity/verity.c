@@ -0,0 +1,108 @@
+// verity.c - fs-verity measurement and enablement
+//
+// For a file with fs-verity enabled the kernel keeps a Merkle tree over its
+// contents and refuses to return data that does not match it, so the file
+// digest from FS_IOC_MEASURE_VERITY stands in for reading and hashing the
+// whole file. The digest is over the verity descriptor, not the plain
+// content, which is why the baseline records it next to the sha256sum line.
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fsverity.h>
+
+#include "integrity.h"
+
+static const char *alg_name(uint16_t alg) {
+    switch (alg) {
+        case FS_VERITY_HASH_ALG_SHA256: return "sha256";
+        case FS_VERITY_HASH_ALG_SHA512: return "sha512";
+        default: return NULL;
+    }
+}
+
+int verity_enabled(const struct statx *stx) {
+    return (stx->stx_attributes_mask & STATX_ATTR_VERITY) && (stx->stx_attributes & STATX_ATTR_VERITY);
+}
+
+static int measure_fd(int fd, verity_digest_t *out) {
+    struct {
+        struct fsverity_digest hdr;
+        uint8_t digest[VERITY_MAX_DIGEST];
+    } arg;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.hdr.digest_size = VERITY_MAX_DIGEST;
+    if (ioctl(fd, FS_IOC_MEASURE_VERITY, &arg) != 0) return -1;
+    if (!alg_name(arg.hdr.digest_algorithm) || arg.hdr.digest_size > VERITY_MAX_DIGEST) {
+        errno = EINVAL;
+        return -1;
+    }
+    out->alg = arg.hdr.digest_algorithm;
+    out->len = arg.hdr.digest_size;
+    memcpy(out->digest, arg.digest, out->len);
+    return 0;
+}
+
+int verity_measure(const char *path, verity_digest_t *out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int rc = measure_fd(fd, out);
+    int err = errno;
+    close(fd);
+    errno = err;
+    return rc;
+}
+
+int verity_matches(const char *path, const struct statx *stx, const verity_digest_t *expected) {
+    verity_digest_t current;
+    if (!expected || !expected->len || !verity_enabled(stx)) return 0;
+    if (verity_measure(path, &current) != 0) return 0;
+    return current.alg == expected->alg && current.len == expected->len &&
+           memcmp(current.digest, expected->digest, current.len) == 0;
+}
+
+int verity_enable(const char *path, verity_digest_t *out) {
+    // The kernel requires a read-only fd and no open writers (ETXTBSY)
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct fsverity_enable_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.version = 1;
+    arg.hash_algorithm = FS_VERITY_HASH_ALG_SHA256;
+    arg.block_size = 4096;
+
+    int rc = ioctl(fd, FS_IOC_ENABLE_VERITY, &arg);
+    if (rc != 0 && errno == EEXIST) rc = 0;     // already enabled
+    if (rc == 0) rc = measure_fd(fd, out);
+    int err = errno;
+    close(fd);
+    errno = err;
+    return rc;
+}
+
+int verity_format(const verity_digest_t *digest, char *out, size_t len) {
+    const char *name = alg_name(digest->alg);
+    if (!name || len < strlen(name) + 2 + 2 * (size_t)digest->len) return -1;
+    size_t n = strlen(name);
+    memcpy(out, name, n);
+    out[n] = ':';
+    hex_encode(digest->digest, digest->len, out + n + 1);
+    return 0;
+}
+
+int verity_parse(const char *text, size_t len, verity_digest_t *out) {
+    const char *colon = memchr(text, ':', len);
+    if (!colon) return -1;
+    size_t name_len = colon - text, hex_len = len - name_len - 1;
+
+    memset(out, 0, sizeof(*out));
+    if (name_len == 6 && memcmp(text, "sha256", 6) == 0) out->alg = FS_VERITY_HASH_ALG_SHA256;
+    else if (name_len == 6 && memcmp(text, "sha512", 6) == 0) out->alg = FS_VERITY_HASH_ALG_SHA512;
+    else return -1;
+    out->len = out->alg == FS_VERITY_HASH_ALG_SHA256 ? 32 : 64;
+    if (hex_len != 2 * (size_t)out->len || hex_decode(colon + 1, out->digest, out->len) != 0) return -1;
+    return 0;
+}
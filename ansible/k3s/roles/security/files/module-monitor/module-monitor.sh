@@ -7,13 +7,46 @@ BASELINE_DIR="/etc/module-security"
 REPORT_DIR="/var/lib/attestation"
 LOG_FILE="/var/log/module-monitor.log"
 STATE_FILE="/var/lib/attestation/module-state-current.json"
-MAX_REPORTS=20  # Keep only last 20 reports
+MODULE_EVENTS_FILE="/var/lib/attestation/module-events.json"  # written by integrity-monitor
+EVENTS_CURSOR_FILE="/var/lib/attestation/module-events.cursor"  # last monitor start and load count seen
 
 log() {
     echo "[$(date '+%Y-%m-%d %H:%M:%S')] $1" | tee -a "$LOG_FILE"
 }
 
 check_loaded_modules() {
+    # integrity-monitor follows module uevents, so it also catches modules that
+    # were loaded and removed again between runs; lsmod is only the fallback
+    if systemctl is-active --quiet integrity-monitor 2>/dev/null && \
+       [ -n "$(find "$MODULE_EVENTS_FILE" -mmin -5 2>/dev/null)" ]; then
+        local started=$(sed -n 's/^ *"monitor_started": "\(.*\)",$/\1/p' "$MODULE_EVENTS_FILE")
+        local unexpected=$(sed -n 's/^ *"unexpected_loads": \([0-9]*\).*/\1/p' "$MODULE_EVENTS_FILE")
+        local not_in_baseline=$(sed -n 's/^ *"not_in_baseline_count": \([0-9]*\).*/\1/p' "$MODULE_EVENTS_FILE")
+        unexpected=${unexpected:-0}
+
+        # unexpected_loads counts since the monitor started; only loads since the
+        # last run are new (all of them if the monitor restarted since)
+        local last_started="" last_unexpected=0
+        [ -f "$EVENTS_CURSOR_FILE" ] && read -r last_started last_unexpected < "$EVENTS_CURSOR_FILE" || true
+        local new_loads=$unexpected
+        if [ "$started" = "$last_started" ] && [ "$unexpected" -ge "${last_unexpected:-0}" ]; then
+            new_loads=$((unexpected - ${last_unexpected:-0}))
+        fi
+        echo "$started $unexpected" > "$EVENTS_CURSOR_FILE.tmp" && mv "$EVENTS_CURSOR_FILE.tmp" "$EVENTS_CURSOR_FILE"
+
+        local status=0
+        if [ "$new_loads" -ne 0 ]; then
+            log "WARNING: $new_loads module loads outside baseline since the last check"
+            grep '"action": "add".*"in_baseline": false' "$MODULE_EVENTS_FILE" | tail -n "$new_loads" >> "$LOG_FILE" || true
+            status=1
+        fi
+        if [ "${not_in_baseline:-0}" -ne 0 ]; then
+            log "WARNING: $not_in_baseline modules outside baseline are loaded"
+            status=1
+        fi
+        return $status
+    fi
+
     local current_modules=$(lsmod | sort)
     local baseline_modules=$(cat "$BASELINE_DIR/modules.baseline")
     
@@ -26,12 +59,12 @@ check_loaded_modules() {
 }
 
 check_module_files() {
-    local current_hashes=$(find /lib/modules/$(uname -r) -name "*.ko*" -exec sha256sum {} \; | sort)
-    local baseline_hashes=$(cat "$BASELINE_DIR/module-files.sha256")
-    
-    if [ "$current_hashes" != "$baseline_hashes" ]; then
+    # Diffs Merkle trees of the baseline and the module directory; only
+    # directories whose hashes differ are walked, and only changed files are listed
+    local changes
+    if ! changes=$(/usr/local/bin/module-state --diff "$BASELINE_DIR/module-files.sha256" 2>>"$LOG_FILE"); then
         log "WARNING: Module files have been modified"
-        diff <(echo "$baseline_hashes") <(echo "$current_hashes") >> "$LOG_FILE" 2>&1 || true
+        echo "$changes" >> "$LOG_FILE"
         return 1
     fi
     return 0
@@ -63,9 +96,13 @@ check_tainted_modules() {
 generate_report() {
     mkdir -p "$REPORT_DIR"
     
-    # Generate report with timestamp
-    local timestamp=$(date +%s)
-    local report_file="$REPORT_DIR/module-state-${timestamp}.json"
+    # The current state file is what module-state embeds; history goes to the
+    # append-only report log instead of one file per run
+    local report_file="$STATE_FILE.tmp"
+    # Root of the persisted module Merkle tree; check_module_files has just brought
+    # it up to date, so this rehashes nothing
+    local tree_root
+    tree_root=$(/usr/local/bin/module-state --tree 2>>"$LOG_FILE") || tree_root="unavailable"
     
     cat > "$report_file" << EOF
 {
@@ -74,7 +111,7 @@ generate_report() {
     "kernel": "$(uname -r)",
     "module_count": $(lsmod | wc -l),
     "modules_hash": "$(lsmod | sha256sum | cut -d' ' -f1)",
-    "module_files_hash": "$(find /lib/modules/$(uname -r) -name "*.ko*" -exec sha256sum {} \; | sha256sum | cut -d' ' -f1)",
+    "module_tree_root": "$tree_root",
     "kernel_tainted": $(cat /proc/sys/kernel/tainted),
     "signature_enforcement": $(grep -q 'module.sig_enforce=1' /proc/cmdline && echo true || echo false),
     "modules_loaded": [
@@ -83,22 +120,10 @@ $(lsmod | tail -n +2 | awk '{printf "        \"%s\"", $1}' | sed 's/,$//' | tr '
 }
 EOF
     
-    # Also update the current state file (always latest)
-    cp "$report_file" "$STATE_FILE"
+    mv "$report_file" "$STATE_FILE"
+    /usr/local/bin/report-log --append module-state < "$STATE_FILE" > /dev/null 2>> "$LOG_FILE" || true
     
-    echo "$report_file"
-}
-
-cleanup_old_reports() {
-    # Clean up old module-state reports (keep only last MAX_REPORTS)
-    if [ -d "$REPORT_DIR" ]; then
-        # Count and remove old module-state files
-        local count=$(ls -1 "$REPORT_DIR"/module-state-*.json 2>/dev/null | wc -l)
-        if [ $count -gt $MAX_REPORTS ]; then
-            ls -t "$REPORT_DIR"/module-state-*.json | tail -n +$((MAX_REPORTS + 1)) | xargs rm -f
-            log "Cleaned up $((count - MAX_REPORTS)) old reports"
-        fi
-    fi
+    echo "$STATE_FILE"
 }
 
 # Main execution
@@ -122,9 +147,6 @@ fi
 REPORT=$(generate_report)
 log "Generated report: $REPORT"
 
-# Clean up old reports
-cleanup_old_reports
-
 # Alert if issues detected
 if [ $STATUS -ne 0 ]; then
     log "Module security issues detected, check logs for details"
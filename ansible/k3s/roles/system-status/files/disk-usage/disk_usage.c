@@ -0,0 +1,802 @@
+// disk_usage.c - Parallel disk usage scan for the system-status /disk endpoints
+//
+// Walks a directory tree with a pool of threads, one getdents64 pass plus a
+// statx per entry, and sums allocated blocks the way du does: each directory
+// counts its own blocks, symlinks are not followed, and a file with several
+// hard links inside the tree is counted once. With -x, directories on another
+// filesystem are skipped, mount points included. Totals match du exactly; a
+// file linked from several directories is charged to whichever of them the
+// walk reaches first, which need not be the one du would pick.
+//
+// Directories down to --max-depth are ranked per depth level in bounded top-N
+// heaps, so the output stays small however large the tree is:
+//
+//   {"path":"/var","total_bytes":N,"max_depth":2,"top":10,
+//    "dirs":N,"files":N,"errors":N,"elapsed_ms":N,
+//    "levels":[{"depth":1,"count":N,"entries":[{"path":"/var/lib","size_bytes":N},...]},...]}
+//
+// "count" is the number of directories found at that depth; "entries" holds the
+// largest --top of them (all of them with --top 0), largest first.
+//
+// With --index, what each directory listing contributed is kept in
+// DEFAULT_INDEX_FILE between runs. A directory whose identity, mtime and ctime are unchanged is
+// not read again: its recorded files and subdirectory names are reused, at
+// the cost of one statx per subdirectory. Changes that leave the directory
+// alone, such as a file growing in place, are only picked up once the record
+// is older than --max-age, so reused sizes are at most that old. The report
+// then adds
+//
+//   "index":{"records":N,"reused":N,"rescanned":N,"stale_seconds":N,"saved":true}
+//
+// where stale_seconds is the age of the oldest record used for this answer.
+//
+// The service runs this tool through sudo, so the index location is not an
+// option: a caller-chosen path would be a root-owned file write. The
+// DISK_USAGE_INDEX override exists for tests and benchmarks; sudo's env_reset
+// keeps it from reaching a sudo invocation.
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+
+#include "disk_usage.h"
+
+#define MAX_THREADS         64
+#define DEFAULT_MAX_THREADS 16      // the service runs with TasksMax=128
+#define DEFAULT_MAX_DEPTH   1
+#define DEFAULT_TOP         10
+#define MAX_DEPTH_LIMIT     64
+#define DIRENT_BUF_SIZE     (64 * 1024)
+#define INODE_SHARDS        64
+#define DEFAULT_MAX_AGE     300     // seconds a reused directory listing may be old
+#define DEFAULT_INDEX_FILE  "/var/cache/disk-usage/index"
+#define STATX_IDENTITY      (STATX_TYPE | STATX_INO | STATX_BLOCKS | STATX_MTIME | STATX_CTIME)
+
+// glibc only wraps getdents64 as getdents() from 2.30 on
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// A directory still being summed. It stays alive until its own entries and
+// every subdirectory have been counted, then adds its total to its parent.
+typedef struct dir_node {
+    struct dir_node *parent;
+    struct dir_node *next;          // work stack link
+    char *path;
+    int depth;
+    uint64_t dev;                   // identity checked against the index
+    uint64_t ino;
+    struct statx_timestamp mtime;
+    struct statx_timestamp ctime;
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast32_t pending;   // unfinished subdirectories + 1 for its own scan
+} dir_node_t;
+
+typedef struct {
+    uint64_t bytes;
+    char *path;
+} entry_t;
+
+// Min-heap on bytes holding at most cap entries; cap 0 keeps everything
+typedef struct {
+    entry_t *items;
+    size_t count;
+    size_t alloc;
+    size_t cap;
+    uint64_t seen;
+} top_heap_t;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+} inode_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    inode_t *slots;
+    size_t used;
+    size_t size;
+} inode_shard_t;
+
+typedef struct {
+    du_record_t **items;
+    size_t count;
+    size_t alloc;
+} record_list_t;
+
+typedef struct {
+    top_heap_t *levels;             // [1..max_depth]
+    uint64_t dirs;
+    uint64_t files;
+    uint64_t errors;
+    record_list_t fresh;            // listings read by this run, owned
+    record_list_t reused;           // records taken over from the loaded index
+    int64_t oldest_reused;          // scanned_at of the oldest reused record
+} worker_state_t;
+
+static struct {
+    int max_depth;
+    size_t top;
+    int one_fs;
+    uint64_t root_dev;
+    du_index_t *index;              // NULL without --index
+    int64_t max_age;
+    int64_t now;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    dir_node_t *stack;
+    int done;
+    uint64_t total;
+
+    inode_shard_t inodes[INODE_SHARDS];
+} scan = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t statx_dev(const struct statx *stx) {
+    return makedev(stx->stx_dev_major, stx->stx_dev_minor);
+}
+
+static uint64_t statx_bytes(const struct statx *stx) {
+    return (stx->stx_mask & STATX_BLOCKS) ? stx->stx_blocks * 512 : 0;
+}
+
+static void set_identity(dir_node_t *node, const struct statx *stx) {
+    node->dev = statx_dev(stx);
+    node->ino = stx->stx_ino;
+    node->mtime = stx->stx_mtime;
+    node->ctime = stx->stx_ctime;
+}
+
+static int list_add(record_list_t *list, du_record_t *rec) {
+    if (list->count == list->alloc) {
+        size_t alloc = list->alloc ? list->alloc * 2 : 64;
+        du_record_t **items = realloc(list->items, alloc * sizeof(du_record_t *));
+        if (!items) return -1;
+        list->items = items;
+        list->alloc = alloc;
+    }
+    list->items[list->count++] = rec;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Hard links: remember (dev, ino) of multiply linked files, count the first one
+// ---------------------------------------------------------------------------
+
+static uint64_t inode_hash(uint64_t dev, uint64_t ino) {
+    uint64_t h = ino * 0x9e3779b97f4a7c15ULL ^ dev;
+    h ^= h >> 29;
+    return h * 0xbf58476d1ce4e5b9ULL;
+}
+
+// Returns 1 the first time an inode is seen
+static int inode_first_seen(uint64_t dev, uint64_t ino) {
+    uint64_t h = inode_hash(dev, ino);
+    inode_shard_t *shard = &scan.inodes[h % INODE_SHARDS];
+    int first = 1;
+
+    pthread_mutex_lock(&shard->lock);
+    if ((shard->used + 1) * 2 > shard->size) {
+        size_t size = shard->size ? shard->size * 2 : 256;
+        inode_t *slots = calloc(size, sizeof(inode_t));
+        if (!slots) {
+            // Out of memory: counting a link twice beats failing the scan
+            pthread_mutex_unlock(&shard->lock);
+            return 1;
+        }
+        for (size_t i = 0; i < shard->size; i++) {
+            inode_t *old = &shard->slots[i];
+            if (!old->ino) continue;
+            size_t j = (inode_hash(old->dev, old->ino) / INODE_SHARDS) & (size - 1);
+            while (slots[j].ino) j = (j + 1) & (size - 1);
+            slots[j] = *old;
+        }
+        free(shard->slots);
+        shard->slots = slots;
+        shard->size = size;
+    }
+    size_t j = (h / INODE_SHARDS) & (shard->size - 1);
+    while (shard->slots[j].ino) {
+        if (shard->slots[j].ino == ino && shard->slots[j].dev == dev) {
+            first = 0;
+            break;
+        }
+        j = (j + 1) & (shard->size - 1);
+    }
+    if (first) {
+        shard->slots[j] = (inode_t){.dev = dev, .ino = ino};
+        shard->used++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return first;
+}
+
+// ---------------------------------------------------------------------------
+// Top-N heaps, one per depth level and worker; merged at the end
+// ---------------------------------------------------------------------------
+
+static void heap_sift_down(top_heap_t *heap, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < heap->count && heap->items[l].bytes < heap->items[m].bytes) m = l;
+        if (r < heap->count && heap->items[r].bytes < heap->items[m].bytes) m = r;
+        if (m == i) return;
+        entry_t tmp = heap->items[i];
+        heap->items[i] = heap->items[m];
+        heap->items[m] = tmp;
+        i = m;
+    }
+}
+
+static void heap_offer(top_heap_t *heap, uint64_t bytes, const char *path) {
+    heap->seen++;
+    if (heap->cap && heap->count == heap->cap) {
+        // Full: only something larger than the current minimum gets in
+        if (bytes <= heap->items[0].bytes) return;
+        char *copy = strdup(path);
+        if (!copy) return;
+        free(heap->items[0].path);
+        heap->items[0] = (entry_t){.bytes = bytes, .path = copy};
+        heap_sift_down(heap, 0);
+        return;
+    }
+    if (heap->count == heap->alloc) {
+        size_t alloc = heap->alloc ? heap->alloc * 2 : 16;
+        if (heap->cap && alloc > heap->cap) alloc = heap->cap;
+        entry_t *items = realloc(heap->items, alloc * sizeof(entry_t));
+        if (!items) return;
+        heap->items = items;
+        heap->alloc = alloc;
+    }
+    char *copy = strdup(path);
+    if (!copy) return;
+    size_t i = heap->count++;
+    heap->items[i] = (entry_t){.bytes = bytes, .path = copy};
+    // Only a bounded heap needs ordering; an unbounded one is sorted once at the end
+    while (heap->cap && i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap->items[parent].bytes <= heap->items[i].bytes) break;
+        entry_t tmp = heap->items[i];
+        heap->items[i] = heap->items[parent];
+        heap->items[parent] = tmp;
+        i = parent;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Tree walk
+// ---------------------------------------------------------------------------
+
+static void push_dirs(dir_node_t *first, dir_node_t *last) {
+    pthread_mutex_lock(&scan.lock);
+    last->next = scan.stack;
+    scan.stack = first;
+    pthread_cond_broadcast(&scan.cond);
+    pthread_mutex_unlock(&scan.lock);
+}
+
+static dir_node_t *pop_dir(void) {
+    pthread_mutex_lock(&scan.lock);
+    while (!scan.stack && !scan.done) pthread_cond_wait(&scan.cond, &scan.lock);
+    dir_node_t *node = scan.stack;
+    if (node) scan.stack = node->next;
+    pthread_mutex_unlock(&scan.lock);
+    return node;
+}
+
+// Drop one pending count; a directory that reaches zero is complete, gets
+// ranked, and hands its total to its parent, which may complete in turn.
+static void finish_dir(dir_node_t *node, worker_state_t *state) {
+    while (node && atomic_fetch_sub(&node->pending, 1) == 1) {
+        uint64_t bytes = atomic_load(&node->bytes);
+        dir_node_t *parent = node->parent;
+
+        if (node->depth >= 1 && node->depth <= scan.max_depth) {
+            heap_offer(&state->levels[node->depth], bytes, node->path);
+        }
+        if (!parent) {
+            pthread_mutex_lock(&scan.lock);
+            scan.total = bytes;
+            scan.done = 1;
+            pthread_cond_broadcast(&scan.cond);
+            pthread_mutex_unlock(&scan.lock);
+        } else {
+            atomic_fetch_add(&parent->bytes, bytes);
+        }
+        free(node->path);
+        free(node);
+        node = parent;
+    }
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t dlen = strlen(dir), nlen = strlen(name);
+    int slash = dlen > 0 && dir[dlen - 1] != '/';
+    char *path = malloc(dlen + slash + nlen + 1);
+    if (!path) return NULL;
+    memcpy(path, dir, dlen);
+    if (slash) path[dlen] = '/';
+    memcpy(path + dlen + slash, name, nlen + 1);
+    return path;
+}
+
+static int open_dir(const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    }
+    return fd;
+}
+
+// Queue a subdirectory found by stx; NULL if it is skipped or allocation fails
+static dir_node_t *new_child(dir_node_t *parent, const char *name, const struct statx *stx,
+                             worker_state_t *state) {
+    if (scan.one_fs && statx_dev(stx) != scan.root_dev) return NULL;
+    dir_node_t *child = calloc(1, sizeof(dir_node_t));
+    char *path = child ? join_path(parent->path, name) : NULL;
+    if (!path) {
+        free(child);
+        state->errors++;
+        return NULL;
+    }
+    child->parent = parent;
+    child->path = path;
+    child->depth = parent->depth + 1;
+    set_identity(child, stx);
+    atomic_init(&child->bytes, statx_bytes(stx));
+    atomic_init(&child->pending, 1);
+    atomic_fetch_add(&parent->pending, 1);
+    return child;
+}
+
+static void count_linked(uint64_t dev, uint64_t ino, uint64_t bytes, uint64_t *total) {
+    if (inode_first_seen(dev, ino)) *total += bytes;
+}
+
+// A record stands for the directory while its identity and timestamps are
+// unchanged, it is young enough, and it was not read in the same second the
+// directory last changed (a later change in that second would look the same).
+static const du_record_t *usable_record(const dir_node_t *node) {
+    if (!scan.index) return NULL;
+    const du_record_t *rec = du_index_find(scan.index, node->path);
+    if (!rec || rec->dev != node->dev || rec->ino != node->ino) return NULL;
+    if (rec->mtime_sec != node->mtime.tv_sec || rec->mtime_nsec != node->mtime.tv_nsec ||
+        rec->ctime_sec != node->ctime.tv_sec || rec->ctime_nsec != node->ctime.tv_nsec) {
+        return NULL;
+    }
+    if (rec->scanned_at <= node->mtime.tv_sec || rec->scanned_at <= node->ctime.tv_sec) return NULL;
+    if (scan.now - rec->scanned_at > scan.max_age) return NULL;
+    return rec;
+}
+
+// Take the directory's own entries from its record; only subdirectories are
+// looked at, to pick up their identity and own blocks
+static int reuse_dir(dir_node_t *node, const du_record_t *rec, worker_state_t *state,
+                     dir_node_t **first, dir_node_t **last, uint64_t *bytes) {
+    int fd = -1;
+    if (rec->n_subdirs) {
+        fd = open(node->path, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) return -1;
+    }
+
+    *bytes += rec->file_bytes;
+    for (uint32_t i = 0; i < rec->n_links; i++) {
+        count_linked(rec->links[i].dev, rec->links[i].ino, rec->links[i].bytes, bytes);
+    }
+    state->files += rec->files;
+
+    for (uint32_t i = 0; i < rec->n_subdirs; i++) {
+        struct statx stx;
+        if (statx(fd, rec->subdirs[i], AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_IDENTITY, &stx) != 0 ||
+            !S_ISDIR(stx.stx_mode)) {
+            // Gone since the parent was checked; the next run re-reads the parent
+            state->errors++;
+            continue;
+        }
+        dir_node_t *child = new_child(node, rec->subdirs[i], &stx, state);
+        if (!child) continue;
+        child->next = *first;
+        *first = child;
+        if (!*last) *last = child;
+    }
+    if (fd >= 0) close(fd);
+
+    list_add(&state->reused, (du_record_t *)rec);
+    if (rec->scanned_at < state->oldest_reused) state->oldest_reused = rec->scanned_at;
+    return 0;
+}
+
+static int add_subdir_name(du_record_t *rec, const char *name) {
+    if ((rec->n_subdirs & (rec->n_subdirs - 1)) == 0) {
+        size_t alloc = rec->n_subdirs ? rec->n_subdirs * 2 : 4;
+        char **subdirs = realloc(rec->subdirs, alloc * sizeof(char *));
+        if (!subdirs) return -1;
+        rec->subdirs = subdirs;
+    }
+    if (!(rec->subdirs[rec->n_subdirs] = strdup(name))) return -1;
+    rec->n_subdirs++;
+    return 0;
+}
+
+static int add_link(du_record_t *rec, uint64_t dev, uint64_t ino, uint64_t bytes) {
+    if ((rec->n_links & (rec->n_links - 1)) == 0) {
+        size_t alloc = rec->n_links ? rec->n_links * 2 : 4;
+        du_link_t *links = realloc(rec->links, alloc * sizeof(du_link_t));
+        if (!links) return -1;
+        rec->links = links;
+    }
+    rec->links[rec->n_links++] = (du_link_t){.dev = dev, .ino = ino, .bytes = bytes};
+    return 0;
+}
+
+// Read the directory; with an index, record what the listing contributed
+static int read_dir(dir_node_t *node, worker_state_t *state, char *buf,
+                    dir_node_t **first, dir_node_t **last, uint64_t *bytes) {
+    int fd = open_dir(node->path);
+    if (fd < 0) return -1;
+
+    du_record_t *rec = NULL;
+    if (scan.index && (rec = calloc(1, sizeof(du_record_t)))) {
+        rec->path = strdup(node->path);
+        rec->dev = node->dev;
+        rec->ino = node->ino;
+        rec->mtime_sec = node->mtime.tv_sec;
+        rec->mtime_nsec = node->mtime.tv_nsec;
+        rec->ctime_sec = node->ctime.tv_sec;
+        rec->ctime_nsec = node->ctime.tv_nsec;
+        rec->scanned_at = scan.now;
+    }
+    int complete = rec && rec->path;
+
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, buf, DIRENT_BUF_SIZE);
+        if (n < 0) {
+            state->errors++;
+            complete = 0;
+        }
+        if (n <= 0) break;
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            off += d->d_reclen;
+            if (d->d_name[0] == '.' &&
+                (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0'))) {
+                continue;
+            }
+
+            struct statx stx;
+            if (statx(fd, d->d_name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+                      STATX_IDENTITY | STATX_NLINK, &stx) != 0) {
+                state->errors++;
+                complete = 0;
+                continue;
+            }
+
+            if (S_ISDIR(stx.stx_mode)) {
+                // Recorded before the filesystem check, so one index serves -x and not
+                if (complete && add_subdir_name(rec, d->d_name) != 0) complete = 0;
+                dir_node_t *child = new_child(node, d->d_name, &stx, state);
+                if (!child) continue;
+                child->next = *first;
+                *first = child;
+                if (!*last) *last = child;
+                continue;
+            }
+
+            state->files++;
+            uint64_t size = statx_bytes(&stx);
+            if (rec) rec->files++;
+            if (stx.stx_nlink > 1) {
+                if (complete && add_link(rec, statx_dev(&stx), stx.stx_ino, size) != 0) complete = 0;
+                count_linked(statx_dev(&stx), stx.stx_ino, size, bytes);
+            } else {
+                if (rec) rec->file_bytes += size;
+                *bytes += size;
+            }
+        }
+    }
+    close(fd);
+
+    // Only a listing read without errors may stand in for the directory later
+    if (complete && list_add(&state->fresh, rec) == 0) return 0;
+    du_record_free(rec);
+    return 0;
+}
+
+static void scan_dir(dir_node_t *node, worker_state_t *state, char *buf) {
+    dir_node_t *first = NULL, *last = NULL;
+    uint64_t bytes = 0;
+
+    // reuse_dir only fails before taking anything from the record
+    const du_record_t *rec = usable_record(node);
+    int rc = rec ? reuse_dir(node, rec, state, &first, &last, &bytes) : -1;
+    if (rc != 0) rc = read_dir(node, state, buf, &first, &last, &bytes);
+    if (rc != 0) {
+        // Unreadable: only its own blocks, taken when the parent listed it, count, like du
+        state->errors++;
+        finish_dir(node, state);
+        return;
+    }
+    state->dirs++;
+
+    atomic_fetch_add(&node->bytes, bytes);
+    if (first) push_dirs(first, last);
+    finish_dir(node, state);
+}
+
+static void *worker(void *arg) {
+    worker_state_t *state = arg;
+    char *buf = aligned_alloc(8, DIRENT_BUF_SIZE);
+    if (!buf) return NULL;
+    dir_node_t *node;
+    while ((node = pop_dir())) {
+        scan_dir(node, state, buf);
+    }
+    free(buf);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+static void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        switch (*p) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+            else fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static int entry_order(const void *a, const void *b) {
+    const entry_t *x = a, *y = b;
+    if (x->bytes != y->bytes) return x->bytes > y->bytes ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+static void print_level(FILE *out, int depth, worker_state_t *states, int threads) {
+    size_t total = 0;
+    uint64_t seen = 0;
+    for (int t = 0; t < threads; t++) {
+        total += states[t].levels[depth].count;
+        seen += states[t].levels[depth].seen;
+    }
+    entry_t *all = malloc((total ? total : 1) * sizeof(entry_t));
+    size_t n = 0;
+    for (int t = 0; t < threads; t++) {
+        top_heap_t *heap = &states[t].levels[depth];
+        for (size_t i = 0; i < heap->count; i++) {
+            if (all) all[n++] = heap->items[i];
+            else free(heap->items[i].path);
+        }
+        free(heap->items);
+    }
+    qsort(all, n, sizeof(entry_t), entry_order);
+
+    fprintf(out, "{\"depth\":%d,\"count\":%llu,\"entries\":[", depth, (unsigned long long)seen);
+    size_t shown = scan.top && n > scan.top ? scan.top : n;
+    for (size_t i = 0; i < n; i++) {
+        if (i < shown) {
+            fprintf(out, "%s{\"path\":", i ? "," : "");
+            json_string(out, all[i].path);
+            fprintf(out, ",\"size_bytes\":%llu}", (unsigned long long)all[i].bytes);
+        }
+        free(all[i].path);
+    }
+    fputs("]}", out);
+    free(all);
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] PATH\n"
+            "  -d, --max-depth N   Rank directories down to depth N (default: %d)\n"
+            "  -n, --top N         Keep the N largest directories per depth, 0 for all (default: %d)\n"
+            "  -x, --one-file-system\n"
+            "                      Skip directories on other filesystems\n"
+            "  -j, --threads N     Worker threads (default: CPUs, at most %d)\n"
+            "  -i, --index         Keep directory listings in %s and reuse unchanged ones\n"
+            "  -a, --max-age S     Re-read directories whose listing is older than S seconds\n"
+            "                      (default: %d, 0 re-reads everything and refreshes the index)\n"
+            "  -h, --help          Show this help\n",
+            prog, DEFAULT_MAX_DEPTH, DEFAULT_TOP, DEFAULT_MAX_THREADS, DEFAULT_INDEX_FILE, DEFAULT_MAX_AGE);
+}
+
+int main(int argc, char **argv) {
+    static const struct option long_opts[] = {
+        {"max-depth", required_argument, NULL, 'd'},
+        {"top", required_argument, NULL, 'n'},
+        {"one-file-system", no_argument, NULL, 'x'},
+        {"threads", required_argument, NULL, 'j'},
+        {"index", no_argument, NULL, 'i'},
+        {"max-age", required_argument, NULL, 'a'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int threads = 0, opt;
+    long top = DEFAULT_TOP;
+    const char *index_file = NULL;
+
+    scan.max_depth = DEFAULT_MAX_DEPTH;
+    scan.max_age = DEFAULT_MAX_AGE;
+    while ((opt = getopt_long(argc, argv, "d:n:xj:ia:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'd': scan.max_depth = atoi(optarg); break;
+        case 'n': top = atol(optarg); break;
+        case 'x': scan.one_fs = 1; break;
+        case 'j': threads = atoi(optarg); break;
+        case 'i':
+            index_file = getenv("DISK_USAGE_INDEX");
+            if (!index_file || !*index_file) index_file = DEFAULT_INDEX_FILE;
+            break;
+        case 'a': scan.max_age = atoll(optarg); break;
+        case 'h': print_usage(argv[0]); return 0;
+        default: print_usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 1 || scan.max_depth < 0 || scan.max_depth > MAX_DEPTH_LIMIT || top < 0 ||
+        scan.max_age < 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+    scan.top = (size_t)top;
+    const char *root_path = argv[optind];
+
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus > DEFAULT_MAX_THREADS ? DEFAULT_MAX_THREADS : (int)cpus;
+    }
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    struct statx root_stx;
+    if (statx(AT_FDCWD, root_path, AT_NO_AUTOMOUNT, STATX_IDENTITY, &root_stx) != 0) {
+        fprintf(stderr, "disk-usage: %s: %s\n", root_path, strerror(errno));
+        return 1;
+    }
+    if (!S_ISDIR(root_stx.stx_mode)) {
+        fprintf(stderr, "disk-usage: %s: Not a directory\n", root_path);
+        return 1;
+    }
+    scan.root_dev = statx_dev(&root_stx);
+    scan.now = time(NULL);
+    if (index_file && !(scan.index = du_index_load(index_file))) {
+        perror("disk-usage");
+        return 1;
+    }
+    for (int i = 0; i < INODE_SHARDS; i++) pthread_mutex_init(&scan.inodes[i].lock, NULL);
+
+    worker_state_t *states = calloc(threads, sizeof(worker_state_t));
+    if (!states) {
+        perror("disk-usage");
+        return 1;
+    }
+    for (int t = 0; t < threads; t++) {
+        states[t].levels = calloc(scan.max_depth + 1, sizeof(top_heap_t));
+        if (!states[t].levels) {
+            perror("disk-usage");
+            return 1;
+        }
+        for (int d = 0; d <= scan.max_depth; d++) states[t].levels[d].cap = scan.top;
+        states[t].oldest_reused = INT64_MAX;
+    }
+
+    dir_node_t *root = calloc(1, sizeof(dir_node_t));
+    if (!root || !(root->path = strdup(root_path))) {
+        perror("disk-usage");
+        return 1;
+    }
+    set_identity(root, &root_stx);
+    atomic_init(&root->bytes, statx_bytes(&root_stx));
+    atomic_init(&root->pending, 1);
+    // The root path is returned as given; the service passes it resolved
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The root must be readable; anything below may fail and is counted
+    int fd = open_dir(root_path);
+    if (fd < 0) {
+        fprintf(stderr, "disk-usage: %s: %s\n", root_path, strerror(errno));
+        return 1;
+    }
+    close(fd);
+    push_dirs(root, root);
+
+    pthread_t tids[MAX_THREADS];
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&tids[started], NULL, worker, &states[t]) != 0) break;
+        started++;
+    }
+    worker(&states[0]);
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    threads = started + 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t dirs = 0, files = 0, errors = 0;
+    size_t fresh = 0, reused = 0;
+    int64_t oldest = INT64_MAX;
+    for (int t = 0; t < threads; t++) {
+        dirs += states[t].dirs;
+        files += states[t].files;
+        errors += states[t].errors;
+        fresh += states[t].fresh.count;
+        reused += states[t].reused.count;
+        if (states[t].oldest_reused < oldest) oldest = states[t].oldest_reused;
+    }
+
+    int saved = 0;
+    size_t records = 0;
+    if (scan.index) {
+        du_record_t **all = malloc((fresh + reused + 1) * sizeof(du_record_t *));
+        if (all) {
+            for (int t = 0; t < threads; t++) {
+                memcpy(all + records, states[t].fresh.items, states[t].fresh.count * sizeof(du_record_t *));
+                records += states[t].fresh.count;
+                memcpy(all + records, states[t].reused.items, states[t].reused.count * sizeof(du_record_t *));
+                records += states[t].reused.count;
+            }
+            saved = du_index_save(index_file, scan.index, root_path, all, records) == 0;
+            if (!saved) fprintf(stderr, "disk-usage: cannot save index %s: %s\n", index_file, strerror(errno));
+            free(all);
+        }
+    }
+
+    FILE *out = stdout;
+    fputs("{\"path\":", out);
+    json_string(out, root_path);
+    fprintf(out,
+            ",\"total_bytes\":%llu,\"max_depth\":%d,\"top\":%zu,\"dirs\":%llu,\"files\":%llu,"
+            "\"errors\":%llu,\"elapsed_ms\":%lld,\"levels\":[",
+            (unsigned long long)scan.total, scan.max_depth, scan.top, (unsigned long long)dirs,
+            (unsigned long long)files, (unsigned long long)errors,
+            (long long)((end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000));
+    for (int d = 1; d <= scan.max_depth; d++) {
+        if (d > 1) fputc(',', out);
+        print_level(out, d, states, threads);
+    }
+    fputc(']', out);
+    if (scan.index) {
+        fprintf(out,
+                ",\"index\":{\"records\":%zu,\"reused\":%zu,\"rescanned\":%llu,\"stale_seconds\":%lld,"
+                "\"saved\":%s}",
+                records, reused, (unsigned long long)(dirs - reused),
+                (long long)(reused ? scan.now - oldest : 0), saved ? "true" : "false");
+    }
+    fputs("}\n", out);
+
+    for (int t = 0; t < threads; t++) {
+        for (size_t i = 0; i < states[t].fresh.count; i++) du_record_free(states[t].fresh.items[i]);
+        free(states[t].fresh.items);
+        free(states[t].reused.items);
+        free(states[t].levels);
+    }
+    free(states);
+    du_index_free(scan.index);
+    return fflush(out) == 0 ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+// disk_usage.h - Shared declarations for the disk-usage scanner
+#ifndef DISK_USAGE_H
+#define DISK_USAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ---------------------------------------------------------------------------
+// index.c - persistent per-directory size index
+// ---------------------------------------------------------------------------
+
+// A file with more than one link, counted once per scan by (dev, ino)
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t bytes;
+} du_link_t;
+
+// What one directory listing contributed, and the directory identity it was
+// taken for. The listing is still valid while dev, ino, mtime and ctime match:
+// creating, removing or renaming an entry changes the directory's mtime.
+// Files growing in place do not, which is what the record age bounds.
+typedef struct {
+    char *path;
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    int64_t scanned_at;     // wall clock seconds when the listing was read
+    uint64_t file_bytes;    // non-directory entries with a single link
+    uint64_t files;
+    uint32_t n_links;
+    uint32_t n_subdirs;
+    du_link_t *links;
+    char **subdirs;         // names of every subdirectory, other filesystems included
+} du_record_t;
+
+typedef struct du_index du_index_t;
+
+// Load an index file. A missing, unreadable or corrupt file gives an empty
+// index (the scan then reads every directory); NULL only when out of memory.
+du_index_t *du_index_load(const char *file);
+void du_index_free(du_index_t *index);
+size_t du_index_count(const du_index_t *index);
+const du_record_t *du_index_find(const du_index_t *index, const char *path);
+
+// Atomically replace file with the records of this scan plus the old records
+// that lie outside root, so indexes of separately scanned trees share a file.
+int du_index_save(const char *file, const du_index_t *old, const char *root,
+                  du_record_t *const *records, size_t count);
+
+void du_record_free(du_record_t *rec);
+
+#endif
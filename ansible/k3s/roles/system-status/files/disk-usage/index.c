@@ -0,0 +1,296 @@
+// index.c - Persistent per-directory size index for disk-usage
+//
+// File layout, native endianness (the index never leaves the host):
+//
+//   "DUINDEX1" u64 count
+//   count x { u32 path_len, path,
+//             u64 dev, ino, i64 mtime_sec, mtime_nsec, ctime_sec, ctime_nsec,
+//             i64 scanned_at, u64 file_bytes, files,
+//             u32 n_links, n_subdirs,
+//             n_links x { u64 dev, ino, bytes },
+//             n_subdirs x { u32 name_len, name } }
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "disk_usage.h"
+
+#define INDEX_MAGIC     "DUINDEX1"
+#define INDEX_MAGIC_LEN 8
+#define INDEX_MAX_STRING (1 << 16)
+
+struct du_index {
+    du_record_t *records;
+    size_t count;
+    size_t *slots;      // open addressing on path, record index + 1, 0 = empty
+    size_t size;
+};
+
+static uint64_t path_hash(const char *s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Bounds-checked reader over the loaded file
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    int bad;
+} reader_t;
+
+static void take(reader_t *r, void *out, size_t len) {
+    if (r->bad || (size_t)(r->end - r->p) < len) {
+        r->bad = 1;
+        memset(out, 0, len);
+        return;
+    }
+    memcpy(out, r->p, len);
+    r->p += len;
+}
+
+static char *take_string(reader_t *r) {
+    uint32_t len = 0;
+    take(r, &len, sizeof(len));
+    if (r->bad || len == 0 || len > INDEX_MAX_STRING || (size_t)(r->end - r->p) < len) {
+        r->bad = 1;
+        return NULL;
+    }
+    char *s = malloc(len + 1);
+    if (!s) {
+        r->bad = 1;
+        return NULL;
+    }
+    memcpy(s, r->p, len);
+    s[len] = '\0';
+    r->p += len;
+    return s;
+}
+
+static int read_record(reader_t *r, du_record_t *rec) {
+    memset(rec, 0, sizeof(*rec));
+    rec->path = take_string(r);
+    take(r, &rec->dev, sizeof(rec->dev));
+    take(r, &rec->ino, sizeof(rec->ino));
+    take(r, &rec->mtime_sec, sizeof(rec->mtime_sec));
+    take(r, &rec->mtime_nsec, sizeof(rec->mtime_nsec));
+    take(r, &rec->ctime_sec, sizeof(rec->ctime_sec));
+    take(r, &rec->ctime_nsec, sizeof(rec->ctime_nsec));
+    take(r, &rec->scanned_at, sizeof(rec->scanned_at));
+    take(r, &rec->file_bytes, sizeof(rec->file_bytes));
+    take(r, &rec->files, sizeof(rec->files));
+    take(r, &rec->n_links, sizeof(rec->n_links));
+    take(r, &rec->n_subdirs, sizeof(rec->n_subdirs));
+    if (r->bad) return -1;
+
+    // Sanity-check counts against what is left before allocating
+    size_t left = r->end - r->p;
+    if ((uint64_t)rec->n_links * sizeof(du_link_t) > left || rec->n_subdirs > left / 5) {
+        r->bad = 1;
+        return -1;
+    }
+    if (rec->n_links) {
+        rec->links = malloc(rec->n_links * sizeof(du_link_t));
+        if (!rec->links) return -1;
+        take(r, rec->links, rec->n_links * sizeof(du_link_t));
+    }
+    if (rec->n_subdirs) {
+        rec->subdirs = calloc(rec->n_subdirs, sizeof(char *));
+        if (!rec->subdirs) return -1;
+        for (uint32_t i = 0; i < rec->n_subdirs && !r->bad; i++) {
+            rec->subdirs[i] = take_string(r);
+        }
+    }
+    return r->bad ? -1 : 0;
+}
+
+static void free_fields(du_record_t *rec) {
+    free(rec->path);
+    free(rec->links);
+    if (rec->subdirs) {
+        for (uint32_t i = 0; i < rec->n_subdirs; i++) free(rec->subdirs[i]);
+    }
+    free(rec->subdirs);
+}
+
+void du_record_free(du_record_t *rec) {
+    if (!rec) return;
+    free_fields(rec);
+    free(rec);
+}
+
+static int build_table(du_index_t *index) {
+    size_t size = 16;
+    while (size < index->count * 2) size *= 2;
+    index->slots = calloc(size, sizeof(size_t));
+    if (!index->slots) return -1;
+    index->size = size;
+    for (size_t i = 0; i < index->count; i++) {
+        size_t j = path_hash(index->records[i].path) & (size - 1);
+        while (index->slots[j]) j = (j + 1) & (size - 1);
+        index->slots[j] = i + 1;
+    }
+    return 0;
+}
+
+static uint8_t *read_file(const char *file, size_t *len_out) {
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    uint8_t *data = NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        data = malloc(st.st_size);
+        size_t got = 0;
+        while (data && got < (size_t)st.st_size) {
+            ssize_t n = read(fd, data + got, st.st_size - got);
+            if (n <= 0) {
+                free(data);
+                data = NULL;
+                break;
+            }
+            got += n;
+        }
+        *len_out = got;
+    }
+    close(fd);
+    return data;
+}
+
+du_index_t *du_index_load(const char *file) {
+    du_index_t *index = calloc(1, sizeof(du_index_t));
+    if (!index) return NULL;
+
+    size_t len = 0;
+    uint8_t *data = read_file(file, &len);
+    if (data) {
+        reader_t r = {.p = data, .end = data + len};
+        char magic[INDEX_MAGIC_LEN];
+        uint64_t count = 0;
+        take(&r, magic, sizeof(magic));
+        take(&r, &count, sizeof(count));
+        if (r.bad || memcmp(magic, INDEX_MAGIC, INDEX_MAGIC_LEN) != 0 || count > len) {
+            fprintf(stderr, "disk-usage: ignoring invalid index %s\n", file);
+        } else if ((index->records = calloc(count ? count : 1, sizeof(du_record_t)))) {
+            for (; index->count < count; index->count++) {
+                if (read_record(&r, &index->records[index->count]) != 0) {
+                    free_fields(&index->records[index->count]);
+                    break;
+                }
+            }
+            if (index->count < count) {
+                // A torn or corrupt index is only a cache: start over
+                fprintf(stderr, "disk-usage: ignoring invalid index %s\n", file);
+                for (size_t i = 0; i < index->count; i++) free_fields(&index->records[i]);
+                index->count = 0;
+            }
+        }
+        free(data);
+    } else if (errno != ENOENT) {
+        fprintf(stderr, "disk-usage: cannot read index %s: %s\n", file, strerror(errno));
+    }
+
+    if (build_table(index) != 0) {
+        du_index_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+void du_index_free(du_index_t *index) {
+    if (!index) return;
+    for (size_t i = 0; i < index->count; i++) free_fields(&index->records[i]);
+    free(index->records);
+    free(index->slots);
+    free(index);
+}
+
+size_t du_index_count(const du_index_t *index) {
+    return index->count;
+}
+
+const du_record_t *du_index_find(const du_index_t *index, const char *path) {
+    size_t j = path_hash(path) & (index->size - 1);
+    while (index->slots[j]) {
+        const du_record_t *rec = &index->records[index->slots[j] - 1];
+        if (strcmp(rec->path, path) == 0) return rec;
+        j = (j + 1) & (index->size - 1);
+    }
+    return NULL;
+}
+
+static int under_root(const char *path, const char *root, size_t root_len) {
+    if (strncmp(path, root, root_len) != 0) return 0;
+    // "/" contains everything; otherwise the next character must end a component
+    return root_len == 1 || path[root_len] == '\0' || path[root_len] == '/';
+}
+
+static void put_string(FILE *out, const char *s) {
+    uint32_t len = strlen(s);
+    fwrite(&len, sizeof(len), 1, out);
+    fwrite(s, 1, len, out);
+}
+
+static void write_record(FILE *out, const du_record_t *rec) {
+    put_string(out, rec->path);
+    fwrite(&rec->dev, sizeof(rec->dev), 1, out);
+    fwrite(&rec->ino, sizeof(rec->ino), 1, out);
+    fwrite(&rec->mtime_sec, sizeof(rec->mtime_sec), 1, out);
+    fwrite(&rec->mtime_nsec, sizeof(rec->mtime_nsec), 1, out);
+    fwrite(&rec->ctime_sec, sizeof(rec->ctime_sec), 1, out);
+    fwrite(&rec->ctime_nsec, sizeof(rec->ctime_nsec), 1, out);
+    fwrite(&rec->scanned_at, sizeof(rec->scanned_at), 1, out);
+    fwrite(&rec->file_bytes, sizeof(rec->file_bytes), 1, out);
+    fwrite(&rec->files, sizeof(rec->files), 1, out);
+    fwrite(&rec->n_links, sizeof(rec->n_links), 1, out);
+    fwrite(&rec->n_subdirs, sizeof(rec->n_subdirs), 1, out);
+    if (rec->n_links) fwrite(rec->links, sizeof(du_link_t), rec->n_links, out);
+    for (uint32_t i = 0; i < rec->n_subdirs; i++) put_string(out, rec->subdirs[i]);
+}
+
+int du_index_save(const char *file, const du_index_t *old, const char *root,
+                  du_record_t *const *records, size_t count) {
+    size_t root_len = strlen(root);
+    uint64_t total = count;
+    for (size_t i = 0; old && i < old->count; i++) {
+        if (!under_root(old->records[i].path, root, root_len)) total++;
+    }
+
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp.%d", file, (int)getpid()) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    FILE *out = fdopen(fd, "w");
+    if (!out) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+
+    fwrite(INDEX_MAGIC, 1, INDEX_MAGIC_LEN, out);
+    fwrite(&total, sizeof(total), 1, out);
+    for (size_t i = 0; old && i < old->count; i++) {
+        if (!under_root(old->records[i].path, root, root_len)) write_record(out, &old->records[i]);
+    }
+    for (size_t i = 0; i < count; i++) write_record(out, records[i]);
+
+    int failed = fflush(out) != 0 || ferror(out) || fsync(fd) != 0;
+    int saved_errno = errno;
+    if (fclose(out) != 0) failed = 1;
+    if (failed || rename(tmp, file) != 0) {
+        if (!failed) saved_errno = errno;
+        unlink(tmp);
+        errno = saved_errno;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#!/bin/bash
+# bench-journal-reader.sh - Compare journalctl against the native journal-reader
+# on the local system journal. Verifies both return the same entries (by
+# cursor) for a unit's tail, checks that paging through with --after-cursor
+# visits the same entries again, then times a tail read of each.
+#
+# Usage: bench-journal-reader.sh [UNIT] [LINES] [PAGE]
+set -e
+
+UNIT=${1:-k3s.service}
+LINES=${2:-1000}
+PAGE=${3:-100}
+HERE="$(cd "$(dirname "$0")" && pwd)"
+NATIVE="$HERE/../journal-reader"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+[ -x "$NATIVE" ] || make -C "$HERE/.." journal-reader >/dev/null
+
+journalctl --unit="$UNIT" --lines="$LINES" --output=json --no-pager \
+    | python3 -c 'import json,sys; [print(json.loads(l)["__CURSOR"]) for l in sys.stdin]' > "$WORK/journalctl.txt"
+"$NATIVE" --unit "$UNIT" --lines "$LINES" > "$WORK/native.ndjson"
+python3 -c 'import json,sys; [print(r["cursor"]) for r in map(json.loads, open(sys.argv[1])) if r["type"] == "entry"]' \
+    "$WORK/native.ndjson" > "$WORK/native.txt"
+count=$(wc -l < "$WORK/journalctl.txt")
+if [ "$count" -eq 0 ]; then
+    echo "FAIL: no journal entries for $UNIT"
+    exit 1
+fi
+if ! diff -q "$WORK/journalctl.txt" "$WORK/native.txt" >/dev/null; then
+    echo "FAIL: entries differ from journalctl"
+    diff "$WORK/journalctl.txt" "$WORK/native.txt" | head -20
+    exit 1
+fi
+
+# Page from the window's first entry to the end, PAGE at a time; entries
+# logged meanwhile only extend the tail
+python3 - "$NATIVE" "$UNIT" "$PAGE" "$WORK/native.txt" <<'PY'
+import json, subprocess, sys
+native, unit, page = sys.argv[1:4]
+expected = open(sys.argv[4]).read().split()
+cursor, seen, pages, more = expected[0], [], 0, True
+while more:
+    out = subprocess.run([native, "--unit", unit, "--lines", page, "--after-cursor", cursor],
+                         capture_output=True, check=True, text=True).stdout
+    rows = [json.loads(line) for line in out.splitlines()]
+    seen += [r["cursor"] for r in rows if r["type"] == "entry"]
+    cursor, more, pages = rows[-1]["next_cursor"], rows[-1]["more"], pages + 1
+assert seen[:len(expected) - 1] == expected[1:], "paged entries differ"
+print(f"Pagination matches: {len(seen)} entries in {pages} pages")
+PY
+echo "Outputs match: $count entries for $UNIT"
+
+time_cmd() {
+    local start end
+    start=$(date +%s%N)
+    "$@" >/dev/null
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000000 ))
+}
+
+# Warm the page cache so both runs measure the read, not the disk
+journalctl --unit="$UNIT" --lines="$LINES" --no-pager >/dev/null
+short_ms=$(time_cmd journalctl --unit="$UNIT" --lines="$LINES" --output=short --no-pager)
+json_ms=$(time_cmd journalctl --unit="$UNIT" --lines="$LINES" --output=json --no-pager)
+native_ms=$(time_cmd "$NATIVE" --unit "$UNIT" --lines "$LINES")
+echo "journalctl --output=short:      ${short_ms} ms"
+echo "journalctl --output=json:       ${json_ms} ms"
+echo "journal-reader:                 ${native_ms} ms"
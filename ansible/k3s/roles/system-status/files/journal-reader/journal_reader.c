@@ -0,0 +1,280 @@
+// journal_reader.c - Stream one unit's journal entries as NDJSON
+//
+// Reads the journal through sd-journal, filtered by the journal's own field
+// indexes the way `journalctl --unit` is: entries logged by the unit, plus
+// systemd's messages about it. One JSON object per line, oldest first:
+//
+//   {"type":"entry","cursor":"s=...","realtime_usec":N,"priority":6,"pid":N,
+//    "identifier":"k3s","message":"..."}
+//   ...
+//   {"type":"end","count":N,"next_cursor":"s=..."|null,"more":false}
+//
+// Without --after-cursor the newest --lines entries are returned (newer than
+// --since, when given). With --after-cursor the entries following that cursor
+// are returned, at most --lines of them, and "more" says whether the journal
+// has further entries. next_cursor is the cursor of the last entry written,
+// or the --after-cursor given when nothing was, so a client tails by always
+// passing it back; it is null only for an empty tail window.
+//
+// Messages are cut at --max-message bytes (sd_journal_set_data_threshold), and
+// invalid UTF-8 is replaced with U+FFFD so every line is valid JSON.
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <systemd/sd-journal.h>
+
+#define DEFAULT_LINES       200
+#define DEFAULT_MAX_MESSAGE (16 * 1024)
+#define OUTPUT_BUF_SIZE     (64 * 1024)
+#define MAX_FIELD           256
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s --unit UNIT [options]\n"
+            "  -u, --unit UNIT         systemd unit to read (required)\n"
+            "  -n, --lines N           Entries to return (default: %d)\n"
+            "  -s, --since USEC        Only entries at or after this realtime, in microseconds\n"
+            "  -c, --after-cursor C    Return entries following cursor C, oldest first\n"
+            "  -m, --max-message N     Truncate message fields to N bytes (default: %d)\n"
+            "  -D, --directory DIR     Read journal files from DIR instead of the system journal\n"
+            "  -h, --help              Show this help\n",
+            prog, DEFAULT_LINES, DEFAULT_MAX_MESSAGE);
+}
+
+// JSON string from raw journal bytes, replacing invalid UTF-8 with U+FFFD
+static void json_bytes(FILE *out, const uint8_t *s, size_t len) {
+    fputc('"', out);
+    for (size_t i = 0; i < len;) {
+        uint8_t c = s[i];
+        if (c < 0x80) {
+            switch (c) {
+            case '"':  fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out); break;
+            case '\r': fputs("\\r", out); break;
+            case '\t': fputs("\\t", out); break;
+            default:
+                if (c < 0x20 || c == 0x7f) fprintf(out, "\\u%04x", c);
+                else fputc(c, out);
+            }
+            i++;
+            continue;
+        }
+        size_t n = c >= 0xf0 && c <= 0xf4 ? 4 : c >= 0xe0 ? 3 : c >= 0xc2 && c <= 0xdf ? 2 : 0;
+        int valid = n && i + n <= len;
+        for (size_t k = 1; valid && k < n; k++) {
+            if ((s[i + k] & 0xc0) != 0x80) valid = 0;
+        }
+        // Reject overlong forms, surrogates and code points past U+10FFFF
+        if (valid && n == 3 && ((c == 0xe0 && s[i + 1] < 0xa0) || (c == 0xed && s[i + 1] >= 0xa0))) valid = 0;
+        if (valid && n == 4 && ((c == 0xf0 && s[i + 1] < 0x90) || (c == 0xf4 && s[i + 1] >= 0x90))) valid = 0;
+        if (valid) {
+            fwrite(s + i, 1, n, out);
+            i += n;
+        } else {
+            fputs("\\ufffd", out);
+            i++;
+        }
+    }
+    fputc('"', out);
+}
+
+// Value of FIELD for the current entry, without the "FIELD=" prefix
+static int get_field(sd_journal *j, const char *field, const uint8_t **value, size_t *len) {
+    const void *data;
+    size_t size;
+    size_t prefix = strlen(field) + 1;
+    if (sd_journal_get_data(j, field, &data, &size) < 0 || size < prefix) return -1;
+    *value = (const uint8_t *)data + prefix;
+    *len = size - prefix;
+    return 0;
+}
+
+// Small decimal field (PRIORITY, _PID) as a number, or -1
+static long get_number(sd_journal *j, const char *field) {
+    const uint8_t *value;
+    size_t len;
+    char buf[32];
+    if (get_field(j, field, &value, &len) != 0 || len == 0 || len >= sizeof(buf)) return -1;
+    memcpy(buf, value, len);
+    buf[len] = '\0';
+    char *end;
+    long n = strtol(buf, &end, 10);
+    return *end ? -1 : n;
+}
+
+static void print_number_or_null(FILE *out, long n) {
+    if (n < 0) fputs("null", out);
+    else fprintf(out, "%ld", n);
+}
+
+// Write the current entry; returns its cursor (caller frees) or NULL
+static char *print_entry(FILE *out, sd_journal *j) {
+    char *cursor = NULL;
+    uint64_t realtime = 0;
+    const uint8_t *value;
+    size_t len;
+
+    if (sd_journal_get_cursor(j, &cursor) < 0) return NULL;
+    sd_journal_get_realtime_usec(j, &realtime);
+
+    fputs("{\"type\":\"entry\",\"cursor\":", out);
+    json_bytes(out, (const uint8_t *)cursor, strlen(cursor));
+    fprintf(out, ",\"realtime_usec\":%llu,\"priority\":", (unsigned long long)realtime);
+    print_number_or_null(out, get_number(j, "PRIORITY"));
+    fputs(",\"pid\":", out);
+    print_number_or_null(out, get_number(j, "_PID"));
+    fputs(",\"identifier\":", out);
+    if (get_field(j, "SYSLOG_IDENTIFIER", &value, &len) == 0 || get_field(j, "_COMM", &value, &len) == 0) {
+        json_bytes(out, value, len);
+    } else {
+        fputs("null", out);
+    }
+    fputs(",\"message\":", out);
+    if (get_field(j, "MESSAGE", &value, &len) == 0) json_bytes(out, value, len);
+    else fputs("\"\"", out);
+    fputs("}\n", out);
+    return cursor;
+}
+
+// journalctl --unit: the unit's own entries, or PID 1's entries about it
+static int add_unit_matches(sd_journal *j, const char *unit) {
+    char match[MAX_FIELD];
+    int r;
+    snprintf(match, sizeof(match), "_SYSTEMD_UNIT=%s", unit);
+    if ((r = sd_journal_add_match(j, match, 0)) < 0) return r;
+    if ((r = sd_journal_add_disjunction(j)) < 0) return r;
+    if ((r = sd_journal_add_match(j, "_PID=1", 0)) < 0) return r;
+    snprintf(match, sizeof(match), "UNIT=%s", unit);
+    return sd_journal_add_match(j, match, 0);
+}
+
+// Position on the oldest of the newest `lines` entries at or after since.
+// Returns the number of entries to emit from there.
+static long seek_tail_window(sd_journal *j, long lines, uint64_t since) {
+    char *oldest = NULL;
+    long count = 0;
+
+    if (sd_journal_seek_tail(j) < 0) return -1;
+    while (count < lines && sd_journal_previous(j) > 0) {
+        uint64_t realtime = 0;
+        if (since && sd_journal_get_realtime_usec(j, &realtime) >= 0 && realtime < since) break;
+        char *cursor;
+        if (sd_journal_get_cursor(j, &cursor) < 0) break;
+        free(oldest);
+        oldest = cursor;
+        count++;
+    }
+    if (count == 0) {
+        free(oldest);
+        return 0;
+    }
+    // Step back onto the oldest counted entry so the forward pass starts on it
+    int r = sd_journal_seek_cursor(j, oldest);
+    free(oldest);
+    return r < 0 ? -1 : count;
+}
+
+int main(int argc, char **argv) {
+    static const struct option long_opts[] = {
+        {"unit", required_argument, NULL, 'u'},
+        {"lines", required_argument, NULL, 'n'},
+        {"since", required_argument, NULL, 's'},
+        {"after-cursor", required_argument, NULL, 'c'},
+        {"max-message", required_argument, NULL, 'm'},
+        {"directory", required_argument, NULL, 'D'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    const char *unit = NULL, *after = NULL, *directory = NULL;
+    long lines = DEFAULT_LINES, max_message = DEFAULT_MAX_MESSAGE;
+    uint64_t since = 0;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "u:n:s:c:m:D:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'u': unit = optarg; break;
+        case 'n': lines = atol(optarg); break;
+        case 's': since = strtoull(optarg, NULL, 10); break;
+        case 'c': after = optarg; break;
+        case 'm': max_message = atol(optarg); break;
+        case 'D': directory = optarg; break;
+        case 'h': print_usage(argv[0]); return 0;
+        default: print_usage(argv[0]); return 2;
+        }
+    }
+    if (!unit || !*unit || strlen(unit) > MAX_FIELD - 32 || lines < 1 || max_message < 1 || optind != argc) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    sd_journal *j;
+    int r = directory ? sd_journal_open_directory(&j, directory, 0)
+                      : sd_journal_open(&j, SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM);
+    if (r < 0) {
+        fprintf(stderr, "journal-reader: cannot open journal: %s\n", strerror(-r));
+        return 1;
+    }
+    sd_journal_set_data_threshold(j, max_message);
+    if ((r = add_unit_matches(j, unit)) < 0) {
+        fprintf(stderr, "journal-reader: cannot filter by unit: %s\n", strerror(-r));
+        sd_journal_close(j);
+        return 1;
+    }
+
+    // The pipe to the service is the bounded buffer; write in large blocks
+    static char outbuf[OUTPUT_BUF_SIZE];
+    setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+
+    long budget;
+    if (after) {
+        if ((r = sd_journal_seek_cursor(j, after)) < 0) {
+            fprintf(stderr, "journal-reader: invalid cursor: %s\n", strerror(-r));
+            sd_journal_close(j);
+            return 1;
+        }
+        // Seeking lands on the cursor's entry when it still exists; skip it
+        if (sd_journal_next(j) > 0 && sd_journal_test_cursor(j, after) <= 0) {
+            sd_journal_previous(j);
+        }
+        budget = lines;
+    } else {
+        budget = seek_tail_window(j, lines, since);
+    }
+    if (budget < 0) {
+        fprintf(stderr, "journal-reader: cannot seek journal\n");
+        sd_journal_close(j);
+        return 1;
+    }
+
+    char *last = NULL;
+    long count = 0;
+    int more = 0;
+    while (sd_journal_next(j) > 0) {
+        if (count == budget) {
+            more = 1;
+            break;
+        }
+        uint64_t realtime = 0;
+        if (since && sd_journal_get_realtime_usec(j, &realtime) >= 0 && realtime < since) continue;
+        char *cursor = print_entry(stdout, j);
+        if (!cursor) continue;
+        free(last);
+        last = cursor;
+        count++;
+    }
+
+    fprintf(stdout, "{\"type\":\"end\",\"count\":%ld,\"next_cursor\":", count);
+    const char *next = last ? last : after;
+    if (next) json_bytes(stdout, (const uint8_t *)next, strlen(next));
+    else fputs("null", stdout);
+    // A tail window is the newest entries by construction
+    fprintf(stdout, ",\"more\":%s}\n", after && more ? "true" : "false");
+
+    free(last);
+    sd_journal_close(j);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
@@ -156,7 +156,7 @@ fi
 
 # Test: Verify integrity checking system
 log_test "Test: Checking binary integrity system"
-if [ -f "/usr/local/bin/binary-check.sh" ]; then
+if [ -x "/usr/local/bin/binary-check" ]; then
     # Check if baseline exists
     if [ -f "/etc/security/integrity/binary-checksums.sha256" ]; then
         log_pass "Integrity checking system is configured with baseline"
@@ -250,26 +250,36 @@ fi
 
 # Test: Test binary modification detection
 log_test "Test: Testing binary modification detection"
-if [ -f "/usr/local/bin/binary-check.sh" ]; then
+if [ -x "/usr/local/bin/binary-check" ]; then
     # Create a test binary and baseline
     TEST_BIN="/tmp/test-binary-$$"
     echo "#!/bin/bash" > "$TEST_BIN"
     chmod +x "$TEST_BIN"
     
-    # Get hash
-    ORIG_HASH=$(sha256sum "$TEST_BIN" | awk '{print $1}')
+    TEST_BASELINE="/tmp/test-baseline-$$.sha256"
+    CHECK_ARGS=(--baseline "$TEST_BASELINE" --scan-dir /nonexistent --log-file /dev/null --alert-file /dev/null)
+    /usr/local/bin/binary-check --create-baseline --binary "$TEST_BIN" "${CHECK_ARGS[@]}" >/dev/null
     
     # Modify the binary
     echo "# modified" >> "$TEST_BIN"
-    NEW_HASH=$(sha256sum "$TEST_BIN" | awk '{print $1}')
     
-    if [ "$ORIG_HASH" != "$NEW_HASH" ]; then
+    if ! /usr/local/bin/binary-check --verify "${CHECK_ARGS[@]}" >/dev/null; then
         log_pass "Binary modification detection test successful"
     else
         log_fail "Failed to detect binary modification"
     fi
+
+    # The binary baseline written alongside must carry the same digest
+    TEST_BASELINE_BIN="/tmp/test-baseline-$$.bin"
+    TEXT_DIGEST=$(/usr/local/bin/binary-check --baseline-digest "${CHECK_ARGS[@]}")
+    BIN_DIGEST=$(/usr/local/bin/binary-check --baseline-digest --baseline "$TEST_BASELINE_BIN" --log-file /dev/null)
+    if [ -n "$TEXT_DIGEST" ] && [ "$TEXT_DIGEST" = "$BIN_DIGEST" ]; then
+        log_pass "Binary baseline digest matches text baseline"
+    else
+        log_fail "Binary baseline digest mismatch ($TEXT_DIGEST vs $BIN_DIGEST)"
+    fi
     
-    rm -f "$TEST_BIN"
+    rm -f "$TEST_BIN" "$TEST_BASELINE" "$TEST_BASELINE_BIN"
 else
     log_skip "Integrity check script not available"
 fi
@@ -308,7 +318,7 @@ log_test "Test: Checking attestation integration"
 ATTESTATION_DIR="/var/lib/attestation"
 if [ -d "$ATTESTATION_DIR" ]; then
     # Check for integrity reports
-    INTEGRITY_REPORTS=$(ls -1 "$ATTESTATION_DIR"/binary-check-*.json 2>/dev/null | wc -l)
+    INTEGRITY_REPORTS=$(/usr/local/bin/report-log --count --type binary-check 2>/dev/null || echo 0)
     if [ "$INTEGRITY_REPORTS" -gt 0 ]; then
         log_pass "Found $INTEGRITY_REPORTS binary attestation reports"
     else
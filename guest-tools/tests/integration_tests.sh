@@ -46,7 +46,7 @@ check_status "Attestation timer" "systemctl is-enabled module-attestation.timer"
 echo -e "\n${YELLOW}Chroot and Init Hardening${NC}"
 check_status "Drop-in exists" "[ -f /etc/systemd/system/k3s.service.d/chroot-restrictions.conf ]"
 check_status "SystemCallFilter blocks chroot" "systemctl show k3s -p SystemCallFilter | grep -q 'chroot'"
-check_status "Integrity check script" "[ -f /usr/local/bin/binary-check.sh ]"
+check_status "Integrity checker" "[ -x /usr/local/bin/binary-check ]"
 check_status "Integrity baseline exists" "[ -f /etc/security/integrity/binary-checksums.sha256 ]"
 check_status "Integrity timer enabled" "systemctl is-enabled binary-attestation.timer"
 check_status "LockPersonality enabled" "systemctl show k3s -p LockPersonality | grep -q yes"
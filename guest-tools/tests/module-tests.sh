@@ -264,7 +264,7 @@ fi
 log_test "Test: Checking attestation service"
 if systemctl is-enabled module-attestation.timer >/dev/null 2>&1; then
     if [ -d "/var/lib/attestation" ]; then
-        REPORT_COUNT=$(ls -1 /var/lib/attestation/module-attestation-*.json 2>/dev/null | wc -l)
+        REPORT_COUNT=$(/usr/local/bin/report-log --count --type module-attestation 2>/dev/null || echo 0)
         if [ $REPORT_COUNT -gt 0 ]; then
             log_pass "Attestation service running with $REPORT_COUNT reports"
         else
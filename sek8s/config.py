@@ -9,9 +9,11 @@ from pathlib import Path
 from typing import Any, Dict, List, Literal, Optional
 from urllib.parse import urlparse
 
-from pydantic import Field, field_validator
+from pydantic import Field, PrivateAttr, field_validator
 from pydantic_settings import BaseSettings, SettingsConfigDict
 
+from sek8s.image_reference import CosignRules
+
 logger = logging.getLogger(__name__)
 
 
@@ -150,6 +152,17 @@ class SystemStatusConfig(AuthConfig):
         ge=1,
         le=7 * 24 * 60,
     )
+    disk_index_max_age_seconds: int = Field(
+        default=300,
+        alias="DISK_INDEX_MAX_AGE_SECONDS",
+        ge=0,
+        le=24 * 60 * 60,
+    )
+    # Unit status is read from systemd over this bus; empty falls back to systemctl
+    systemd_bus_address: str = Field(
+        default="unix:path=/run/dbus/system_bus_socket",
+        alias="SYSTEMD_BUS_ADDRESS",
+    )
 
     model_config = SettingsConfigDict(
         env_file_encoding="utf-8",
@@ -306,6 +319,8 @@ class CosignVerificationConfig(BaseSettings):
     
     # Transparency log
     rekor_url: str = "https://rekor.sigstore.dev"
+    # Accept key-based signatures without a verified Rekor entry (cosign --insecure-ignore-tlog)
+    ignore_tlog: bool = False
     fulcio_url: str = "https://fulcio.sigstore.dev"
     
     model_config = SettingsConfigDict(case_sensitive=False)
@@ -340,7 +355,22 @@ class CosignConfig(BaseSettings):
     cache_ttl: int = Field(default=3600, ge=0)
     cache_maxsize: int = Field(default=1024, ge=1)
     negative_cache_ttl: int = Field(default=300, ge=0)
+    # How long a tag's resolved digest is reused before asking the registry again
+    digest_cache_ttl: int = Field(default=300, ge=0)
+    # Verdicts shared by the controllers on the node and kept across restarts; memory only when unset
+    shared_cache_path: Optional[Path] = None
+    shared_cache_slots: int = Field(default=16384, ge=64)
     rate_limit_backoff_seconds: int = Field(default=300, ge=0)
+    # Registry verifications running at once, across all admission requests
+    max_concurrent_verifications: int = Field(default=8, ge=1)
+
+    # Verify key-based signatures in-process instead of spawning `cosign verify`. Only used
+    # where the tlog can be checked offline: the policy ignores it, or its rekor_url is
+    # cosign_rekor_url and rekor_public_key is set; other policies still go to the CLI
+    native_key_verification: bool = True
+    # Public key of the Rekor log at cosign_rekor_url
+    rekor_public_key: Optional[Path] = None
+    registry_timeout: float = Field(default=15.0, gt=0)
 
     # Cosign config
     oidc_identity_regex: str = Field(default="^https://github.com/your-org/.*")
@@ -364,6 +394,10 @@ class CosignConfig(BaseSettings):
         case_sensitive=False,
     )
 
+    # registry_configs compiled for lookup, and the configs they were compiled from
+    _rules: Optional[CosignRules] = PrivateAttr(default=None)
+    _rules_key: tuple = PrivateAttr(default=())
+
     @field_validator("registry_configs", mode="before")
     @classmethod
     def parse_registry_configs(cls, v: Any) -> List[CosignRegistryConfig]:
@@ -472,63 +506,11 @@ class CosignConfig(BaseSettings):
         
         logger.debug(f"Looking up config for {registry}/{organization}/{repository}")
         
-        # Find matching registry config (exact match or pattern match)
-        registry_config = None
-        wildcard_config = None
-        
-        for config in self.registry_configs:
-            if config.registry == registry:
-                registry_config = config
-                break
-            elif config.registry == "*":
-                wildcard_config = config
-            elif self._matches_registry_pattern(registry, config.registry):
-                registry_config = config
-                break
-        
-        # Fall back to wildcard if no specific registry found
-        if not registry_config:
-            registry_config = wildcard_config
-        
-        if not registry_config:
+        verification_config = self.compiled_rules().lookup(registry, organization, repository)
+        if not verification_config:
             logger.warning(f"No registry config found for {registry}")
             return None
-        
-        # Start with registry-level defaults
-        verification_config = registry_config
-        
-        # Check for organization-level override
-        org_config = None
-        if registry_config.organizations:
-            # Try exact match first
-            if organization in registry_config.organizations:
-                org_config = registry_config.organizations[organization]
-            else:
-                # Try pattern matching
-                for org_pattern, config in registry_config.organizations.items():
-                    if self._matches_pattern(organization, org_pattern):
-                        org_config = config
-                        break
-            
-            if org_config:
-                logger.debug(f"Found org-level config for {organization}")
-                verification_config = org_config
-                
-                # Check for repository-level override within this org
-                if org_config.repositories:
-                    # Try exact match first
-                    if repository in org_config.repositories:
-                        repo_config = org_config.repositories[repository]
-                        logger.debug(f"Found repo-level config for {repository}")
-                        verification_config = repo_config
-                    else:
-                        # Try pattern matching
-                        for repo_pattern, config in org_config.repositories.items():
-                            if self._matches_pattern(repository, repo_pattern):
-                                logger.debug(f"Found repo-level config for {repository} via pattern {repo_pattern}")
-                                verification_config = config
-                                break
-        
+
         logger.debug(
             f"Using {verification_config.__class__.__name__} for {registry}/{organization}/{repository}: "
             f"method={verification_config.verification_method}, "
@@ -537,6 +519,18 @@ class CosignConfig(BaseSettings):
         
         return verification_config
 
+    def compiled_rules(self) -> CosignRules:
+        """Rules compiled from registry_configs, rebuilt when the list is replaced or edited.
+
+        The compiled rules hold the configs they were built from, so their ids
+        stay unique while they are the cache key.
+        """
+        key = tuple(map(id, self.registry_configs))
+        if self._rules is None or key != self._rules_key:
+            self._rules = CosignRules(self.registry_configs)
+            self._rules_key = key
+        return self._rules
+
     def _normalize_registry_name(self, registry: str) -> str:
         """Normalize registry name for consistent matching."""
         # Remove protocol if present
@@ -549,78 +543,6 @@ class CosignConfig(BaseSettings):
         
         return registry.lower()
 
-    def _matches_registry_pattern(self, registry: str, pattern: str) -> bool:
-        """Match registry against a pattern.
-        
-        Supports:
-        - Exact match: "docker.io" matches "docker.io"
-        - Prefix with wildcard: "docker.io/*" matches "docker.io"
-        - Prefix match: "gcr.io*" matches "gcr.io", "gcr.io.local", etc.
-        - Suffix match: "*.gcr.io" matches "us.gcr.io", "eu.gcr.io", etc.
-        - Wildcard: "*" matches everything
-        """
-        if pattern == "*":
-            return True
-        
-        registry = registry.lower()
-        pattern = pattern.lower()
-        
-        # Simple wildcard support
-        if "*" in pattern:
-            if pattern.endswith("/*"):
-                # Prefix with slash: "docker.io/*" matches "docker.io"
-                prefix = pattern[:-2]
-                return registry.startswith(prefix + "/") or registry == prefix
-            elif pattern.endswith("*"):
-                # Prefix match: gcr.io* matches gcr.io, gcr.io.local, etc.
-                prefix = pattern[:-1]
-                return registry.startswith(prefix)
-            elif pattern.startswith("*"):
-                # Suffix match: *.gcr.io matches us.gcr.io, eu.gcr.io, etc.
-                suffix = pattern[1:]
-                return registry.endswith(suffix)
-        
-        return registry == pattern
-
-    def _matches_pattern(self, value: str, pattern: str) -> bool:
-        """
-        Simple pattern matching for organizations and repositories.
-        
-        Supports:
-        - Exact match: "parachutes" matches "parachutes"
-        - Prefix match: "google/*" matches "google/anything"
-        - Suffix match: "*/base" matches "anything/base"
-        - Wildcard: "*" matches everything
-        """
-        if pattern == "*":
-            return True
-        
-        value = value.lower()
-        pattern = pattern.lower()
-        
-        if "*" not in pattern:
-            # Exact match
-            return value == pattern
-        
-        if pattern.endswith("/*"):
-            # Prefix match: "google/*" matches "google/cloud-sdk", "google/anything"
-            prefix = pattern[:-2]
-            return value.startswith(prefix + "/") or value == prefix
-        
-        if pattern.startswith("*/"):
-            # Suffix match: "*/base" matches "distroless/base", "alpine/base"
-            suffix = pattern[2:]
-            return value.endswith("/" + suffix) or value == suffix
-        
-        if pattern == "*/*":
-            # Match anything with at least one slash
-            return "/" in value
-        
-        # For more complex patterns, you could use fnmatch or regex
-        # For now, just do simple wildcard replacement
-        import fnmatch
-        return fnmatch.fnmatch(value, pattern)
-
 
 # For backward compatibility and convenience
 def load_config(**kwargs) -> AdmissionConfig:
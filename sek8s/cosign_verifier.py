@@ -0,0 +1,236 @@
+"""In-process verification of cosign key-based image signatures.
+
+Does what ``cosign verify --key`` does for a simple-signing signature, without
+spawning cosign: fetch the ``sha256-<digest>.sig`` manifest stored next to the
+image, fetch each signature layer (the simple-signing payload), verify the
+``dev.cosignproject.cosign/signature`` annotation over it with the configured
+public key, and check that the payload names the image's manifest digest.
+
+Transparency log: as with cosign, a signature only counts when its layer
+carries a Rekor bundle that records this signature and payload, whose signed
+entry timestamp verifies against the configured Rekor public key. Without
+that key nothing verifies, unless the policy opts out of tlog checks
+(cosign's ``--insecure-ignore-tlog``).
+"""
+
+import base64
+import hashlib
+import json
+import logging
+from pathlib import Path
+from typing import Dict, Optional, Tuple
+
+from cryptography.exceptions import InvalidSignature
+from cryptography.hazmat.primitives import hashes, serialization
+from cryptography.hazmat.primitives.asymmetric import ec, ed25519, padding, rsa
+
+from sek8s.image_reference import ImageReference, parse_image_reference
+from sek8s.registry_client import RegistryClient, RegistryError, RegistryNotFound, RegistryRateLimited
+
+logger = logging.getLogger(__name__)
+
+SIMPLE_SIGNING_MEDIA_TYPE = "application/vnd.dev.cosign.simplesigning.v1+json"
+SIGNATURE_ANNOTATION = "dev.cosignproject.cosign/signature"
+BUNDLE_ANNOTATION = "dev.sigstore.cosign/bundle"
+SIMPLE_SIGNING_TYPE = "cosign container image signature"
+
+
+class SignatureError(Exception):
+    """A signature layer does not verify."""
+
+
+def signature_tag(digest: str) -> str:
+    """Tag cosign stores an image's signatures under: sha256:abc -> sha256-abc.sig."""
+    algorithm, _, encoded = digest.partition(":")
+    return f"{algorithm}-{encoded}.sig"
+
+
+def api_repository(reference: ImageReference) -> str:
+    """Repository as the registry API names it (Docker Hub official images live under library/)."""
+    if reference.registry == "docker.io" and "/" not in reference.path:
+        return f"library/{reference.path}"
+    return reference.path
+
+
+def verify_with_public_key(public_key, signature: bytes, data: bytes) -> None:
+    """Raise InvalidSignature unless signature is public_key's signature of data (SHA-256, as cosign signs)."""
+    if isinstance(public_key, ec.EllipticCurvePublicKey):
+        public_key.verify(signature, data, ec.ECDSA(hashes.SHA256()))
+    elif isinstance(public_key, rsa.RSAPublicKey):
+        public_key.verify(signature, data, padding.PKCS1v15(), hashes.SHA256())
+    elif isinstance(public_key, ed25519.Ed25519PublicKey):
+        public_key.verify(signature, data)
+    else:
+        raise InvalidSignature(f"unsupported public key type {type(public_key).__name__}")
+
+
+def rekor_log_id(rekor_key) -> str:
+    """Rekor log ID: hex SHA-256 of the log's DER-encoded public key."""
+    der = rekor_key.public_bytes(serialization.Encoding.DER, serialization.PublicFormat.SubjectPublicKeyInfo)
+    return hashlib.sha256(der).hexdigest()
+
+
+# (path, inode, size, mtime_ns) -> SHA-256 of the file
+_fingerprints: Dict[tuple, str] = {}
+
+
+def key_fingerprint(path: Optional[Path]) -> Optional[str]:
+    """SHA-256 of a key file's contents, recomputed when the file changes; None when unreadable."""
+    if path is None:
+        return None
+    try:
+        st = path.stat()
+        key = (str(path), st.st_ino, st.st_size, st.st_mtime_ns)
+        fingerprint = _fingerprints.get(key)
+        if fingerprint is None:
+            fingerprint = hashlib.sha256(path.read_bytes()).hexdigest()
+            if len(_fingerprints) >= 64:
+                _fingerprints.clear()
+            _fingerprints[key] = fingerprint
+        return fingerprint
+    except OSError:
+        return None
+
+
+class PublicKeyCache:
+    """PEM public keys by path, reloaded when the file changes."""
+
+    def __init__(self):
+        self._keys: Dict[Path, Tuple[float, object]] = {}
+
+    def load(self, path: Path):
+        mtime = path.stat().st_mtime
+        cached = self._keys.get(path)
+        if cached and cached[0] == mtime:
+            return cached[1]
+        key = serialization.load_pem_public_key(path.read_bytes())
+        self._keys[path] = (mtime, key)
+        return key
+
+
+class KeySignatureVerifier:
+    """Verifies cosign key-based signatures over a shared registry client."""
+
+    def __init__(self, registry: RegistryClient, rekor_public_key: Optional[Path] = None):
+        self.registry = registry
+        self.rekor_public_key = rekor_public_key
+        self._keys = PublicKeyCache()
+
+    async def verify(
+        self,
+        image: str,
+        public_key_path: Path,
+        allow_http: bool = False,
+        allow_insecure: bool = False,
+        ignore_tlog: bool = False,
+    ) -> bool:
+        """True when at least one signature layer verifies against the key.
+
+        Raises RegistryRateLimited when the registry answers 429; every other
+        failure is logged and reported as unverified.
+        """
+        try:
+            public_key = self._keys.load(public_key_path)
+            rekor_key = None
+            if not ignore_tlog:
+                if self.rekor_public_key is None:
+                    logger.error(f"Cannot verify {image}: no Rekor public key to check its transparency log entry")
+                    return False
+                rekor_key = self._keys.load(self.rekor_public_key)
+        except (OSError, ValueError) as e:
+            logger.error(f"Cannot load public key for cosign verification: {e}")
+            return False
+
+        reference = parse_image_reference(image)
+        registry, repository = reference.registry, api_repository(reference)
+        options = {"allow_http": allow_http, "insecure": allow_insecure}
+
+        try:
+            digest = reference.digest
+            if digest is None:
+                digest, _ = await self.registry.get_manifest(registry, repository, reference.tag_or_digest, **options)
+            try:
+                _, manifest = await self.registry.get_manifest(registry, repository, signature_tag(digest), **options)
+            except RegistryNotFound:
+                logger.error(f"No cosign signatures found for {image} ({digest})")
+                return False
+
+            layers = json.loads(manifest).get("layers") or []
+            for layer in layers:
+                if layer.get("mediaType") != SIMPLE_SIGNING_MEDIA_TYPE:
+                    continue
+                payload = await self.registry.get_blob(registry, repository, layer.get("digest", ""), **options)
+                try:
+                    self._verify_layer(layer.get("annotations") or {}, payload, digest, public_key, rekor_key)
+                except SignatureError as e:
+                    logger.debug(f"Signature layer {layer.get('digest')} of {image} rejected: {e}")
+                    continue
+                logger.debug(f"Verified cosign signature for {image} ({digest})")
+                return True
+        except RegistryRateLimited:
+            raise
+        except (RegistryError, ValueError, AttributeError) as e:
+            logger.error(f"Cosign key verification failed for {image}: {e}")
+            return False
+
+        logger.error(f"Cosign key verification failed for {image}: no signature matches the key")
+        return False
+
+    def _verify_layer(
+        self, annotations: Dict[str, str], payload: bytes, digest: str, public_key, rekor_key
+    ) -> None:
+        try:
+            signature = base64.b64decode(annotations[SIGNATURE_ANNOTATION], validate=True)
+        except (KeyError, ValueError) as e:
+            raise SignatureError("missing or malformed signature annotation") from e
+        try:
+            verify_with_public_key(public_key, signature, payload)
+        except InvalidSignature as e:
+            raise SignatureError("signature does not match the public key") from e
+
+        try:
+            critical = json.loads(payload)["critical"]
+            signed_type = critical["type"]
+            signed_digest = critical["image"]["docker-manifest-digest"]
+        except (ValueError, KeyError, TypeError) as e:
+            raise SignatureError("payload is not a simple-signing document") from e
+        if signed_type != SIMPLE_SIGNING_TYPE:
+            raise SignatureError(f"unexpected payload type {signed_type!r}")
+        if signed_digest != digest:
+            raise SignatureError(f"payload signs {signed_digest}, not {digest}")
+
+        if rekor_key is None:
+            return  # the policy ignores the transparency log
+        bundle = annotations.get(BUNDLE_ANNOTATION)
+        if not bundle:
+            raise SignatureError("no transparency log bundle")
+        self._verify_bundle(bundle, annotations[SIGNATURE_ANNOTATION], payload, rekor_key)
+
+    @staticmethod
+    def _verify_bundle(bundle: str, signature: str, payload: bytes, rekor_key) -> None:
+        """Check the Rekor entry records this signature and payload, and its timestamp verifies."""
+        try:
+            document = json.loads(bundle)
+            entry = document["Payload"]
+            body = json.loads(base64.b64decode(entry["body"]))
+            spec = body["spec"]
+            recorded_signature = spec["signature"]["content"]
+            recorded_hash = spec["data"]["hash"]["value"]
+        except (ValueError, KeyError, TypeError) as e:
+            raise SignatureError("malformed transparency log bundle") from e
+        if recorded_signature != signature or recorded_hash != hashlib.sha256(payload).hexdigest():
+            raise SignatureError("transparency log entry is for a different signature")
+
+        if entry.get("logID") != rekor_log_id(rekor_key):
+            raise SignatureError("transparency log entry is from a different log")
+        try:
+            # The signed entry timestamp covers the canonical JSON of the entry
+            canonical = json.dumps(
+                {key: entry[key] for key in ("body", "integratedTime", "logIndex", "logID")},
+                sort_keys=True,
+                separators=(",", ":"),
+            ).encode()
+            timestamp = base64.b64decode(document["SignedEntryTimestamp"], validate=True)
+            verify_with_public_key(rekor_key, timestamp, canonical)
+        except (KeyError, ValueError, InvalidSignature) as e:
+            raise SignatureError("transparency log timestamp does not verify") from e
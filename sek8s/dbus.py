@@ -0,0 +1,439 @@
+"""Minimal asyncio D-Bus client.
+
+Implements the parts of the D-Bus wire protocol the system-status service
+needs to talk to systemd: little-endian marshalling of the basic and container
+types, EXTERNAL authentication over a Unix socket, method calls that can be
+pipelined (several requests written before any reply is awaited) and signal
+delivery. There is no introspection, object export or Unix fd passing.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import os
+import struct
+from dataclasses import dataclass, field
+from typing import Any, Callable, Dict, List, Optional, Sequence, Tuple
+
+from loguru import logger
+
+SYSTEM_BUS_ADDRESS = "unix:path=/run/dbus/system_bus_socket"
+
+BUS_NAME = "org.freedesktop.DBus"
+BUS_PATH = "/org/freedesktop/DBus"
+BUS_INTERFACE = "org.freedesktop.DBus"
+PROPERTIES_INTERFACE = "org.freedesktop.DBus.Properties"
+
+# Message types
+METHOD_CALL = 1
+METHOD_RETURN = 2
+ERROR = 3
+SIGNAL = 4
+
+# Header flags
+NO_REPLY_EXPECTED = 0x1
+
+# Header field codes
+FIELD_PATH = 1
+FIELD_INTERFACE = 2
+FIELD_MEMBER = 3
+FIELD_ERROR_NAME = 4
+FIELD_REPLY_SERIAL = 5
+FIELD_DESTINATION = 6
+FIELD_SENDER = 7
+FIELD_SIGNATURE = 8
+
+_FIELD_TYPES = {
+    FIELD_PATH: "o",
+    FIELD_INTERFACE: "s",
+    FIELD_MEMBER: "s",
+    FIELD_ERROR_NAME: "s",
+    FIELD_REPLY_SERIAL: "u",
+    FIELD_DESTINATION: "s",
+    FIELD_SENDER: "s",
+    FIELD_SIGNATURE: "g",
+}
+
+_ALIGNMENT = {
+    "y": 1, "b": 4, "n": 2, "q": 2, "i": 4, "u": 4, "x": 8, "t": 8, "d": 8, "h": 4,
+    "s": 4, "o": 4, "g": 1, "v": 1, "a": 4, "(": 8, "{": 8,
+}
+_FIXED_FORMATS = {
+    "y": "<B", "b": "<I", "n": "<h", "q": "<H", "i": "<i", "u": "<I",
+    "x": "<q", "t": "<Q", "d": "<d", "h": "<I",
+}
+
+# Largest message the specification allows
+MAX_MESSAGE_SIZE = 128 * 1024 * 1024
+
+
+class DBusError(Exception):
+    """An error reply, or a failure of the connection itself."""
+
+    def __init__(self, name: str, message: str = ""):
+        super().__init__(f"{name}: {message}" if message else name)
+        self.name = name
+        self.message = message
+
+
+DISCONNECTED = "org.freedesktop.DBus.Error.Disconnected"
+
+
+@dataclass(frozen=True)
+class Variant:
+    signature: str
+    value: Any
+
+
+def _type_end(signature: str, start: int) -> int:
+    """Index just past the single complete type starting at start."""
+    code = signature[start]
+    if code == "a":
+        return _type_end(signature, start + 1)
+    if code in "({":
+        index = start + 1
+        while signature[index] not in ")}":
+            index = _type_end(signature, index)
+        return index + 1
+    if code not in _ALIGNMENT:
+        raise ValueError(f"invalid type code {code!r} in signature {signature!r}")
+    return start + 1
+
+
+def split_signature(signature: str) -> List[str]:
+    """Split a signature into its complete types: "sa{sv}as" -> ["s", "a{sv}", "as"]."""
+    types = []
+    index = 0
+    while index < len(signature):
+        end = _type_end(signature, index)
+        types.append(signature[index:end])
+        index = end
+    return types
+
+
+class _Writer:
+    def __init__(self) -> None:
+        self.buf = bytearray()
+
+    def align(self, boundary: int) -> None:
+        self.buf.extend(b"\0" * (-len(self.buf) % boundary))
+
+    def write(self, signature: str, value: Any) -> None:
+        code = signature[0]
+        if code in _FIXED_FORMATS:
+            self.align(_ALIGNMENT[code])
+            self.buf += struct.pack(_FIXED_FORMATS[code], int(bool(value)) if code == "b" else value)
+        elif code in "so":
+            data = value.encode()
+            self.align(4)
+            self.buf += struct.pack("<I", len(data)) + data + b"\0"
+        elif code == "g":
+            data = value.encode()
+            self.buf += bytes([len(data)]) + data + b"\0"
+        elif code == "v":
+            self.write("g", value.signature)
+            self.write(value.signature, value.value)
+        elif code == "a":
+            element = signature[1:]
+            self.align(4)
+            length_at = len(self.buf)
+            self.buf += b"\0\0\0\0"
+            self.align(_ALIGNMENT[element[0]])
+            start = len(self.buf)
+            for item in value.items() if element[0] == "{" else value:
+                self.write(element, item)
+            struct.pack_into("<I", self.buf, length_at, len(self.buf) - start)
+        elif code in "({":
+            self.align(8)
+            for member, item in zip(split_signature(signature[1:-1]), value):
+                self.write(member, item)
+        else:
+            raise ValueError(f"cannot marshal type {signature!r}")
+
+
+class _Reader:
+    def __init__(self, data: bytes, offset: int = 0) -> None:
+        self.data = data
+        self.pos = offset
+
+    def align(self, boundary: int) -> None:
+        self.pos += -self.pos % boundary
+
+    def read(self, signature: str) -> Any:
+        code = signature[0]
+        if code in _FIXED_FORMATS:
+            self.align(_ALIGNMENT[code])
+            fmt = _FIXED_FORMATS[code]
+            (value,) = struct.unpack_from(fmt, self.data, self.pos)
+            self.pos += struct.calcsize(fmt)
+            return bool(value) if code == "b" else value
+        if code in "sog":
+            if code == "g":
+                length = self.data[self.pos]
+                self.pos += 1
+            else:
+                self.align(4)
+                (length,) = struct.unpack_from("<I", self.data, self.pos)
+                self.pos += 4
+            end = self.pos + length
+            if end >= len(self.data):
+                raise ValueError("string runs past the end of the message")
+            value = self.data[self.pos:end].decode()
+            self.pos = end + 1
+            return value
+        if code == "v":
+            inner = self.read("g")
+            return Variant(inner, self.read(inner))
+        if code == "a":
+            element = signature[1:]
+            self.align(4)
+            (length,) = struct.unpack_from("<I", self.data, self.pos)
+            self.pos += 4
+            self.align(_ALIGNMENT[element[0]])
+            end = self.pos + length
+            if end > len(self.data):
+                raise ValueError("array runs past the end of the message")
+            items = []
+            while self.pos < end:
+                items.append(self.read(element))
+            return dict(items) if element[0] == "{" else items
+        if code in "({":
+            self.align(8)
+            return tuple(self.read(member) for member in split_signature(signature[1:-1]))
+        raise ValueError(f"cannot unmarshal type {signature!r}")
+
+
+@dataclass
+class Message:
+    type: int
+    serial: int
+    flags: int = 0
+    fields: Dict[int, Any] = field(default_factory=dict)
+    body: Tuple[Any, ...] = ()
+
+    @property
+    def path(self) -> Optional[str]:
+        return self.fields.get(FIELD_PATH)
+
+    @property
+    def interface(self) -> Optional[str]:
+        return self.fields.get(FIELD_INTERFACE)
+
+    @property
+    def member(self) -> Optional[str]:
+        return self.fields.get(FIELD_MEMBER)
+
+    @property
+    def error_name(self) -> Optional[str]:
+        return self.fields.get(FIELD_ERROR_NAME)
+
+    @property
+    def reply_serial(self) -> Optional[int]:
+        return self.fields.get(FIELD_REPLY_SERIAL)
+
+    @property
+    def destination(self) -> Optional[str]:
+        return self.fields.get(FIELD_DESTINATION)
+
+    @property
+    def sender(self) -> Optional[str]:
+        return self.fields.get(FIELD_SENDER)
+
+    @property
+    def signature(self) -> str:
+        return self.fields.get(FIELD_SIGNATURE) or ""
+
+    def encode(self) -> bytes:
+        body = _Writer()
+        for member, item in zip(split_signature(self.signature), self.body):
+            body.write(member, item)
+        header = _Writer()
+        header.buf += struct.pack("<cBBBII", b"l", self.type, self.flags, 1, len(body.buf), self.serial)
+        header.write(
+            "a(yv)",
+            [(code, Variant(_FIELD_TYPES[code], value)) for code, value in self.fields.items() if value is not None],
+        )
+        header.align(8)
+        return bytes(header.buf + body.buf)
+
+
+async def read_message(reader: asyncio.StreamReader) -> Message:
+    """Read one message from the stream. Raises ValueError on malformed input."""
+    fixed = await reader.readexactly(16)
+    if fixed[0:1] != b"l":
+        raise ValueError("only little-endian messages are supported")
+    msg_type, flags, _version, body_length, serial, fields_length = struct.unpack_from("<BBBIII", fixed, 1)
+    header_length = 16 + fields_length + (-fields_length % 8)
+    if header_length + body_length > MAX_MESSAGE_SIZE:
+        raise ValueError("message too large")
+    rest = await reader.readexactly(header_length - 16 + body_length)
+    data = fixed + rest
+
+    fields = {code: variant.value for code, variant in _Reader(data[:header_length], 12).read("a(yv)")}
+    message = Message(type=msg_type, serial=serial, flags=flags, fields=fields)
+    body_reader = _Reader(data[header_length:])
+    message.body = tuple(body_reader.read(member) for member in split_signature(message.signature))
+    return message
+
+
+def _socket_path(address: str) -> str:
+    """Socket path of the first unix: entry of a D-Bus address."""
+    for entry in address.split(";"):
+        transport, _, params = entry.partition(":")
+        if transport != "unix":
+            continue
+        options = dict(param.split("=", 1) for param in params.split(",") if "=" in param)
+        if "path" in options:
+            return options["path"]
+        if "abstract" in options:
+            return "\0" + options["abstract"]
+    raise ValueError(f"unsupported D-Bus address {address!r}")
+
+
+SignalHandler = Callable[[Message], None]
+
+
+class DBusConnection:
+    """One client connection to a message bus."""
+
+    def __init__(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter):
+        self._reader = reader
+        self._writer = writer
+        self._serial = 0
+        self._pending: Dict[int, asyncio.Future] = {}
+        self._signal_handlers: List[SignalHandler] = []
+        self._closed = False
+        self._task: Optional[asyncio.Task] = None
+        self.unique_name: Optional[str] = None
+
+    @classmethod
+    async def connect(cls, address: str = SYSTEM_BUS_ADDRESS) -> "DBusConnection":
+        reader, writer = await asyncio.open_unix_connection(_socket_path(address))
+        try:
+            uid = str(os.getuid()).encode().hex()
+            writer.write(b"\0AUTH EXTERNAL " + uid.encode() + b"\r\n")
+            line = await reader.readline()
+            if not line.startswith(b"OK "):
+                raise DBusError(
+                    "org.freedesktop.DBus.Error.AuthFailed", line.decode(errors="replace").strip()
+                )
+            writer.write(b"BEGIN\r\n")
+        except BaseException:
+            writer.close()
+            raise
+
+        connection = cls(reader, writer)
+        connection._task = asyncio.create_task(connection._read_loop())
+        try:
+            (connection.unique_name,) = await connection.call(BUS_NAME, BUS_PATH, BUS_INTERFACE, "Hello")
+        except BaseException:
+            await connection.close()
+            raise
+        return connection
+
+    @property
+    def closed(self) -> bool:
+        return self._closed
+
+    def add_signal_handler(self, handler: SignalHandler) -> None:
+        self._signal_handlers.append(handler)
+
+    def send_call(
+        self,
+        destination: Optional[str],
+        path: str,
+        interface: Optional[str],
+        member: str,
+        signature: str = "",
+        args: Sequence[Any] = (),
+    ) -> asyncio.Future:
+        """Queue a method call without waiting; the future resolves to the reply body.
+
+        Calls queued back to back go out in one write once the caller awaits
+        drain() or any call(), so a batch costs a single round trip.
+        """
+        if self._closed:
+            raise DBusError(DISCONNECTED, "connection closed")
+        self._serial += 1
+        message = Message(
+            type=METHOD_CALL,
+            serial=self._serial,
+            fields={
+                FIELD_PATH: path,
+                FIELD_INTERFACE: interface,
+                FIELD_MEMBER: member,
+                FIELD_DESTINATION: destination,
+                FIELD_SIGNATURE: signature or None,
+            },
+            body=tuple(args),
+        )
+        data = message.encode()
+        future = asyncio.get_running_loop().create_future()
+        self._pending[message.serial] = future
+        self._writer.write(data)
+        return future
+
+    async def drain(self) -> None:
+        await self._writer.drain()
+
+    async def call(
+        self,
+        destination: Optional[str],
+        path: str,
+        interface: Optional[str],
+        member: str,
+        signature: str = "",
+        args: Sequence[Any] = (),
+    ) -> Tuple[Any, ...]:
+        future = self.send_call(destination, path, interface, member, signature, args)
+        await self.drain()
+        return await future
+
+    async def add_match(self, rule: str) -> None:
+        await self.call(BUS_NAME, BUS_PATH, BUS_INTERFACE, "AddMatch", "s", (rule,))
+
+    async def close(self) -> None:
+        if self._task is not None:
+            self._task.cancel()
+            try:
+                await self._task
+            except asyncio.CancelledError:
+                pass
+        self._shutdown(DBusError(DISCONNECTED, "connection closed"))
+
+    def _shutdown(self, error: DBusError) -> None:
+        self._closed = True
+        self._writer.close()
+        for future in self._pending.values():
+            if not future.done():
+                future.set_exception(error)
+        self._pending.clear()
+
+    async def _read_loop(self) -> None:
+        try:
+            while True:
+                self._dispatch(await read_message(self._reader))
+        except asyncio.IncompleteReadError:
+            self._shutdown(DBusError(DISCONNECTED, "connection closed by the bus"))
+        except (ValueError, IndexError, struct.error, UnicodeDecodeError) as exc:
+            self._shutdown(DBusError(DISCONNECTED, f"protocol error: {exc}"))
+        except OSError as exc:
+            self._shutdown(DBusError(DISCONNECTED, str(exc)))
+
+    def _dispatch(self, message: Message) -> None:
+        if message.type in (METHOD_RETURN, ERROR):
+            future = self._pending.pop(message.reply_serial, None)
+            if future is None or future.done():
+                return
+            if message.type == ERROR:
+                detail = message.body[0] if message.body and isinstance(message.body[0], str) else ""
+                future.set_exception(DBusError(message.error_name or "org.freedesktop.DBus.Error.Failed", detail))
+            else:
+                future.set_result(message.body)
+        elif message.type == SIGNAL:
+            # Any peer can send us a signal; a bad one must not stop the reader
+            for handler in self._signal_handlers:
+                try:
+                    handler(message)
+                except Exception as exc:
+                    logger.warning("D-Bus signal handler failed on {}.{}: {}", message.interface, message.member, exc)
@@ -4,4 +4,6 @@ class TdxQuoteException(AttestationException): ...
 
 class NvTrustException(AttestationException): ...
 
-class NvmlException(AttestationException): ...
\ No newline at end of file
+class NvmlException(AttestationException): ...
+
+class IntegritySnapshotException(AttestationException): ...
@@ -0,0 +1,364 @@
+"""Container image references and the registry rules matched against them.
+
+Image strings are parsed once, following the distribution reference grammar
+(github.com/distribution/reference), and the parse is memoised so the
+registry and cosign validators share it across admission requests. Registry
+allowlists and cosign registry/organization/repository rules are compiled
+into prefix tries, so finding the rule that applies to an image costs one
+walk per level instead of a scan over every configured pattern.
+"""
+
+from __future__ import annotations
+
+import fnmatch
+import re
+from dataclasses import dataclass
+from functools import lru_cache
+from typing import TYPE_CHECKING, Any, Dict, Iterable, List, Optional, Sequence, Tuple
+
+if TYPE_CHECKING:  # pragma: no cover - typing only; sek8s.config imports this module
+    from sek8s.config import CosignRegistryConfig, CosignVerificationConfig
+
+DEFAULT_DOMAIN = "docker.io"
+DEFAULT_ORGANIZATION = "library"
+DEFAULT_TAG = "latest"
+NAME_TOTAL_LENGTH_MAX = 255
+VERDICT_CACHE_SIZE = 4096
+
+# Docker Hub is reachable under several names; cosign rules are written for docker.io
+DOCKER_HUB_ALIASES = frozenset({"docker.io", "registry-1.docker.io", "index.docker.io"})
+
+_DOMAIN_COMPONENT = r"(?:[a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9-]*[a-zA-Z0-9])"
+_DOMAIN_RE = re.compile(
+    rf"^(?:{_DOMAIN_COMPONENT}(?:\.{_DOMAIN_COMPONENT})*|\[[a-fA-F0-9:]+\])(?::[0-9]+)?$"
+)
+_PATH_COMPONENT = r"[a-z0-9]+(?:(?:[._]|__|[-]+)[a-z0-9]+)*"
+_PATH_RE = re.compile(rf"^{_PATH_COMPONENT}(?:/{_PATH_COMPONENT})*$")
+_TAG_RE = re.compile(r"^[A-Za-z0-9_][A-Za-z0-9._-]{0,127}$")
+# OCI image-spec digest grammar: algorithm ":" encoded
+_DIGEST_RE = re.compile(r"^[a-z0-9]+(?:[+._-][a-z0-9]+)*:[a-zA-Z0-9=_-]+$")
+
+
+class InvalidImageReference(ValueError):
+    """The image string is not a valid reference."""
+
+
+@dataclass(frozen=True)
+class ImageReference:
+    domain: str  # as written; docker.io when omitted
+    path: str  # repository path without the domain, e.g. "parachutes/chutes-agent"
+    tag: Optional[str] = None
+    digest: Optional[str] = None
+
+    @property
+    def registry(self) -> str:
+        """Domain as cosign rules name it (Docker Hub aliases folded, lowercase)."""
+        domain = self.domain.lower()
+        return DEFAULT_DOMAIN if domain in DOCKER_HUB_ALIASES else domain
+
+    @property
+    def organization(self) -> str:
+        """First path component, or "library" for single-component paths."""
+        head, sep, _ = self.path.partition("/")
+        return head if sep else DEFAULT_ORGANIZATION
+
+    @property
+    def repository(self) -> str:
+        """Path after the organization: "subdir/app" for gcr.io/project/subdir/app."""
+        head, sep, rest = self.path.partition("/")
+        return rest if sep else head
+
+    @property
+    def tag_or_digest(self) -> str:
+        """"@<digest>" when pinned, else the tag, else "latest"."""
+        if self.digest:
+            return f"@{self.digest}"
+        return self.tag or DEFAULT_TAG
+
+
+@lru_cache(maxsize=VERDICT_CACHE_SIZE)
+def parse_image_reference(image: str) -> ImageReference:
+    """Parse an image string. Raises InvalidImageReference when it is not a reference."""
+    if not image:
+        raise InvalidImageReference("empty image reference")
+
+    name, at, digest = image.partition("@")
+    if at and not _DIGEST_RE.match(digest):
+        raise InvalidImageReference(f"invalid digest in image reference: {image}")
+
+    tag = None
+    colon = name.rfind(":")
+    if colon > name.rfind("/"):
+        name, tag = name[:colon], name[colon + 1:]
+        if not _TAG_RE.match(tag):
+            raise InvalidImageReference(f"invalid tag in image reference: {image}")
+
+    if len(name) > NAME_TOTAL_LENGTH_MAX:
+        raise InvalidImageReference(f"repository name too long: {image}")
+
+    # The first component is a domain only if it looks like one (distribution's splitDockerDomain)
+    first, slash, remainder = name.partition("/")
+    if slash and (any(c in first for c in ".:") or first == "localhost" or first.lower() != first):
+        domain, path = first, remainder
+    else:
+        domain, path = DEFAULT_DOMAIN, name
+
+    if not _DOMAIN_RE.match(domain):
+        raise InvalidImageReference(f"invalid registry in image reference: {image}")
+    if not _PATH_RE.match(path):
+        raise InvalidImageReference(f"invalid repository in image reference: {image}")
+
+    return ImageReference(domain=domain, path=path, tag=tag, digest=digest if at else None)
+
+
+class _Trie:
+    """Character trie mapping keys to the lowest rule index stored under them."""
+
+    __slots__ = ("root",)
+
+    def __init__(self) -> None:
+        self.root: Dict[str, Any] = {}
+
+    def add(self, key: str, index: int) -> None:
+        node = self.root
+        for char in key:
+            node = node.setdefault(char, {})
+        node[""] = min(index, node.get("", index))
+
+    def first_prefix(self, text: str) -> Optional[int]:
+        """Lowest index among keys that are prefixes of text."""
+        best = None
+        node = self.root
+        for char in text:
+            if "" in node and (best is None or node[""] < best):
+                best = node[""]
+            node = node.get(char)
+            if node is None:
+                return best
+        if "" in node and (best is None or node[""] < best):
+            best = node[""]
+        return best
+
+
+class PatternSet:
+    """Ordered patterns compiled for first-match lookup.
+
+    Each pattern gets an index (its position in the configuration); lookup
+    returns the lowest index that matches. Exact keys are checked before
+    patterns, as the configuration lookup always has.
+    """
+
+    def __init__(self) -> None:
+        self._exact: Dict[str, int] = {}
+        self._equal: Dict[str, int] = {}  # lowercased
+        self._prefixes = _Trie()  # lowercased
+        self._suffixes = _Trie()  # lowercased and reversed
+        self._any: Optional[int] = None
+        self._globs: List[Tuple[int, "re.Pattern[str]"]] = []
+
+    def add_exact(self, key: str, index: int) -> None:
+        self._exact.setdefault(key, index)
+
+    def add_equal(self, key: str, index: int) -> None:
+        self._equal.setdefault(key.lower(), index)
+
+    def add_prefix(self, prefix: str, index: int) -> None:
+        self._prefixes.add(prefix.lower(), index)
+
+    def add_suffix(self, suffix: str, index: int) -> None:
+        self._suffixes.add(suffix.lower()[::-1], index)
+
+    def add_any(self, index: int) -> None:
+        if self._any is None:
+            self._any = index
+
+    def add_glob(self, pattern: str, index: int) -> None:
+        self._globs.append((index, re.compile(fnmatch.translate(pattern.lower()))))
+
+    def exact(self, value: str) -> Optional[int]:
+        return self._exact.get(value)
+
+    def first(self, value: str) -> Optional[int]:
+        lowered = value.lower()
+        best = self._any
+        for index in (
+            self._equal.get(lowered),
+            self._prefixes.first_prefix(lowered),
+            self._suffixes.first_prefix(lowered[::-1]),
+        ):
+            if index is not None and (best is None or index < best):
+                best = index
+        for index, pattern in self._globs:
+            if best is not None and index > best:
+                break
+            if pattern.match(lowered):
+                best = index
+                break
+        return best
+
+
+def compile_registry_patterns(patterns: Iterable[Tuple[int, str]]) -> PatternSet:
+    """Registry patterns: "gcr.io*" prefix, "*.gcr.io" suffix, "docker.io/*" for the registry itself."""
+    compiled = PatternSet()
+    for index, pattern in patterns:
+        lowered = pattern.lower()
+        if "*" not in lowered:
+            compiled.add_equal(lowered, index)
+        elif lowered.endswith("/*"):
+            # Registry names have no "/", so this only ever matches the registry itself
+            compiled.add_equal(lowered[:-2], index)
+        elif lowered.endswith("*"):
+            compiled.add_prefix(lowered[:-1], index)
+        elif lowered.startswith("*"):
+            compiled.add_suffix(lowered[1:], index)
+        else:
+            # A "*" inside the pattern is taken literally
+            compiled.add_equal(lowered, index)
+    return compiled
+
+
+def compile_name_patterns(patterns: Iterable[Tuple[int, str]]) -> PatternSet:
+    """Organization/repository patterns: "*", "google/*", "*/base", or fnmatch globs."""
+    compiled = PatternSet()
+    for index, pattern in patterns:
+        compiled.add_exact(pattern, index)
+        lowered = pattern.lower()
+        if lowered == "*":
+            compiled.add_any(index)
+        elif "*" not in lowered:
+            compiled.add_equal(lowered, index)
+        elif lowered.endswith("/*"):
+            compiled.add_equal(lowered[:-2], index)
+            compiled.add_prefix(lowered[:-1], index)
+        elif lowered.startswith("*/"):
+            compiled.add_equal(lowered[2:], index)
+            compiled.add_suffix(lowered[1:], index)
+        else:
+            compiled.add_glob(lowered, index)
+    return compiled
+
+
+class _ScopedRules:
+    """Rules at one level (registries, or one registry's organizations, ...)."""
+
+    def __init__(self, configs: Sequence[Any], patterns: PatternSet, children: Sequence[Optional["_ScopedRules"]]):
+        self.configs = configs
+        self.patterns = patterns
+        self.children = children
+
+    def find(self, value: str) -> Optional[int]:
+        index = self.patterns.exact(value)
+        return index if index is not None else self.patterns.first(value)
+
+
+def _compile_names(mapping: Dict[str, Any], child_attr: Optional[str]) -> Optional[_ScopedRules]:
+    if not mapping:
+        return None
+    keys = list(mapping)
+    configs = [mapping[key] for key in keys]
+    children = [
+        _compile_names(getattr(config, child_attr) or {}, None) if child_attr else None for config in configs
+    ]
+    return _ScopedRules(configs, compile_name_patterns(enumerate(keys)), children)
+
+
+class CosignRules:
+    """Cosign registry/organization/repository rules compiled for lookup.
+
+    Lookup follows CosignConfig's precedence: the first registry rule (in
+    configuration order) that matches the registry exactly or by pattern,
+    else the last "*" rule; then an exact or first-matching organization
+    override; then likewise a repository override within it.
+    """
+
+    def __init__(self, registry_configs: Sequence["CosignRegistryConfig"]):
+        self._configs = list(registry_configs)
+        self._wildcard: Optional[int] = None
+        patterns = []
+        for index, config in enumerate(self._configs):
+            if config.registry == "*":
+                self._wildcard = index
+            else:
+                patterns.append((index, config.registry))
+        self._registries = compile_registry_patterns(patterns)
+        self._organizations = [_compile_names(config.organizations, "repositories") for config in self._configs]
+
+    def lookup(
+        self, registry: str, organization: str = "", repository: str = ""
+    ) -> Optional["CosignVerificationConfig"]:
+        index = self._registries.first(registry)
+        if index is None:
+            index = self._wildcard
+        if index is None:
+            return None
+
+        config = self._configs[index]
+        organizations = self._organizations[index]
+        if organizations is None:
+            return config
+        org_index = organizations.find(organization)
+        if org_index is None:
+            return config
+
+        config = organizations.configs[org_index]
+        repositories = organizations.children[org_index]
+        if repositories is None:
+            return config
+        repo_index = repositories.find(repository)
+        return config if repo_index is None else repositories.configs[repo_index]
+
+
+class RegistryAllowlist:
+    """Allowed registries: exact names (case-insensitive) or "prefix*" entries."""
+
+    def __init__(self, allowed: Iterable[str]):
+        self._exact = set()
+        self._prefixes = _Trie()
+        for entry in allowed:
+            if entry.endswith("*"):
+                # Prefix entries compare case-sensitively, as they always have
+                self._prefixes.add(entry[:-1], 0)
+            else:
+                self._exact.add(entry.lower())
+
+    def allows(self, registry: str) -> bool:
+        return registry.lower() in self._exact or self._prefixes.first_prefix(registry) is not None
+
+
+@dataclass(frozen=True)
+class ImageVerdict:
+    reference: ImageReference
+    registry_allowed: bool
+    verification_config: Optional["CosignVerificationConfig"]
+
+
+class ImagePolicy:
+    """Registry allowlist and cosign rules, matched against an image in one call."""
+
+    def __init__(self, allowed_registries: Iterable[str], cosign_rules: Optional[CosignRules] = None):
+        self.allowlist = RegistryAllowlist(allowed_registries)
+        self.cosign_rules = cosign_rules
+        # Rules are fixed once compiled, so a verdict holds for as long as the policy does
+        self._verdicts: Dict[str, ImageVerdict] = {}
+
+    def evaluate(self, image: str) -> ImageVerdict:
+        """Raises InvalidImageReference for strings that are not image references."""
+        verdict = self._verdicts.get(image)
+        if verdict is not None:
+            return verdict
+
+        reference = parse_image_reference(image)
+        verification_config = None
+        if self.cosign_rules is not None:
+            verification_config = self.cosign_rules.lookup(
+                reference.registry, reference.organization, reference.repository
+            )
+        verdict = ImageVerdict(
+            reference=reference,
+            registry_allowed=self.allowlist.allows(reference.domain),
+            verification_config=verification_config,
+        )
+        if len(self._verdicts) >= VERDICT_CACHE_SIZE:
+            self._verdicts.clear()
+        self._verdicts[image] = verdict
+        return verdict
@@ -6,6 +6,9 @@ import time
 from collections import defaultdict
 from typing import Dict
 
+# Cosign verifications this soon after start count as startup load (cold caches)
+STARTUP_WINDOW_SECONDS = 300
+
 
 class MetricsCollector:
     """Collect and export metrics for monitoring."""
@@ -17,6 +20,9 @@ class MetricsCollector:
         self.admission_by_operation = defaultdict(int)  # by operation
         self.cache_hits = 0
         self.cache_misses = 0
+        self.cosign_cache_lookups = defaultdict(int)  # by memory/shared/inflight/miss
+        self.cosign_verifications = 0
+        self.cosign_startup_verifications = 0
 
         # Histograms (simplified - just track sum and count)
         self.admission_duration_sum = 0.0
@@ -47,6 +53,22 @@ class MetricsCollector:
         """Record a cache miss."""
         self.cache_misses += 1
 
+    def record_cosign_cache_lookup(self, result: str):
+        """Record where a cosign verdict came from: "memory", "shared", "inflight" or "miss"."""
+        self.cosign_cache_lookups[result] += 1
+
+    def record_cosign_verification(self):
+        """Record a signature verification against the registry."""
+        self.cosign_verifications += 1
+        if time.time() - self.start_time < STARTUP_WINDOW_SECONDS:
+            self.cosign_startup_verifications += 1
+
+    def cosign_cache_hit_ratio(self) -> float:
+        lookups = sum(self.cosign_cache_lookups.values())
+        if not lookups:
+            return 0.0
+        return (lookups - self.cosign_cache_lookups["miss"]) / lookups
+
     def record_validator_error(self, validator_name: str):
         """Record a validator error."""
         self.validator_errors[validator_name] += 1
@@ -115,6 +137,26 @@ class MetricsCollector:
         lines.append("# TYPE admission_cache_misses_total counter")
         lines.append(f"admission_cache_misses_total {self.cache_misses}")
 
+        # Cosign verification cache
+        lines.append("# HELP cosign_cache_lookups_total Cosign verdict lookups by where they were answered")
+        lines.append("# TYPE cosign_cache_lookups_total counter")
+        for result, count in self.cosign_cache_lookups.items():
+            lines.append(f'cosign_cache_lookups_total{{result="{result}"}} {count}')
+
+        lines.append("# HELP cosign_cache_hit_ratio Share of cosign verdicts served from cache")
+        lines.append("# TYPE cosign_cache_hit_ratio gauge")
+        lines.append(f"cosign_cache_hit_ratio {self.cosign_cache_hit_ratio():.4f}")
+
+        lines.append("# HELP cosign_verifications_total Signature verifications against registries")
+        lines.append("# TYPE cosign_verifications_total counter")
+        lines.append(f"cosign_verifications_total {self.cosign_verifications}")
+
+        lines.append(
+            f"# HELP cosign_startup_verifications_total Verifications in the first {STARTUP_WINDOW_SECONDS}s after start"
+        )
+        lines.append("# TYPE cosign_startup_verifications_total counter")
+        lines.append(f"cosign_startup_verifications_total {self.cosign_startup_verifications}")
+
         # Errors
         if self.validator_errors:
             lines.append("# HELP admission_validator_errors_total Validator errors")
@@ -139,5 +181,11 @@ class MetricsCollector:
                 else 0,
             },
             "cache": {"hits": self.cache_hits, "misses": self.cache_misses},
+            "cosign_cache": {
+                "lookups": dict(self.cosign_cache_lookups),
+                "hit_ratio": self.cosign_cache_hit_ratio(),
+                "verifications": self.cosign_verifications,
+                "startup_verifications": self.cosign_startup_verifications,
+            },
             "validator_errors": dict(self.validator_errors),
         }
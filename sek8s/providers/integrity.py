@@ -0,0 +1,50 @@
+import asyncio
+import hashlib
+
+from loguru import logger
+
+from sek8s.exceptions import IntegritySnapshotException
+
+
+SNAPSHOT_BINARY = "/usr/local/bin/integrity-snapshot"
+
+
+class IntegritySnapshotProvider():
+    """Collects the canonical runtime integrity snapshot that gets bound into a quote."""
+
+    async def get_snapshot(self, nonce: str) -> bytes:
+        """
+        Run integrity-snapshot for the given nonce.
+
+        Returns:
+            The canonical snapshot document, exactly the bytes that are hashed
+        """
+        try:
+            result = await asyncio.create_subprocess_exec(
+                *[SNAPSHOT_BINARY, "--nonce", nonce],
+                stdout=asyncio.subprocess.PIPE,
+                stderr=asyncio.subprocess.PIPE,
+            )
+            # The snapshot embeds the state documents and can exceed a pipe buffer
+            stdout, stderr = await result.communicate()
+
+            if result.returncode != 0:
+                logger.error(f"Failed to collect integrity snapshot: {stderr.decode()}")
+                raise IntegritySnapshotException("Failed to collect integrity snapshot.")
+
+            # The trailing newline is not part of the canonical document
+            snapshot = stdout.rstrip(b"\n")
+            if not snapshot:
+                raise IntegritySnapshotException("No output from integrity snapshot command")
+
+            logger.info(f"Collected integrity snapshot ({len(snapshot)} bytes)")
+            return snapshot
+        except IntegritySnapshotException:
+            raise
+        except Exception as e:
+            logger.error(f"Unexpected error collecting integrity snapshot: {e}")
+            raise IntegritySnapshotException(f"Unexpected error collecting integrity snapshot: {e}")
+
+    @staticmethod
+    def digest(snapshot: bytes) -> bytes:
+        return hashlib.sha256(snapshot).digest()
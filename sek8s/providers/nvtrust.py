@@ -9,6 +9,11 @@ from loguru import logger
 from sek8s.exceptions import NvTrustException
 import pynvml
 
+
+EVIDENCE_BINARY = "chutes-nvevidence"
+EVIDENCE_WORKDIR = "/var/log/attestation-service"
+
+
 class NvEvidenceProvider:
     """Async web server for admission webhook."""
 
@@ -24,20 +29,27 @@ class NvEvidenceProvider:
 
         return False
 
+    # NVML init/shutdown can take a while on a multi-GPU host; keep it off the event loop
+    async def __aenter__(self):
+        return await asyncio.to_thread(self.__enter__)
+
+    async def __aexit__(self, exc_type, exc_val, exc_tb):
+        return await asyncio.to_thread(self.__exit__, exc_type, exc_val, exc_tb)
+
     async def get_evidence(self, name: str, nonce: str, gpu_ids: list[str] = None) -> str:
         try:
             result = await asyncio.create_subprocess_exec(
-                *["chutes-nvevidence", "--name", name, "--nonce", nonce],
+                *[EVIDENCE_BINARY, "--name", name, "--nonce", nonce],
                 stdout=asyncio.subprocess.PIPE,
                 stderr=asyncio.subprocess.PIPE,
-                cwd="/var/log/attestation-service"
+                cwd=EVIDENCE_WORKDIR
             )
 
-            await result.wait()
+            # Evidence for a full node is larger than a pipe buffer
+            stdout, stderr = await result.communicate()
 
             if result.returncode == 0:
-                result_output = await result.stdout.read()
-                output_str = result_output.decode()
+                output_str = stdout.decode()
                 
                 # Get the last non-empty line
                 lines = [line for line in output_str.strip().split('\n') if line.strip()]
@@ -47,11 +59,10 @@ class NvEvidenceProvider:
                 evidence_json = lines[-1]
                 logger.info(f"Successfully generated NVTrust evidence")
                 
-                filtered_evidence = self._filter_evidence(evidence_json, gpu_ids)
+                filtered_evidence = await asyncio.to_thread(self._filter_evidence, evidence_json, gpu_ids)
                 return filtered_evidence
             else:
-                result_output = await result.stderr.read()
-                logger.error(f"Failed to gather GPU evidence:{result_output}")
+                logger.error(f"Failed to gather GPU evidence:{stderr}")
                 raise NvTrustException(f"Failed to gather evidence.")
         except Exception as e:
             logger.error(f"Unexpected error gathering GPU evidence:{e}")
@@ -1,9 +1,13 @@
 import asyncio
 import base64
+import os
 import tempfile
 import hashlib
-import subprocess
+import re
+from typing import Optional
 
+from cryptography import x509
+from cryptography.hazmat.primitives import serialization
 from loguru import logger
 
 from sek8s.exceptions import TdxQuoteException
@@ -12,6 +16,18 @@ from sek8s.exceptions import TdxQuoteException
 QUOTE_GENERATOR_BINARY = "/usr/bin/tdx-quote-generator"
 SERVER_CERT = "/etc/attestation-service/certs/server.crt"
 
+# (path, inode, size, mtime_ns) -> hash; providers are created per request
+_cert_hash_cache: dict[tuple, str] = {}
+
+# Verifier nonces fill the first half of the report data: 32 bytes as hex
+NONCE_HEX_LEN = 64
+_NONCE_RE = re.compile(rf"[0-9a-fA-F]{{{NONCE_HEX_LEN}}}")
+
+
+def is_valid_nonce(nonce: str) -> bool:
+    return _NONCE_RE.fullmatch(nonce) is not None
+
+
 class TdxQuoteProvider():
     """Async TDX quote provider with cert hash binding."""
 
@@ -19,62 +35,86 @@ class TdxQuoteProvider():
         """
         Compute SHA-256 hash of the server certificate's public key.
         This binds the quote to the specific certificate being used.
+
+        The hash is over the DER SubjectPublicKeyInfo, the same bytes as
+        `openssl x509 -pubkey | openssl pkey -pubin -outform der`, and is
+        reused until the certificate file changes. Blocking; call it
+        through asyncio.to_thread.
         
         Returns:
             64-character hex string (SHA-256 hash)
         """
         try:
-            # Extract public key from certificate
-            pubkey_result = subprocess.run(
-                ["openssl", "x509", "-in", SERVER_CERT, "-pubkey", "-noout"],
-                capture_output=True,
-                check=True,
-                text=True  # Get string output
-            )
-            
-            # Convert public key to DER format and hash it
-            der_result = subprocess.run(
-                ["openssl", "pkey", "-pubin", "-outform", "der"],
-                input=pubkey_result.stdout.encode('utf-8'),  # Encode string to bytes
-                capture_output=True,
-                check=True,
-                text=False  # Keep as False since we need bytes output
+            st = os.stat(SERVER_CERT)
+            key = (SERVER_CERT, st.st_ino, st.st_size, st.st_mtime_ns)
+            cert_hash = _cert_hash_cache.get(key)
+            if cert_hash is not None:
+                return cert_hash
+
+            with open(SERVER_CERT, "rb") as f:
+                cert = x509.load_pem_x509_certificate(f.read())
+            der = cert.public_key().public_bytes(
+                serialization.Encoding.DER,
+                serialization.PublicFormat.SubjectPublicKeyInfo,
             )
-            
+
             # Compute SHA-256 hash
-            cert_hash = hashlib.sha256(der_result.stdout).hexdigest()
+            cert_hash = hashlib.sha256(der).hexdigest()
+            _cert_hash_cache.clear()
+            _cert_hash_cache[key] = cert_hash
             
             logger.debug(f"Computed cert hash: {cert_hash}")
             return cert_hash
             
-        except subprocess.CalledProcessError as e:
+        except (OSError, ValueError) as e:
             logger.error(f"Failed to compute cert hash: {e}")
             raise TdxQuoteException(f"Failed to compute certificate hash: {e}")
         except Exception as e:
             logger.error(f"Unexpected error computing cert hash: {e}")
             raise TdxQuoteException(f"Unexpected error computing certificate hash: {e}")
 
-    async def get_quote(self, nonce: str) -> bytes:
+    @staticmethod
+    def report_data(nonce: str, cert_hash: str, binding: Optional[bytes] = None) -> str:
+        """
+        Build the 64-byte report data as 128 hex chars.
+
+        The first half is the nonce. The second half is the cert hash, or with
+        a binding digest SHA-256(cert_hash || binding), so one quote covers
+        both the TLS key and e.g. an integrity snapshot.
+
+        With a binding, raises ValueError unless the nonce is exactly 64 hex
+        chars: anything else would shift or cut off the bound half. Without
+        one, the nonce is taken as-is and the result truncated, as before.
+        """
+        if binding is not None:
+            if not is_valid_nonce(nonce):
+                raise ValueError(f"Nonce must be {NONCE_HEX_LEN} hex characters, got {len(nonce)}")
+            cert_hash = hashlib.sha256(bytes.fromhex(cert_hash) + binding).hexdigest()
+
+        # TDX report data is 64 bytes (128 hex chars)
+        # We have: 64 chars (nonce) + 64 chars (cert_hash) = 128 chars
+        report_data = f"{nonce}{cert_hash}"
+
+        # Truncate to 128 hex chars (64 bytes) if needed
+        return report_data[:128]
+
+    async def get_quote(self, nonce: str, binding: Optional[bytes] = None) -> bytes:
         """
         Generate a TDX quote with nonce and certificate hash in report data.
         
         Args:
             nonce: 64-character hex string (32 bytes)
+            binding: Optional digest folded into the certificate half of the report data
             
         Returns:
             Raw quote bytes
         """
         try:
             # Get certificate hash
-            cert_hash = self._get_cert_hash()
+            cert_hash = await asyncio.to_thread(self._get_cert_hash)
             
             # Combine nonce and cert hash for report data
-            # TDX report data is 64 bytes (128 hex chars)
-            # We have: 64 chars (nonce) + 64 chars (cert_hash) = 128 chars
-            report_data = f"{nonce}{cert_hash}"
-            
-            # Truncate to 128 hex chars (64 bytes) if needed
-            report_data = report_data[:128]
+            report_data = self.report_data(nonce, cert_hash, binding)
             
             logger.debug(f"Report data: nonce({len(nonce)}) + cert_hash({len(cert_hash)}) = {len(report_data)} chars")
             
@@ -85,20 +125,18 @@ class TdxQuoteProvider():
                     stderr=asyncio.subprocess.PIPE,
                 )
 
-                await result.wait()
+                stdout, stderr = await result.communicate()
 
                 if result.returncode == 0:
-                    result_output = await result.stdout.read()
-                    logger.info(f"Successfully generated quote with nonce and cert hash.\n{result_output.decode()}")
+                    logger.info(f"Successfully generated quote with nonce and cert hash.\n{stdout.decode()}")
                     
                     # Read the quote from the file
                     fp.seek(0)
-                    quote_content = fp.read()
+                    quote_content = await asyncio.to_thread(fp.read)
 
                     return quote_content
                 else:
-                    result_output = await result.stderr.read()
-                    logger.error(f"Failed to generate quote: {result_output.decode()}")
+                    logger.error(f"Failed to generate quote: {stderr.decode()}")
                     raise TdxQuoteException(f"Failed to generate quote.")
         except TdxQuoteException:
             raise
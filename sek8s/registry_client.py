@@ -0,0 +1,304 @@
+"""Minimal OCI distribution client for reading manifests and blobs.
+
+One keep-alive connection pool is shared across registries, and bearer tokens
+from the registry's token service are cached per repository until they
+expire, so repeated verifications against the same registry reuse both the
+TLS session and the token. Credentials are taken from the Docker config file
+(``$DOCKER_CONFIG/config.json`` or ``~/.docker/config.json``) when it has an
+entry for the registry; otherwise tokens are requested anonymously.
+"""
+
+import hashlib
+import json
+import logging
+import os
+import re
+import time
+from pathlib import Path
+from typing import Dict, Optional, Tuple
+
+import httpx
+
+logger = logging.getLogger(__name__)
+
+# Docker Hub's API lives on a different host than the name images use
+DOCKER_HUB_API_HOST = "registry-1.docker.io"
+
+MANIFEST_MEDIA_TYPES = (
+    "application/vnd.oci.image.index.v1+json",
+    "application/vnd.docker.distribution.manifest.list.v2+json",
+    "application/vnd.oci.image.manifest.v1+json",
+    "application/vnd.docker.distribution.manifest.v2+json",
+)
+MAX_MANIFEST_BYTES = 4 * 1024 * 1024
+MAX_BLOB_BYTES = 16 * 1024 * 1024
+MAX_TOKEN_BYTES = 1024 * 1024
+
+REGISTRY_TIMEOUT = 15.0
+REGISTRY_MAX_CONNECTIONS = 32
+REGISTRY_MAX_KEEPALIVE = 16
+REGISTRY_KEEPALIVE_EXPIRY = 60.0
+
+# Tokens without expires_in are good for 60 seconds (distribution token spec)
+DEFAULT_TOKEN_TTL = 60
+TOKEN_EXPIRY_MARGIN = 10
+
+_CHALLENGE_PARAM_RE = re.compile(r'(\w+)="([^"]*)"')
+
+
+class RegistryError(Exception):
+    """A registry request failed."""
+
+    def __init__(self, message: str, status_code: Optional[int] = None):
+        super().__init__(message)
+        self.status_code = status_code
+
+
+class RegistryNotFound(RegistryError):
+    """The manifest or blob does not exist."""
+
+
+class RegistryRateLimited(RegistryError):
+    """The registry answered 429; retry_after is its Retry-After in seconds, when given."""
+
+    def __init__(self, message: str, retry_after: Optional[float] = None):
+        super().__init__(message, status_code=429)
+        self.retry_after = retry_after
+
+
+def _retry_after(response: httpx.Response) -> Optional[float]:
+    value = response.headers.get("Retry-After")
+    if value is None:
+        return None
+    try:
+        return max(float(value), 0.0)
+    except ValueError:
+        return None
+
+
+def _load_docker_auths() -> Dict[str, str]:
+    """Registry host -> base64 "user:password" from the Docker config file."""
+    config_dir = os.environ.get("DOCKER_CONFIG") or str(Path.home() / ".docker")
+    path = Path(config_dir) / "config.json"
+    try:
+        with open(path, "r") as f:
+            auths = json.load(f).get("auths", {})
+    except (OSError, ValueError, AttributeError):
+        return {}
+
+    credentials = {}
+    for key, entry in auths.items():
+        if isinstance(entry, dict) and entry.get("auth"):
+            host = key.split("://", 1)[-1].split("/", 1)[0]
+            credentials[host] = entry["auth"]
+    return credentials
+
+
+class RegistryClient:
+    """Reads manifests and blobs from OCI registries over pooled connections."""
+
+    def __init__(self, timeout: float = REGISTRY_TIMEOUT):
+        self.timeout = timeout
+        self._clients: Dict[bool, httpx.AsyncClient] = {}
+        self._tokens: Dict[Tuple[str, str], Tuple[str, float]] = {}
+        self._auths: Optional[Dict[str, str]] = None
+
+    def _client(self, insecure: bool) -> httpx.AsyncClient:
+        """Pooled client; registries that skip TLS verification get their own pool."""
+        client = self._clients.get(insecure)
+        if client is None:
+            client = httpx.AsyncClient(
+                timeout=httpx.Timeout(self.timeout),
+                verify=not insecure,
+                limits=httpx.Limits(
+                    max_connections=REGISTRY_MAX_CONNECTIONS,
+                    max_keepalive_connections=REGISTRY_MAX_KEEPALIVE,
+                    keepalive_expiry=REGISTRY_KEEPALIVE_EXPIRY,
+                ),
+            )
+            self._clients[insecure] = client
+        return client
+
+    async def close(self) -> None:
+        for client in self._clients.values():
+            await client.aclose()
+        self._clients.clear()
+
+    @staticmethod
+    def api_host(registry: str) -> str:
+        return DOCKER_HUB_API_HOST if registry == "docker.io" else registry
+
+    def _basic_auth(self, host: str) -> Optional[str]:
+        if self._auths is None:
+            self._auths = _load_docker_auths()
+        if host == DOCKER_HUB_API_HOST:
+            return self._auths.get("index.docker.io") or self._auths.get("docker.io")
+        return self._auths.get(host)
+
+    async def get_manifest(
+        self, registry: str, repository: str, reference: str, allow_http: bool = False, insecure: bool = False
+    ) -> Tuple[str, bytes]:
+        """Fetch a manifest by tag or digest; returns (digest, raw manifest bytes)."""
+        _, content = await self._request(
+            registry,
+            repository,
+            f"manifests/{reference}",
+            {"Accept": ", ".join(MANIFEST_MEDIA_TYPES)},
+            allow_http,
+            insecure,
+            limit=MAX_MANIFEST_BYTES,
+        )
+        digest = f"sha256:{hashlib.sha256(content).hexdigest()}"
+        if reference.startswith("sha256:") and reference != digest:
+            raise RegistryError(f"manifest {repository}@{reference} does not match its digest")
+        return digest, content
+
+    async def resolve_digest(
+        self, registry: str, repository: str, tag: str, allow_http: bool = False, insecure: bool = False
+    ) -> str:
+        """Digest a tag currently points at, from a HEAD request (GET when no digest header is sent)."""
+        response, _ = await self._request(
+            registry,
+            repository,
+            f"manifests/{tag}",
+            {"Accept": ", ".join(MANIFEST_MEDIA_TYPES)},
+            allow_http,
+            insecure,
+            method="HEAD",
+        )
+        digest = response.headers.get("Docker-Content-Digest", "")
+        if digest.startswith("sha256:"):
+            return digest
+        digest, _ = await self.get_manifest(registry, repository, tag, allow_http, insecure)
+        return digest
+
+    async def get_blob(
+        self, registry: str, repository: str, digest: str, allow_http: bool = False, insecure: bool = False
+    ) -> bytes:
+        """Fetch a blob and check it against its sha256 digest."""
+        if not digest.startswith("sha256:"):
+            raise RegistryError(f"unsupported blob digest {digest}")
+        _, content = await self._request(
+            registry, repository, f"blobs/{digest}", {}, allow_http, insecure, limit=MAX_BLOB_BYTES
+        )
+        if f"sha256:{hashlib.sha256(content).hexdigest()}" != digest:
+            raise RegistryError(f"blob {repository}@{digest} does not match its digest")
+        return content
+
+    async def _request(
+        self,
+        registry: str,
+        repository: str,
+        path: str,
+        headers: Dict[str, str],
+        allow_http: bool,
+        insecure: bool,
+        method: str = "GET",
+        limit: int = MAX_MANIFEST_BYTES,
+    ) -> Tuple[httpx.Response, bytes]:
+        """Send one registry request, answering a 401 challenge; returns (response, body)."""
+        host = self.api_host(registry)
+        scheme = "http" if allow_http else "https"
+        url = f"{scheme}://{host}/v2/{repository}/{path}"
+        client = self._client(insecure)
+        scope = f"repository:{repository}:pull"
+
+        token = self._cached_token(host, scope)
+        if token:
+            headers = {**headers, "Authorization": token}
+        response, body = await self._send(client, method, url, headers, limit)
+
+        if response.status_code == 401:
+            token = await self._authenticate(client, host, scope, response.headers.get("WWW-Authenticate", ""))
+            if token:
+                response, body = await self._send(client, method, url, {**headers, "Authorization": token}, limit)
+
+        self._raise_for_status(response, f"{host}/{repository} {path}")
+        return response, body
+
+    @staticmethod
+    async def _send(
+        client: httpx.AsyncClient, method: str, url: str, headers: Dict[str, str], limit: int
+    ) -> Tuple[httpx.Response, bytes]:
+        """
+        Stream one response, reading at most limit bytes of body.
+
+        The registry is untrusted, so a body past the limit is refused as soon
+        as its Content-Length or the running total says so, rather than after
+        it has been buffered. Error bodies are drained up to the same limit so
+        the connection can be reused, then dropped.
+        """
+        try:
+            async with client.stream(method, url, headers=headers, follow_redirects=True) as response:
+                failed = response.status_code >= 400
+                length = response.headers.get("Content-Length", "")
+                if not failed and method != "HEAD" and length.isdigit() and int(length) > limit:
+                    raise RegistryError(f"{method} {url} body exceeds {limit} bytes")
+                chunks = []
+                total = 0
+                async for chunk in response.aiter_bytes():
+                    total += len(chunk)
+                    if total > limit:
+                        if failed:
+                            break
+                        raise RegistryError(f"{method} {url} body exceeds {limit} bytes")
+                    chunks.append(chunk)
+                return response, b"" if failed else b"".join(chunks)
+        except httpx.HTTPError as e:
+            raise RegistryError(f"{method} {url} failed: {e}") from e
+
+    def _cached_token(self, host: str, scope: str) -> Optional[str]:
+        cached = self._tokens.get((host, scope))
+        if cached and cached[1] > time.monotonic():
+            return cached[0]
+        return None
+
+    async def _authenticate(
+        self, client: httpx.AsyncClient, host: str, scope: str, challenge: str
+    ) -> Optional[str]:
+        """Answer a 401 challenge; returns the Authorization header value to retry with."""
+        scheme, _, params = challenge.partition(" ")
+        basic = self._basic_auth(host)
+        if scheme.lower() == "basic":
+            return f"Basic {basic}" if basic else None
+        if scheme.lower() != "bearer":
+            return None
+
+        fields = dict(_CHALLENGE_PARAM_RE.findall(params))
+        realm = fields.get("realm")
+        if not realm:
+            return None
+        query = {"scope": fields.get("scope") or scope}
+        if fields.get("service"):
+            query["service"] = fields["service"]
+        response, content = await self._send(
+            client,
+            "GET",
+            str(httpx.URL(realm, params=query)),
+            {"Authorization": f"Basic {basic}"} if basic else {},
+            MAX_TOKEN_BYTES,
+        )
+        self._raise_for_status(response, f"token for {host} {scope}")
+        try:
+            body = json.loads(content)
+        except ValueError as e:
+            raise RegistryError(f"invalid token response from {realm}") from e
+        token = body.get("token") or body.get("access_token")
+        if not token:
+            raise RegistryError(f"token response from {realm} has no token")
+
+        logger.debug(f"Fetched registry token for {host} ({scope})")
+        header = f"Bearer {token}"
+        ttl = body.get("expires_in") or DEFAULT_TOKEN_TTL
+        self._tokens[(host, scope)] = (header, time.monotonic() + max(ttl - TOKEN_EXPIRY_MARGIN, 1))
+        return header
+
+    @staticmethod
+    def _raise_for_status(response: httpx.Response, what: str) -> None:
+        if response.status_code < 400:
+            return
+        if response.status_code == 429:
+            raise RegistryRateLimited(f"registry rate limited {what}", _retry_after(response))
+        if response.status_code == 404:
+            raise RegistryNotFound(f"{what} not found", status_code=404)
+        raise RegistryError(f"{what} failed with HTTP {response.status_code}", status_code=response.status_code)
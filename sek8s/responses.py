@@ -10,6 +10,15 @@ class AttestationResponse(BaseModel):
     nvtrust_evidence: str = Field(..., description="")
 
 
+class IntegrityAttestationResponse(BaseModel):
+
+    tdx_quote: str = Field(..., description="Base64 TDX quote whose report data binds the snapshot")
+
+    snapshot: str = Field(..., description="Canonical integrity snapshot; its UTF-8 bytes are what is hashed")
+
+    snapshot_sha256: str = Field(..., description="SHA-256 of the snapshot")
+
+
 # System Status API Response Models
 
 
@@ -91,6 +100,12 @@ class DiskSpaceResponse(BaseModel):
     diagnostic_mode: bool = Field(False, description="Whether diagnostic mode was enabled")
     max_depth: Optional[int] = Field(None, description="Maximum depth analyzed in diagnostic mode")
     top_n: Optional[int] = Field(None, description="Number of top offenders shown per level")
+    index_stale_seconds: Optional[int] = Field(
+        None, description="Age of the oldest cached directory listing used; bounds how far sizes may lag"
+    )
+    index_reused_dirs: Optional[int] = Field(
+        None, description="Directories served from the disk usage index instead of being re-read"
+    )
 
 
 class ShutdownResponse(BaseModel):
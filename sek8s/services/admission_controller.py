@@ -49,7 +49,7 @@ class AdmissionController:
         # Registry validator (lightweight, always enabled)
         self.validators.append(RegistryValidator(self.config))
 
-        self.validators.append(CosignValidator(self.config))
+        self.validators.append(CosignValidator(self.config, metrics=self.metrics))
 
         logger.info("Initialized validators: %s", [v.__class__.__name__ for v in self.validators])
 
@@ -1,15 +1,17 @@
 import asyncio
 import base64
-from fastapi import HTTPException, Query, status
+from fastapi import HTTPException, Query, Response, status
 import logging
+import time
 from loguru import logger
 from sek8s.config import AttestationServiceConfig
 from sek8s.exceptions import AttestationException, NvmlException
 from sek8s.models import DeviceInfo
 from sek8s.providers.gpu import GpuDeviceProvider
+from sek8s.providers.integrity import IntegritySnapshotProvider
 from sek8s.providers.nvtrust import NvEvidenceProvider
-from sek8s.providers.tdx import TdxQuoteProvider
-from sek8s.responses import AttestationResponse
+from sek8s.providers.tdx import NONCE_HEX_LEN, TdxQuoteProvider, is_valid_nonce
+from sek8s.responses import AttestationResponse, IntegrityAttestationResponse
 from sek8s.server import WebServer
 
 from typing import Optional
@@ -30,6 +32,28 @@ def _normalize_gpu_ids(gpu_ids: Optional[list[str]]) -> Optional[list[str]]:
     return normalized or None
 
 
+async def _timed(timings: dict[str, float], name: str, coro):
+    start = time.perf_counter()
+    try:
+        return await coro
+    finally:
+        timings[name] = time.perf_counter() - start
+
+
+def _server_timing(timings: dict[str, float]) -> str:
+    """Render component latencies as a Server-Timing header (milliseconds)."""
+    return ", ".join(f"{name};dur={seconds * 1000:.1f}" for name, seconds in timings.items())
+
+
+async def _gather_all(*coros):
+    """Like asyncio.gather, but waits for every coroutine before raising the first error."""
+    results = await asyncio.gather(*coros, return_exceptions=True)
+    for result in results:
+        if isinstance(result, BaseException):
+            raise result
+    return results
+
+
 class AttestationServer(WebServer):
     """Async web server for admission webhook."""
 
@@ -44,12 +68,14 @@ class AttestationServer(WebServer):
         self.app.add_api_route("/devices", self.get_device_info, methods=["GET"])
         self.app.add_api_route("/tdx/quote", self.get_quote, methods=["GET"])
         self.app.add_api_route("/nvtrust/evidence", self.get_nvtrust_evidence, methods=["GET"])
+        self.app.add_api_route("/integrity", self.attest_integrity, methods=["GET"])
 
     async def ping(self):
         return "pong"
 
     async def attest(
         self, 
+        response: Response,
         nonce: str = Query(..., description="Nonce to include in the quote"),
         gpu_ids: list[str] = Query(
             None, description="List of GPU IDs to use.  If not provided gets evidence for all devices."
@@ -58,9 +84,19 @@ class AttestationServer(WebServer):
         try:
             gpu_ids = _normalize_gpu_ids(gpu_ids)
             tdx_provider = TdxQuoteProvider()
-            with NvEvidenceProvider() as nvtrust_provider:
-                quote_content = await tdx_provider.get_quote(nonce)
-                nvtrust_evidence = await nvtrust_provider.get_evidence(self.config.hostname, nonce, gpu_ids)
+
+            async def gpu_evidence():
+                async with NvEvidenceProvider() as nvtrust_provider:
+                    return await nvtrust_provider.get_evidence(self.config.hostname, nonce, gpu_ids)
+
+            # The quote and the GPU evidence are independent; collect them side by side
+            timings: dict[str, float] = {}
+            quote_content, nvtrust_evidence = await _timed(timings, "total", _gather_all(
+                _timed(timings, "tdx_quote", tdx_provider.get_quote(nonce)),
+                _timed(timings, "nvtrust_evidence", gpu_evidence()),
+            ))
+            response.headers["Server-Timing"] = _server_timing(timings)
+            logger.info(f"Attestation evidence collected: {_server_timing(timings)}")
 
             return AttestationResponse(
                 tdx_quote=base64.b64encode(quote_content).decode('utf-8'),
@@ -121,6 +157,46 @@ class AttestationServer(WebServer):
                 detail=f"Unexpected error generating TDX quote.",
             )
 
+    async def attest_integrity(
+        self,
+        response: Response,
+        nonce: str = Query(..., description="Nonce to include in the snapshot and the quote")
+    ) -> IntegrityAttestationResponse:
+        if not is_valid_nonce(nonce):
+            raise HTTPException(
+                status_code=status.HTTP_400_BAD_REQUEST,
+                detail=f"Nonce must be {NONCE_HEX_LEN} hex characters."
+            )
+        try:
+            timings: dict[str, float] = {}
+            snapshot_provider = IntegritySnapshotProvider()
+            snapshot = await _timed(timings, "integrity_snapshot", snapshot_provider.get_snapshot(nonce))
+            snapshot_digest = snapshot_provider.digest(snapshot)
+
+            tdx_provider = TdxQuoteProvider()
+            quote_content = await _timed(
+                timings, "tdx_quote", tdx_provider.get_quote(nonce, binding=snapshot_digest)
+            )
+            response.headers["Server-Timing"] = _server_timing(timings)
+
+            return IntegrityAttestationResponse(
+                tdx_quote=base64.b64encode(quote_content).decode('utf-8'),
+                snapshot=snapshot.decode('utf-8'),
+                snapshot_sha256=snapshot_digest.hex()
+            )
+        except AttestationException as e:
+            logger.error(f"Error generating integrity attestation: {e}")
+            raise HTTPException(
+                status_code=status.HTTP_500_INTERNAL_SERVER_ERROR,
+                detail=str(e)
+            )
+        except Exception as e:
+            logger.error(f"Unexpected exception encountered generating integrity attestation: {e}")
+            raise HTTPException(
+                status_code=status.HTTP_500_INTERNAL_SERVER_ERROR,
+                detail="Unexpected exception encountered generating integrity attestation."
+            )
+
     async def get_nvtrust_evidence(
         self,
         name: str = Query(
@@ -135,7 +211,7 @@ class AttestationServer(WebServer):
     ):
         try:
             gpu_ids = _normalize_gpu_ids(gpu_ids)
-            with NvEvidenceProvider() as provider:
+            async with NvEvidenceProvider() as provider:
                 evidence = await provider.get_evidence(name, nonce, gpu_ids)
 
             return evidence
@@ -6,6 +6,7 @@ import stat
 from typing import Dict, Optional
 from urllib.parse import urljoin
 from fastapi import FastAPI, HTTPException, Request, Response, Depends
+from fastapi.responses import StreamingResponse
 from loguru import logger
 from sek8s.config import AttestationProxyConfig
 from sek8s.server import WebServer
@@ -21,11 +22,39 @@ CLUSTER_DOMAIN = "svc.cluster.local"
 SOCKET_PATH = "/var/run/attestation/attestation.sock"
 MAX_CONSECUTIVE_FAILURES = 5
 
+# Keep-alive pool to the host service socket
+SOCKET_MAX_CONNECTIONS = 64
+SOCKET_MAX_KEEPALIVE = 32
+SOCKET_KEEPALIVE_EXPIRY = 30.0
+
+# Hop-by-hop headers are never forwarded in either direction
+HOP_BY_HOP_HEADERS = frozenset({
+    "connection", "keep-alive", "upgrade", "proxy-authenticate",
+    "proxy-authorization", "te", "trailers", "transfer-encoding",
+})
+# The upstream request gets its own Host and framing
+REQUEST_SKIP_HEADERS = HOP_BY_HOP_HEADERS | {"host", "content-length"}
+
+# Client certificate headers always sent upstream, empty when the client did not set them
+CLIENT_CERT_HEADERS = (
+    "X-Client-Cert", "X-Client-Verify", "X-Client-S-DN", "X-Client-I-DN",
+    "X-Real-IP", "X-Forwarded-For", "X-Forwarded-Proto",
+)
+
 # Port configuration
 EXTERNAL_PORT = int(os.getenv("EXTERNAL_PORT", "8443"))
 INTERNAL_PORT = int(os.getenv("INTERNAL_PORT", "8444"))
 
 
+async def relay_body(response: httpx.Response):
+    """Yield the upstream body as received, releasing the pooled connection at the end."""
+    try:
+        async for chunk in response.aiter_raw():
+            yield chunk
+    finally:
+        await response.aclose()
+
+
 class SharedProxyResources:
     """Shared resources used by both internal and external proxy servers."""
     
@@ -52,8 +81,16 @@ class SharedProxyResources:
             )
             
             try:
+                # Limits belong to the transport when one is passed explicitly
                 self.unix_client = httpx.AsyncClient(
-                    transport=httpx.AsyncHTTPTransport(uds=SOCKET_PATH),
+                    transport=httpx.AsyncHTTPTransport(
+                        uds=SOCKET_PATH,
+                        limits=httpx.Limits(
+                            max_connections=SOCKET_MAX_CONNECTIONS,
+                            max_keepalive_connections=SOCKET_MAX_KEEPALIVE,
+                            keepalive_expiry=SOCKET_KEEPALIVE_EXPIRY,
+                        ),
+                    ),
                     base_url="http://localhost",
                     timeout=httpx.Timeout(30.0)
                 )
@@ -109,18 +146,35 @@ class BaseProxyServer(WebServer):
         
         super().__init__(config, lifespan=lifespan)
     
-    def extract_client_cert_info(self, request: Request) -> Dict[str, str]:
-        """Extract client certificate information from headers"""
-        return {
-            "X-Client-Cert": request.headers.get("X-Client-Cert", ""),
-            "X-Client-Verify": request.headers.get("X-Client-Verify", ""),
-            "X-Client-S-DN": request.headers.get("X-Client-S-DN", ""),
-            "X-Client-I-DN": request.headers.get("X-Client-I-DN", ""),
-            "X-Real-IP": request.headers.get("X-Real-IP", ""),
-            "X-Forwarded-For": request.headers.get("X-Forwarded-For", ""),
-            "X-Forwarded-Proto": request.headers.get("X-Forwarded-Proto", ""),
-        }
-    
+    async def request_body(self, request: Request) -> bytes:
+        """
+        Request body for the upstream call, buffered so a backoff retry can
+        send it again; a consumed stream could not be replayed. Starlette
+        caches it, so a middleware that read it first costs nothing extra.
+        """
+        if request.method in ("GET", "HEAD"):
+            return b""
+        return await request.body()
+
+    def forward_headers(self, request: Request) -> list[tuple[bytes, bytes]]:
+        """
+        Upstream request headers in one pass over the raw client headers:
+        everything except hop-by-hop and framing headers, plus any client
+        certificate header the client did not send, as an empty value.
+        """
+        headers = []
+        seen = set()
+        for name, value in request.headers.raw:
+            lower = name.decode("latin-1").lower()
+            if lower in REQUEST_SKIP_HEADERS:
+                continue
+            seen.add(lower)
+            headers.append((name, value))
+        for name in CLIENT_CERT_HEADERS:
+            if name.lower() not in seen:
+                headers.append((name.encode("latin-1"), b""))
+        return headers
+
     @backoff.on_exception(
         backoff.expo,
         httpx.ConnectError,
@@ -132,56 +186,48 @@ class BaseProxyServer(WebServer):
         target_url: str,
         method: str,
         path: str,
-        headers: Dict[str, str],
-        body: bytes = b"",
+        headers: list[tuple[bytes, bytes]],
+        body=b"",
         params: Dict[str, str] = None,
         use_unix_socket: bool = False
     ) -> Response:
-        """Proxy request with automatic retry on connection errors."""
+        """
+        Proxy request with automatic retry on connection errors.
+
+        The request body is bytes so a retry can resend it; the upstream response is
+        relayed chunk by chunk as it arrives (undecoded, so Content-Length and
+        Content-Encoding stay valid) and its connection goes back to the pool
+        once the client has the last byte or goes away.
+        """
         
         client = self.shared.unix_client if use_unix_socket else self.shared.http_client
         full_url = urljoin(target_url, path)
         
-        # Filter hop-by-hop headers
-        filtered_headers = {
-            k: v for k, v in headers.items() 
-            if k.lower() not in [
-                "host", "connection", "upgrade", "proxy-authenticate",
-                "proxy-authorization", "te", "trailers", "transfer-encoding"
-            ]
-        }
-        
         try:
             logger.info(f"Proxying {method} {full_url}")
             
-            response = await client.request(
+            upstream_request = client.build_request(
                 method=method,
                 url=full_url,
-                headers=filtered_headers,
+                headers=headers,
                 content=body,
                 params=params,
-                follow_redirects=False
             )
+            response = await client.send(upstream_request, stream=True, follow_redirects=False)
             
             # Reset failure counter on success
             if use_unix_socket:
                 self.shared.consecutive_socket_failures = 0
             
-            # Filter response headers
-            response_headers = {
-                k: v for k, v in response.headers.items()
-                if k.lower() not in [
-                    "connection", "upgrade", "proxy-authenticate",
-                    "proxy-authorization", "te", "trailers", "transfer-encoding"
-                ]
-            }
+            # Filter response headers in one pass; raw pairs keep repeated headers
+            response_headers = [
+                (name, value) for name, value in response.headers.raw
+                if name.decode("latin-1").lower() not in HOP_BY_HOP_HEADERS
+            ]
             
-            return Response(
-                content=response.content,
-                status_code=response.status_code,
-                headers=response_headers,
-                media_type=response.headers.get("content-type")
-            )
+            streamed = StreamingResponse(relay_body(response), status_code=response.status_code)
+            streamed.raw_headers = response_headers
+            return streamed
             
         except httpx.ConnectError as e:
             logger.error(f"Connection failed to {full_url}: {e}")
@@ -247,23 +293,13 @@ class BaseProxyServer(WebServer):
     
     async def proxy_to_host_service(self, path: str, request: Request):
         """Proxy requests to host attestation service via Unix socket"""
-        method = request.method
-        body = await request.body()
-        params = dict(request.query_params)
-        headers = self.extract_client_cert_info(request)
-        
-        # Add original request headers
-        for key, value in request.headers.items():
-            if key.lower() not in ["host", "content-length"]:
-                headers[key] = value
-        
         return await self.proxy_request(
             target_url="http://localhost",
-            method=method,
+            method=request.method,
             path=f"/{path}",
-            headers=headers,
-            body=body,
-            params=params,
+            headers=self.forward_headers(request),
+            body=await self.request_body(request),
+            params=dict(request.query_params),
             use_unix_socket=True
         )
     
@@ -276,26 +312,16 @@ class BaseProxyServer(WebServer):
                 detail="Invalid service name"
             )
         
-        method = request.method
-        body = await request.body()
-        params = dict(request.query_params)
-        headers = self.extract_client_cert_info(request)
-        
-        # Add original request headers
-        for key, value in request.headers.items():
-            if key.lower() not in ["host", "content-length"]:
-                headers[key] = value
-        
         # Build K8s service URL
         service_url = f"http://{service_name}.{SERVICE_NAMESPACE}.{CLUSTER_DOMAIN}"
         
         return await self.proxy_request(
             target_url=service_url,
-            method=method,
+            method=request.method,
             path=f"/{path}",
-            headers=headers,
-            body=body,
-            params=params,
+            headers=self.forward_headers(request),
+            body=await self.request_body(request),
+            params=dict(request.query_params),
             use_unix_socket=False
         )
 
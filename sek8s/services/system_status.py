@@ -3,19 +3,23 @@
 from __future__ import annotations
 
 import asyncio
+import json
 import os
 import re
 import sys
+from contextlib import asynccontextmanager
 from dataclasses import dataclass
 from datetime import datetime, timedelta, timezone
 from pathlib import Path
-from typing import Any, Dict, List, Optional
+from typing import Any, AsyncIterator, Dict, List, Optional
 
 from aiocache import cached as aiocache_cached
-from fastapi import Depends, HTTPException, Query
+from fastapi import Depends, FastAPI, HTTPException, Query
+from fastapi.responses import StreamingResponse
 from loguru import logger
 
 from sek8s.config import SystemStatusConfig
+from sek8s.dbus import DBusError
 from sek8s.responses import (
     DirectoryInfo,
     DiskSpaceResponse,
@@ -30,6 +34,7 @@ from sek8s.responses import (
     ShutdownResponse,
 )
 from sek8s.server import WebServer
+from sek8s.services.unit_status import UnitStatusCache
 from sek8s.services.util import authorize
 
 
@@ -78,6 +83,21 @@ SERVICE_ALLOWLIST: Dict[str, ServiceDefinition] = {
 }
 
 
+# Native parallel scanner built by the system-status role (files/disk-usage)
+DISK_USAGE_BINARY = "/usr/local/bin/disk-usage"
+# Immediate subdirectories listed in standard mode; the scanner reports how many there were
+DISK_SIMPLE_MAX_ENTRIES = 1000
+# The scanner's output is bounded by its top-N per level, not by the size of the tree
+DISK_USAGE_OUTPUT_LIMIT = 4 * 1024 * 1024
+
+# Native sd-journal reader built by the system-status role (files/journal-reader)
+JOURNAL_READER_BINARY = "/usr/local/bin/journal-reader"
+# Read size when relaying the reader's NDJSON; the pipe plus one chunk is all that is buffered
+JOURNAL_STREAM_CHUNK = 64 * 1024
+# sd-journal cursors: "s=<hex>;i=<hex>;b=<hex>;m=<hex>;t=<hex>;x=<hex>"
+JOURNAL_CURSOR_PATTERN = re.compile(r"^[0-9a-z=;]{1,256}$")
+
+
 def _parse_key_value(output: str) -> Dict[str, str]:
     parsed: Dict[str, str] = {}
     for line in output.splitlines():
@@ -140,13 +160,87 @@ async def _run_command(command: List[str], timeout: float, limit: int) -> Comman
     return result
 
 
+async def _stream_command(command: List[str], timeout: float) -> AsyncIterator[bytes]:
+    """Start a command and relay its stdout in chunks.
+
+    Waits for the first chunk so a command that fails before writing anything
+    raises HTTPException like _run_command; afterwards each read is bounded by
+    timeout and the process is killed when the client goes away.
+    """
+    logger.debug("Streaming command: {}", command)
+    command_name = command[1] if command[0] == "sudo" else command[0]
+
+    try:
+        process = await asyncio.create_subprocess_exec(
+            *command,
+            stdout=asyncio.subprocess.PIPE,
+            stderr=asyncio.subprocess.PIPE,
+        )
+    except FileNotFoundError as exc:
+        logger.error("Binary not found for {}", command)
+        raise HTTPException(
+            status_code=503,
+            detail={"error": "missing_binary", "binary": command_name},
+        ) from exc
+
+    try:
+        first = await asyncio.wait_for(process.stdout.read(JOURNAL_STREAM_CHUNK), timeout=timeout)
+    except asyncio.TimeoutError as exc:
+        process.kill()
+        await process.wait()
+        logger.error("Command timeout for {}", command)
+        raise HTTPException(
+            status_code=504,
+            detail={"error": "timeout", "command": command_name},
+        ) from exc
+
+    if not first:
+        stderr_bytes = await process.stderr.read()
+        exit_code = await process.wait()
+        stderr = stderr_bytes.decode("utf-8", errors="replace").strip()
+        logger.warning("Command {} returned exit code {}: {}", command_name, exit_code, stderr)
+        raise HTTPException(
+            status_code=500,
+            detail={"error": "command_failed", "command": command_name, "stderr": stderr},
+        )
+
+    async def relay() -> AsyncIterator[bytes]:
+        try:
+            chunk = first
+            while chunk:
+                yield chunk
+                chunk = await asyncio.wait_for(process.stdout.read(JOURNAL_STREAM_CHUNK), timeout=timeout)
+        except asyncio.TimeoutError:
+            # The body simply ends without its trailer; clients treat that as incomplete
+            logger.error("Command timeout while streaming {}", command)
+        finally:
+            if process.returncode is None:
+                process.kill()
+            await process.wait()
+
+    return relay()
+
 
 class SystemStatusServer(WebServer):
     """FastAPI server exposing read-only system state."""
 
     def __init__(self, config: SystemStatusConfig):
         self.config = config
-        super().__init__(config)
+        self.unit_status: Optional[UnitStatusCache] = None
+        if config.systemd_bus_address:
+            self.unit_status = UnitStatusCache(
+                (service.unit for service in SERVICE_ALLOWLIST.values()),
+                config.systemd_bus_address,
+                config.command_timeout_seconds,
+            )
+
+        @asynccontextmanager
+        async def lifespan(app: FastAPI):
+            yield
+            if self.unit_status is not None:
+                await self.unit_status.close()
+
+        super().__init__(config, lifespan=lifespan)
 
     def _setup_routes(self) -> None:
         self.app.add_api_route(
@@ -181,6 +275,17 @@ class SystemStatusServer(WebServer):
             summary="Get service logs",
             description="Returns recent journal logs for a specific service",
         )
+        self.app.add_api_route(
+            "/services/{service_id}/logs/stream",
+            self.stream_service_logs,
+            methods=["GET"],
+            response_class=StreamingResponse,
+            summary="Stream service logs",
+            description=(
+                "Streams journal entries for a specific service as NDJSON, ending with a trailer "
+                "whose next_cursor continues from the last entry"
+            ),
+        )
         self.app.add_api_route(
             "/gpu/nvidia-smi",
             self.nvidia_smi,
@@ -232,7 +337,6 @@ class SystemStatusServer(WebServer):
             ]
         )
 
-    @aiocache_cached(ttl=30)
     async def overview(self) -> OverviewResponse:
         services = await asyncio.gather(
             *(
@@ -253,7 +357,6 @@ class SystemStatusServer(WebServer):
             timestamp=datetime.now(timezone.utc).isoformat(),
         )
 
-    @aiocache_cached(ttl=30)
     async def get_service_status(self, service_id: str) -> ServiceStatusResponse:
         service = self._resolve_service(service_id)
         return await self._collect_service_status(service)
@@ -264,6 +367,13 @@ class SystemStatusServer(WebServer):
         *,
         tolerate_errors: bool = False,
     ) -> ServiceStatusResponse:
+        # Served from the D-Bus cache when systemd is reachable, one systemctl per unit otherwise
+        if self.unit_status is not None:
+            try:
+                return self._status_response(service, await self.unit_status.get(service.unit))
+            except DBusError as exc:
+                logger.debug("Falling back to systemctl for {}: {}", service.unit, exc)
+
         properties = [
             "Id",
             "LoadState",
@@ -318,7 +428,9 @@ class SystemStatusServer(WebServer):
                 )
             raise HTTPException(status_code=502, detail=error_detail)
 
-        data = _parse_key_value(result.stdout)
+        return self._status_response(service, _parse_key_value(result.stdout))
+
+    def _status_response(self, service: ServiceDefinition, data: Dict[str, str]) -> ServiceStatusResponse:
         status = ServiceStatus(
             load_state=data.get("LoadState"),
             active_state=data.get("ActiveState"),
@@ -380,6 +492,42 @@ class SystemStatusServer(WebServer):
             logs=entries,
         )
 
+    async def stream_service_logs(
+        self,
+        service_id: str,
+        lines: int = Query(200, ge=1),
+        since_minutes: Optional[int] = Query(None, ge=1, le=1440),
+        after_cursor: Optional[str] = Query(None, description="Return entries following this cursor"),
+    ) -> StreamingResponse:
+        service = self._resolve_service(service_id)
+
+        max_lines = self.config.log_tail_max
+        default_lines = self.config.log_tail_default
+        clamped_lines = max(1, min(lines or default_lines, max_lines))
+
+        # No sudo: the status user reads the journal through the systemd-journal group
+        command = [
+            JOURNAL_READER_BINARY,
+            f"--unit={service.unit}",
+            f"--lines={clamped_lines}",
+        ]
+
+        if since_minutes:
+            window_limit = min(since_minutes, self.config.log_window_max_minutes)
+            since_time = datetime.now(timezone.utc) - timedelta(minutes=window_limit)
+            command.append(f"--since={int(since_time.timestamp() * 1_000_000)}")
+
+        if after_cursor is not None:
+            if not JOURNAL_CURSOR_PATTERN.match(after_cursor):
+                raise HTTPException(
+                    status_code=400,
+                    detail={"error": "invalid_cursor", "cursor": after_cursor[:256]},
+                )
+            command.append(f"--after-cursor={after_cursor}")
+
+        body = await _stream_command(command, self.config.command_timeout_seconds)
+        return StreamingResponse(body, media_type="application/x-ndjson")
+
     @aiocache_cached(ttl=60)
     async def nvidia_smi(
         self,
@@ -446,17 +594,6 @@ class SystemStatusServer(WebServer):
 
         return resolved
 
-    def _parse_du_line(self, line: str) -> tuple[int, str]:
-        """Parse a line from du output: size<tab>path."""
-        parts = line.split("\t", 1)
-        if len(parts) != 2:
-            raise ValueError(f"Invalid du output line: {line}")
-        try:
-            size_kb = int(parts[0])
-        except ValueError as exc:
-            raise ValueError(f"Invalid size in du output: {parts[0]}") from exc
-        return size_kb * 1024, parts[1]
-
     def _human_readable_size(self, size_bytes: int) -> str:
         """Convert bytes to human-readable format."""
         for unit in ["B", "KB", "MB", "GB", "TB"]:
@@ -472,6 +609,7 @@ class SystemStatusServer(WebServer):
         max_depth: int = Query(3, ge=1, le=10, description="Maximum depth for diagnostic mode (default: 3)"),
         top_n: int = Query(10, ge=1, le=100, description="Show top N directories per level (default: 10)"),
         cross_filesystems: bool = Query(False, description="Cross filesystem boundaries (include mounted volumes)"),
+        rescan: bool = Query(False, description="Re-read every directory instead of reusing unchanged ones from the index"),
     ) -> DiskSpaceResponse:
         """Get sizes of subdirectories within the given path.
         
@@ -479,178 +617,133 @@ class SystemStatusServer(WebServer):
         Diagnostic mode: Recursively analyzes up to max_depth levels and shows top N offenders.
         By default, stays within a single filesystem. Set cross_filesystems=true to include mounted volumes.
         The max_depth and top_n parameters are only used when diagnostic=true.
+        Directories unchanged since an earlier scan are served from the scanner's index; files
+        growing in place show up once their listing is older than DISK_INDEX_MAX_AGE_SECONDS,
+        and index_stale_seconds reports the bound for each answer. rescan=true re-reads everything.
         """
         validated_path = self._validate_path(path)
 
         if diagnostic:
             return await self._get_disk_space_diagnostic(
-                validated_path, max_depth, top_n, cross_filesystems
+                validated_path, max_depth, top_n, cross_filesystems, rescan
             )
         else:
-            return await self._get_disk_space_simple(validated_path, cross_filesystems)
-
-    async def _get_disk_space_simple(
-        self, validated_path: Path, cross_filesystems: bool = False
-    ) -> DiskSpaceResponse:
-        """Get sizes of immediate subdirectories only."""
-        # Use sudo du to access all directories
-        # -k: output in kilobytes
-        # -x: don't cross filesystem boundaries (unless cross_filesystems=True)
-        # --max-depth=1: only immediate children
-        # Note: Don't use -s with --max-depth as they conflict
+            return await self._get_disk_space_simple(validated_path, cross_filesystems, rescan)
+
+    async def _scan_disk_usage(
+        self, validated_path: Path, max_depth: int, top_n: int, cross_filesystems: bool, rescan: bool
+    ) -> Dict[str, Any]:
+        """Run the native scanner and return its JSON report."""
+        # Use sudo so every directory is readable
+        # --index: reuse listings of unchanged directories, at most --max-age seconds old
+        # --one-file-system: don't cross filesystem boundaries (unless cross_filesystems=True)
+        max_age = 0 if rescan else self.config.disk_index_max_age_seconds
         command = [
             "sudo",
-            "du",
-            "-k",
+            DISK_USAGE_BINARY,
+            f"--max-depth={max_depth}",
+            f"--top={top_n}",
+            "--index",
+            f"--max-age={max_age}",
         ]
         if not cross_filesystems:
-            command.append("-x")  # Don't cross filesystem boundaries
-        command.extend([
-            "--max-depth=1",
-            str(validated_path),
-        ])
+            command.append("--one-file-system")
+        command.append(str(validated_path))
 
-        # Use longer timeout for diagnostic mode to handle large directory trees
+        # Use longer timeout to handle large directory trees
         timeout = max(self.config.command_timeout_seconds * 5, 120)  # Max 2 minutes
 
-        result = await _run_command(
-            command,
-            timeout,
-            self.config.max_output_bytes,
-        )
-
-        directories: List[DirectoryInfo] = []
-        parent_size = 0
-
-        for line in result.stdout.strip().splitlines():
-            if not line:
-                continue
-
-            try:
-                size_bytes, dir_path = self._parse_du_line(line)
-            except ValueError as exc:
-                logger.warning("Failed to parse du line: {}", exc)
-                continue
-
-            # Skip the parent directory itself (it appears in the output)
-            if Path(dir_path).resolve() == validated_path:
-                parent_size = size_bytes
-                continue
-
-            dir_name = Path(dir_path).name
-            directories.append(
-                DirectoryInfo(
-                    name=dir_name,
-                    path=dir_path,
-                    size_bytes=size_bytes,
-                    size_human=self._human_readable_size(size_bytes),
-                    depth=1,
-                    percentage=None,
-                )
+        result = await _run_command(command, timeout, DISK_USAGE_OUTPUT_LIMIT)
+        if result.exit_code != 0:
+            logger.error("disk-usage failed for {}: {}", validated_path, result.stderr.strip())
+            raise HTTPException(
+                status_code=500,
+                detail={"error": "scan_failed", "command": "disk-usage", "stderr": result.stderr.strip()},
             )
 
-        # Sort by size descending
-        directories.sort(key=lambda d: d.size_bytes, reverse=True)
+        try:
+            report = json.loads(result.stdout)
+        except ValueError as exc:
+            logger.error("Invalid disk-usage output for {}: {}", validated_path, exc)
+            raise HTTPException(
+                status_code=502,
+                detail={"error": "invalid_output", "command": "disk-usage"},
+            ) from exc
+
+        if report["errors"]:
+            logger.warning(
+                "disk-usage skipped {} unreadable entries under {}", report["errors"], validated_path
+            )
+        index = report.get("index", {})
+        if index and not index["saved"]:
+            logger.warning("disk-usage could not save its index")
+        logger.debug(
+            "disk-usage scanned {} dirs ({} from index), {} files under {} in {} ms",
+            report["dirs"], index.get("reused", 0), report["files"], validated_path, report["elapsed_ms"],
+        )
+        return report
+
+    def _index_fields(self, report: Dict[str, Any]) -> Dict[str, Any]:
+        index = report.get("index")
+        if not index:
+            return {}
+        return {"index_stale_seconds": index["stale_seconds"], "index_reused_dirs": index["reused"]}
+
+    def _directory_info(self, path: str, size_bytes: int, depth: int, total_bytes: int) -> DirectoryInfo:
+        return DirectoryInfo(
+            name=Path(path).name,
+            path=path,
+            size_bytes=size_bytes,
+            size_human=self._human_readable_size(size_bytes),
+            depth=depth,
+            percentage=(size_bytes / total_bytes * 100) if total_bytes > 0 else None,
+        )
 
-        # Calculate total (use parent_size if available, otherwise sum subdirs)
-        total_bytes = parent_size if parent_size > 0 else sum(d.size_bytes for d in directories)
+    async def _get_disk_space_simple(
+        self, validated_path: Path, cross_filesystems: bool = False, rescan: bool = False
+    ) -> DiskSpaceResponse:
+        """Get sizes of immediate subdirectories only."""
+        report = await self._scan_disk_usage(
+            validated_path, 1, DISK_SIMPLE_MAX_ENTRIES, cross_filesystems, rescan
+        )
+        total_bytes = report["total_bytes"]
+        level = report["levels"][0]
 
-        # Add percentages
-        if total_bytes > 0:
-            for d in directories:
-                d.percentage = (d.size_bytes / total_bytes) * 100
+        # Entries arrive sorted by size descending
+        directories = [
+            self._directory_info(entry["path"], entry["size_bytes"], 1, total_bytes)
+            for entry in level["entries"]
+        ]
 
         return DiskSpaceResponse(
             path=str(validated_path),
             directories=directories,
             total_size_bytes=total_bytes,
             total_size_human=self._human_readable_size(total_bytes),
-            stdout_truncated=result.stdout_truncated,
+            stdout_truncated=level["count"] > len(directories),
             diagnostic_mode=False,
+            **self._index_fields(report),
         )
 
     async def _get_disk_space_diagnostic(
-        self, validated_path: Path, max_depth: int, top_n: int, cross_filesystems: bool = False
+        self,
+        validated_path: Path,
+        max_depth: int,
+        top_n: int,
+        cross_filesystems: bool = False,
+        rescan: bool = False,
     ) -> DiskSpaceResponse:
         """Recursive analysis to find worst disk space offenders at multiple depth levels."""
-        # Use sudo du with specified max-depth to get all directories up to that level
-        # This gives us a complete picture of disk usage at all levels
-        command = [
-            "sudo",
-            "du",
-            "-k",
+        # The scanner keeps the top N per depth level itself, so nothing is
+        # lost to output truncation however many directories the tree holds
+        report = await self._scan_disk_usage(validated_path, max_depth, top_n, cross_filesystems, rescan)
+        root_size = report["total_bytes"]
+
+        top_offenders: List[DirectoryInfo] = [
+            self._directory_info(entry["path"], entry["size_bytes"], level["depth"], root_size)
+            for level in report["levels"]
+            for entry in level["entries"]
         ]
-        if not cross_filesystems:
-            command.append("-x")  # Don't cross filesystem boundaries
-        command.extend([
-            f"--max-depth={max_depth}",
-            str(validated_path),
-        ])
-
-        # Use longer timeout for diagnostic mode to handle large directory trees
-        timeout = max(self.config.command_timeout_seconds * 5, 120)  # Max 2 minutes
-        
-        result = await _run_command(
-            command,
-            timeout,
-            self.config.max_output_bytes * 2,  # Allow larger output
-        )
-
-        # Parse all directory entries
-        all_entries: List[tuple[int, str, int]] = []  # (size_bytes, path, depth)
-        root_size = 0
-
-        for line in result.stdout.strip().splitlines():
-            if not line:
-                continue
-
-            try:
-                size_bytes, dir_path = self._parse_du_line(line)
-            except ValueError as exc:
-                logger.warning("Failed to parse du line: {}", exc)
-                continue
-
-            resolved = Path(dir_path).resolve()
-            
-            # Calculate depth relative to validated_path
-            try:
-                relative = resolved.relative_to(validated_path)
-                depth = len(relative.parts) if str(relative) != "." else 0
-            except ValueError:
-                # Path is not relative to validated_path (shouldn't happen)
-                continue
-
-            if depth == 0:
-                root_size = size_bytes
-                continue
-
-            all_entries.append((size_bytes, str(resolved), depth))
-
-        # Group by depth and get top N for each level
-        depth_groups: Dict[int, List[tuple[int, str]]] = {}
-        for size_bytes, path, depth in all_entries:
-            if depth not in depth_groups:
-                depth_groups[depth] = []
-            depth_groups[depth].append((size_bytes, path))
-
-        # Get top N from each depth level
-        top_offenders: List[DirectoryInfo] = []
-        for depth in sorted(depth_groups.keys()):
-            entries = depth_groups[depth]
-            entries.sort(reverse=True)  # Sort by size descending
-            
-            for size_bytes, path in entries[:top_n]:
-                percentage = (size_bytes / root_size * 100) if root_size > 0 else 0
-                top_offenders.append(
-                    DirectoryInfo(
-                        name=Path(path).name,
-                        path=path,
-                        size_bytes=size_bytes,
-                        size_human=self._human_readable_size(size_bytes),
-                        depth=depth,
-                        percentage=percentage,
-                    )
-                )
 
         # Sort all results by size descending for final output
         top_offenders.sort(key=lambda d: d.size_bytes, reverse=True)
@@ -660,10 +753,11 @@ class SystemStatusServer(WebServer):
             directories=top_offenders,
             total_size_bytes=root_size,
             total_size_human=self._human_readable_size(root_size),
-            stdout_truncated=result.stdout_truncated,
+            stdout_truncated=False,
             diagnostic_mode=True,
             max_depth=max_depth,
             top_n=top_n,
+            **self._index_fields(report),
         )
 
     async def shutdown_system(self) -> ShutdownResponse:
@@ -0,0 +1,249 @@
+"""systemd unit properties over one D-Bus connection, kept current by signals.
+
+The cache connects to the system bus on first use, asks systemd for every
+configured unit's properties in one pipelined batch, and then applies the
+PropertiesChanged signals systemd emits for those units, so status reads are
+served from memory. Properties systemd only invalidates (rather than sending
+their new value) are re-read on the next access, as are all properties after a
+daemon reload or a unit file change. A lost connection is re-established on the
+next access.
+
+Any local peer may send a signal straight to our connection, so only those
+whose sender is systemd's current unique name (looked up with GetNameOwner and
+tracked through NameOwnerChanged from the bus itself) are applied.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import string
+import time
+from typing import Dict, Iterable, Optional, Sequence, Set
+
+from loguru import logger
+
+from sek8s.dbus import (
+    BUS_INTERFACE,
+    BUS_NAME,
+    BUS_PATH,
+    PROPERTIES_INTERFACE,
+    DBusConnection,
+    DBusError,
+    Message,
+)
+
+SYSTEMD_BUS_NAME = "org.freedesktop.systemd1"
+SYSTEMD_PATH = "/org/freedesktop/systemd1"
+MANAGER_INTERFACE = "org.freedesktop.systemd1.Manager"
+UNIT_INTERFACE = "org.freedesktop.systemd1.Unit"
+SERVICE_INTERFACE = "org.freedesktop.systemd1.Service"
+
+# Properties the status endpoints report (the `systemctl show` set), by interface
+UNIT_PROPERTIES: Dict[str, Sequence[str]] = {
+    UNIT_INTERFACE: ("Id", "LoadState", "ActiveState", "SubState", "UnitFileState"),
+    SERVICE_INTERFACE: ("MainPID", "ExecMainCode", "ExecMainStatus"),
+}
+
+# A unit without a property (e.g. MainPID on a non-service unit) simply omits it
+_MISSING_PROPERTY_ERRORS = {
+    "org.freedesktop.DBus.Error.UnknownProperty",
+    "org.freedesktop.DBus.Error.UnknownInterface",
+    "org.freedesktop.DBus.Error.InvalidArgs",
+}
+
+_LABEL_SAFE = set(string.ascii_letters + string.digits)
+
+
+def unit_object_path(unit: str) -> str:
+    """systemd's object path for a unit name: k3s.service -> .../unit/k3s_2eservice."""
+    label = "".join(
+        char if char in _LABEL_SAFE and not (index == 0 and char.isdigit()) else f"_{ord(char):02x}"
+        for index, char in enumerate(unit)
+    )
+    return f"{SYSTEMD_PATH}/unit/{label}"
+
+
+def _format(value: object) -> str:
+    """Render a property value the way `systemctl show` prints it."""
+    if isinstance(value, bool):
+        return "yes" if value else "no"
+    return str(value)
+
+
+class UnitStatusCache:
+    """Cached properties of a fixed set of units, read from systemd over D-Bus."""
+
+    def __init__(
+        self,
+        units: Iterable[str],
+        address: str,
+        timeout: float,
+        retry_seconds: float = 30.0,
+    ):
+        self.address = address
+        self.timeout = timeout
+        self.retry_seconds = retry_seconds
+        self._paths = {unit_object_path(unit): unit for unit in units}
+        self._properties: Dict[str, Dict[str, str]] = {unit: {} for unit in self._paths.values()}
+        self._stale: Set[str] = set(self._properties)
+        # Bumped by every signal for a unit, so a batch read that overlaps one is not applied
+        self._generation: Dict[str, int] = {unit: 0 for unit in self._properties}
+        self._connection: Optional[DBusConnection] = None
+        # Unique bus name of systemd; signals from anyone else are ignored
+        self._systemd_owner: Optional[str] = None
+        self._lock = asyncio.Lock()
+        self._failed_at: Optional[float] = None
+        self._failure: Optional[DBusError] = None
+
+    async def get_all(self) -> Dict[str, Dict[str, str]]:
+        """Properties of every unit. Raises DBusError when systemd cannot be reached."""
+        async with self._lock:
+            if self._connection is None or self._connection.closed:
+                await self._connect()
+            # A unit signalled while its batch was in flight is read again
+            for _ in range(3):
+                if not self._stale:
+                    break
+                await self._refresh(sorted(self._stale))
+            return {unit: dict(properties) for unit, properties in self._properties.items()}
+
+    async def get(self, unit: str) -> Dict[str, str]:
+        return (await self.get_all())[unit]
+
+    async def close(self) -> None:
+        if self._connection is not None:
+            await self._connection.close()
+            self._connection = None
+
+    async def _connect(self) -> None:
+        # Don't retry an unreachable bus on every request
+        if self._failed_at is not None and time.monotonic() - self._failed_at < self.retry_seconds:
+            raise self._failure
+
+        self._stale.update(self._properties)
+        self._systemd_owner = None
+        connection = None
+        try:
+            connection = await asyncio.wait_for(DBusConnection.connect(self.address), self.timeout)
+            connection.add_signal_handler(self._on_signal)
+            # Subscribe before the first read so no change between the two is lost. Signals that
+            # arrive before systemd's name is known are dropped; the first read covers them.
+            futures = [
+                connection.send_call(BUS_NAME, BUS_PATH, BUS_INTERFACE, "AddMatch", "s", (rule,))
+                for rule in self._match_rules()
+            ]
+            owner = connection.send_call(BUS_NAME, BUS_PATH, BUS_INTERFACE, "GetNameOwner", "s", (SYSTEMD_BUS_NAME,))
+            futures.append(connection.send_call(SYSTEMD_BUS_NAME, SYSTEMD_PATH, MANAGER_INTERFACE, "Subscribe"))
+            await connection.drain()
+            await asyncio.wait_for(asyncio.gather(owner, *futures), self.timeout)
+            (self._systemd_owner,) = owner.result()
+        except (DBusError, OSError, ValueError, asyncio.TimeoutError) as exc:
+            if connection is not None:
+                await connection.close()
+            self._failed_at = time.monotonic()
+            self._failure = exc if isinstance(exc, DBusError) else DBusError(
+                "org.freedesktop.DBus.Error.NoServer", str(exc) or type(exc).__name__
+            )
+            logger.warning("systemd D-Bus unavailable at {}: {}", self.address, self._failure)
+            raise self._failure from exc
+
+        if self._connection is not None:
+            await self._connection.close()
+        self._connection = connection
+        self._failed_at = None
+        self._failure = None
+        logger.info("Watching {} units over D-Bus at {}", len(self._paths), self.address)
+
+    def _match_rules(self) -> Sequence[str]:
+        rules = [
+            f"type='signal',sender='{SYSTEMD_BUS_NAME}',path='{path}',"
+            f"interface='{PROPERTIES_INTERFACE}',member='PropertiesChanged'"
+            for path in self._paths
+        ]
+        rules += [
+            f"type='signal',sender='{SYSTEMD_BUS_NAME}',path='{SYSTEMD_PATH}',"
+            f"interface='{MANAGER_INTERFACE}',member='{member}'"
+            for member in ("Reloading", "UnitFilesChanged")
+        ]
+        rules.append(
+            f"type='signal',sender='{BUS_NAME}',path='{BUS_PATH}',interface='{BUS_INTERFACE}',"
+            f"member='NameOwnerChanged',arg0='{SYSTEMD_BUS_NAME}'"
+        )
+        return rules
+
+    async def _refresh(self, units: Sequence[str]) -> None:
+        """Re-read every property of units, all Get calls in one pipelined batch."""
+        connection = self._connection
+        generation = dict(self._generation)
+        requests = []
+        for path, unit in self._paths.items():
+            if unit not in units:
+                continue
+            for interface, names in UNIT_PROPERTIES.items():
+                for name in names:
+                    future = connection.send_call(
+                        SYSTEMD_BUS_NAME, path, PROPERTIES_INTERFACE, "Get", "ss", (interface, name)
+                    )
+                    requests.append((unit, name, future))
+        await connection.drain()
+
+        futures = [future for _, _, future in requests]
+        try:
+            replies = await asyncio.wait_for(asyncio.gather(*futures, return_exceptions=True), self.timeout)
+        except asyncio.TimeoutError as exc:
+            # The replies may still arrive; start from a clean connection instead
+            await connection.close()
+            raise DBusError("org.freedesktop.DBus.Error.Timeout", "systemd did not answer") from exc
+
+        fresh: Dict[str, Dict[str, str]] = {unit: {} for unit in units}
+        for (unit, name, _), reply in zip(requests, replies):
+            if isinstance(reply, DBusError):
+                if reply.name in _MISSING_PROPERTY_ERRORS:
+                    continue
+                raise reply
+            if isinstance(reply, BaseException):
+                raise reply
+            fresh[unit][name] = _format(reply[0].value)
+
+        for unit, properties in fresh.items():
+            if self._generation[unit] == generation[unit]:
+                self._properties[unit] = properties
+                self._stale.discard(unit)
+
+    def _invalidate_all(self) -> None:
+        self._stale.update(self._properties)
+        for unit in self._generation:
+            self._generation[unit] += 1
+
+    def _on_signal(self, message: Message) -> None:
+        if message.sender == BUS_NAME and message.member == "NameOwnerChanged":
+            # Only the bus itself sends as org.freedesktop.DBus; systemd re-executed or restarted
+            if message.signature == "sss" and message.body[0] == SYSTEMD_BUS_NAME and self._systemd_owner is not None:
+                self._systemd_owner = message.body[2] or None
+                self._invalidate_all()
+            return
+        if message.sender is None or message.sender != self._systemd_owner:
+            return
+
+        if message.path == SYSTEMD_PATH and message.interface == MANAGER_INTERFACE:
+            # Reloading(false) ends a daemon-reload; UnitFileState is never signalled
+            if message.member == "UnitFilesChanged" or (message.member == "Reloading" and message.body == (False,)):
+                self._invalidate_all()
+            return
+
+        unit = self._paths.get(message.path)
+        if unit is None or message.interface != PROPERTIES_INTERFACE or message.member != "PropertiesChanged":
+            return
+        if message.signature != "sa{sv}as":
+            return
+        interface, changed, invalidated = message.body
+        names = UNIT_PROPERTIES.get(interface)
+        if not names:
+            return
+        self._generation[unit] += 1
+        properties = self._properties[unit]
+        for name, variant in changed.items():
+            if name in names:
+                properties[name] = _format(variant.value)
+        if any(name in names for name in invalidated):
+            self._stale.add(unit)
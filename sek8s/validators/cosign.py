@@ -3,13 +3,18 @@ import json
 import logging
 import re
 import time
-from typing import Dict, Tuple
+from typing import Dict, Optional, Tuple
 from urllib.parse import urlparse
 
 from cachetools import TTLCache
 
 from sek8s.validators.base import ValidatorBase, ValidationResult
 from sek8s.config import AdmissionConfig, CosignConfig, CosignRegistryConfig, CosignVerificationConfig
+from sek8s.cosign_verifier import KeySignatureVerifier, api_repository, key_fingerprint
+from sek8s.image_reference import ImagePolicy, parse_image_reference
+from sek8s.metrics import MetricsCollector
+from sek8s.registry_client import RegistryClient, RegistryError, RegistryRateLimited
+from sek8s.verification_cache import SharedVerificationCache
 
 
 logger = logging.getLogger(__name__)
@@ -22,15 +27,31 @@ class RateLimitError(Exception):
 class CosignValidator(ValidatorBase):
     """Validator that verifies container image signatures using cosign."""
 
-    def __init__(self, config: AdmissionConfig):
+    def __init__(self, config: AdmissionConfig, metrics: Optional[MetricsCollector] = None):
         super().__init__(config)
         self.cosign_config = CosignConfig()
+        self.metrics = metrics
         self._result_cache = TTLCache(
             maxsize=self.cosign_config.cache_maxsize, ttl=self.cosign_config.cache_ttl
         )
         self._negative_cache = TTLCache(
             maxsize=self.cosign_config.cache_maxsize, ttl=self.cosign_config.negative_cache_ttl
         )
+        self._shared_cache = self._open_shared_cache()
+        self._digest_cache = TTLCache(
+            maxsize=self.cosign_config.cache_maxsize, ttl=self.cosign_config.digest_cache_ttl
+        )
+        self._policy: Optional[ImagePolicy] = None
+        # Registry verifications in flight, by cache key, and the bound on how many run at once
+        self._inflight: Dict[tuple, asyncio.Future] = {}
+        self._verify_semaphore = asyncio.Semaphore(self.cosign_config.max_concurrent_verifications)
+        self._registry_client = RegistryClient(timeout=self.cosign_config.registry_timeout)
+        self._key_verifier = KeySignatureVerifier(self._registry_client, self.cosign_config.rekor_public_key)
+        if self.cosign_config.native_key_verification and not self.cosign_config.rekor_public_key:
+            logger.warning(
+                "No Rekor public key configured; key-based policies that check the transparency log "
+                "are verified with the cosign CLI"
+            )
         self._rate_limit_until = 0.0
         self._rate_limit_patterns = [
             re.compile(p, re.IGNORECASE)
@@ -72,21 +93,26 @@ class CosignValidator(ValidatorBase):
         if not images:
             return ValidationResult.allow()
 
-        # Check each image
+        # Work out which distinct images need a signature, then verify those concurrently
         violations = []
+        pending = []
         seen = set()
         for image in images:
             if image in seen:
                 continue
             seen.add(image)
             try:
-                # Parse image reference into components
-                registry, org, repo, tag = self._parse_image_reference(image)
-                
-                logger.debug(f"Parsed image {image} -> registry={registry}, org={org}, repo={repo}, tag={tag}")
+                # Parse the reference and find the most specific cosign configuration
+                verdict = self._image_policy().evaluate(image)
+                reference = verdict.reference
+                registry, org, repo = reference.registry, reference.organization, reference.repository
 
-                # Get the most specific cosign configuration
-                verification_config = self.cosign_config.get_verification_config(registry, org, repo)
+                logger.debug(
+                    f"Parsed image {image} -> registry={registry}, org={org}, repo={repo}, "
+                    f"tag={reference.tag_or_digest}"
+                )
+
+                verification_config = verdict.verification_config
 
                 if not verification_config:
                     logger.warning(
@@ -102,86 +128,54 @@ class CosignValidator(ValidatorBase):
                     logger.debug(f"Signature verification disabled for {registry}/{org}/{repo}")
                     continue
 
-                # Verify the image signature
-                is_valid = await self._verify_image_signature(image, verification_config)
-                if not is_valid:
-                    violations.append(
-                        f"Image {image} has invalid or missing signature (registry: {registry}, org: {org})"
-                    )
-
-            except RateLimitError as e:
-                logger.warning(f"Rate limited while verifying {image}: {e}")
-                violations.append(str(e))
-                break  # Avoid hammering upstream during a known backoff window
+                pending.append((image, registry, org, verification_config))
             except Exception as e:
                 logger.error(f"Error verifying image {image}: {e}")
                 violations.append(f"Verification failed for {image}: {str(e)}")
 
+        results = await asyncio.gather(
+            *(self._verify_image_signature(image, config) for image, _, _, config in pending),
+            return_exceptions=True,
+        )
+        for (image, registry, org, _), result in zip(pending, results):
+            if isinstance(result, RateLimitError):
+                logger.warning(f"Rate limited while verifying {image}: {result}")
+                violations.append(str(result))
+                break  # One backoff message covers the rest
+            if isinstance(result, BaseException):
+                logger.error(f"Error verifying image {image}: {result}")
+                violations.append(f"Verification failed for {image}: {str(result)}")
+            elif not result:
+                violations.append(
+                    f"Image {image} has invalid or missing signature (registry: {registry}, org: {org})"
+                )
+
         if violations:
             return ValidationResult.deny("; ".join(violations))
         else:
             return ValidationResult.allow()
 
-    def _parse_image_reference(self, image: str) -> tuple[str, str, str, str]:
-        """
-        Parse image reference into (registry, organization, repository, tag/digest).
-        
-        Examples:
-            nginx:latest -> (docker.io, library, nginx, latest)
-            parachutes/chutes-agent:k3s -> (docker.io, parachutes, chutes-agent, k3s)
-            gcr.io/distroless/base:latest -> (gcr.io, distroless, base, latest)
-            gcr.io/my-project/subdir/app:v1 -> (gcr.io, my-project, subdir/app, v1)
-            registry.k8s.io/pause:3.9 -> (registry.k8s.io, library, pause, 3.9)
-        """
-        original_image = image
-        
-        # Handle digest vs tag
-        if "@" in image:
-            image, digest = image.split("@", 1)
-            tag_or_digest = f"@{digest}"
-        elif ":" in image.split("/")[-1]:  # Only check last component for tag
-            image, tag = image.rsplit(":", 1)
-            tag_or_digest = tag
-        else:
-            tag_or_digest = "latest"
-        
-        # No slashes = official Docker Hub image (nginx, alpine, etc.)
-        if "/" not in image:
-            return ("docker.io", "library", image, tag_or_digest)
-        
-        parts = image.split("/")
-        first_part = parts[0]
-        
-        # Check if first part is a registry (contains . or :)
-        if "." in first_part or ":" in first_part:
-            # Has explicit registry
-            registry = first_part
-            remaining = parts[1:]
-            
-            if len(remaining) == 0:
-                raise ValueError(f"Invalid image reference: {original_image}")
-            elif len(remaining) == 1:
-                # registry.io/image -> assume "library" org
-                org = "library"
-                repo = remaining[0]
-            else:
-                # registry.io/org/repo or registry.io/org/subdir/repo
-                org = remaining[0]
-                repo = "/".join(remaining[1:])
-        else:
-            # No explicit registry, assume Docker Hub
-            registry = "docker.io"
-            
-            if len(parts) == 1:
-                # Should have been caught by "/" check, but just in case
-                org = "library"
-                repo = parts[0]
-            else:
-                # user/repo or user/subdir/repo
-                org = parts[0]
-                repo = "/".join(parts[1:])
-        
-        return (registry, org, repo, tag_or_digest)
+    def _open_shared_cache(self) -> Optional[SharedVerificationCache]:
+        """Node-wide verdict cache, if configured; verdicts stay in memory only when it cannot be opened."""
+        path = self.cosign_config.shared_cache_path
+        if not path:
+            return None
+        try:
+            return SharedVerificationCache(path, self.cosign_config.shared_cache_slots)
+        except (OSError, ValueError) as e:
+            logger.warning(f"Shared cosign cache at {path} unavailable, caching in memory only: {e}")
+            return None
+
+    def _record_cache_lookup(self, result: str) -> None:
+        if self.metrics is not None:
+            self.metrics.record_cosign_cache_lookup(result)
+
+    def _image_policy(self) -> ImagePolicy:
+        """Policy over the current cosign rules; rebuilt when the rules are recompiled."""
+        rules = self.cosign_config.compiled_rules()
+        if self._policy is None or self._policy.cosign_rules is not rules:
+            self._policy = ImagePolicy(self.config.allowed_registries, rules)
+        return self._policy
 
     async def _verify_image_signature(
         self, image: str, verification_config: CosignVerificationConfig
@@ -189,42 +183,79 @@ class CosignValidator(ValidatorBase):
         """Verify image signature using cosign based on verification configuration."""
         logger.debug(f"Verifying image signature for {image=}")
 
-        if self._rate_limit_until and time.time() < self._rate_limit_until:
-            raise RateLimitError(
-                f"Cosign verification paused due to upstream rate limiting; retry after "
-                f"{time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(self._rate_limit_until))}"
-            )
+        self._check_rate_limit()
 
-        resolved_image = await self._resolve_image_reference(image)
+        resolved_image = await self._resolve_image_reference(image, verification_config)
         cache_key = self._make_cache_key(resolved_image, verification_config)
 
         if cache_key in self._result_cache:
             logger.debug(f"Cosign cache hit (positive) for {resolved_image}")
+            self._record_cache_lookup("memory")
             return True
         if cache_key in self._negative_cache:
             logger.debug(f"Cosign cache hit (negative) for {resolved_image}")
+            self._record_cache_lookup("memory")
             return False
-
-        try:
-            if verification_config.verification_method == "key":
-                valid = await self._verify_with_key(resolved_image, verification_config)
-            elif verification_config.verification_method == "keyless":
-                valid = await self._verify_keyless(resolved_image, verification_config)
-            else:
-                logger.error(f"Unknown verification method: {verification_config.verification_method}")
+        if self._shared_cache is not None:
+            shared = self._shared_cache.get(cache_key)
+            if shared is not None:
+                logger.debug(f"Cosign shared cache hit ({'positive' if shared else 'negative'}) for {resolved_image}")
+                self._record_cache_lookup("shared")
+                return shared
+
+        # Concurrent admissions needing the same verification wait for the one in flight
+        task = self._inflight.get(cache_key)
+        if task is not None:
+            logger.debug(f"Joining in-flight cosign verification for {resolved_image}")
+            self._record_cache_lookup("inflight")
+        else:
+            self._record_cache_lookup("miss")
+            task = asyncio.ensure_future(self._verify_and_cache(resolved_image, cache_key, verification_config))
+            self._inflight[cache_key] = task
+            task.add_done_callback(lambda done: self._verification_done(cache_key, done))
+        # A cancelled admission leaves the verification running for the others
+        return await asyncio.shield(task)
+
+    def _verification_done(self, cache_key: tuple, task: asyncio.Future) -> None:
+        self._inflight.pop(cache_key, None)
+        if not task.cancelled():
+            task.exception()  # retrieved here in case every waiter was cancelled
+
+    async def _verify_and_cache(
+        self, resolved_image: str, cache_key: tuple, verification_config: CosignVerificationConfig
+    ) -> bool:
+        """Verify against the registry (bounded by the global semaphore) and cache the verdict."""
+        async with self._verify_semaphore:
+            # Another verification may have hit a rate limit while this one waited
+            self._check_rate_limit()
+            if self.metrics is not None:
+                self.metrics.record_cosign_verification()
+            try:
+                if verification_config.verification_method == "key":
+                    valid = await self._verify_with_key(resolved_image, verification_config)
+                elif verification_config.verification_method == "keyless":
+                    valid = await self._verify_keyless(resolved_image, verification_config)
+                else:
+                    logger.error(f"Unknown verification method: {verification_config.verification_method}")
+                    valid = False
+            except RateLimitError:
+                # propagate so caller can stop hammering upstream
+                raise
+            except Exception as e:
+                logger.error(f"Exception during cosign verification: {e}")
                 valid = False
-        except RateLimitError:
-            # propagate so caller can stop hammering upstream
-            raise
-        except Exception as e:
-            logger.error(f"Exception during cosign verification: {e}")
-            valid = False
 
         # Cache result (success in main cache; failure in short negative cache)
         if valid:
             self._result_cache[cache_key] = True
         else:
             self._negative_cache[cache_key] = False
+        if self._shared_cache is not None:
+            ttl = self.cosign_config.cache_ttl if valid else self.cosign_config.negative_cache_ttl
+            try:
+                self._shared_cache.set(cache_key, valid, ttl)
+            except OSError as e:
+                logger.warning(f"Could not store cosign verdict in shared cache: {e}")
 
         return valid
 
@@ -233,6 +264,18 @@ class CosignValidator(ValidatorBase):
         valid = False
         if not verification_config.public_key or not verification_config.public_key.exists():
             logger.error(f"Public key not found: {verification_config.public_key}")
+        elif self._can_verify_natively(verification_config):
+            try:
+                valid = await self._key_verifier.verify(
+                    image,
+                    verification_config.public_key,
+                    allow_http=verification_config.allow_http,
+                    allow_insecure=verification_config.allow_insecure,
+                    ignore_tlog=verification_config.ignore_tlog,
+                )
+            except RegistryRateLimited as e:
+                self._record_rate_limit(e.retry_after)
+                raise RateLimitError(self._rate_limit_message()) from e
         else:
             try:
                 cmd = [
@@ -248,7 +291,9 @@ class CosignValidator(ValidatorBase):
                 if verification_config.allow_insecure:
                     cmd.append("--allow-insecure-registry")
 
-                if verification_config.rekor_url:
+                if verification_config.ignore_tlog:
+                    cmd.append("--insecure-ignore-tlog")
+                elif verification_config.rekor_url:
                     cmd.extend(["--rekor-url", verification_config.rekor_url])
 
                 cmd.append(image)
@@ -274,6 +319,18 @@ class CosignValidator(ValidatorBase):
 
         return valid
 
+    def _can_verify_natively(self, verification_config: CosignVerificationConfig) -> bool:
+        """Whether the in-process verifier checks everything `cosign verify --key` would for this policy."""
+        if not self.cosign_config.native_key_verification:
+            return False
+        if verification_config.ignore_tlog:
+            return True
+        # The tlog entry is checked offline, against the key of the one Rekor log we know
+        return (
+            self.cosign_config.rekor_public_key is not None
+            and verification_config.rekor_url == self.cosign_config.cosign_rekor_url
+        )
+
     async def _verify_keyless(self, image: str, verification_config: CosignVerificationConfig) -> bool:
         """Verify image signature using keyless verification (OIDC)."""
         if not verification_config.keyless_identity_regex or not verification_config.keyless_issuer:
@@ -318,39 +375,36 @@ class CosignValidator(ValidatorBase):
             logger.error(f"Exception during keyless verification: {e}")
             return False
 
-    async def _resolve_image_reference(self, image: str) -> str:
+    async def _resolve_image_reference(
+        self, image: str, verification_config: Optional[CosignVerificationConfig] = None
+    ) -> str:
         """Resolve image tag to digest if necessary."""
+        reference = parse_image_reference(image)
         # If image already has digest, return as-is
-        if "@" in image:
+        if reference.digest:
             return image
 
-        try:
-            # Use docker inspect to resolve tag to digest
-            process = await asyncio.create_subprocess_exec(
-                "docker",
-                "inspect",
-                "--format={{index .RepoDigests 0}}",
-                image,
-                stdout=asyncio.subprocess.PIPE,
-                stderr=asyncio.subprocess.PIPE,
-            )
-
-            stdout, stderr = await process.communicate()
-
-            if process.returncode == 0:
-                digest_ref = stdout.decode().strip()
-                if digest_ref and digest_ref != "<no value>":
-                    logger.debug(f"Resolved {image} to {digest_ref}")
-                    return digest_ref
-
-            # If resolution fails, return original image reference
-            # This allows cosign to handle the resolution
-            logger.debug(f"Could not resolve {image} to digest, using original reference")
-            return image
-
-        except Exception as e:
-            logger.debug(f"Could not resolve image reference {image}: {e}")
-            return image
+        key = (reference.registry, api_repository(reference), reference.tag_or_digest)
+        digest = self._digest_cache.get(key)
+        if digest is None:
+            try:
+                digest = await self._registry_client.resolve_digest(
+                    *key,
+                    allow_http=bool(verification_config and verification_config.allow_http),
+                    insecure=bool(verification_config and verification_config.allow_insecure),
+                )
+            except RegistryRateLimited as e:
+                self._record_rate_limit(e.retry_after)
+                raise RateLimitError(self._rate_limit_message()) from e
+            except RegistryError as e:
+                # Leave the tag for the verifier to resolve (and report) itself
+                logger.debug(f"Could not resolve {image} to digest, using original reference: {e}")
+                return image
+            self._digest_cache[key] = digest
+
+        digest_ref = f"{reference.domain}/{reference.path}@{digest}"
+        logger.debug(f"Resolved {image} to {digest_ref}")
+        return digest_ref
 
     async def _run_cosign(self, cmd: list[str]) -> Tuple[bool, str, str, bool]:
         """Run cosign command and detect rate limiting."""
@@ -369,9 +423,18 @@ class CosignValidator(ValidatorBase):
         combined = f"{stdout}\n{stderr}"
         return any(p.search(combined) for p in self._rate_limit_patterns)
 
-    def _record_rate_limit(self):
-        """Back off for a configured period after a rate-limit signal."""
-        self._rate_limit_until = time.time() + self.cosign_config.rate_limit_backoff_seconds
+    def _check_rate_limit(self) -> None:
+        """Raise RateLimitError while a rate-limit backoff is in effect."""
+        if self._rate_limit_until and time.time() < self._rate_limit_until:
+            raise RateLimitError(
+                f"Cosign verification paused due to upstream rate limiting; retry after "
+                f"{time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(self._rate_limit_until))}"
+            )
+
+    def _record_rate_limit(self, retry_after: Optional[float] = None):
+        """Back off after a rate-limit signal, for the registry's Retry-After when it gave one."""
+        backoff = retry_after if retry_after is not None else self.cosign_config.rate_limit_backoff_seconds
+        self._rate_limit_until = time.time() + backoff
 
     def _rate_limit_message(self) -> str:
         """Human-friendly rate limit message."""
@@ -385,14 +448,26 @@ class CosignValidator(ValidatorBase):
     def _make_cache_key(
         self, resolved_image: str, verification_config: CosignVerificationConfig
     ) -> tuple:
-        """Create a cache key that accounts for image digest and verification config."""
+        """Create a cache key that accounts for image digest and verification config.
+
+        Keys are identified by their contents, so verdicts (including those kept in
+        the shared cache across restarts) are not reused once a key is rotated in
+        place, nor across a switch between in-process and CLI verification.
+        """
+        mode = ("cli", None)
+        if verification_config.verification_method == "key" and self._can_verify_natively(verification_config):
+            rekor_key = None if verification_config.ignore_tlog else self.cosign_config.rekor_public_key
+            mode = ("native", key_fingerprint(rekor_key))
         return (
             resolved_image,
             verification_config.verification_method,
             str(verification_config.public_key) if verification_config.public_key else None,
+            key_fingerprint(verification_config.public_key),
+            mode,
             verification_config.keyless_identity_regex,
             verification_config.keyless_issuer,
             verification_config.rekor_url,
+            verification_config.ignore_tlog,
             verification_config.fulcio_url,
             verification_config.allow_http,
             verification_config.allow_insecure,
@@ -1,6 +1,8 @@
 import logging
 from typing import Dict
 
+from sek8s.config import AdmissionConfig
+from sek8s.image_reference import ImagePolicy, InvalidImageReference, parse_image_reference
 from sek8s.validators.base import ValidatorBase, ValidationResult
 
 
@@ -10,6 +12,10 @@ logger = logging.getLogger(__name__)
 class RegistryValidator(ValidatorBase):
     """Validator that checks container images against registry allowlist."""
 
+    def __init__(self, config: AdmissionConfig):
+        super().__init__(config)
+        self._policy = ImagePolicy(config.allowed_registries)
+
     async def validate(self, admission_review: Dict) -> ValidationResult:
         """Validate that all container images are from allowed registries."""
         request = admission_review.get("request", {})
@@ -46,8 +52,16 @@ class RegistryValidator(ValidatorBase):
         # Check each image
         violations = []
         for image in images:
-            registry = self._extract_registry(image)
-            if not self._is_registry_allowed(registry):
+            if not image:
+                continue
+            try:
+                verdict = self._policy.evaluate(image)
+            except InvalidImageReference as e:
+                violations.append(f"Image {image} is not a valid image reference: {e}")
+                continue
+            if not verdict.registry_allowed:
+                registry = verdict.reference.domain
+                logger.warning(f"Registry {registry} not in {self.config.allowed_registries}")
                 violations.append(f"Image {image} uses disallowed registry {registry}")
 
         if violations:
@@ -70,32 +84,13 @@ class RegistryValidator(ValidatorBase):
         return ValidationResult.allow()
 
     def _extract_registry(self, image: str) -> str:
-        """Extract registry from image name."""
-        # Handle different image formats
-        if "/" not in image:
-            # No slash means Docker Hub official image
-            return "docker.io"
-
-        parts = image.split("/")
-        first_part = parts[0]
-
-        # Check if first part is a registry (contains . or :)
-        if "." in first_part or ":" in first_part or first_part == "localhost":
-            return first_part
-
-        # Otherwise it's Docker Hub
-        return "docker.io"
+        """Extract registry from image name (docker.io when the reference names none)."""
+        return parse_image_reference(image).domain
 
     def _is_registry_allowed(self, registry: str) -> bool:
         """Check if registry is in allowlist."""
-        # Handle wildcards
-        for allowed in self.config.allowed_registries:
-            if allowed.endswith("*"):
-                prefix = allowed[:-1]
-                if registry.startswith(prefix):
-                    return True
-            elif allowed.lower() == registry.lower():
-                return True
+        if self._policy.allowlist.allows(registry):
+            return True
 
         logger.warning(f"Registry {registry} not in {self.config.allowed_registries}")
         return False
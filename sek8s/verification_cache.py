@@ -0,0 +1,152 @@
+"""Cosign verification results in a memory-mapped file shared between processes.
+
+The file is a fixed-size open-addressing hash table. Each slot holds a 128-bit
+hash of the cache key, the wall-clock time the entry expires, the verdict and
+a CRC over those fields. Writers serialize on an fcntl lock over the file;
+readers take no lock and treat a slot whose CRC does not match (a write in
+progress, or one torn by a crash) as empty. The mapping is shared, so entries
+outlive the process that wrote them and are visible to every controller on
+the node.
+
+Verdicts are keyed by the contents of the keys they were reached with, so
+rotating a key file in place invalidates them. To drop every verdict (say, a
+signature was revoked without rotating the key), stop the controllers,
+delete the file, and start them again; a controller still running keeps the
+old table mapped.
+"""
+
+import fcntl
+import hashlib
+import logging
+import mmap
+import os
+import struct
+import time
+import zlib
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Hashable, Optional
+
+logger = logging.getLogger(__name__)
+
+MAGIC = b"SEK8SVC1"
+# magic, slot count, slot size, CRC of the three
+_HEADER = struct.Struct("<8sIII")
+HEADER_SIZE = 64
+# key hash, expires at (epoch seconds), verdict, CRC of the preceding fields
+_SLOT = struct.Struct("<16sdB3xI")
+_SLOT_CRC_SPAN = 25
+# Slots probed for a key before the entry expiring soonest is evicted
+PROBE_LIMIT = 16
+# Bytes cleared per write when a table is laid out afresh
+_ZERO_CHUNK = 1024 * 1024
+
+
+def key_hash(key: Hashable) -> bytes:
+    """Stable 128-bit hash of a cache key (a tuple of strings, bools and None)."""
+    return hashlib.blake2b(repr(key).encode(), digest_size=16).digest()
+
+
+class SharedVerificationCache:
+    """Verdicts with per-entry expiry in a file mapped by every process using it."""
+
+    def __init__(self, path: Path, slots: int = 16384):
+        self.path = Path(path)
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        self._fd = os.open(self.path, os.O_RDWR | os.O_CREAT, 0o600)
+        try:
+            with self._locked():
+                self.slots = self._open_table(slots)
+            self._map = mmap.mmap(self._fd, HEADER_SIZE + self.slots * _SLOT.size)
+        except BaseException:
+            os.close(self._fd)
+            raise
+
+    def _open_table(self, slots: int) -> int:
+        """Adopt the table already in the file, or lay out an empty one."""
+        header = os.pread(self._fd, _HEADER.size, 0)
+        if len(header) == _HEADER.size:
+            magic, existing, slot_size, crc = _HEADER.unpack(header)
+            size = os.fstat(self._fd).st_size
+            if (
+                magic == MAGIC
+                and slot_size == _SLOT.size
+                and crc == zlib.crc32(header[:16])
+                and size >= HEADER_SIZE + existing * _SLOT.size
+            ):
+                if existing != slots:
+                    logger.info(f"Using existing {existing}-slot verification cache at {self.path}")
+                return existing
+            logger.warning(f"Reinitializing unreadable verification cache at {self.path}")
+
+        # Other processes may have this file mapped and read it without the
+        # lock, so it is never shrunk: touching a page past EOF is SIGBUS.
+        # Grow it, clear the slots in place, and only then write the header.
+        size = HEADER_SIZE + slots * _SLOT.size
+        if os.fstat(self._fd).st_size < size:
+            os.ftruncate(self._fd, size)
+        zeros = bytes(min(size - HEADER_SIZE, _ZERO_CHUNK))
+        for offset in range(HEADER_SIZE, size, len(zeros)):
+            os.pwrite(self._fd, zeros[:size - offset], offset)
+        fields = _HEADER.pack(MAGIC, slots, _SLOT.size, 0)[:16]
+        os.pwrite(self._fd, fields + struct.pack("<I", zlib.crc32(fields)), 0)
+        return slots
+
+    @contextmanager
+    def _locked(self):
+        fcntl.lockf(self._fd, fcntl.LOCK_EX)
+        try:
+            yield
+        finally:
+            fcntl.lockf(self._fd, fcntl.LOCK_UN)
+
+    def _read(self, index: int):
+        """(key hash, expires at, verdict) of a slot, or None when it is empty or torn."""
+        offset = HEADER_SIZE + index * _SLOT.size
+        raw = self._map[offset:offset + _SLOT.size]
+        digest, expires_at, verdict, crc = _SLOT.unpack(raw)
+        if crc != zlib.crc32(raw[:_SLOT_CRC_SPAN]):
+            return None
+        return digest, expires_at, verdict
+
+    def _probe(self, digest: bytes):
+        start = int.from_bytes(digest[:8], "little") % self.slots
+        for step in range(min(PROBE_LIMIT, self.slots)):
+            yield (start + step) % self.slots
+
+    def get(self, key: Hashable) -> Optional[bool]:
+        """The cached verdict for key, or None when absent or expired."""
+        digest = key_hash(key)
+        now = time.time()
+        for index in self._probe(digest):
+            entry = self._read(index)
+            if entry is not None and entry[0] == digest:
+                return bool(entry[2]) if entry[1] > now else None
+        return None
+
+    def set(self, key: Hashable, verdict: bool, ttl: float) -> None:
+        digest = key_hash(key)
+        now = time.time()
+        record = _SLOT.pack(digest, now + ttl, 1 if verdict else 0, 0)[:_SLOT_CRC_SPAN]
+        record += b"\0" * (_SLOT.size - 4 - _SLOT_CRC_SPAN) + struct.pack("<I", zlib.crc32(record))
+
+        with self._locked():
+            # The key's own slot, else the first free or expired one, else the one expiring soonest
+            own, free, soonest = None, None, None
+            for index in self._probe(digest):
+                entry = self._read(index)
+                if entry is not None and entry[0] == digest:
+                    own = index
+                    break
+                if entry is None or entry[1] <= now:
+                    if free is None:
+                        free = index
+                elif soonest is None or entry[1] < soonest[1]:
+                    soonest = (index, entry[1])
+            target = own if own is not None else free if free is not None else soonest[0]
+            offset = HEADER_SIZE + target * _SLOT.size
+            self._map[offset:offset + _SLOT.size] = record
+
+    def close(self) -> None:
+        self._map.close()
+        os.close(self._fd)
@@ -0,0 +1,87 @@
+"""
+Admission latency with a pod's images verified one after another or concurrently.
+
+Every pod has an init container, a main container and a sidecar whose signed
+images have not been seen before, so each admission verifies all three against
+a local registry stand-in with added latency. The sequential row runs with one
+verification at a time (the previous loop); the concurrent rows allow up to
+--concurrency. A final burst admits replicas of one deployment at once and
+counts how many registry verifications the in-flight deduplication leaves.
+
+Usage: python tests/benchmarks/admission/bench_concurrent_verification.py [--pods N] [--latency-ms MS] [--concurrency N]
+"""
+
+import argparse
+import asyncio
+import statistics
+import tempfile
+import time
+
+from sek8s.metrics import MetricsCollector
+
+from standins import SignedRegistry, make_validator, pod_review
+
+
+def signed_pod(registry: SignedRegistry, name: str):
+    return [
+        f"{registry.host}/{repo}@{registry.push(repo, 'stable')}"
+        for repo in (f"apps/{name}-init", f"apps/{name}", f"sidecars/{name}-proxy")
+    ]
+
+
+async def sequential_vs_concurrent(registry, args, workdir):
+    for label, limit in (("sequential", 1), (f"concurrent (limit {args.concurrency})", args.concurrency)):
+        validator = make_validator(registry, workdir)
+        validator._verify_semaphore = asyncio.Semaphore(limit)
+        latencies = []
+        for pod in range(args.pods):
+            images = signed_pod(registry, f"{label.split()[0]}-{pod}")
+            t0 = time.perf_counter()
+            result = await validator.validate(pod_review(images))
+            assert result.allowed, result.messages
+            latencies.append((time.perf_counter() - t0) * 1000)
+        await validator._registry_client.close()
+        latencies.sort()
+        print(f"  {label:<24} p50 {statistics.median(latencies):7.2f} ms"
+              f"  p99 {latencies[int(len(latencies) * 0.99) - 1]:7.2f} ms")
+
+
+async def replica_burst(registry, args, workdir):
+    validator = make_validator(registry, workdir)
+    validator.metrics = MetricsCollector()
+    validator._verify_semaphore = asyncio.Semaphore(args.concurrency)
+    images = signed_pod(registry, "burst")
+    requests_before = sum(registry.requests.values())
+    t0 = time.perf_counter()
+    results = await asyncio.gather(*(validator.validate(pod_review(images)) for _ in range(args.replicas)))
+    elapsed = (time.perf_counter() - t0) * 1000
+    await validator._registry_client.close()
+    assert all(result.allowed for result in results)
+    lookups = validator.metrics.cosign_cache_lookups
+    print(f"  {args.replicas} replicas admitted at once: {elapsed:.1f} ms,"
+          f" {validator.metrics.cosign_verifications} verifications for {args.replicas * len(images)} image checks"
+          f" ({lookups['inflight']} joined in flight),"
+          f" {sum(registry.requests.values()) - requests_before} registry requests")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--pods", type=int, default=50)
+    parser.add_argument("--latency-ms", type=float, default=20.0, help="added registry round-trip latency")
+    parser.add_argument("--concurrency", type=int, default=8, help="max_concurrent_verifications")
+    parser.add_argument("--replicas", type=int, default=20, help="pods in the concurrent burst")
+    args = parser.parse_args()
+
+    registry = SignedRegistry(latency_ms=args.latency_ms)
+    await registry.start()
+    try:
+        print(f"{args.pods} pods with 3 unseen signed images each, {args.latency_ms:g} ms registry latency:")
+        with tempfile.TemporaryDirectory() as workdir:
+            await sequential_vs_concurrent(registry, args, workdir)
+            await replica_burst(registry, args, workdir)
+    finally:
+        await registry.stop()
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
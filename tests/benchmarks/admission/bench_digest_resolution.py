@@ -0,0 +1,123 @@
+"""
+Admission latency and cosign cache behaviour for tag-referenced pods.
+
+Admits a stream of pods whose containers reference images by tag, through
+CosignValidator against a local signed-registry stand-in (with added network
+latency), twice:
+
+  docker inspect   the previous resolver: spawn `docker inspect` per image. On a
+                   k3s node there is no dockerd, so it fails (a stand-in `docker`
+                   reproduces that) and the result cache is keyed by the tag.
+  registry HEAD    the pooled registry HEAD resolver with its TTL cache, so the
+                   result cache is keyed by digest.
+
+Images are retagged during the run; with digest keys a moved tag is verified
+again once its cached digest expires, with tag keys the old verdict is reused.
+
+Usage: python tests/benchmarks/admission/bench_digest_resolution.py [--pods N] [--images N] [--latency-ms MS]
+"""
+
+import argparse
+import asyncio
+import os
+import random
+import statistics
+import tempfile
+import time
+
+from cachetools import TTLCache
+
+from standins import SignedRegistry, containerd_node_path, make_validator, pod_review
+
+
+async def docker_inspect_resolve(image: str, verification_config=None) -> str:
+    """The resolver CosignValidator used before: `docker inspect`, falling back to the tag."""
+    try:
+        process = await asyncio.create_subprocess_exec(
+            "docker", "inspect", "--format={{index .RepoDigests 0}}", image,
+            stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.PIPE,
+        )
+        stdout, _ = await process.communicate()
+        if process.returncode == 0:
+            digest_ref = stdout.decode().strip()
+            if digest_ref and digest_ref != "<no value>":
+                return digest_ref
+        return image
+    except Exception:
+        return image
+
+
+async def run(label, registry, args, workdir, legacy: bool):
+    rng = random.Random(7)
+    repositories = [f"team-{i % 10}/svc-{i}" for i in range(args.images)]
+    for repository in repositories:
+        registry.push(repository, "stable")
+
+    validator = make_validator(registry, workdir)
+    validator._digest_cache = TTLCache(maxsize=1024, ttl=args.digest_ttl)
+    if legacy:
+        validator._resolve_image_reference = docker_inspect_resolve
+
+    verifications = 0
+    verify_with_key = validator._verify_with_key
+
+    async def counting_verify(image, config):
+        nonlocal verifications
+        verifications += 1
+        return await verify_with_key(image, config)
+
+    validator._verify_with_key = counting_verify
+    registry.requests = {"HEAD": 0, "GET": 0}
+
+    latencies, denied, build = [], 0, 0
+    started = time.perf_counter()
+    for pod in range(args.pods):
+        if pod and pod % args.retag_every == 0:
+            build += 1
+            registry.push(rng.choice(repositories), "stable", build)
+        images = [f"{registry.host}/{repo}:stable" for repo in rng.sample(repositories, args.containers)]
+        t0 = time.perf_counter()
+        result = await validator.validate(pod_review(images))
+        latencies.append((time.perf_counter() - t0) * 1000)
+        denied += not result.allowed
+        if args.pod_interval_ms:
+            await asyncio.sleep(args.pod_interval_ms / 1000)
+    elapsed = time.perf_counter() - started
+    await validator._registry_client.close()
+
+    checks = args.pods * args.containers
+    latencies.sort()
+    print(
+        f"  {label:<16} p50 {statistics.median(latencies):6.2f} ms  p99 {latencies[int(len(latencies) * 0.99) - 1]:6.2f} ms"
+        f"  cache hits {100 * (checks - verifications) / checks:5.1f}%  verifications {verifications:4d}"
+        f"  registry HEAD/GET {registry.requests.get('HEAD', 0)}/{registry.requests.get('GET', 0)}"
+        f"  denied {denied}  ({elapsed:.1f} s, {build} retags)"
+    )
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--pods", type=int, default=500)
+    parser.add_argument("--images", type=int, default=40, help="distinct tag-referenced images")
+    parser.add_argument("--containers", type=int, default=2, help="containers per pod")
+    parser.add_argument("--latency-ms", type=float, default=20.0, help="added registry round-trip latency")
+    parser.add_argument("--retag-every", type=int, default=100, help="pods between retags of one image")
+    parser.add_argument("--digest-ttl", type=float, default=2.0, help="resolved-digest cache TTL (s)")
+    parser.add_argument("--pod-interval-ms", type=float, default=5.0, help="pause between admissions")
+    args = parser.parse_args()
+
+    os.environ["PATH"] = f"{containerd_node_path()}:{os.environ['PATH']}"
+    print(f"{args.pods} pods x {args.containers} tag-referenced containers over {args.images} images, "
+          f"{args.latency_ms:g} ms registry latency, digest TTL {args.digest_ttl:g} s:")
+    with tempfile.TemporaryDirectory() as workdir:
+        for label, legacy in (("docker inspect", True), ("registry HEAD", False)):
+            registry = SignedRegistry(latency_ms=args.latency_ms)
+            await registry.start()
+            try:
+                await run(label, registry, args, workdir, legacy)
+            finally:
+                await registry.stop()
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,251 @@
+"""
+Image-reference parsing and registry/cosign rule matching for admission.
+
+Builds realistic multi-container pod specs (app containers, init containers
+and sidecars from several registries, tags and digests) and a cosign
+configuration with registry, organization and repository rules, then times
+the per-request work the registry and cosign validators do for every image:
+the previous string splitting plus linear rule search, against the memoised
+grammar parser and the compiled tries. Both must pick the same rule for every
+image before anything is timed.
+
+Usage: python tests/benchmarks/admission/bench_image_policy.py [--pods N] [--rules N] [--rounds N]
+"""
+
+import argparse
+import fnmatch
+import hashlib
+import random
+import time
+
+from sek8s.config import CosignConfig, CosignRegistryConfig
+from sek8s.image_reference import ImagePolicy, parse_image_reference
+
+ALLOWED_REGISTRIES = ["docker.io", "gcr.io", "quay.io", "ghcr.io", "registry.k8s.io", "localhost:30500", "*.ecr.aws"]
+
+
+# --- Previous implementation, kept as the baseline ---------------------------------------------
+
+def legacy_extract_registry(image):
+    if "/" not in image:
+        return "docker.io"
+    first_part = image.split("/")[0]
+    if "." in first_part or ":" in first_part or first_part == "localhost":
+        return first_part
+    return "docker.io"
+
+
+def legacy_registry_allowed(registry, allowed_registries):
+    for allowed in allowed_registries:
+        if allowed.endswith("*"):
+            if registry.startswith(allowed[:-1]):
+                return True
+        elif allowed.lower() == registry.lower():
+            return True
+    return False
+
+
+def legacy_parse_image_reference(image):
+    if "@" in image:
+        image, digest = image.split("@", 1)
+        tag_or_digest = f"@{digest}"
+    elif ":" in image.split("/")[-1]:
+        image, tag_or_digest = image.rsplit(":", 1)
+    else:
+        tag_or_digest = "latest"
+    if "/" not in image:
+        return ("docker.io", "library", image, tag_or_digest)
+    parts = image.split("/")
+    if "." in parts[0] or ":" in parts[0]:
+        remaining = parts[1:]
+        if len(remaining) == 1:
+            return (parts[0], "library", remaining[0], tag_or_digest)
+        return (parts[0], remaining[0], "/".join(remaining[1:]), tag_or_digest)
+    return ("docker.io", parts[0], "/".join(parts[1:]), tag_or_digest)
+
+
+def legacy_normalize(registry):
+    if registry in ["docker.io", "registry-1.docker.io", "index.docker.io"]:
+        return "docker.io"
+    return registry.lower()
+
+
+def legacy_matches_registry_pattern(registry, pattern):
+    if pattern == "*":
+        return True
+    registry, pattern = registry.lower(), pattern.lower()
+    if "*" in pattern:
+        if pattern.endswith("/*"):
+            prefix = pattern[:-2]
+            return registry.startswith(prefix + "/") or registry == prefix
+        elif pattern.endswith("*"):
+            return registry.startswith(pattern[:-1])
+        elif pattern.startswith("*"):
+            return registry.endswith(pattern[1:])
+    return registry == pattern
+
+
+def legacy_matches_pattern(value, pattern):
+    if pattern == "*":
+        return True
+    value, pattern = value.lower(), pattern.lower()
+    if "*" not in pattern:
+        return value == pattern
+    if pattern.endswith("/*"):
+        prefix = pattern[:-2]
+        return value.startswith(prefix + "/") or value == prefix
+    if pattern.startswith("*/"):
+        suffix = pattern[2:]
+        return value.endswith("/" + suffix) or value == suffix
+    return fnmatch.fnmatch(value, pattern)
+
+
+def legacy_get_verification_config(registry_configs, registry, organization, repository):
+    registry = legacy_normalize(registry)
+    registry_config = wildcard_config = None
+    for config in registry_configs:
+        if config.registry == registry:
+            registry_config = config
+            break
+        elif config.registry == "*":
+            wildcard_config = config
+        elif legacy_matches_registry_pattern(registry, config.registry):
+            registry_config = config
+            break
+    registry_config = registry_config or wildcard_config
+    if not registry_config:
+        return None
+    verification_config = registry_config
+    if registry_config.organizations:
+        org_config = registry_config.organizations.get(organization)
+        if org_config is None:
+            for pattern, config in registry_config.organizations.items():
+                if legacy_matches_pattern(organization, pattern):
+                    org_config = config
+                    break
+        if org_config:
+            verification_config = org_config
+            if org_config.repositories:
+                repo_config = org_config.repositories.get(repository)
+                if repo_config is None:
+                    for pattern, config in org_config.repositories.items():
+                        if legacy_matches_pattern(repository, pattern):
+                            repo_config = config
+                            break
+                if repo_config:
+                    verification_config = repo_config
+    return verification_config
+
+
+def legacy_evaluate(image, registry_configs):
+    allowed = legacy_registry_allowed(legacy_extract_registry(image), ALLOWED_REGISTRIES)
+    registry, org, repo, _ = legacy_parse_image_reference(image)
+    return allowed, legacy_get_verification_config(registry_configs, registry, org, repo)
+
+
+# --- Workload -----------------------------------------------------------------------------------
+
+def build_registry_configs(rules: int, rng: random.Random):
+    """Registry rules with org and repo overrides, most of them for unrelated orgs."""
+    method = lambda: rng.choice(["key", "keyless", "disabled"])  # noqa: E731
+    configs = []
+    for registry in ["docker.io", "ghcr.io", "gcr.io", "quay.io", "*.ecr.aws", "registry.k8s.io"]:
+        organizations = {}
+        for index in range(rules):
+            org = f"team-{index}"
+            organizations[org] = {
+                "organization": org,
+                "verification_method": method(),
+                "repositories": {
+                    f"svc-{r}": {"repository": f"svc-{r}", "verification_method": method()} for r in range(5)
+                },
+            }
+        organizations["parachutes"] = {
+            "organization": "parachutes",
+            "verification_method": "key",
+            "repositories": {
+                "chutes-*": {"repository": "chutes-*", "verification_method": "keyless"},
+                "agent": {"repository": "agent", "verification_method": "disabled"},
+            },
+        }
+        organizations["vendor-*"] = {"organization": "vendor-*", "verification_method": method()}
+        configs.append(CosignRegistryConfig(registry=registry, verification_method=method(), organizations=organizations))
+    configs.append(CosignRegistryConfig(registry="*", verification_method="key"))
+    return configs
+
+
+def build_fleet(images: int, rules: int, rng: random.Random):
+    """Distinct images a cluster runs: workloads across registries, tagged or pinned by digest."""
+    repos = [f"team-{i}/svc-{r}" for i in range(rules) for r in range(5)]
+    repos += ["parachutes/chutes-agent", "parachutes/agent", "parachutes/chutes-api", "vendor-x/tool", "library/redis"]
+    registries = ["", "docker.io/", "ghcr.io/", "gcr.io/", "quay.io/", "123456789012.dkr.ecr.aws/", "localhost:30500/"]
+    fleet = set()
+    while len(fleet) < images:
+        ref = rng.choice(registries) + rng.choice(repos)
+        version = f"v{rng.randint(1, 40)}"
+        if rng.random() < 0.3:
+            ref += "@sha256:" + hashlib.sha256(f"{ref}:{version}".encode()).hexdigest()
+        else:
+            ref += f":{version}"
+        fleet.add(ref)
+    return sorted(fleet)
+
+
+def build_pods(pods: int, fleet, rng: random.Random):
+    """Pod specs drawn from the fleet: 1-4 app/init containers plus common sidecars."""
+    sidecars = ["nginx:1.25", "registry.k8s.io/pause:3.9", "busybox", "envoyproxy/envoy:v1.29.1"]
+    return [
+        rng.sample(fleet, rng.randint(1, 4)) + rng.sample(sidecars, rng.randint(0, 2))
+        for _ in range(pods)
+    ]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--pods", type=int, default=2000)
+    parser.add_argument("--images", type=int, default=1000, help="distinct images in the cluster")
+    parser.add_argument("--rules", type=int, default=50, help="organizations per registry")
+    parser.add_argument("--rounds", type=int, default=5, help="times each pod spec is admitted")
+    args = parser.parse_args()
+
+    rng = random.Random(1)
+    cosign_config = CosignConfig()
+    cosign_config.registry_configs = build_registry_configs(args.rules, rng)
+    registry_configs = cosign_config.registry_configs
+    rules = cosign_config.compiled_rules()
+    fleet = build_fleet(args.images, args.rules, rng)
+    pods = build_pods(args.pods, fleet, rng)
+    images = [image for pod in pods for image in pod]
+    distinct = sorted(set(images))
+
+    policy = ImagePolicy(ALLOWED_REGISTRIES, rules)
+    for image in distinct:
+        verdict = policy.evaluate(image)
+        assert (verdict.registry_allowed, verdict.verification_config) == legacy_evaluate(image, registry_configs), image
+    print(f"Verdicts match for {len(distinct)} distinct images "
+          f"({len(registry_configs)} registry rules, {args.rules} orgs each)")
+
+    def timed(label, corpus, rounds, evaluate):
+        start = time.perf_counter()
+        for _ in range(rounds):
+            for image in corpus:
+                evaluate(image)
+        elapsed = time.perf_counter() - start
+        print(f"  {label:<28} {elapsed * 1000:8.1f} ms  {elapsed / (rounds * len(corpus)) * 1e6:6.2f} us/image")
+        return elapsed
+
+    print(f"First sight of each of {len(distinct)} distinct images:")
+    legacy = timed("split + linear search", distinct, 1, lambda image: legacy_evaluate(image, registry_configs))
+    parse_image_reference.cache_clear()
+    cold = timed("parse + tries", distinct, 1, ImagePolicy(ALLOWED_REGISTRIES, rules).evaluate)
+    print(f"  speedup: {legacy / cold:.1f}x")
+
+    print(f"{args.rounds} rounds x {len(pods)} pods ({len(images)} images per round):")
+    legacy = timed("split + linear search", images, args.rounds, lambda image: legacy_evaluate(image, registry_configs))
+    parse_image_reference.cache_clear()
+    warm = timed("parse + tries, memoised", images, args.rounds, ImagePolicy(ALLOWED_REGISTRIES, rules).evaluate)
+    print(f"  speedup: {legacy / warm:.1f}x")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,93 @@
+"""
+Registry verification load after an admission-controller restart.
+
+A controller admits a stream of pods (digest-pinned images, signed, served by
+a local registry stand-in with added latency) until its cache is warm, then
+is replaced by a fresh one, as on a restart or redeploy, which admits the same
+stream again. With verdicts cached in memory only, the restarted controller
+verifies every image again; with the shared verification cache it answers
+from the table the previous process left behind.
+
+Usage: python tests/benchmarks/admission/bench_restart_load.py [--pods N] [--images N] [--latency-ms MS]
+"""
+
+import argparse
+import asyncio
+import os
+import random
+import statistics
+import tempfile
+import time
+
+from sek8s.metrics import MetricsCollector
+
+from standins import SignedRegistry, make_validator, pod_review
+
+
+async def admit(validator, pods):
+    latencies = []
+    for images in pods:
+        t0 = time.perf_counter()
+        result = await validator.validate(pod_review(images))
+        assert result.allowed, result.messages
+        latencies.append((time.perf_counter() - t0) * 1000)
+    return latencies
+
+
+async def run(label, registry, pods, workdir, shared_path):
+    if shared_path:
+        os.environ["SHARED_CACHE_PATH"] = shared_path
+    else:
+        os.environ.pop("SHARED_CACHE_PATH", None)
+
+    warm = make_validator(registry, workdir)
+    await admit(warm, pods)
+    await warm._registry_client.close()
+
+    # The restarted process: new caches, new metrics
+    metrics = MetricsCollector()
+    restarted = make_validator(registry, workdir)
+    restarted.metrics = metrics
+    requests_before = sum(registry.requests.values())
+    started = time.perf_counter()
+    latencies = sorted(await admit(restarted, pods))
+    elapsed = time.perf_counter() - started
+    await restarted._registry_client.close()
+
+    print(
+        f"  {label:<22} startup verifications {metrics.cosign_startup_verifications:4d}"
+        f"  registry requests {sum(registry.requests.values()) - requests_before:5d}"
+        f"  hit ratio {metrics.cosign_cache_hit_ratio():6.1%}"
+        f"  p50 {statistics.median(latencies):6.2f} ms  p99 {latencies[int(len(latencies) * 0.99) - 1]:7.2f} ms"
+        f"  ({elapsed:.2f} s)"
+    )
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--pods", type=int, default=300)
+    parser.add_argument("--images", type=int, default=100, help="distinct signed images")
+    parser.add_argument("--containers", type=int, default=3, help="containers per pod")
+    parser.add_argument("--latency-ms", type=float, default=20.0, help="added registry round-trip latency")
+    args = parser.parse_args()
+
+    registry = SignedRegistry(latency_ms=args.latency_ms)
+    await registry.start()
+    rng = random.Random(3)
+    try:
+        images = [
+            f"{registry.host}/team-{i % 10}/svc-{i}@{registry.push(f'team-{i % 10}/svc-{i}', 'stable')}"
+            for i in range(args.images)
+        ]
+        pods = [rng.sample(images, args.containers) for _ in range(args.pods)]
+        print(f"Restart with {args.images} distinct images, {args.pods} pods x {args.containers} containers, "
+              f"{args.latency_ms:g} ms registry latency:")
+        with tempfile.TemporaryDirectory() as workdir:
+            await run("memory-only cache", registry, pods, workdir, None)
+            await run("shared mmap cache", registry, pods, workdir, os.path.join(workdir, "cosign-cache.bin"))
+    finally:
+        await registry.stop()
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,181 @@
+"""
+Local stand-ins for the admission benchmarks: an OCI registry serving
+cosign-signed images, and a CosignValidator configured to verify against it.
+"""
+
+import asyncio
+import base64
+import hashlib
+import json
+import os
+import tempfile
+from pathlib import Path
+
+from aiohttp import web
+from cryptography.hazmat.primitives import hashes, serialization
+from cryptography.hazmat.primitives.asymmetric import ec
+
+from sek8s.config import AdmissionConfig, CosignRegistryConfig
+from sek8s.cosign_verifier import (
+    BUNDLE_ANNOTATION,
+    SIGNATURE_ANNOTATION,
+    SIMPLE_SIGNING_MEDIA_TYPE,
+    KeySignatureVerifier,
+    rekor_log_id,
+    signature_tag,
+)
+from sek8s.validators.cosign import CosignValidator
+
+OCI_MANIFEST = "application/vnd.oci.image.manifest.v1+json"
+
+
+def _digest(data: bytes) -> str:
+    return f"sha256:{hashlib.sha256(data).hexdigest()}"
+
+
+class SignedRegistry:
+    """OCI distribution API on localhost serving images signed with one cosign key,
+    each signature with a bundle from a stand-in Rekor log.
+
+    latency_ms is added to every request to stand in for a registry across
+    the network.
+    """
+
+    def __init__(self, latency_ms: float = 0.0):
+        self.latency = latency_ms / 1000
+        self.key = ec.generate_private_key(ec.SECP256R1())
+        self.rekor_key = ec.generate_private_key(ec.SECP256R1())
+        self.manifests = {}
+        self.blobs = {}
+        self.requests = {"HEAD": 0, "GET": 0}
+        app = web.Application()
+        app.router.add_get(r"/v2/{repository:.+}/manifests/{reference}", self._manifest)
+        app.router.add_get(r"/v2/{repository:.+}/blobs/{digest}", self._blob)
+        self._runner = web.AppRunner(app, access_log=None)
+
+    async def start(self) -> None:
+        await self._runner.setup()
+        site = web.TCPSite(self._runner, "127.0.0.1", 0)
+        await site.start()
+        self.host = f"127.0.0.1:{site._server.sockets[0].getsockname()[1]}"
+
+    async def stop(self) -> None:
+        await self._runner.cleanup()
+
+    def public_key_file(self, directory: str, name: str = "cosign.pub", key=None) -> Path:
+        path = Path(directory) / name
+        path.write_bytes(
+            (key or self.key).public_key().public_bytes(
+                serialization.Encoding.PEM, serialization.PublicFormat.SubjectPublicKeyInfo
+            )
+        )
+        return path
+
+    def _bundle(self, signature: bytes, payload: bytes) -> str:
+        body = base64.b64encode(json.dumps({
+            "kind": "hashedrekord",
+            "spec": {
+                "signature": {"content": base64.b64encode(signature).decode()},
+                "data": {"hash": {"algorithm": "sha256", "value": hashlib.sha256(payload).hexdigest()}},
+            },
+        }).encode()).decode()
+        entry = {"body": body, "integratedTime": 1700000000, "logIndex": 1,
+                 "logID": rekor_log_id(self.rekor_key.public_key())}
+        timestamp = self.rekor_key.sign(
+            json.dumps(entry, sort_keys=True, separators=(",", ":")).encode(), ec.ECDSA(hashes.SHA256())
+        )
+        return json.dumps({"SignedEntryTimestamp": base64.b64encode(timestamp).decode(), "Payload": entry})
+
+    def push(self, repository: str, tag: str, build: int = 0) -> str:
+        """Push (or retag) an image and sign it; returns its digest."""
+        manifest = json.dumps(
+            {"schemaVersion": 2, "mediaType": OCI_MANIFEST, "layers": [],
+             "annotations": {"ref": f"{repository}:{tag}", "build": str(build)}}
+        ).encode()
+        digest = _digest(manifest)
+        self.manifests[(repository, tag)] = manifest
+        self.manifests[(repository, digest)] = manifest
+
+        payload = json.dumps({
+            "critical": {
+                "identity": {"docker-reference": f"{self.host}/{repository}"},
+                "image": {"docker-manifest-digest": digest},
+                "type": "cosign container image signature",
+            },
+            "optional": None,
+        }).encode()
+        signature = self.key.sign(payload, ec.ECDSA(hashes.SHA256()))
+        self.blobs[_digest(payload)] = payload
+        layer = {
+            "mediaType": SIMPLE_SIGNING_MEDIA_TYPE,
+            "digest": _digest(payload),
+            "size": len(payload),
+            "annotations": {
+                SIGNATURE_ANNOTATION: base64.b64encode(signature).decode(),
+                BUNDLE_ANNOTATION: self._bundle(signature, payload),
+            },
+        }
+        self.manifests[(repository, signature_tag(digest))] = json.dumps(
+            {"schemaVersion": 2, "mediaType": OCI_MANIFEST, "layers": [layer]}
+        ).encode()
+        return digest
+
+    async def _delay(self, request) -> None:
+        self.requests[request.method] = self.requests.get(request.method, 0) + 1
+        if self.latency:
+            await asyncio.sleep(self.latency)
+
+    async def _manifest(self, request):
+        await self._delay(request)
+        manifest = self.manifests.get((request.match_info["repository"], request.match_info["reference"]))
+        if manifest is None:
+            raise web.HTTPNotFound()
+        return web.Response(body=manifest, content_type=OCI_MANIFEST,
+                            headers={"Docker-Content-Digest": _digest(manifest)})
+
+    async def _blob(self, request):
+        await self._delay(request)
+        blob = self.blobs.get(request.match_info["digest"])
+        if blob is None:
+            raise web.HTTPNotFound()
+        return web.Response(body=blob)
+
+
+def make_validator(registry: SignedRegistry, workdir: str) -> CosignValidator:
+    """CosignValidator requiring key signatures for every image, verified against registry."""
+    validator = CosignValidator(AdmissionConfig(allowed_registries=[registry.host]))
+    rekor_public_key = registry.public_key_file(workdir, "rekor.pub", registry.rekor_key)
+    validator.cosign_config.rekor_public_key = rekor_public_key
+    validator._key_verifier = KeySignatureVerifier(validator._registry_client, rekor_public_key)
+    validator.cosign_config.registry_configs = [
+        CosignRegistryConfig(
+            registry="*",
+            verification_method="key",
+            public_key=registry.public_key_file(workdir),
+            allow_http=True,
+        )
+    ]
+    return validator
+
+
+def pod_review(images) -> dict:
+    return {
+        "request": {
+            "kind": {"kind": "Pod"},
+            "operation": "CREATE",
+            "object": {
+                "metadata": {"name": "bench"},
+                "spec": {"containers": [{"name": f"c{i}", "image": image} for i, image in enumerate(images)]},
+            },
+        }
+    }
+
+
+def containerd_node_path() -> str:
+    """Directory with a `docker` that fails like the CLI does on a node without dockerd."""
+    directory = tempfile.mkdtemp(prefix="bench-docker-")
+    shim = os.path.join(directory, "docker")
+    with open(shim, "w") as f:
+        f.write("#!/bin/sh\necho 'Cannot connect to the Docker daemon at unix:///var/run/docker.sock.' >&2\nexit 1\n")
+    os.chmod(shim, 0o755)
+    return directory
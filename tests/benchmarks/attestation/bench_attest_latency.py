@@ -0,0 +1,104 @@
+"""
+End-to-end latency of the attestation endpoints against local stand-ins.
+
+The mock tdx-quote-generator and stub chutes-nvevidence in ./stubs replace the
+hardware backends, NVML is faked, and requests go through the real FastAPI app
+in-process. Per-component latency comes from the Server-Timing header, so the
+output shows how much of the component sum the concurrent /attest saves.
+
+Usage: python tests/benchmarks/attestation/bench_attest_latency.py [--requests N] [--concurrency C]
+"""
+
+import argparse
+import asyncio
+import statistics
+import sys
+import tempfile
+import time
+
+from standins import setup_backends
+
+
+def parse_server_timing(header: str) -> dict[str, float]:
+    timings = {}
+    for entry in header.split(","):
+        name, _, duration = entry.strip().partition(";dur=")
+        if duration:
+            timings[name] = float(duration)
+    return timings
+
+
+def percentile(values: list[float], pct: float) -> float:
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, max(0, round(pct / 100 * len(ordered)) - 1))
+    return ordered[index]
+
+
+def report(label: str, values: list[float]):
+    print(
+        f"  {label:<18} p50 {percentile(values, 50):8.1f} ms  p95 {percentile(values, 95):8.1f} ms"
+        f"  p99 {percentile(values, 99):8.1f} ms  mean {statistics.mean(values):8.1f} ms"
+    )
+
+
+async def run(path: str, requests: int, concurrency: int):
+    import httpx
+
+    from sek8s.config import AttestationServiceConfig
+    from sek8s.services.attestation import AttestationServer
+
+    config = AttestationServiceConfig(
+        hostname="bench-node", tls_cert_path=None, tls_key_path=None, client_ca_path=None
+    )
+    app = AttestationServer(config).app
+    transport = httpx.ASGITransport(app=app)
+
+    latencies: list[float] = []
+    components: dict[str, list[float]] = {}
+    semaphore = asyncio.Semaphore(concurrency)
+
+    async with httpx.AsyncClient(transport=transport, base_url="http://bench", timeout=60) as client:
+
+        async def one(i: int):
+            async with semaphore:
+                start = time.perf_counter()
+                response = await client.get(path, params={"nonce": f"{i:064x}"})
+                latencies.append((time.perf_counter() - start) * 1000)
+                response.raise_for_status()
+                for name, value in parse_server_timing(response.headers.get("Server-Timing", "")).items():
+                    components.setdefault(name, []).append(value)
+
+        start = time.perf_counter()
+        await asyncio.gather(*(one(i) for i in range(requests)))
+        wall = time.perf_counter() - start
+
+    print(f"{path}: {requests} requests, concurrency {concurrency}, {requests / wall:.2f} req/s")
+    report("end-to-end", latencies)
+    for name, values in components.items():
+        report(name, values)
+    parts = [statistics.mean(v) for name, v in components.items() if name != "total"]
+    if len(parts) > 1:
+        print(f"  component sum      {sum(parts):8.1f} ms  (what a sequential handler would take)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--requests", type=int, default=20)
+    parser.add_argument("--concurrency", type=int, default=1)
+    parser.add_argument("--gpus", type=int, default=8)
+    parser.add_argument("--path", action="append", help="Endpoint(s) to drive (default: /attest)")
+    args = parser.parse_args()
+
+    from loguru import logger
+
+    logger.remove()
+    logger.add(sys.stderr, level="WARNING")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        setup_backends(workdir, args.gpus)
+        for path in args.path or ["/attest"]:
+            asyncio.run(run(path, args.requests, args.concurrency))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,248 @@
+"""
+Load test of the attestation service and attestation proxy together.
+
+Starts the attestation service on a Unix socket, with the stand-ins from
+standins.py for the TDX quote generator, chutes-nvevidence and NVML. The
+proxy's external and internal servers run in a second process in front of
+that socket. The native load generator (loadgen.c) then drives each endpoint
+through every hop:
+
+  service    straight to the Unix socket
+  internal   internal proxy port, no auth
+  external   external proxy port, validator-signed requests
+
+It prints throughput and latency percentiles per hop and endpoint. The signer
+is a throwaway SR25519 key that the proxy is configured to accept as
+validator and miner. Nonces for every second of the run are signed up front,
+so signing does not load the client.
+
+Usage: python tests/benchmarks/attestation/bench_e2e.py [--duration S] [--connections N]
+"""
+
+import argparse
+import json
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+from standins import HERE, REPO_ROOT, setup_backends
+
+LOADGEN = HERE / "loadgen"
+NONCE = "0" * 64
+ENDPOINTS = {
+    "/attest": f"nonce={NONCE}",
+    "/tdx/quote": f"nonce={NONCE}",
+    "/nvtrust/evidence": f"name=bench-node&nonce={NONCE}",
+}
+PURPOSE = "attest"
+
+
+def free_port() -> int:
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def quiet_logs():
+    from loguru import logger
+
+    logger.remove()
+    logger.add(sys.stderr, level="WARNING")
+
+
+def serve_attestation(args):
+    quiet_logs()
+    setup_backends(args.workdir, args.gpus)
+
+    import uvicorn
+
+    from sek8s.config import AttestationServiceConfig
+    from sek8s.services.attestation import AttestationServer
+
+    config = AttestationServiceConfig(
+        hostname="bench-node", tls_cert_path=None, tls_key_path=None, client_ca_path=None
+    )
+    uvicorn.run(AttestationServer(config).app, uds=args.uds, log_level="warning")
+
+
+def serve_proxy(args):
+    import asyncio
+
+    quiet_logs()
+    import sek8s.services.attestation_proxy as proxy
+    from sek8s.config import AttestationProxyConfig
+
+    proxy.SOCKET_PATH = args.uds
+    shared = proxy.SharedProxyResources()
+    external_config = AttestationProxyConfig()
+    external_config.port = args.external_port
+    internal_config = AttestationProxyConfig()
+    internal_config.port = args.internal_port
+    external = proxy.ExternalProxyServer(external_config, shared)
+    internal = proxy.InternalProxyServer(internal_config, shared)
+
+    async def run_both():
+        try:
+            await asyncio.gather(
+                proxy.run_server_async(external, args.external_port, external_config),
+                proxy.run_server_async(internal, args.internal_port, internal_config),
+            )
+        finally:
+            await shared.cleanup()
+
+    asyncio.run(run_both())
+
+
+def sign_nonces(path: Path, seconds: int):
+    """Sign "<hotkey>:<nonce>:attest" for every second of the run; returns the hotkey."""
+    from bittensor_wallet import Keypair
+
+    keypair = Keypair.create_from_seed(os.urandom(32).hex())
+    start = int(time.time()) - 1
+    with open(path, "w") as f:
+        for nonce in range(start, start + seconds):
+            signature = keypair.sign(f"{keypair.ss58_address}:{nonce}:{PURPOSE}")
+            f.write(f"{nonce} {signature.hex()}\n")
+    return keypair.ss58_address
+
+
+def wait_ready(url: str, uds: str | None = None, timeout: float = 30):
+    import httpx
+
+    transport = httpx.HTTPTransport(uds=uds) if uds else None
+    deadline = time.monotonic() + timeout
+    with httpx.Client(transport=transport, timeout=2) as client:
+        while time.monotonic() < deadline:
+            try:
+                if client.get(url).status_code == 200:
+                    return
+            except httpx.HTTPError:
+                pass
+            time.sleep(0.2)
+    raise RuntimeError(f"{url} did not become ready")
+
+
+def run_loadgen(target: list[str], path: str, args, extra: list[str]) -> dict:
+    command = [
+        str(LOADGEN), *target, "--path", path,
+        "--connections", str(args.connections), "--duration", str(args.duration), *extra,
+    ]
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode not in (0, 2) or not result.stdout.strip():
+        raise RuntimeError(f"loadgen failed: {result.stderr.strip()}")
+    return json.loads(result.stdout)
+
+
+def print_row(hop: str, endpoint: str, result: dict):
+    latency = result["latency_ms"]
+    print(
+        f"{hop:<9} {endpoint:<18} {result['rps']:8.2f} {latency['p50']:9.1f} {latency['p90']:9.1f}"
+        f" {latency['p99']:9.1f} {latency['max']:9.1f} {result['ok']:6d} {result['non_2xx']:6d} {result['errors']:6d}"
+    )
+
+
+def run_benchmark(args):
+    if not LOADGEN.exists():
+        subprocess.run(["make", "-C", str(HERE), "loadgen"], check=True, stdout=subprocess.DEVNULL)
+
+    with tempfile.TemporaryDirectory() as workdir:
+        work = Path(workdir)
+        uds = str(work / "attestation.sock")
+        external_port, internal_port = free_port(), free_port()
+        runs = len(ENDPOINTS) * 3
+        hotkey = sign_nonces(work / "signatures", int(runs * (args.duration + 5) + 120))
+
+        env = dict(
+            os.environ,
+            PYTHONPATH=os.pathsep.join(filter(None, [str(REPO_ROOT), os.environ.get("PYTHONPATH")])),
+            MINER_SS58=hotkey,
+            ALLOWED_VALIDATORS=hotkey,
+            MOCK_QUOTE_DELAY=str(args.quote_delay),
+            MOCK_EVIDENCE_DELAY=str(args.evidence_delay),
+        )
+        me = [sys.executable, str(Path(__file__).resolve())]
+        logs = [open(work / name, "w") for name in ("attestation.log", "proxy.log")]
+        children = [
+            subprocess.Popen(
+                me + ["serve-attestation", "--uds", uds, "--workdir", workdir, "--gpus", str(args.gpus)],
+                env=env, stdout=logs[0], stderr=subprocess.STDOUT,
+            )
+        ]
+        try:
+            wait_ready("http://localhost/health", uds=uds)
+            children.append(
+                subprocess.Popen(
+                    me + ["serve-proxy", "--uds", uds, "--external-port", str(external_port),
+                          "--internal-port", str(internal_port)],
+                    env=env, stdout=logs[1], stderr=subprocess.STDOUT,
+                )
+            )
+            wait_ready(f"http://127.0.0.1:{internal_port}/health")
+
+            hops = [
+                ("service", ["--uds", uds], "", []),
+                ("internal", ["--port", str(internal_port)], "/server", []),
+                ("external", ["--port", str(external_port)], "/server",
+                 ["--hotkey", hotkey, "--signatures", str(work / "signatures")]),
+            ]
+            print(
+                f"{args.connections} connections, {args.duration:g}s per run, quote {args.quote_delay:g}s, "
+                f"evidence {args.evidence_delay:g}s, {args.gpus} GPUs"
+            )
+            print(f"{'hop':<9} {'endpoint':<18} {'req/s':>8} {'p50 ms':>9} {'p90 ms':>9} {'p99 ms':>9} "
+                  f"{'max ms':>9} {'ok':>6} {'!2xx':>6} {'err':>6}")
+            for endpoint, query in ENDPOINTS.items():
+                for hop, target, prefix, extra in hops:
+                    path = f"{prefix}{endpoint}?{query}"
+                    print_row(hop, endpoint, run_loadgen(target, path, args, extra))
+        except Exception:
+            for log in logs:
+                log.flush()
+                print(f"--- {log.name}", file=sys.stderr)
+                print(Path(log.name).read_text()[-4000:], file=sys.stderr)
+            raise
+        finally:
+            for child in children:
+                child.terminate()
+            for child in children:
+                child.wait(timeout=10)
+            for log in logs:
+                log.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command")
+
+    bench = parser
+    bench.add_argument("--duration", type=float, default=10)
+    bench.add_argument("--connections", type=int, default=8)
+    bench.add_argument("--gpus", type=int, default=8)
+    bench.add_argument("--quote-delay", type=float, default=0.3)
+    bench.add_argument("--evidence-delay", type=float, default=0.5)
+
+    attestation = sub.add_parser("serve-attestation")
+    attestation.add_argument("--uds", required=True)
+    attestation.add_argument("--workdir", required=True)
+    attestation.add_argument("--gpus", type=int, default=8)
+
+    proxy = sub.add_parser("serve-proxy")
+    proxy.add_argument("--uds", required=True)
+    proxy.add_argument("--external-port", type=int, required=True)
+    proxy.add_argument("--internal-port", type=int, required=True)
+
+    args = parser.parse_args()
+    if args.command == "serve-attestation":
+        serve_attestation(args)
+    elif args.command == "serve-proxy":
+        serve_proxy(args)
+    else:
+        run_benchmark(args)
+
+
+if __name__ == "__main__":
+    main()
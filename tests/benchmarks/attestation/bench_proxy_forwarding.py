@@ -0,0 +1,183 @@
+"""
+Forwarding overhead of the attestation proxy's Unix-socket hop.
+
+A trivial upstream on a Unix socket returns a fixed body of --size bytes, so
+the proxy itself is the only real work. Two proxies sit in front of it on the
+internal (unauthenticated) route and the native load generator drives both:
+
+  buffered   the same server with the previous forwarding path: the whole
+             upstream body read into memory, headers filtered with list scans
+             into dicts and copied into a new Response
+  streaming  the real InternalProxyServer: pooled keep-alive connections to the
+             socket, single-pass header filtering, raw body chunks relayed as
+             they arrive
+
+Usage: python tests/benchmarks/attestation/bench_proxy_forwarding.py [--size BYTES] [--duration S]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+from bench_e2e import LOADGEN, free_port, print_row, quiet_logs, run_loadgen, wait_ready
+from standins import HERE, REPO_ROOT
+
+PATH = "/server/blob"
+
+
+def serve_upstream(args):
+    import uvicorn
+    from fastapi import FastAPI
+    from fastapi.responses import Response
+
+    app = FastAPI()
+    body = os.urandom(args.size // 2).hex().encode()
+
+    @app.get("/health")
+    async def health():
+        return {"status": "ok"}
+
+    @app.get("/blob")
+    async def blob():
+        return Response(content=body, media_type="application/octet-stream")
+
+    uvicorn.run(app, uds=args.uds, log_level="warning")
+
+
+def buffered_server(proxy):
+    """InternalProxyServer with the forwarding path as it was before pooling and streaming."""
+    from fastapi import Request, Response
+    from loguru import logger
+
+    hop_by_hop = [
+        "connection", "upgrade", "proxy-authenticate", "proxy-authorization", "te", "trailers", "transfer-encoding"
+    ]
+
+    class BufferedProxyServer(proxy.InternalProxyServer):
+        async def proxy_to_host_service(self, path: str, request: Request):
+            headers = {name: request.headers.get(name, "") for name in proxy.CLIENT_CERT_HEADERS}
+            for key, value in request.headers.items():
+                if key.lower() not in ["host", "content-length"]:
+                    headers[key] = value
+            headers = {k: v for k, v in headers.items() if k.lower() not in ["host", *hop_by_hop]}
+
+            logger.info(f"Proxying {request.method} http://localhost/{path}")
+            response = await self.shared.unix_client.request(
+                method=request.method, url=f"http://localhost/{path}", headers=headers,
+                content=await request.body(), params=dict(request.query_params), follow_redirects=False,
+            )
+            response_headers = {k: v for k, v in response.headers.items() if k.lower() not in hop_by_hop}
+            return Response(
+                content=response.content, status_code=response.status_code,
+                headers=response_headers, media_type=response.headers.get("content-type"),
+            )
+
+    return BufferedProxyServer
+
+
+def serve_proxy(args):
+    import asyncio
+
+    quiet_logs()
+    import sek8s.services.attestation_proxy as proxy
+    from sek8s.config import AttestationProxyConfig
+
+    proxy.SOCKET_PATH = args.uds
+    shared = proxy.SharedProxyResources()
+    config = AttestationProxyConfig()
+    config.port = args.port
+    server_class = buffered_server(proxy) if args.mode == "buffered" else proxy.InternalProxyServer
+    server = server_class(config, shared)
+
+    async def run():
+        try:
+            await proxy.run_server_async(server, args.port, config)
+        finally:
+            await shared.cleanup()
+
+    asyncio.run(run())
+
+
+def run_benchmark(args):
+    if not LOADGEN.exists():
+        subprocess.run(["make", "-C", str(HERE), "loadgen"], check=True, stdout=subprocess.DEVNULL)
+
+    with tempfile.TemporaryDirectory() as workdir:
+        uds = str(Path(workdir) / "upstream.sock")
+        env = dict(
+            os.environ,
+            PYTHONPATH=os.pathsep.join(filter(None, [str(REPO_ROOT), os.environ.get("PYTHONPATH")])),
+            MINER_SS58=os.environ.get("MINER_SS58", "bench"),
+            ALLOWED_VALIDATORS=os.environ.get("ALLOWED_VALIDATORS", "bench"),
+        )
+        me = [sys.executable, str(Path(__file__).resolve())]
+        log = open(Path(workdir) / "servers.log", "w")
+        children = [
+            subprocess.Popen(
+                me + ["serve-upstream", "--uds", uds, "--size", str(args.size)],
+                env=env, stdout=log, stderr=subprocess.STDOUT,
+            )
+        ]
+        try:
+            wait_ready("http://localhost/health", uds=uds)
+            ports = {}
+            for mode in ("buffered", "streaming"):
+                ports[mode] = free_port()
+                children.append(
+                    subprocess.Popen(
+                        me + ["serve-proxy", "--mode", mode, "--uds", uds, "--port", str(ports[mode])],
+                        env=env, stdout=log, stderr=subprocess.STDOUT,
+                    )
+                )
+                wait_ready(f"http://127.0.0.1:{ports[mode]}/health")
+
+            print(f"{args.connections} connections, {args.duration:g}s per run, {args.size} byte body")
+            print(f"{'proxy':<9} {'endpoint':<18} {'req/s':>8} {'p50 ms':>9} {'p90 ms':>9} {'p99 ms':>9} "
+                  f"{'max ms':>9} {'ok':>6} {'!2xx':>6} {'err':>6}")
+            upstream = run_loadgen(["--uds", uds], "/blob", args, [])
+            print_row("direct", "/blob", upstream)
+            for mode, port in ports.items():
+                print_row(mode, PATH, run_loadgen(["--port", str(port)], PATH, args, []))
+        except Exception:
+            log.flush()
+            print(Path(log.name).read_text()[-4000:], file=sys.stderr)
+            raise
+        finally:
+            for child in children:
+                child.terminate()
+            for child in children:
+                child.wait(timeout=10)
+            log.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command")
+
+    parser.add_argument("--duration", type=float, default=10)
+    parser.add_argument("--connections", type=int, default=16)
+    parser.add_argument("--size", type=int, default=64 * 1024)
+
+    upstream = sub.add_parser("serve-upstream")
+    upstream.add_argument("--uds", required=True)
+    upstream.add_argument("--size", type=int, required=True)
+
+    proxy = sub.add_parser("serve-proxy")
+    proxy.add_argument("--mode", choices=["buffered", "streaming"], required=True)
+    proxy.add_argument("--uds", required=True)
+    proxy.add_argument("--port", type=int, required=True)
+
+    args = parser.parse_args()
+    if args.command == "serve-upstream":
+        serve_upstream(args)
+    elif args.command == "serve-proxy":
+        serve_proxy(args)
+    else:
+        run_benchmark(args)
+
+
+if __name__ == "__main__":
+    main()
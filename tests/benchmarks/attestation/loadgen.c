@@ -0,0 +1,528 @@
+// loadgen.c - HTTP/1.1 keep-alive load generator for the attestation benchmarks
+//
+// Opens --connections connections over TCP or a Unix socket, keeps one request
+// in flight on each and records the latency of every response until
+// --requests have completed or --duration has run out. Responses may be
+// Content-Length, chunked or close-delimited. The result is one JSON object
+// on stdout with throughput and latency percentiles.
+//
+// Signed requests: --signatures FILE holds "<epoch> <hex>" lines for the
+// "hotkey:nonce:purpose" strings of consecutive seconds; every request carries
+// the newest entry not after the current time as X-Chutes-Nonce and
+// X-Chutes-Signature, next to X-Chutes-Hotkey from --hotkey.
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_HEADERS     16
+#define MAX_EVENTS      256
+#define READ_CHUNK      (64 * 1024)
+#define REQUEST_MAX     8192
+
+typedef enum {
+    CONN_IDLE = 0,
+    CONN_CONNECTING,
+    CONN_SENDING,
+    CONN_READING,
+} conn_state_t;
+
+typedef struct {
+    int fd;
+    conn_state_t state;
+    char out[REQUEST_MAX];
+    size_t out_len;
+    size_t out_off;
+    char *in;
+    size_t in_len;
+    size_t in_cap;
+    size_t body_start;          // zero until the header block is complete
+    long long content_length;   // -1 when not given
+    int chunked;
+    int close_after;
+    size_t chunk_pos;
+    int status;
+    int64_t started_ns;
+} conn_t;
+
+typedef struct {
+    int64_t epoch;
+    char sig[192];
+} signature_t;
+
+typedef struct {
+    const char *uds;
+    const char *host;
+    const char *port;
+    const char *path;
+    const char *hotkey;
+    const char *headers[MAX_HEADERS];
+    int n_headers;
+    int connections;
+    long requests;              // 0: run for the duration
+    double duration;
+    double timeout;
+    signature_t *signatures;
+    size_t n_signatures;
+} config_t;
+
+typedef struct {
+    uint32_t *latency_us;
+    size_t count;
+    size_t cap;
+    long ok;
+    long non_2xx;
+    long errors;
+    long issued;
+    uint64_t bytes_read;
+} results_t;
+
+static struct addrinfo *target_addr;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int load_signatures(config_t *cfg, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    size_t cap = 0;
+    signature_t entry;
+    char sig[sizeof(entry.sig)];
+    long long epoch;
+    while (fscanf(f, "%lld %191s", &epoch, sig) == 2) {
+        if (cfg->n_signatures == cap) {
+            cap = cap ? cap * 2 : 128;
+            signature_t *grown = realloc(cfg->signatures, cap * sizeof(signature_t));
+            if (!grown) {
+                fclose(f);
+                return -1;
+            }
+            cfg->signatures = grown;
+        }
+        entry.epoch = epoch;
+        snprintf(entry.sig, sizeof(entry.sig), "%s", sig);
+        cfg->signatures[cfg->n_signatures++] = entry;
+    }
+    fclose(f);
+    return cfg->n_signatures ? 0 : -1;
+}
+
+// Newest signature whose nonce is not in the future (entries are in epoch order)
+static const signature_t *current_signature(const config_t *cfg) {
+    static size_t cursor;
+    int64_t now = time(NULL);
+    while (cursor + 1 < cfg->n_signatures && cfg->signatures[cursor + 1].epoch <= now) cursor++;
+    return &cfg->signatures[cursor];
+}
+
+static void build_request(const config_t *cfg, conn_t *c) {
+    int n = snprintf(c->out, sizeof(c->out), "GET %s HTTP/1.1\r\nHost: %s\r\n", cfg->path,
+                     cfg->uds ? "localhost" : cfg->host);
+    for (int i = 0; i < cfg->n_headers; i++) {
+        n += snprintf(c->out + n, sizeof(c->out) - n, "%s\r\n", cfg->headers[i]);
+    }
+    if (cfg->n_signatures) {
+        const signature_t *s = current_signature(cfg);
+        n += snprintf(c->out + n, sizeof(c->out) - n,
+                      "X-Chutes-Hotkey: %s\r\nX-Chutes-Nonce: %lld\r\nX-Chutes-Signature: %s\r\n",
+                      cfg->hotkey, (long long)s->epoch, s->sig);
+    }
+    n += snprintf(c->out + n, sizeof(c->out) - n, "\r\n");
+    c->out_len = (size_t)n < sizeof(c->out) ? (size_t)n : sizeof(c->out) - 1;
+    c->out_off = 0;
+    c->in_len = 0;
+    c->body_start = 0;
+    c->content_length = -1;
+    c->chunked = 0;
+    c->close_after = 0;
+    c->chunk_pos = 0;
+    c->status = 0;
+}
+
+static int open_connection(const config_t *cfg, conn_t *c) {
+    int fd;
+    if (cfg->uds) {
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", cfg->uds);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS && errno != EAGAIN) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        fd = socket(target_addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, target_addr->ai_addr, target_addr->ai_addrlen) != 0 && errno != EINPROGRESS) {
+            close(fd);
+            return -1;
+        }
+    }
+    c->fd = fd;
+    c->state = CONN_CONNECTING;
+    return 0;
+}
+
+static void record(results_t *res, int64_t elapsed_ns) {
+    if (res->count == res->cap) {
+        res->cap = res->cap ? res->cap * 2 : 4096;
+        uint32_t *grown = realloc(res->latency_us, res->cap * sizeof(uint32_t));
+        if (!grown) return;
+        res->latency_us = grown;
+    }
+    res->latency_us[res->count++] = (uint32_t)(elapsed_ns / 1000);
+}
+
+// True if token appears in the header value [value, eol)
+static int header_has(const char *value, const char *eol, const char *token) {
+    size_t n = strlen(token);
+    for (const char *p = value; p + n <= eol; p++) {
+        if (strncasecmp(p, token, n) == 0) return 1;
+    }
+    return 0;
+}
+
+static void parse_headers(conn_t *c, size_t end) {
+    c->body_start = end + 4;
+    c->chunk_pos = c->body_start;
+    if (end > 9 && strncmp(c->in, "HTTP/1.", 7) == 0) c->status = atoi(c->in + 9);
+
+    const char *line = c->in, *limit = c->in + end;
+    while ((line = memchr(line, '\n', limit - line)) && ++line < limit) {
+        const char *eol = memchr(line, '\r', limit - line);
+        if (!eol) eol = limit;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) c->content_length = strtoll(line + 15, NULL, 10);
+        else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) c->chunked = header_has(line + 18, eol, "chunked");
+        else if (strncasecmp(line, "Connection:", 11) == 0) c->close_after = header_has(line + 11, eol, "close");
+    }
+}
+
+// 1 when the response is complete, 0 if more bytes are needed, -1 if malformed
+static int response_complete(conn_t *c) {
+    if (!c->body_start) {
+        void *end = memmem(c->in, c->in_len, "\r\n\r\n", 4);
+        if (!end) return 0;
+        parse_headers(c, (char *)end - c->in);
+    }
+    if (c->status == 204 || c->status == 304 || (c->status >= 100 && c->status < 200)) return 1;
+    if (c->chunked) {
+        for (;;) {
+            char *eol = memmem(c->in + c->chunk_pos, c->in_len - c->chunk_pos, "\r\n", 2);
+            if (!eol) return 0;
+            char *end = NULL;
+            unsigned long long size = strtoull(c->in + c->chunk_pos, &end, 16);
+            if (end == c->in + c->chunk_pos) return -1;
+            size_t data = eol + 2 - c->in;
+            if (size == 0) {
+                // Last chunk, then optional trailers up to an empty line
+                if (c->in_len >= data + 2 && memcmp(c->in + data, "\r\n", 2) == 0) return 1;
+                return memmem(c->in + data, c->in_len - data, "\r\n\r\n", 4) ? 1 : 0;
+            }
+            if (c->in_len < data + size + 2) return 0;
+            c->chunk_pos = data + size + 2;
+        }
+    }
+    if (c->content_length >= 0) return c->in_len >= c->body_start + (size_t)c->content_length;
+    return 0;   // delimited by close
+}
+
+static void close_connection(int epfd, conn_t *c) {
+    if (c->fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+    }
+    c->fd = -1;
+    c->state = CONN_IDLE;
+}
+
+static int may_issue(const config_t *cfg, const results_t *res, int64_t deadline) {
+    if (cfg->requests > 0) return res->issued < cfg->requests;
+    return now_ns() < deadline;
+}
+
+// Put an idle connection to work: connect if needed, then send the next request
+static int start_request(int epfd, const config_t *cfg, conn_t *c, results_t *res) {
+    if (c->fd < 0) {
+        if (open_connection(cfg, c) != 0) return -1;
+        struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = c};
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+            close_connection(epfd, c);
+            return -1;
+        }
+    } else {
+        c->state = CONN_SENDING;
+        struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = c};
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+    build_request(cfg, c);
+    c->started_ns = now_ns();
+    res->issued++;
+    return 0;
+}
+
+static void finish_request(int epfd, const config_t *cfg, conn_t *c, results_t *res, int ok, int64_t deadline) {
+    if (ok) {
+        record(res, now_ns() - c->started_ns);
+        if (c->status >= 200 && c->status < 300) res->ok++;
+        else res->non_2xx++;
+    } else {
+        res->errors++;
+    }
+    if (!ok || c->close_after) close_connection(epfd, c);
+    else c->state = CONN_IDLE;
+
+    if (may_issue(cfg, res, deadline) && start_request(epfd, cfg, c, res) != 0) {
+        res->errors++;
+        close_connection(epfd, c);
+    }
+}
+
+static void handle_event(int epfd, const config_t *cfg, conn_t *c, uint32_t events, results_t *res, int64_t deadline) {
+    if (c->state == CONN_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err || (events & (EPOLLERR | EPOLLHUP))) {
+            finish_request(epfd, cfg, c, res, 0, deadline);
+            return;
+        }
+        c->state = CONN_SENDING;
+    }
+
+    if (c->state == CONN_SENDING) {
+        while (c->out_off < c->out_len) {
+            ssize_t n = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
+            if (n < 0) {
+                if (errno == EAGAIN) return;
+                finish_request(epfd, cfg, c, res, 0, deadline);
+                return;
+            }
+            c->out_off += n;
+        }
+        c->state = CONN_READING;
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = c};
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        return;
+    }
+
+    if (c->state != CONN_READING) return;
+    for (;;) {
+        if (c->in_cap - c->in_len < READ_CHUNK) {
+            size_t cap = c->in_cap ? c->in_cap * 2 : 2 * READ_CHUNK;
+            char *grown = realloc(c->in, cap);
+            if (!grown) {
+                finish_request(epfd, cfg, c, res, 0, deadline);
+                return;
+            }
+            c->in = grown;
+            c->in_cap = cap;
+        }
+        ssize_t n = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+        if (n < 0) {
+            if (errno == EAGAIN) break;
+            finish_request(epfd, cfg, c, res, 0, deadline);
+            return;
+        }
+        if (n == 0) {
+            // A close-delimited body ends here; anything else was cut short
+            int done = c->body_start && !c->chunked && c->content_length < 0;
+            c->close_after = 1;
+            finish_request(epfd, cfg, c, res, done, deadline);
+            return;
+        }
+        c->in_len += n;
+        res->bytes_read += n;
+    }
+
+    int rc = response_complete(c);
+    if (rc != 0) finish_request(epfd, cfg, c, res, rc > 0, deadline);
+}
+
+static int by_value(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_ms(const results_t *res, double pct) {
+    if (!res->count) return 0;
+    size_t index = (size_t)(pct / 100.0 * res->count + 0.5);
+    if (index > 0) index--;
+    if (index >= res->count) index = res->count - 1;
+    return res->latency_us[index] / 1000.0;
+}
+
+static void print_results(const results_t *res, double elapsed) {
+    qsort(res->latency_us, res->count, sizeof(uint32_t), by_value);
+    double sum = 0;
+    for (size_t i = 0; i < res->count; i++) sum += res->latency_us[i];
+    printf("{\"requests\": %zu, \"ok\": %ld, \"non_2xx\": %ld, \"errors\": %ld, "
+           "\"duration_s\": %.3f, \"rps\": %.2f, \"bytes_read\": %llu, ",
+           res->count, res->ok, res->non_2xx, res->errors, elapsed,
+           elapsed > 0 ? res->count / elapsed : 0.0, (unsigned long long)res->bytes_read);
+    printf("\"latency_ms\": {\"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}}\n",
+           res->count ? sum / res->count / 1000.0 : 0.0, percentile_ms(res, 50), percentile_ms(res, 90),
+           percentile_ms(res, 99), res->count ? res->latency_us[res->count - 1] / 1000.0 : 0.0);
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s (--uds PATH | --port PORT) --path PATH [OPTIONS]\n", prog_name);
+    printf("Options:\n");
+    printf("  --uds PATH            Connect to a Unix socket\n");
+    printf("  --host HOST           TCP host (default: 127.0.0.1)\n");
+    printf("  --port PORT           TCP port\n");
+    printf("  --path PATH           Request target, e.g. /attest?nonce=...\n");
+    printf("  --header 'K: V'       Extra request header (repeatable, up to %d)\n", MAX_HEADERS);
+    printf("  --hotkey SS58         Signer for X-Chutes-Hotkey (with --signatures)\n");
+    printf("  --signatures FILE     '<epoch> <hex>' lines, one signed nonce per second\n");
+    printf("  --connections N       Concurrent connections (default: 1)\n");
+    printf("  --requests N          Stop after N requests\n");
+    printf("  --duration S          Stop issuing after S seconds (default: 10)\n");
+    printf("  --timeout S           Per-request timeout (default: 60)\n");
+    printf("  -h, --help            Show this help message\n");
+}
+
+enum {
+    OPT_UDS = 256, OPT_HOST, OPT_PORT, OPT_PATH, OPT_HEADER, OPT_HOTKEY, OPT_SIGNATURES,
+    OPT_CONNECTIONS, OPT_REQUESTS, OPT_DURATION, OPT_TIMEOUT,
+};
+
+int main(int argc, char *argv[]) {
+    config_t cfg = {
+        .host = "127.0.0.1",
+        .connections = 1,
+        .duration = 10,
+        .timeout = 60,
+    };
+    const char *signatures = NULL;
+
+    static struct option long_options[] = {
+        {"uds", required_argument, 0, OPT_UDS},
+        {"host", required_argument, 0, OPT_HOST},
+        {"port", required_argument, 0, OPT_PORT},
+        {"path", required_argument, 0, OPT_PATH},
+        {"header", required_argument, 0, OPT_HEADER},
+        {"hotkey", required_argument, 0, OPT_HOTKEY},
+        {"signatures", required_argument, 0, OPT_SIGNATURES},
+        {"connections", required_argument, 0, OPT_CONNECTIONS},
+        {"requests", required_argument, 0, OPT_REQUESTS},
+        {"duration", required_argument, 0, OPT_DURATION},
+        {"timeout", required_argument, 0, OPT_TIMEOUT},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_UDS: cfg.uds = optarg; break;
+            case OPT_HOST: cfg.host = optarg; break;
+            case OPT_PORT: cfg.port = optarg; break;
+            case OPT_PATH: cfg.path = optarg; break;
+            case OPT_HEADER:
+                if (cfg.n_headers < MAX_HEADERS) cfg.headers[cfg.n_headers++] = optarg;
+                break;
+            case OPT_HOTKEY: cfg.hotkey = optarg; break;
+            case OPT_SIGNATURES: signatures = optarg; break;
+            case OPT_CONNECTIONS: cfg.connections = atoi(optarg); break;
+            case OPT_REQUESTS: cfg.requests = atol(optarg); break;
+            case OPT_DURATION: cfg.duration = atof(optarg); break;
+            case OPT_TIMEOUT: cfg.timeout = atof(optarg); break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!cfg.path || (!cfg.uds && !cfg.port) || cfg.connections < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (signatures && (!cfg.hotkey || load_signatures(&cfg, signatures) != 0)) {
+        fprintf(stderr, "Cannot use signatures from %s (--hotkey is required)\n", signatures);
+        return 1;
+    }
+    if (!cfg.uds) {
+        struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+        int rc = getaddrinfo(cfg.host, cfg.port, &hints, &target_addr);
+        if (rc != 0) {
+            fprintf(stderr, "Cannot resolve %s:%s: %s\n", cfg.host, cfg.port, gai_strerror(rc));
+            return 1;
+        }
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    conn_t *conns = calloc(cfg.connections, sizeof(conn_t));
+    if (epfd < 0 || !conns) {
+        fprintf(stderr, "Cannot set up: %s\n", strerror(errno));
+        return 1;
+    }
+
+    results_t res = {0};
+    int64_t start = now_ns();
+    int64_t deadline = start + (int64_t)(cfg.duration * 1e9);
+    int64_t timeout_ns = (int64_t)(cfg.timeout * 1e9);
+    for (int i = 0; i < cfg.connections; i++) {
+        conns[i].fd = -1;
+        if (may_issue(&cfg, &res, deadline) && start_request(epfd, &cfg, &conns[i], &res) != 0) {
+            res.errors++;
+            close_connection(epfd, &conns[i]);
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    for (;;) {
+        int active = 0;
+        int64_t now = now_ns();
+        for (int i = 0; i < cfg.connections; i++) {
+            conn_t *c = &conns[i];
+            if (c->state == CONN_IDLE) {
+                // A connection that failed to start gets another try while issuing continues
+                if (c->fd < 0 && may_issue(&cfg, &res, deadline) && start_request(epfd, &cfg, c, &res) != 0) {
+                    res.errors++;
+                    close_connection(epfd, c);
+                }
+                if (c->state == CONN_IDLE) continue;
+            }
+            if (now - c->started_ns > timeout_ns) {
+                finish_request(epfd, &cfg, c, &res, 0, deadline);
+                if (c->state == CONN_IDLE) continue;
+            }
+            active++;
+        }
+        if (!active) break;
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 100);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; i++) {
+            handle_event(epfd, &cfg, events[i].data.ptr, events[i].events, &res, deadline);
+        }
+    }
+
+    print_results(&res, (now_ns() - start) / 1e9);
+    for (int i = 0; i < cfg.connections; i++) {
+        close_connection(epfd, &conns[i]);
+        free(conns[i].in);
+    }
+    free(conns);
+    free(res.latency_us);
+    free(cfg.signatures);
+    if (target_addr) freeaddrinfo(target_addr);
+    close(epfd);
+    return res.errors ? 2 : 0;
+}
@@ -0,0 +1,69 @@
+"""
+Local stand-ins for the attestation backends, shared by the benchmarks.
+
+setup_backends() points the providers at the mock tdx-quote-generator and the
+stub chutes-nvevidence in ./stubs, replaces pynvml with a fake reporting
+`gpu_count` devices and writes a throwaway server certificate for the quote
+binding. Call it before the attestation app handles its first request.
+"""
+
+import datetime
+import os
+import sys
+import types
+from pathlib import Path
+
+HERE = Path(__file__).resolve().parent
+REPO_ROOT = HERE.parents[2]
+STUBS = HERE / "stubs"
+if str(REPO_ROOT) not in sys.path:
+    sys.path.insert(0, str(REPO_ROOT))
+
+
+def fake_pynvml(gpu_count: int) -> types.ModuleType:
+    module = types.ModuleType("pynvml")
+    module.nvmlInit = lambda: None
+    module.nvmlShutdown = lambda: None
+    module.nvmlDeviceGetCount = lambda: gpu_count
+    module.nvmlDeviceGetHandleByIndex = lambda index: index
+    module.nvmlDeviceGetUUID = lambda handle: f"GPU-00000000-0000-0000-0000-{handle:012d}"
+    return module
+
+
+def write_server_cert(directory: str) -> str:
+    from cryptography import x509
+    from cryptography.hazmat.primitives import hashes, serialization
+    from cryptography.hazmat.primitives.asymmetric import ec
+    from cryptography.x509.oid import NameOID
+
+    key = ec.generate_private_key(ec.SECP256R1())
+    name = x509.Name([x509.NameAttribute(NameOID.COMMON_NAME, "bench")])
+    now = datetime.datetime.now(datetime.timezone.utc)
+    cert = (
+        x509.CertificateBuilder()
+        .subject_name(name)
+        .issuer_name(name)
+        .public_key(key.public_key())
+        .serial_number(x509.random_serial_number())
+        .not_valid_before(now)
+        .not_valid_after(now + datetime.timedelta(days=1))
+        .sign(key, hashes.SHA256())
+    )
+    path = os.path.join(directory, "server.crt")
+    with open(path, "wb") as f:
+        f.write(cert.public_bytes(serialization.Encoding.PEM))
+    return path
+
+
+def setup_backends(workdir: str, gpu_count: int):
+    os.environ["MOCK_GPU_COUNT"] = str(gpu_count)
+    sys.modules["pynvml"] = fake_pynvml(gpu_count)
+
+    import sek8s.providers.nvtrust as nvtrust
+    import sek8s.providers.tdx as tdx
+
+    nvtrust.pynvml = sys.modules["pynvml"]
+    nvtrust.EVIDENCE_BINARY = str(STUBS / "chutes-nvevidence")
+    nvtrust.EVIDENCE_WORKDIR = workdir
+    tdx.QUOTE_GENERATOR_BINARY = str(STUBS / "tdx-quote-generator")
+    tdx.SERVER_CERT = write_server_cert(workdir)
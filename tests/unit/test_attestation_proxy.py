@@ -0,0 +1,99 @@
+import httpx
+import pytest
+from fastapi.testclient import TestClient
+
+from sek8s.config import AttestationProxyConfig
+from sek8s.services.attestation_proxy import InternalProxyServer, SharedProxyResources
+
+
+class ChunkedStream(httpx.AsyncByteStream):
+    """Upstream body that arrives in pieces, like a real socket read."""
+
+    def __init__(self, body: bytes, chunk_size: int = 16384):
+        self.chunks = [body[i : i + chunk_size] for i in range(0, len(body), chunk_size)]
+
+    async def __aiter__(self):
+        for chunk in self.chunks:
+            yield chunk
+
+
+@pytest.fixture
+def proxy_client():
+    seen = []
+
+    def upstream(request: httpx.Request) -> httpx.Response:
+        seen.append(request)
+        return httpx.Response(
+            200,
+            headers=[
+                ("content-type", "application/json"),
+                ("connection", "keep-alive"),
+                ("set-cookie", "a=1"),
+                ("set-cookie", "b=2"),
+            ],
+            stream=ChunkedStream(b'{"quote": "' + b"q" * 200_000 + b'"}'),
+        )
+
+    shared = SharedProxyResources()
+    shared.unix_client = httpx.AsyncClient(
+        transport=httpx.MockTransport(upstream), base_url="http://localhost"
+    )
+    shared._initialized = True
+
+    server = InternalProxyServer(AttestationProxyConfig(), shared)
+    client = TestClient(server.app)
+    client.upstream_requests = seen
+    return client
+
+
+def test_proxy_streams_body_and_filters_headers(proxy_client):
+    response = proxy_client.get(
+        "/server/tdx/quote",
+        params={"nonce": "abc"},
+        headers={"X-Client-Verify": "SUCCESS", "Proxy-Authorization": "secret", "TE": "trailers"},
+    )
+
+    assert response.status_code == 200
+    assert response.json()["quote"] == "q" * 200_000
+    assert response.headers.get_list("set-cookie") == ["a=1", "b=2"]
+    assert "keep-alive" not in response.headers.get("connection", "")
+
+    (upstream,) = proxy_client.upstream_requests
+    assert upstream.url.path == "/tdx/quote"
+    assert upstream.url.params["nonce"] == "abc"
+    assert upstream.headers["x-client-verify"] == "SUCCESS"
+    assert upstream.headers["x-client-cert"] == ""
+    assert "proxy-authorization" not in upstream.headers
+    assert "te" not in upstream.headers
+
+
+def test_proxy_forwards_request_body(proxy_client):
+    response = proxy_client.post("/server/echo", content=b"x" * 100_000)
+
+    assert response.status_code == 200
+    (upstream,) = proxy_client.upstream_requests
+    assert upstream.method == "POST"
+    assert upstream.read() == b"x" * 100_000
+
+
+def test_proxy_replays_request_body_on_connect_retry():
+    seen = []
+
+    def upstream(request: httpx.Request) -> httpx.Response:
+        seen.append(request.read())
+        if len(seen) == 1:
+            raise httpx.ConnectError("socket not ready", request=request)
+        return httpx.Response(200, stream=ChunkedStream(b"ok"))
+
+    shared = SharedProxyResources()
+    shared.unix_client = httpx.AsyncClient(
+        transport=httpx.MockTransport(upstream), base_url="http://localhost"
+    )
+    shared._initialized = True
+
+    client = TestClient(InternalProxyServer(AttestationProxyConfig(), shared).app)
+    response = client.post("/server/echo", content=b"y" * 50_000)
+
+    assert response.status_code == 200
+    assert seen == [b"y" * 50_000, b"y" * 50_000]
+    assert shared.consecutive_socket_failures == 0
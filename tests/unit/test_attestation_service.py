@@ -1,3 +1,5 @@
+import asyncio
+import hashlib
 from unittest.mock import AsyncMock, MagicMock
 
 import pytest
@@ -6,6 +8,8 @@ from fastapi.testclient import TestClient
 from sek8s.config import AttestationServiceConfig
 from sek8s.models import DeviceInfo
 from sek8s.providers.gpu import sanitize_gpu_id
+from sek8s.providers.integrity import IntegritySnapshotProvider
+from sek8s.providers.tdx import TdxQuoteProvider
 from sek8s.services.attestation import AttestationServer
 
 
@@ -58,8 +62,14 @@ def attestation_client(monkeypatch, sample_devices):
     nvtrust_provider = MagicMock()
     nvtrust_provider.__enter__.return_value = nvtrust_provider
     nvtrust_provider.__exit__.return_value = False
+    nvtrust_provider.__aenter__.return_value = nvtrust_provider
+    nvtrust_provider.__aexit__.return_value = False
     nvtrust_provider.get_evidence = AsyncMock(return_value='[{"evidence": "ok"}]')
 
+    snapshot_provider = MagicMock()
+    snapshot_provider.get_snapshot = AsyncMock(return_value=b'{"nonce":"abc","version":1}')
+    snapshot_provider.digest = IntegritySnapshotProvider.digest
+
     monkeypatch.setattr(
         "sek8s.services.attestation.GpuDeviceProvider",
         lambda: provider,
@@ -72,6 +82,10 @@ def attestation_client(monkeypatch, sample_devices):
         "sek8s.services.attestation.NvEvidenceProvider",
         lambda: nvtrust_provider,
     )
+    monkeypatch.setattr(
+        "sek8s.services.attestation.IntegritySnapshotProvider",
+        lambda: snapshot_provider,
+    )
 
     config = AttestationServiceConfig(
         hostname="test-node",
@@ -84,6 +98,7 @@ def attestation_client(monkeypatch, sample_devices):
     client.gpu_provider = provider
     client.tdx_provider = tdx_provider
     client.nvtrust_provider = nvtrust_provider
+    client.snapshot_provider = snapshot_provider
     return client
 
 
@@ -169,3 +184,102 @@ def test_nvtrust_endpoint_with_comma_separated_gpu_ids(attestation_client):
         "123",
         ["GPU-a", "GPU-b"],
     )
+
+
+def test_integrity_binds_snapshot_into_quote(attestation_client):
+    nonce = "b" * 64
+    response = attestation_client.get("/integrity", params={"nonce": nonce})
+
+    assert response.status_code == 200
+    data = response.json()
+    snapshot = b'{"nonce":"abc","version":1}'
+    assert data["tdx_quote"] == "ZmFrZS1xdW90ZQ=="
+    assert data["snapshot"] == snapshot.decode()
+    assert data["snapshot_sha256"] == hashlib.sha256(snapshot).hexdigest()
+
+    attestation_client.snapshot_provider.get_snapshot.assert_awaited_once_with(nonce)
+    attestation_client.tdx_provider.get_quote.assert_awaited_once_with(
+        nonce, binding=hashlib.sha256(snapshot).digest()
+    )
+
+
+def test_report_data_binding():
+    nonce = "c" * 64
+    cert_hash = "d" * 64
+    binding = hashlib.sha256(b"snapshot").digest()
+
+    assert TdxQuoteProvider.report_data(nonce, cert_hash) == nonce + cert_hash
+
+    bound = TdxQuoteProvider.report_data(nonce, cert_hash, binding)
+    assert len(bound) == 128
+    assert bound[:64] == nonce
+    assert bound[64:] == hashlib.sha256(bytes.fromhex(cert_hash) + binding).hexdigest()
+
+    # A nonce that is not exactly 64 hex chars would shift or cut off the binding
+    for bad in ("0" * 128, "0" * 65, "c" * 63, "g" * 64):
+        with pytest.raises(ValueError):
+            TdxQuoteProvider.report_data(bad, cert_hash, binding)
+
+
+def test_integrity_rejects_nonce_that_is_not_64_hex_chars(attestation_client):
+    for nonce in ("0" * 128, "0" * 65, "abc", "z" * 64):
+        response = attestation_client.get("/integrity", params={"nonce": nonce})
+        assert response.status_code == 400
+
+    attestation_client.snapshot_provider.get_snapshot.assert_not_awaited()
+    attestation_client.tdx_provider.get_quote.assert_not_awaited()
+
+
+def test_attest_collects_quote_and_evidence_concurrently(attestation_client):
+    # Each stub waits until the other has started, so run one after the other
+    # they would time out instead of returning
+    quote_started = asyncio.Event()
+    evidence_started = asyncio.Event()
+
+    async def quote(nonce):
+        quote_started.set()
+        await asyncio.wait_for(evidence_started.wait(), timeout=5)
+        return b"fake-quote"
+
+    async def evidence(name, nonce, gpu_ids):
+        evidence_started.set()
+        await asyncio.wait_for(quote_started.wait(), timeout=5)
+        return '[{"evidence": "ok"}]'
+
+    attestation_client.tdx_provider.get_quote = AsyncMock(side_effect=quote)
+    attestation_client.nvtrust_provider.get_evidence = AsyncMock(side_effect=evidence)
+
+    response = attestation_client.get("/attest", params={"nonce": "a" * 64})
+
+    assert response.status_code == 200
+    timing = dict(
+        entry.strip().split(";dur=") for entry in response.headers["Server-Timing"].split(",")
+    )
+    assert set(timing) == {"tdx_quote", "nvtrust_evidence", "total"}
+
+
+def test_attest_and_quote_accept_short_nonce_without_binding(attestation_client, monkeypatch):
+    """/attest and /tdx/quote run the real report data path; only /integrity requires 64 hex chars."""
+    cert_hash = "d" * 64
+    seen = []
+
+    async def fake_exec(*args, **kwargs):
+        seen.append(args[args.index("--report-data") + 1])
+        with open(args[args.index("--output") + 1], "wb") as f:
+            f.write(b"real-quote")
+        proc = MagicMock()
+        proc.returncode = 0
+        proc.communicate = AsyncMock(return_value=(b"", b""))
+        return proc
+
+    monkeypatch.setattr(TdxQuoteProvider, "_get_cert_hash", lambda self: cert_hash)
+    monkeypatch.setattr("sek8s.providers.tdx.asyncio.create_subprocess_exec", fake_exec)
+    monkeypatch.setattr("sek8s.services.attestation.TdxQuoteProvider", TdxQuoteProvider)
+
+    response = attestation_client.get("/attest", params={"nonce": "123"})
+    assert response.status_code == 200
+
+    response = attestation_client.get("/tdx/quote", params={"nonce": "123"})
+    assert response.status_code == 200
+
+    assert seen == ["123" + cert_hash, "123" + cert_hash]
@@ -0,0 +1,380 @@
+import base64
+import hashlib
+import json
+import time
+from unittest.mock import AsyncMock
+
+import pytest
+import pytest_asyncio
+from aiohttp import web
+from cryptography.hazmat.primitives import hashes, serialization
+from cryptography.hazmat.primitives.asymmetric import ec
+
+from sek8s.config import AdmissionConfig, CosignVerificationConfig
+from sek8s.cosign_verifier import (
+    BUNDLE_ANNOTATION,
+    SIGNATURE_ANNOTATION,
+    SIMPLE_SIGNING_MEDIA_TYPE,
+    KeySignatureVerifier,
+    rekor_log_id,
+    signature_tag,
+)
+from sek8s.registry_client import RegistryClient, RegistryError, RegistryRateLimited
+from sek8s.validators.cosign import CosignValidator, RateLimitError
+
+OCI_MANIFEST = "application/vnd.oci.image.manifest.v1+json"
+
+
+def _digest(data: bytes) -> str:
+    return f"sha256:{hashlib.sha256(data).hexdigest()}"
+
+
+class FakeRegistry:
+    """OCI distribution API stand-in with bearer-token auth, served on localhost."""
+
+    def __init__(self):
+        self.manifests = {}  # (repository, reference) -> bytes
+        self.blobs = {}  # digest -> bytes
+        self.chunked = set()  # digests served without Content-Length
+        self.token_requests = 0
+        self.head_requests = 0
+        self.connections = set()
+        self.rate_limited = False
+        self.app = web.Application()
+        self.app.router.add_get("/token", self._token)
+        self.app.router.add_get(r"/v2/{repository:.+}/manifests/{reference}", self._manifest)
+        self.app.router.add_get(r"/v2/{repository:.+}/blobs/{digest}", self._blob)
+
+    async def start(self):
+        self.runner = web.AppRunner(self.app)
+        await self.runner.setup()
+        site = web.TCPSite(self.runner, "127.0.0.1", 0)
+        await site.start()
+        self.host = f"127.0.0.1:{site._server.sockets[0].getsockname()[1]}"
+
+    async def stop(self):
+        await self.runner.cleanup()
+
+    def push_image(self, repository: str, tag: str) -> str:
+        manifest = json.dumps(
+            {"schemaVersion": 2, "mediaType": OCI_MANIFEST, "layers": [], "annotations": {"ref": f"{repository}:{tag}"}}
+        ).encode()
+        digest = _digest(manifest)
+        self.manifests[(repository, tag)] = manifest
+        self.manifests[(repository, digest)] = manifest
+        return digest
+
+    def push_signature(self, repository: str, digest: str, payload: bytes, signature: bytes, bundle=None):
+        self.blobs[_digest(payload)] = payload
+        annotations = {SIGNATURE_ANNOTATION: base64.b64encode(signature).decode()}
+        if bundle is not None:
+            annotations[BUNDLE_ANNOTATION] = json.dumps(bundle)
+        layer = {
+            "mediaType": SIMPLE_SIGNING_MEDIA_TYPE,
+            "digest": _digest(payload),
+            "size": len(payload),
+            "annotations": annotations,
+        }
+        manifest = json.dumps({"schemaVersion": 2, "mediaType": OCI_MANIFEST, "layers": [layer]}).encode()
+        self.manifests[(repository, signature_tag(digest))] = manifest
+
+    def _check(self, request):
+        self.connections.add(id(request.transport))
+        if self.rate_limited:
+            raise web.HTTPTooManyRequests(headers={"Retry-After": "42"})
+        if request.headers.get("Authorization") != "Bearer test-token":
+            raise web.HTTPUnauthorized(
+                headers={
+                    "WWW-Authenticate": f'Bearer realm="http://{self.host}/token",service="fake",'
+                    f'scope="repository:{request.match_info["repository"]}:pull"'
+                }
+            )
+
+    async def _token(self, request):
+        self.token_requests += 1
+        return web.json_response({"token": "test-token", "expires_in": 300})
+
+    async def _manifest(self, request):
+        self._check(request)
+        if request.method == "HEAD":
+            self.head_requests += 1
+        manifest = self.manifests.get((request.match_info["repository"], request.match_info["reference"]))
+        if manifest is None:
+            raise web.HTTPNotFound()
+        return web.Response(
+            body=manifest, content_type=OCI_MANIFEST, headers={"Docker-Content-Digest": _digest(manifest)}
+        )
+
+    async def _blob(self, request):
+        self._check(request)
+        blob = self.blobs.get(request.match_info["digest"])
+        if blob is None:
+            raise web.HTTPNotFound()
+        if request.match_info["digest"] not in self.chunked:
+            return web.Response(body=blob)
+        response = web.StreamResponse()
+        response.enable_chunked_encoding()
+        await response.prepare(request)
+        for offset in range(0, len(blob), 4096):
+            await response.write(blob[offset : offset + 4096])
+        await response.write_eof()
+        return response
+
+
+def _payload(reference: str, digest: str) -> bytes:
+    return json.dumps(
+        {
+            "critical": {
+                "identity": {"docker-reference": reference},
+                "image": {"docker-manifest-digest": digest},
+                "type": "cosign container image signature",
+            },
+            "optional": None,
+        }
+    ).encode()
+
+
+def _sign(key, data: bytes) -> bytes:
+    return key.sign(data, ec.ECDSA(hashes.SHA256()))
+
+
+def _bundle(rekor_key, signature: bytes, payload: bytes, **overrides) -> dict:
+    """Rekor bundle for a hashedrekord entry of signature over payload, timestamped by rekor_key."""
+    body = base64.b64encode(
+        json.dumps(
+            {
+                "kind": "hashedrekord",
+                "spec": {
+                    "signature": {"content": base64.b64encode(signature).decode()},
+                    "data": {"hash": {"algorithm": "sha256", "value": hashlib.sha256(payload).hexdigest()}},
+                },
+            }
+        ).encode()
+    ).decode()
+    entry = {"body": body, "integratedTime": 1700000000, "logIndex": 7, "logID": rekor_log_id(rekor_key.public_key())}
+    canonical = json.dumps(entry, sort_keys=True, separators=(",", ":")).encode()
+    return {
+        "SignedEntryTimestamp": base64.b64encode(_sign(rekor_key, canonical)).decode(),
+        "Payload": {**entry, **overrides},
+    }
+
+
+def _write_public_key(path, key):
+    path.write_bytes(
+        key.public_key().public_bytes(
+            serialization.Encoding.PEM, serialization.PublicFormat.SubjectPublicKeyInfo
+        )
+    )
+    return path
+
+
+@pytest_asyncio.fixture
+async def registry():
+    registry = FakeRegistry()
+    await registry.start()
+    yield registry
+    await registry.stop()
+
+
+@pytest.fixture
+def signing_key():
+    return ec.generate_private_key(ec.SECP256R1())
+
+
+@pytest.fixture
+def public_key(tmp_path, signing_key):
+    return _write_public_key(tmp_path / "cosign.pub", signing_key)
+
+
+@pytest.fixture
+def rekor_key():
+    return ec.generate_private_key(ec.SECP256R1())
+
+
+@pytest.fixture
+def rekor_public_key(tmp_path, rekor_key):
+    return _write_public_key(tmp_path / "rekor.pub", rekor_key)
+
+
+@pytest_asyncio.fixture
+async def verifier(rekor_public_key):
+    client = RegistryClient(timeout=5)
+    yield KeySignatureVerifier(client, rekor_public_key)
+    await client.close()
+
+
+def _push_signed(registry, repository, digest, signing_key, rekor_key, reference=None):
+    payload = _payload(reference or f"{registry.host}/{repository}", digest)
+    signature = _sign(signing_key, payload)
+    registry.push_signature(repository, digest, payload, signature, _bundle(rekor_key, signature, payload))
+
+
+@pytest.mark.asyncio
+async def test_verifies_signed_image_over_one_connection(registry, signing_key, rekor_key, public_key, verifier):
+    digest = registry.push_image("parachutes/app", "v1")
+    _push_signed(registry, "parachutes/app", digest, signing_key, rekor_key)
+
+    assert await verifier.verify(f"{registry.host}/parachutes/app@{digest}", public_key, allow_http=True)
+    assert await verifier.verify(f"{registry.host}/parachutes/app:v1", public_key, allow_http=True)
+
+    # One token for the repository, and every request over the same pooled connection
+    assert registry.token_requests == 1
+    assert len(registry.connections) == 1
+
+
+@pytest.mark.asyncio
+async def test_rejects_wrong_key_unsigned_and_mismatched_digest(
+    tmp_path, registry, signing_key, rekor_key, public_key, verifier
+):
+    digest = registry.push_image("parachutes/app", "v1")
+    _push_signed(registry, "parachutes/app", digest, signing_key, rekor_key)
+    other_key = _write_public_key(tmp_path / "other.pub", ec.generate_private_key(ec.SECP256R1()))
+    assert not await verifier.verify(f"{registry.host}/parachutes/app@{digest}", other_key, allow_http=True)
+
+    unsigned = registry.push_image("parachutes/unsigned", "v1")
+    assert not await verifier.verify(f"{registry.host}/parachutes/unsigned@{unsigned}", public_key, allow_http=True)
+
+    # A valid signature over a payload for a different image does not carry over
+    other = registry.push_image("parachutes/other", "v2")
+    payload = _payload(f"{registry.host}/parachutes/other", digest)
+    signature = _sign(signing_key, payload)
+    registry.push_signature("parachutes/other", other, payload, signature, _bundle(rekor_key, signature, payload))
+    assert not await verifier.verify(f"{registry.host}/parachutes/other@{other}", public_key, allow_http=True)
+
+
+@pytest.mark.asyncio
+async def test_checks_transparency_log_bundle(registry, signing_key, rekor_key, public_key, verifier):
+    digest = registry.push_image("parachutes/app", "v1")
+    payload = _payload(f"{registry.host}/parachutes/app", digest)
+    signature = _sign(signing_key, payload)
+    image = f"{registry.host}/parachutes/app@{digest}"
+
+    registry.push_signature("parachutes/app", digest, payload, signature, _bundle(rekor_key, signature, payload))
+    assert await verifier.verify(image, public_key, allow_http=True)
+
+    registry.push_signature("parachutes/app", digest, payload, signature, _bundle(rekor_key, signature, payload, logIndex=8))
+    assert not await verifier.verify(image, public_key, allow_http=True)
+
+    # A timestamp from another log does not count, even one it signed itself
+    other_log = ec.generate_private_key(ec.SECP256R1())
+    registry.push_signature("parachutes/app", digest, payload, signature, _bundle(other_log, signature, payload))
+    assert not await verifier.verify(image, public_key, allow_http=True)
+
+    registry.push_signature("parachutes/app", digest, payload, signature)
+    assert not await verifier.verify(image, public_key, allow_http=True)
+    # ...unless the policy opts out of tlog checks
+    assert await verifier.verify(image, public_key, allow_http=True, ignore_tlog=True)
+
+
+@pytest.mark.asyncio
+async def test_unbundled_signature_is_rejected_under_default_config(registry, signing_key, public_key):
+    digest = registry.push_image("parachutes/app", "v1")
+    payload = _payload(f"{registry.host}/parachutes/app", digest)
+    registry.push_signature("parachutes/app", digest, payload, _sign(signing_key, payload))
+    image = f"{registry.host}/parachutes/app@{digest}"
+
+    # No Rekor key: the native verifier accepts nothing that needs the tlog
+    client = RegistryClient(timeout=5)
+    try:
+        assert not await KeySignatureVerifier(client).verify(image, public_key, allow_http=True)
+    finally:
+        await client.close()
+
+    # ...and the validator leaves such policies to the cosign CLI, which fails here
+    validator = CosignValidator(AdmissionConfig(allowed_registries=[registry.host]))
+    validator._run_cosign = AsyncMock(return_value=(False, "", "no matching signatures: tlog entry not found", False))
+    config = CosignVerificationConfig(verification_method="key", public_key=public_key, allow_http=True)
+    try:
+        assert not await validator._verify_with_key(image, config)
+        validator._run_cosign.assert_awaited_once()
+        assert "--rekor-url" in validator._run_cosign.await_args.args[0]
+    finally:
+        await validator._registry_client.close()
+
+
+@pytest.mark.asyncio
+async def test_validator_verifies_natively_only_when_tlog_can_be_checked(rekor_public_key, public_key):
+    validator = CosignValidator(AdmissionConfig())
+    key_config = CosignVerificationConfig(verification_method="key", public_key=public_key)
+    assert not validator._can_verify_natively(key_config)
+    assert validator._can_verify_natively(key_config.model_copy(update={"ignore_tlog": True}))
+
+    validator.cosign_config.rekor_public_key = rekor_public_key
+    assert validator._can_verify_natively(key_config)
+    # A policy naming another Rekor instance is not checked against this log's key
+    assert not validator._can_verify_natively(key_config.model_copy(update={"rekor_url": "https://rekor.example"}))
+    await validator._registry_client.close()
+
+
+@pytest.mark.asyncio
+async def test_rate_limit_is_a_structured_signal(registry, public_key, verifier):
+    registry.rate_limited = True
+    with pytest.raises(RegistryRateLimited) as excinfo:
+        await verifier.verify(f"{registry.host}/parachutes/app:v1", public_key, allow_http=True)
+    assert excinfo.value.retry_after == 42
+
+
+@pytest.mark.asyncio
+async def test_validator_backs_off_for_registry_retry_after(registry, public_key):
+    registry.rate_limited = True
+    validator = CosignValidator(AdmissionConfig(allowed_registries=[registry.host]))
+    config = CosignVerificationConfig(
+        verification_method="key", public_key=public_key, allow_http=True, ignore_tlog=True
+    )
+    try:
+        with pytest.raises(RateLimitError):
+            await validator._verify_with_key(f"{registry.host}/parachutes/app:v1", config)
+    finally:
+        await validator._registry_client.close()
+
+    assert 40 < validator._rate_limit_until - time.time() <= 42
+
+
+@pytest.mark.asyncio
+async def test_validator_resolves_tags_by_registry_head_and_caches_them(registry):
+    validator = CosignValidator(AdmissionConfig(allowed_registries=[registry.host]))
+    config = CosignVerificationConfig(verification_method="key", allow_http=True)
+    digest = registry.push_image("parachutes/app", "v1")
+    image = f"{registry.host}/parachutes/app:v1"
+    try:
+        assert await validator._resolve_image_reference(image, config) == f"{registry.host}/parachutes/app@{digest}"
+        assert await validator._resolve_image_reference(image, config) == f"{registry.host}/parachutes/app@{digest}"
+        assert registry.head_requests == 1
+
+        # A retag is picked up once the cached digest expires
+        moved = registry.push_image("parachutes/app", "v1-moved")
+        registry.manifests[("parachutes/app", "v1")] = registry.manifests[("parachutes/app", moved)]
+        validator._digest_cache.clear()
+        assert await validator._resolve_image_reference(image, config) == f"{registry.host}/parachutes/app@{moved}"
+
+        # Digest references are used as given; unknown tags fall back to the tag
+        pinned = f"{registry.host}/parachutes/app@{digest}"
+        assert await validator._resolve_image_reference(pinned, config) == pinned
+        missing = f"{registry.host}/parachutes/app:missing"
+        assert await validator._resolve_image_reference(missing, config) == missing
+    finally:
+        await validator._registry_client.close()
+
+
+@pytest.mark.asyncio
+async def test_refuses_blobs_larger_than_the_cap(registry, monkeypatch):
+    monkeypatch.setattr("sek8s.registry_client.MAX_BLOB_BYTES", 16 * 1024)
+    small = b"s" * 1024
+    large = b"x" * (64 * 1024)
+    registry.blobs[_digest(small)] = small
+    registry.blobs[_digest(large)] = large
+
+    client = RegistryClient(timeout=5)
+    try:
+        assert await client.get_blob(registry.host, "parachutes/app", _digest(small), allow_http=True) == small
+
+        # Refused from its Content-Length...
+        with pytest.raises(RegistryError, match="exceeds"):
+            await client.get_blob(registry.host, "parachutes/app", _digest(large), allow_http=True)
+
+        # ...and, without one, once the running total passes the cap
+        registry.chunked.add(_digest(large))
+        with pytest.raises(RegistryError, match="exceeds"):
+            await client.get_blob(registry.host, "parachutes/app", _digest(large), allow_http=True)
+    finally:
+        await client.close()
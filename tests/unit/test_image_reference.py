@@ -0,0 +1,146 @@
+import pytest
+
+from sek8s.config import CosignConfig, CosignRegistryConfig
+from sek8s.image_reference import (
+    CosignRules,
+    ImagePolicy,
+    InvalidImageReference,
+    RegistryAllowlist,
+    parse_image_reference,
+)
+
+
+@pytest.mark.parametrize(
+    "image,domain,path,tag,digest",
+    [
+        ("nginx", "docker.io", "nginx", None, None),
+        ("nginx:1.25", "docker.io", "nginx", "1.25", None),
+        ("parachutes/chutes-agent:k3s", "docker.io", "parachutes/chutes-agent", "k3s", None),
+        ("localhost/app", "localhost", "app", None, None),
+        ("localhost:5000/app:v1", "localhost:5000", "app", "v1", None),
+        ("Registry.Example.com/team/app", "Registry.Example.com", "team/app", None, None),
+        ("[::1]:5000/app", "[::1]:5000", "app", None, None),
+        ("gcr.io/my-project/sub/app:v1", "gcr.io", "my-project/sub/app", "v1", None),
+        ("ghcr.io/org/app:1.0@sha256:" + "a" * 64, "ghcr.io", "org/app", "1.0", "sha256:" + "a" * 64),
+        ("quay.io/user/app@sha256:abc123", "quay.io", "user/app", None, "sha256:abc123"),
+    ],
+)
+def test_parse_follows_reference_grammar(image, domain, path, tag, digest):
+    reference = parse_image_reference(image)
+    assert (reference.domain, reference.path, reference.tag, reference.digest) == (domain, path, tag, digest)
+
+
+def test_parse_splits_organization_and_repository():
+    reference = parse_image_reference("index.docker.io/nginx@sha256:abcd1234")
+    assert reference.registry == "docker.io"
+    assert (reference.organization, reference.repository) == ("library", "nginx")
+    assert reference.tag_or_digest == "@sha256:abcd1234"
+
+    reference = parse_image_reference("gcr.io/my-project/subdir/app")
+    assert (reference.organization, reference.repository, reference.tag_or_digest) == (
+        "my-project",
+        "subdir/app",
+        "latest",
+    )
+
+
+@pytest.mark.parametrize(
+    "image,domain,organization,repository,tag_or_digest",
+    [
+        ("parachutes/chutes-agent:k3s-latest", "docker.io", "parachutes", "chutes-agent", "k3s-latest"),
+        ("nginx:latest", "docker.io", "library", "nginx", "latest"),
+        ("gcr.io/google-containers/pause:3.9", "gcr.io", "google-containers", "pause", "3.9"),
+        ("docker.io/parachutes/app@sha256:abcd1234", "docker.io", "parachutes", "app", "@sha256:abcd1234"),
+    ],
+)
+def test_parse_yields_cosign_rule_components(image, domain, organization, repository, tag_or_digest):
+    reference = parse_image_reference(image)
+    assert (reference.domain, reference.organization, reference.repository, reference.tag_or_digest) == (
+        domain,
+        organization,
+        repository,
+        tag_or_digest,
+    )
+
+
+@pytest.mark.parametrize(
+    "image",
+    ["", "org/UPPER", "app:\u00fcn\u00efcode", "app:v\u0661", "registry.io/", "app:bad tag", "app@sha256", "app@:abc", "-bad.io/app", "a//b"],
+)
+def test_parse_rejects_invalid_references(image):
+    with pytest.raises(InvalidImageReference):
+        parse_image_reference(image)
+
+
+def test_allowlist_exact_and_prefix_entries():
+    allowlist = RegistryAllowlist(["docker.io", "GCR.io", "localhost:*"])
+    assert allowlist.allows("docker.io")
+    assert allowlist.allows("gcr.io")
+    assert allowlist.allows("localhost:30500")
+    assert not allowlist.allows("quay.io")
+    assert not allowlist.allows("evil-docker.io")
+
+
+def _registry(name, method="key", **organizations):
+    return CosignRegistryConfig(
+        registry=name,
+        verification_method=method,
+        organizations={
+            org: {"organization": org, "verification_method": org_method, "repositories": repos}
+            for org, (org_method, repos) in organizations.items()
+        },
+    )
+
+
+def test_cosign_rules_follow_configuration_precedence():
+    configs = [
+        _registry("*", "keyless"),
+        _registry("*.internal.io", "disabled"),
+        _registry(
+            "docker.io",
+            "key",
+            parachutes=(
+                "keyless",
+                {
+                    "chutes-*": {"repository": "chutes-*", "verification_method": "disabled"},
+                    "agent": {"repository": "agent", "verification_method": "key"},
+                },
+            ),
+            **{"google/*": ("disabled", {})},
+        ),
+        _registry("gcr.io*", "disabled"),
+        _registry("gcr.io", "keyless"),
+    ]
+    rules = CosignRules(configs)
+
+    assert rules.lookup("docker.io", "library", "nginx") is configs[2]
+    assert rules.lookup("docker.io", "parachutes", "other").verification_method == "keyless"
+    assert rules.lookup("docker.io", "parachutes", "chutes-api").verification_method == "disabled"
+    assert rules.lookup("docker.io", "parachutes", "agent").verification_method == "key"
+    assert rules.lookup("docker.io", "google", "x").verification_method == "disabled"
+    assert rules.lookup("eu.internal.io") is configs[1]
+    # The earlier "gcr.io*" rule wins over the later exact "gcr.io"
+    assert rules.lookup("gcr.io") is configs[3]
+    assert rules.lookup("quay.io") is configs[0]
+    assert CosignRules([_registry("docker.io")]).lookup("quay.io") is None
+
+
+def test_cosign_config_recompiles_when_configs_replaced():
+    config = CosignConfig(registry_configs=[_registry("docker.io", "key")])
+    assert config.get_verification_config("docker.io").verification_method == "key"
+
+    config.registry_configs = [_registry("docker.io", "keyless")]
+    assert config.get_verification_config("index.docker.io").verification_method == "keyless"
+
+
+def test_image_policy_returns_verdict_and_config_in_one_call():
+    configs = [_registry("docker.io", "key", parachutes=("keyless", {}))]
+    policy = ImagePolicy(["docker.io"], CosignRules(configs))
+
+    verdict = policy.evaluate("parachutes/chutes-agent:k3s")
+    assert verdict.registry_allowed is True
+    assert verdict.verification_config.verification_method == "keyless"
+
+    verdict = policy.evaluate("quay.io/parachutes/chutes-agent:k3s")
+    assert verdict.registry_allowed is False
+    assert verdict.verification_config is None
@@ -1,3 +1,6 @@
+import asyncio
+import json
+
 import pytest
 from fastapi.testclient import TestClient
 
@@ -34,7 +37,8 @@ def fake_runner(monkeypatch):
 
 @pytest.fixture
 def status_client():
-    config = SystemStatusConfig(uds_path="/tmp/system-status.sock")
+    # No D-Bus: these tests cover the systemctl path
+    config = SystemStatusConfig(uds_path="/tmp/system-status.sock", SYSTEMD_BUS_ADDRESS="")
     server = SystemStatusServer(config)
     with TestClient(server.app) as client:
         yield client
@@ -104,6 +108,81 @@ def test_logs_endpoint_respects_clamp(status_client, fake_runner):
     assert any("--lines=1000" in arg for arg in fake_runner.commands[-1])
 
 
+def _eof_reader(data: bytes) -> asyncio.StreamReader:
+    reader = asyncio.StreamReader()
+    reader.feed_data(data)
+    reader.feed_eof()
+    return reader
+
+
+class FakeStreamProcess:
+    def __init__(self, stdout: bytes, stderr: bytes = b"", exit_code: int = 0):
+        # Built inside the fake create_subprocess_exec so the readers bind to the app's loop
+        self.stdout = _eof_reader(stdout)
+        self.stderr = _eof_reader(stderr)
+        self.exit_code = exit_code
+        self.returncode = None
+        self.killed = False
+
+    def kill(self):
+        self.killed = True
+
+    async def wait(self):
+        self.returncode = self.exit_code
+        return self.returncode
+
+
+@pytest.fixture
+def fake_stream(monkeypatch):
+    state = {"commands": [], "output": None}
+
+    async def create_subprocess_exec(*command, **kwargs):
+        state["commands"].append(list(command))
+        return FakeStreamProcess(*state["output"])
+
+    monkeypatch.setattr("sek8s.services.system_status.asyncio.create_subprocess_exec", create_subprocess_exec)
+    return state
+
+
+def test_log_stream_relays_reader_ndjson(status_client, fake_stream):
+    ndjson = (
+        b'{"type":"entry","cursor":"s=1;i=2","realtime_usec":1,"priority":6,"pid":7,'
+        b'"identifier":"k3s","message":"hello"}\n'
+        b'{"type":"end","count":1,"next_cursor":"s=1;i=2","more":false}\n'
+    )
+    fake_stream["output"] = (ndjson,)
+
+    response = status_client.get("/services/k3s/logs/stream?lines=5001&after_cursor=s=1;i=1")
+    assert response.status_code == 200
+    assert response.headers["content-type"].startswith("application/x-ndjson")
+    rows = [json.loads(line) for line in response.text.splitlines()]
+    assert rows[0]["message"] == "hello"
+    assert rows[-1] == {"type": "end", "count": 1, "next_cursor": "s=1;i=2", "more": False}
+
+    command = fake_stream["commands"][-1]
+    assert command[0].endswith("journal-reader")
+    assert "--unit=k3s.service" in command
+    assert "--lines=1000" in command
+    assert "--after-cursor=s=1;i=1" in command
+
+
+def test_log_stream_rejects_bad_cursor(status_client, fake_stream):
+    response = status_client.get("/services/k3s/logs/stream?after_cursor=--directory=/tmp")
+    assert response.status_code == 400
+    assert response.json()["detail"]["error"] == "invalid_cursor"
+    assert fake_stream["commands"] == []
+
+
+def test_log_stream_reader_failure_returns_500(status_client, fake_stream):
+    fake_stream["output"] = (b"", b"journal-reader: invalid cursor: Invalid argument\n", 1)
+
+    response = status_client.get("/services/k3s/logs/stream?after_cursor=s=deadbeef")
+    assert response.status_code == 500
+    detail = response.json()["detail"]
+    assert detail["error"] == "command_failed"
+    assert "invalid cursor" in detail["stderr"]
+
+
 def test_nvidia_smi_command_building(status_client, fake_runner):
     fake_runner.set_response(
         "nvidia-smi",
@@ -196,3 +275,73 @@ def test_overview_degraded_on_service_failure(status_client, fake_runner):
     data = response.json()
     assert data["status"] == "degraded"
     assert any(entry.get("error") for entry in data["services"])
+
+
+def test_disk_space_diagnostic_uses_scanner_report(status_client, fake_runner, tmp_path):
+    report = {
+        "path": str(tmp_path),
+        "total_bytes": 4096 * 10,
+        "max_depth": 2,
+        "top": 2,
+        "dirs": 5,
+        "files": 12,
+        "errors": 0,
+        "elapsed_ms": 1,
+        "index": {"records": 5, "reused": 4, "rescanned": 1, "stale_seconds": 42, "saved": True},
+        "levels": [
+            {"depth": 1, "count": 3, "entries": [
+                {"path": f"{tmp_path}/a", "size_bytes": 4096 * 6},
+                {"path": f"{tmp_path}/b", "size_bytes": 4096 * 3},
+            ]},
+            {"depth": 2, "count": 1, "entries": [
+                {"path": f"{tmp_path}/a/x", "size_bytes": 4096 * 5},
+            ]},
+        ],
+    }
+    fake_runner.set_response(
+        "sudo",
+        CommandResult(
+            exit_code=0,
+            stdout=json.dumps(report),
+            stderr="",
+            stdout_truncated=False,
+            stderr_truncated=False,
+        ),
+    )
+
+    response = status_client.get(
+        "/disk/space", params={"path": str(tmp_path), "diagnostic": "true", "max_depth": 2, "top_n": 2}
+    )
+    assert response.status_code == 200
+    data = response.json()
+    assert fake_runner.commands[-1] == [
+        "sudo", "/usr/local/bin/disk-usage", "--max-depth=2", "--top=2", "--index", "--max-age=300",
+        "--one-file-system", str(tmp_path),
+    ]
+    assert [d["path"] for d in data["directories"]] == [f"{tmp_path}/a", f"{tmp_path}/a/x", f"{tmp_path}/b"]
+    assert [d["depth"] for d in data["directories"]] == [1, 2, 1]
+    assert data["directories"][0]["percentage"] == pytest.approx(60.0)
+    assert data["total_size_bytes"] == 4096 * 10
+    assert data["stdout_truncated"] is False
+    assert data["index_stale_seconds"] == 42
+    assert data["index_reused_dirs"] == 4
+
+
+def test_disk_space_scanner_failure_returns_500(status_client, fake_runner, tmp_path):
+    fake_runner.set_response(
+        "sudo",
+        CommandResult(
+            exit_code=1,
+            stdout="",
+            stderr="disk-usage: permission denied",
+            stdout_truncated=False,
+            stderr_truncated=False,
+        ),
+    )
+
+    response = status_client.get(
+        "/disk/space", params={"path": str(tmp_path), "cross_filesystems": "true", "rescan": "true"}
+    )
+    assert response.status_code == 500
+    assert "--one-file-system" not in fake_runner.commands[-1]
+    assert "--max-age=0" in fake_runner.commands[-1]
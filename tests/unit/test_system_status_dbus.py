@@ -0,0 +1,336 @@
+import asyncio
+import threading
+
+import pytest
+from fastapi.testclient import TestClient
+
+from sek8s.config import SystemStatusConfig
+from sek8s.dbus import (
+    ERROR,
+    FIELD_DESTINATION,
+    FIELD_ERROR_NAME,
+    FIELD_INTERFACE,
+    FIELD_MEMBER,
+    FIELD_PATH,
+    FIELD_REPLY_SERIAL,
+    FIELD_SENDER,
+    FIELD_SIGNATURE,
+    METHOD_RETURN,
+    SIGNAL,
+    Message,
+    Variant,
+    read_message,
+)
+from sek8s.services.system_status import CommandResult, SERVICE_ALLOWLIST, SystemStatusServer
+from sek8s.services.unit_status import (
+    SERVICE_INTERFACE,
+    UNIT_INTERFACE,
+    UnitStatusCache,
+    unit_object_path,
+)
+
+from .test_system_status import FakeRunner
+
+UNITS = [service.unit for service in SERVICE_ALLOWLIST.values()]
+SYSTEMD_UNIQUE_NAME = ":1.1"
+
+
+class FakeSystemdBus:
+    """Stand-in system bus with systemd behind it, on its own loop thread.
+
+    Speaks enough of the protocol for UnitStatusCache: authentication, Hello,
+    AddMatch, GetNameOwner, Manager.Subscribe and Properties.Get, and can emit
+    signals, by default as systemd.
+    """
+
+    def __init__(self, path: str):
+        self.path = path
+        self.properties = {
+            unit_object_path(unit): {
+                UNIT_INTERFACE: {
+                    "Id": Variant("s", unit),
+                    "LoadState": Variant("s", "loaded"),
+                    "ActiveState": Variant("s", "active"),
+                    "SubState": Variant("s", "running"),
+                    "UnitFileState": Variant("s", "enabled"),
+                },
+                SERVICE_INTERFACE: {
+                    "MainPID": Variant("u", 1000 + index),
+                    "ExecMainCode": Variant("i", 0),
+                    "ExecMainStatus": Variant("i", 0),
+                },
+            }
+            for index, unit in enumerate(UNITS)
+        }
+        self.calls = []
+        self.match_rules = []
+        self._writers = []
+        self._serial = 0
+        self._loop = asyncio.new_event_loop()
+        self._thread = threading.Thread(target=self._loop.run_forever, daemon=True)
+
+    def start(self) -> None:
+        self._thread.start()
+        self._server = asyncio.run_coroutine_threadsafe(
+            asyncio.start_unix_server(self._serve, path=self.path), self._loop
+        ).result()
+
+    def stop(self) -> None:
+        async def shutdown():
+            self._server.close()
+            for writer in self._writers:
+                writer.close()
+
+        asyncio.run_coroutine_threadsafe(shutdown(), self._loop).result()
+        self._loop.call_soon_threadsafe(self._loop.stop)
+        self._thread.join()
+
+    def get_calls(self):
+        return [call for call in self.calls if call[0] == "Get"]
+
+    def emit(self, path, interface, member, signature, body, sender=SYSTEMD_UNIQUE_NAME) -> None:
+        def send():
+            self._serial += 1
+            message = Message(
+                type=SIGNAL,
+                serial=self._serial,
+                fields={
+                    FIELD_PATH: path,
+                    FIELD_INTERFACE: interface,
+                    FIELD_MEMBER: member,
+                    FIELD_SIGNATURE: signature,
+                    FIELD_SENDER: sender,
+                },
+                body=body,
+            )
+            for writer in self._writers:
+                writer.write(message.encode())
+
+        self._loop.call_soon_threadsafe(send)
+
+    def drop_clients(self) -> None:
+        def close():
+            for writer in self._writers:
+                writer.close()
+            self._writers.clear()
+
+        self._loop.call_soon_threadsafe(close)
+
+    async def _serve(self, reader, writer):
+        self._writers.append(writer)
+        try:
+            auth = await reader.readuntil(b"\r\n")
+            assert auth.startswith(b"\0AUTH EXTERNAL ")
+            writer.write(b"OK 0123456789abcdef0123456789abcdef\r\n")
+            assert await reader.readuntil(b"\r\n") == b"BEGIN\r\n"
+            while True:
+                writer.write(self._handle(await read_message(reader)).encode())
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+
+    def _handle(self, call: Message) -> Message:
+        self.calls.append((call.member, call.path, call.body))
+        self._serial += 1
+        reply = Message(type=METHOD_RETURN, serial=self._serial, fields={FIELD_REPLY_SERIAL: call.serial})
+        if call.member == "Hello":
+            reply.fields[FIELD_SIGNATURE] = "s"
+            reply.body = (":1.42",)
+        elif call.member == "AddMatch":
+            self.match_rules.append(call.body[0])
+        elif call.member == "GetNameOwner":
+            reply.fields[FIELD_SIGNATURE] = "s"
+            reply.body = (SYSTEMD_UNIQUE_NAME,)
+        elif call.member == "Get" and call.fields.get(FIELD_DESTINATION) == "org.freedesktop.systemd1":
+            interface, name = call.body
+            value = self.properties.get(call.path, {}).get(interface, {}).get(name)
+            if value is None:
+                reply.type = ERROR
+                reply.fields[FIELD_ERROR_NAME] = "org.freedesktop.DBus.Error.UnknownProperty"
+            else:
+                reply.fields[FIELD_SIGNATURE] = "v"
+                reply.body = (value,)
+        return reply
+
+
+@pytest.fixture
+def fake_runner(monkeypatch):
+    runner = FakeRunner()
+    monkeypatch.setattr("sek8s.services.system_status._run_command", runner)
+    return runner
+
+
+@pytest.fixture
+def fake_bus(tmp_path):
+    bus = FakeSystemdBus(str(tmp_path / "system_bus_socket"))
+    bus.start()
+    yield bus
+    bus.stop()
+
+
+async def wait_for_signal():
+    # Signals are applied by the connection's read loop; let it run
+    for _ in range(50):
+        await asyncio.sleep(0.01)
+
+
+@pytest.mark.asyncio
+async def test_unit_status_reads_all_units_in_one_batch(fake_bus):
+    cache = UnitStatusCache(UNITS, f"unix:path={fake_bus.path}", timeout=5)
+    try:
+        first = await cache.get_all()
+        second = await cache.get_all()
+    finally:
+        await cache.close()
+
+    assert first == second
+    assert first["k3s.service"]["ActiveState"] == "active"
+    assert first["k3s.service"]["MainPID"] == str(1000 + UNITS.index("k3s.service"))
+    assert first["k3s.service"]["ExecMainCode"] == "0"
+    # Eight properties per unit, fetched once; the second read is served from memory
+    assert len(fake_bus.get_calls()) == 8 * len(UNITS)
+    assert any("Subscribe" == call[0] for call in fake_bus.calls)
+    assert any(unit_object_path("k3s.service") in rule for rule in fake_bus.match_rules)
+
+
+@pytest.mark.asyncio
+async def test_unit_status_applies_properties_changed(fake_bus):
+    cache = UnitStatusCache(UNITS, f"unix:path={fake_bus.path}", timeout=5)
+    path = unit_object_path("k3s.service")
+    try:
+        await cache.get_all()
+        fetched = len(fake_bus.get_calls())
+
+        fake_bus.emit(
+            path,
+            "org.freedesktop.DBus.Properties",
+            "PropertiesChanged",
+            "sa{sv}as",
+            (UNIT_INTERFACE, {"ActiveState": Variant("s", "failed"), "SubState": Variant("s", "failed")}, []),
+        )
+        await wait_for_signal()
+        status = await cache.get("k3s.service")
+        assert status["ActiveState"] == "failed"
+        assert len(fake_bus.get_calls()) == fetched
+
+        # An invalidated property is re-read for that unit only
+        fake_bus.properties[path][SERVICE_INTERFACE]["MainPID"] = Variant("u", 4242)
+        fake_bus.emit(
+            path,
+            "org.freedesktop.DBus.Properties",
+            "PropertiesChanged",
+            "sa{sv}as",
+            (SERVICE_INTERFACE, {}, ["MainPID"]),
+        )
+        await wait_for_signal()
+        status = await cache.get("k3s.service")
+        assert status["MainPID"] == "4242"
+        assert len(fake_bus.get_calls()) == fetched + 8
+    finally:
+        await cache.close()
+
+
+@pytest.mark.asyncio
+async def test_unit_status_ignores_signals_not_from_systemd(fake_bus):
+    cache = UnitStatusCache(UNITS, f"unix:path={fake_bus.path}", timeout=5)
+    path = unit_object_path("k3s.service")
+    failed = (UNIT_INTERFACE, {"ActiveState": Variant("s", "failed")}, [])
+    try:
+        await cache.get_all()
+
+        # Another local peer forging systemd's signal is ignored
+        fake_bus.emit(path, "org.freedesktop.DBus.Properties", "PropertiesChanged", "sa{sv}as", failed, sender=":1.99")
+        # A malformed body is dropped without taking the connection down
+        fake_bus.emit(path, "org.freedesktop.DBus.Properties", "PropertiesChanged", "sss", ("a", "b", "c"))
+        await wait_for_signal()
+        assert (await cache.get("k3s.service"))["ActiveState"] == "active"
+        assert not cache._connection.closed
+
+        # After systemd re-executes under a new unique name, only that name is trusted
+        fake_bus.emit(
+            "/org/freedesktop/DBus", "org.freedesktop.DBus", "NameOwnerChanged", "sss",
+            ("org.freedesktop.systemd1", SYSTEMD_UNIQUE_NAME, ":1.77"), sender="org.freedesktop.DBus",
+        )
+        fake_bus.emit(path, "org.freedesktop.DBus.Properties", "PropertiesChanged", "sa{sv}as", failed)
+        await wait_for_signal()
+        assert (await cache.get("k3s.service"))["ActiveState"] == "active"
+        fake_bus.emit(path, "org.freedesktop.DBus.Properties", "PropertiesChanged", "sa{sv}as", failed, sender=":1.77")
+        await wait_for_signal()
+        assert (await cache.get("k3s.service"))["ActiveState"] == "failed"
+    finally:
+        await cache.close()
+
+
+@pytest.mark.asyncio
+async def test_signal_handler_errors_do_not_stop_the_reader(fake_bus):
+    cache = UnitStatusCache(UNITS, f"unix:path={fake_bus.path}", timeout=5)
+    try:
+        await cache.get_all()
+
+        def broken(message):
+            raise TypeError("bad signal")
+
+        cache._connection.add_signal_handler(broken)
+        fake_bus.emit("/", "org.example", "Ping", "", ())
+        await wait_for_signal()
+        assert not cache._connection.closed
+        cache._stale.add("k3s.service")
+        assert (await cache.get("k3s.service"))["ActiveState"] == "active"
+    finally:
+        await cache.close()
+
+
+@pytest.mark.asyncio
+async def test_unit_status_reconnects_after_disconnect(fake_bus):
+    cache = UnitStatusCache(UNITS, f"unix:path={fake_bus.path}", timeout=5)
+    try:
+        await cache.get_all()
+        fake_bus.drop_clients()
+        await wait_for_signal()
+        fake_bus.properties[unit_object_path("k3s.service")][UNIT_INTERFACE]["SubState"] = Variant("s", "exited")
+        status = await cache.get("k3s.service")
+        assert status["SubState"] == "exited"
+        assert len(fake_bus.get_calls()) == 2 * 8 * len(UNITS)
+    finally:
+        await cache.close()
+
+
+def test_overview_served_over_dbus(fake_bus, fake_runner):
+    fake_runner.set_response(
+        "nvidia-smi",
+        CommandResult(exit_code=0, stdout="gpu output", stderr="", stdout_truncated=False, stderr_truncated=False),
+    )
+    config = SystemStatusConfig(uds_path="/tmp/system-status.sock", SYSTEMD_BUS_ADDRESS=f"unix:path={fake_bus.path}")
+    with TestClient(SystemStatusServer(config).app) as client:
+        response = client.get("/overview")
+        assert response.status_code == 200
+        data = response.json()
+        assert data["status"] == "ok"
+        assert all(entry["healthy"] for entry in data["services"])
+
+        response = client.get("/services/k3s/status")
+        assert response.json()["status"]["unit_file_state"] == "enabled"
+
+    assert all(command[0] != "systemctl" for command in fake_runner.commands)
+    assert len(fake_bus.get_calls()) == 8 * len(UNITS)
+
+
+def test_status_falls_back_to_systemctl_without_bus(tmp_path, fake_runner):
+    fake_runner.set_response(
+        "systemctl",
+        CommandResult(
+            exit_code=0,
+            stdout="LoadState=loaded\nActiveState=active\nSubState=running\n",
+            stderr="",
+            stdout_truncated=False,
+            stderr_truncated=False,
+        ),
+    )
+    config = SystemStatusConfig(
+        uds_path="/tmp/system-status.sock", SYSTEMD_BUS_ADDRESS=f"unix:path={tmp_path / 'missing'}"
+    )
+    with TestClient(SystemStatusServer(config).app) as client:
+        response = client.get("/services/k3s/status")
+
+    assert response.status_code == 200
+    assert response.json()["healthy"] is True
+    assert fake_runner.commands[-1][0] == "systemctl"
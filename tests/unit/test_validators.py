@@ -4,15 +4,16 @@ Unit tests for individual validators
 """
 
 import asyncio
+import hashlib
 import pytest
 from unittest.mock import Mock, AsyncMock, patch
 import aiohttp
 
 from sek8s.validators.base import ValidationResult
-from sek8s.validators.cosign import CosignValidator
+from sek8s.validators.cosign import CosignValidator, RateLimitError
 from sek8s.validators.registry import RegistryValidator
 from sek8s.validators.opa import OPAValidator
-from sek8s.config import AdmissionConfig, CosignConfig, NamespacePolicy
+from sek8s.config import AdmissionConfig, CosignConfig, CosignRegistryConfig, NamespacePolicy
 
 
 @pytest.fixture
@@ -321,51 +322,93 @@ class TestValidationResult:
         assert "Denied" in combined.messages
         assert "Warning" in combined.warnings
 
-class TestCosignValidator:
-    """Tests for CosignValidator."""
 
-    def test_parse_image_reference_docker_hub_with_org(self, config):
-        """Test parsing Docker Hub image with organization."""
-        validator = CosignValidator(config)
-
-        registry, org, repo, tag = validator._parse_image_reference('parachutes/chutes-agent:k3s-latest')
+def _pod_review(images):
+    return {
+        "request": {
+            "kind": {"kind": "Pod"},
+            "operation": "CREATE",
+            "object": {
+                "metadata": {"name": "app"},
+                "spec": {
+                    "initContainers": [{"name": "init", "image": images[0]}],
+                    "containers": [{"name": f"c{i}", "image": image} for i, image in enumerate(images[1:])],
+                },
+            },
+        }
+    }
 
-        assert registry == 'docker.io'
-        assert org == 'parachutes'
-        assert repo == 'chutes-agent'
-        assert tag == 'k3s-latest'
 
-    def test_parse_image_reference_official_image(self, config):
-        """Test parsing Docker Hub official image."""
-        validator = CosignValidator(config)
+def _digest_image(name):
+    return f"docker.io/parachutes/{name}@sha256:" + hashlib.sha256(name.encode()).hexdigest()
 
-        registry, org, repo, tag = validator._parse_image_reference('nginx:latest')
 
-        assert registry == 'docker.io'
-        assert org == 'library'
-        assert repo == 'nginx'
-        assert tag == 'latest'
+class TestCosignConcurrency:
+    """Concurrent signature verification in CosignValidator."""
 
-    def test_parse_image_reference_with_registry(self, config):
-        """Test parsing image with explicit registry."""
+    @pytest.fixture
+    def validator(self, config):
         validator = CosignValidator(config)
+        validator.cosign_config.registry_configs = [
+            CosignRegistryConfig(registry="*", verification_method="key")
+        ]
+        return validator
 
-        registry, org, repo, tag = validator._parse_image_reference('gcr.io/google-containers/pause:3.9')
+    @pytest.mark.asyncio
+    async def test_images_verified_concurrently_within_bound(self, validator):
+        validator._verify_semaphore = asyncio.Semaphore(2)
+        running, peak = 0, 0
+
+        async def verify(image, verification_config):
+            nonlocal running, peak
+            running += 1
+            peak = max(peak, running)
+            await asyncio.sleep(0.05)
+            running -= 1
+            return True
+
+        validator._verify_with_key = verify
+        images = [_digest_image(name) for name in ("init", "app", "sidecar", "proxy")]
+        result = await validator.validate(_pod_review(images))
 
-        assert registry == 'gcr.io'
-        assert org == 'google-containers'
-        assert repo == 'pause'
-        assert tag == '3.9'
+        assert result.allowed is True
+        assert peak == 2
 
-    def test_parse_image_reference_with_digest(self, config):
-        """Test parsing image with digest."""
-        validator = CosignValidator(config)
+    @pytest.mark.asyncio
+    async def test_identical_verifications_in_flight_are_shared(self, validator):
+        started = asyncio.Event()
+        release = asyncio.Event()
+
+        async def verify(image, verification_config):
+            started.set()
+            await release.wait()
+            return True
+
+        validator._verify_with_key = AsyncMock(side_effect=verify)
+        images = [_digest_image("init"), _digest_image("app")]
+        first = asyncio.ensure_future(validator.validate(_pod_review(images)))
+        await started.wait()
+        second = asyncio.ensure_future(validator.validate(_pod_review(list(reversed(images)))))
+        await asyncio.sleep(0.01)
+        release.set()
+
+        assert (await first).allowed and (await second).allowed
+        assert validator._verify_with_key.await_count == 2
+        assert validator._inflight == {}
 
-        registry, org, repo, tag = validator._parse_image_reference(
-            'docker.io/parachutes/app@sha256:abcd1234'
-        )
+    @pytest.mark.asyncio
+    async def test_rate_limit_short_circuits_queued_verifications(self, validator):
+        validator._verify_semaphore = asyncio.Semaphore(1)
 
-        assert registry == 'docker.io'
-        assert org == 'parachutes'
-        assert repo == 'app'
-        assert tag == '@sha256:abcd1234'
\ No newline at end of file
+        async def verify(image, verification_config):
+            validator._record_rate_limit()
+            raise RateLimitError(validator._rate_limit_message())
+
+        validator._verify_with_key = AsyncMock(side_effect=verify)
+        images = [_digest_image(name) for name in ("init", "app", "sidecar")]
+        result = await validator.validate(_pod_review(images))
+
+        assert result.allowed is False
+        assert len(result.messages) == 1
+        assert result.messages[0].count("rate limit") == 1
+        assert validator._verify_with_key.await_count == 1
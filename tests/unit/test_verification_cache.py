@@ -0,0 +1,188 @@
+import multiprocessing
+import os
+import time
+from pathlib import Path
+from unittest.mock import AsyncMock
+
+import pytest
+
+from sek8s.config import AdmissionConfig, CosignVerificationConfig
+from sek8s.metrics import MetricsCollector
+from sek8s.validators.cosign import CosignValidator
+from sek8s.verification_cache import HEADER_SIZE, SharedVerificationCache, key_hash
+
+
+def _key(n: int) -> tuple:
+    return (f"docker.io/parachutes/app@sha256:{n:064x}", "key", "/etc/cosign.pub", None, None, "", "", False, False)
+
+
+def _live_entries(cache: SharedVerificationCache) -> int:
+    now = time.time()
+    return sum(1 for index in range(cache.slots) if (entry := cache._read(index)) is not None and entry[1] > now)
+
+
+def _write_entries(path: str, start: int, count: int) -> None:
+    cache = SharedVerificationCache(Path(path), slots=1024)
+    for n in range(start, start + count):
+        cache.set(_key(n), n % 2 == 0, ttl=60)
+    cache.close()
+
+
+def test_entries_expire_and_survive_reopening(tmp_path):
+    path = tmp_path / "cosign-cache.bin"
+    cache = SharedVerificationCache(path, slots=256)
+    cache.set(_key(1), True, ttl=60)
+    cache.set(_key(2), False, ttl=60)
+    cache.set(_key(3), True, ttl=-1)
+    assert (cache.get(_key(1)), cache.get(_key(2)), cache.get(_key(3)), cache.get(_key(4))) == (True, False, None, None)
+
+    cache.set(_key(2), True, ttl=60)
+    assert cache.get(_key(2)) is True
+    assert _live_entries(cache) == 2
+    cache.close()
+
+    # A restarted controller sees the same table, whatever size it asks for
+    reopened = SharedVerificationCache(path, slots=4096)
+    assert reopened.slots == 256
+    assert reopened.get(_key(1)) is True
+    assert reopened.get(_key(2)) is True
+    reopened.close()
+
+
+def test_processes_share_entries(tmp_path):
+    path = tmp_path / "cosign-cache.bin"
+    cache = SharedVerificationCache(path, slots=1024)
+    context = multiprocessing.get_context("fork")
+    writers = [context.Process(target=_write_entries, args=(str(path), start, 100)) for start in (0, 100, 200)]
+    for writer in writers:
+        writer.start()
+    for writer in writers:
+        writer.join()
+        assert writer.exitcode == 0
+
+    assert all(cache.get(_key(n)) == (n % 2 == 0) for n in range(300))
+    cache.close()
+
+
+def test_torn_slots_read_as_misses_and_bad_headers_reinitialize(tmp_path):
+    path = tmp_path / "cosign-cache.bin"
+    cache = SharedVerificationCache(path, slots=64)
+    cache.set(_key(1), True, ttl=60)
+    cache.close()
+
+    data = bytearray(path.read_bytes())
+    slot = HEADER_SIZE + data[HEADER_SIZE:].find(key_hash(_key(1)))
+    data[slot + 20] ^= 0xFF  # inside expires_at
+    path.write_bytes(bytes(data))
+    cache = SharedVerificationCache(path, slots=64)
+    assert cache.get(_key(1)) is None
+    cache.set(_key(1), True, ttl=60)
+    assert cache.get(_key(1)) is True
+    cache.close()
+
+    path.write_bytes(b"not a cache file")
+    cache = SharedVerificationCache(path, slots=64)
+    assert cache.get(_key(1)) is None
+    assert _live_entries(cache) == 0
+    cache.close()
+
+
+def test_reinitializing_never_shrinks_a_mapped_file(tmp_path, monkeypatch):
+    path = tmp_path / "cosign-cache.bin"
+    mapped = SharedVerificationCache(path, slots=256)
+    mapped.set(_key(1), True, ttl=60)
+    size = path.stat().st_size
+
+    with open(path, "r+b") as f:
+        f.write(b"CORRUPT!")
+    truncations = []
+    real_ftruncate = os.ftruncate
+    monkeypatch.setattr(
+        "sek8s.verification_cache.os.ftruncate", lambda fd, n: (truncations.append(n), real_ftruncate(fd, n))
+    )
+    fresh = SharedVerificationCache(path, slots=64)
+
+    assert truncations == []
+    assert path.stat().st_size == size
+    assert fresh.get(_key(1)) is None
+    # The larger table still mapped by another controller stays readable
+    mapped.get(_key(1))
+    assert _live_entries(mapped) <= 1
+    fresh.close()
+    mapped.close()
+
+
+def test_full_table_evicts_entries_expiring_soonest(tmp_path):
+    cache = SharedVerificationCache(tmp_path / "cosign-cache.bin", slots=64)
+    for n in range(200):
+        cache.set(_key(n), True, ttl=1000 + n)
+    # The newest entries always find a slot
+    assert all(cache.get(_key(n)) is True for n in range(190, 200))
+    assert _live_entries(cache) == 64
+    cache.close()
+
+
+@pytest.mark.asyncio
+async def test_validator_reuses_verdicts_across_restarts(tmp_path, monkeypatch):
+    monkeypatch.setenv("SHARED_CACHE_PATH", str(tmp_path / "cosign-cache.bin"))
+    verification_config = CosignVerificationConfig(verification_method="key")
+    image = "docker.io/parachutes/app@sha256:" + "a" * 64
+
+    first_metrics = MetricsCollector()
+    first = CosignValidator(AdmissionConfig(), metrics=first_metrics)
+    first._verify_with_key = AsyncMock(return_value=True)
+    assert await first._verify_image_signature(image, verification_config)
+    assert await first._verify_image_signature(image, verification_config)
+    assert first._verify_with_key.await_count == 1
+    assert dict(first_metrics.cosign_cache_lookups) == {"miss": 1, "memory": 1}
+    assert first_metrics.cosign_verifications == first_metrics.cosign_startup_verifications == 1
+
+    # A restarted (or second) controller answers from the shared cache without verifying
+    second_metrics = MetricsCollector()
+    second = CosignValidator(AdmissionConfig(), metrics=second_metrics)
+    second._verify_with_key = AsyncMock(return_value=True)
+    assert await second._verify_image_signature(image, verification_config)
+    second._verify_with_key.assert_not_awaited()
+    assert dict(second_metrics.cosign_cache_lookups) == {"shared": 1}
+    assert second_metrics.cosign_cache_hit_ratio() == 1.0
+    assert "cosign_verifications_total 0" in second_metrics.export_prometheus()
+
+
+@pytest.mark.asyncio
+async def test_rotated_key_or_mode_switch_does_not_reuse_shared_verdicts(tmp_path, monkeypatch):
+    monkeypatch.setenv("SHARED_CACHE_PATH", str(tmp_path / "cosign-cache.bin"))
+    public_key = tmp_path / "cosign.pub"
+    public_key.write_text("first key")
+    verification_config = CosignVerificationConfig(verification_method="key", public_key=public_key, ignore_tlog=True)
+    image = "docker.io/parachutes/app@sha256:" + "a" * 64
+
+    def restarted(native: bool = True) -> CosignValidator:
+        monkeypatch.setenv("NATIVE_KEY_VERIFICATION", str(native).lower())
+        validator = CosignValidator(AdmissionConfig())
+        validator._verify_with_key = AsyncMock(return_value=True)
+        return validator
+
+    first = restarted()
+    assert await first._verify_image_signature(image, verification_config)
+    cached = restarted()
+    assert await cached._verify_image_signature(image, verification_config)
+    cached._verify_with_key.assert_not_awaited()
+
+    # Same path, new contents: the verdict for the old key is not reused
+    public_key.write_text("rotated key, a different length")
+    rotated = restarted()
+    assert await rotated._verify_image_signature(image, verification_config)
+    rotated._verify_with_key.assert_awaited_once()
+
+    # Nor is a natively reached verdict once verification goes back to the CLI
+    cli = restarted(native=False)
+    assert await cli._verify_image_signature(image, verification_config)
+    cli._verify_with_key.assert_awaited_once()
+
+
+def test_validator_runs_without_shared_cache_when_path_unusable(tmp_path, monkeypatch):
+    blocker = tmp_path / "file"
+    blocker.write_text("")
+    monkeypatch.setenv("SHARED_CACHE_PATH", str(blocker / "cosign-cache.bin"))
+    validator = CosignValidator(AdmissionConfig())
+    assert validator._shared_cache is None
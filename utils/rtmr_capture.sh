@@ -3,6 +3,8 @@
 
 BOOT_NUM=${1:-auto}
 BASE_DIR="rtmr_snapshots"
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+TDX_EVENTLOG="$SCRIPT_DIR/tdx-eventlog"
 
 # Auto-increment boot number if not specified
 if [ "$BOOT_NUM" == "auto" ]; then
@@ -20,6 +22,12 @@ echo "Capturing RTMR snapshot: Boot $BOOT_NUM"
 echo "Output directory: $OUTPUT_DIR"
 echo "==================================="
 
+# Build tdx-eventlog next to this script if it is missing or older than its source
+if [ ! -x "$TDX_EVENTLOG" ] || [ "$SCRIPT_DIR/tdx_eventlog.c" -nt "$TDX_EVENTLOG" ]; then
+    echo "Building tdx-eventlog..."
+    gcc -O2 -o "$TDX_EVENTLOG" "$SCRIPT_DIR/tdx_eventlog.c" -lcrypto || echo "WARNING: Failed to build tdx-eventlog"
+fi
+
 # Generate TDX quote (adjust path to your quote generator)
 cd /home/tdx
 echo "Generating TDX quote..."
@@ -49,6 +57,14 @@ done
 # Capture CCEL event log
 echo "Capturing CCEL..."
 xxd /sys/firmware/acpi/tables/CCEL > "$OUTPUT_DIR/ccel.txt" 2>/dev/null || true
+cp /sys/firmware/acpi/tables/data/CCEL "$OUTPUT_DIR/ccel.bin" 2>/dev/null || true
+
+# Match measured EFI variable events against current efivars
+echo "Correlating EFI variables with the event log..."
+# Warnings go to their own file so eventlog.json stays valid JSON for rtmr_diff.sh
+"$TDX_EVENTLOG" --json > "$OUTPUT_DIR/eventlog.json" 2> "$OUTPUT_DIR/eventlog.err"
+EVENTLOG_EXIT=$?
+[ -s "$OUTPUT_DIR/eventlog.err" ] || rm -f "$OUTPUT_DIR/eventlog.err"
 
 echo ""
 echo "Snapshot saved to $OUTPUT_DIR/"
@@ -64,6 +80,11 @@ cd - > /dev/null
 grep -i "rtmr" "$OUTPUT_DIR/rtmrs.json" || echo "Failed to extract RTMRs"
 echo ""
 
+if [ $EVENTLOG_EXIT -eq 2 ]; then
+    echo "WARNING: Measured EFI variables differ from current contents:"
+    grep '"status": "\(changed\|absent\|log_mismatch\)"' "$OUTPUT_DIR/eventlog.json" || true
+fi
+
 if [ $QUOTE_EXIT -ne 0 ]; then
     echo "WARNING: Quote generation may have failed (exit code: $QUOTE_EXIT)"
 fi
@@ -96,6 +96,18 @@ echo ""
         done
         echo ""
         
+        # Compare measured EFI variable events (one JSON line per variable)
+        echo "### Measured EFI Variables (event log) ###"
+        if [ -f "$BOOT1/eventlog.json" ] && [ -f "$BOOT2/eventlog.json" ]; then
+            if diff -q <(grep '"name"' "$BOOT1/eventlog.json") <(grep '"name"' "$BOOT2/eventlog.json") > /dev/null 2>&1; then
+                echo "✓ Measured EFI variables are IDENTICAL"
+            else
+                echo "✗ Measured EFI variables DIFFER:"
+                diff <(grep '"name"' "$BOOT1/eventlog.json") <(grep '"name"' "$BOOT2/eventlog.json") || true
+            fi
+        fi
+        echo ""
+        
         # Compare CCEL
         echo "### CCEL Event Log ###"
         if [ -f "$BOOT1/ccel.txt" ] && [ -f "$BOOT2/ccel.txt" ]; then
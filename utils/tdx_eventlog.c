@@ -0,0 +1,436 @@
+// tdx_eventlog.c - Decode the TDX CCEL event log and correlate measured EFI
+// variables with the current contents of /sys/firmware/efi/efivars.
+//
+// Build: gcc -O2 -o tdx-eventlog tdx_eventlog.c -lcrypto
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <openssl/evp.h>
+
+#define DEFAULT_CCEL_PATH     "/sys/firmware/acpi/tables/data/CCEL"
+#define DEFAULT_EFIVARS_PATH  "/sys/firmware/efi/efivars"
+
+// TCG PC Client event types we care about
+#define EV_NO_ACTION                    0x00000003
+#define EV_EFI_VARIABLE_DRIVER_CONFIG   0x80000001
+#define EV_EFI_VARIABLE_BOOT            0x80000002
+#define EV_EFI_VARIABLE_BOOT2           0x8000000C
+
+// TPM algorithm IDs used in crypto-agile logs
+#define TPM_ALG_SHA1    0x0004
+#define TPM_ALG_SHA256  0x000B
+#define TPM_ALG_SHA384  0x000C
+#define TPM_ALG_SHA512  0x000D
+
+#define MAX_ALGS        8
+#define MAX_DIGEST      64
+#define MAX_VAR_SIZE    (1 << 20)
+#define NUM_RTMRS       4
+
+typedef struct {
+    uint16_t alg_id;
+    uint16_t size;
+} digest_alg_t;
+
+typedef struct {
+    const uint8_t *guid;        // 16 bytes, EFI_GUID layout
+    char name[128];             // UTF-8 variable name
+    const uint8_t *data;        // measured variable data
+    uint64_t data_len;
+    const uint8_t *raw;         // UEFI_VARIABLE_DATA header and name
+    size_t header_len;
+} efi_var_event_t;
+
+typedef enum {
+    VAR_MATCH = 0,      // current contents hash to the measured digest
+    VAR_CHANGED,        // variable exists but differs from what was measured
+    VAR_ABSENT,         // variable not exposed in efivarfs
+    VAR_LOG_MISMATCH,   // event digest does not cover the event's own data
+} var_status_t;
+
+static const char *status_names[] = {"match", "changed", "absent", "log_mismatch"};
+
+static const char *variable_event_name(uint32_t event_type) {
+    switch (event_type) {
+        case EV_EFI_VARIABLE_DRIVER_CONFIG: return "EFI_VARIABLE_DRIVER_CONFIG";
+        case EV_EFI_VARIABLE_BOOT: return "EFI_VARIABLE_BOOT";
+        case EV_EFI_VARIABLE_BOOT2: return "EFI_VARIABLE_BOOT2";
+        default: return "EFI_VARIABLE";
+    }
+}
+
+static uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t rd32(const uint8_t *p) { return rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+static uint64_t rd64(const uint8_t *p) { return rd32(p) | ((uint64_t)rd32(p + 4) << 32); }
+
+const EVP_MD *alg_to_md(uint16_t alg_id) {
+    switch (alg_id) {
+        case TPM_ALG_SHA1:   return EVP_sha1();
+        case TPM_ALG_SHA256: return EVP_sha256();
+        case TPM_ALG_SHA384: return EVP_sha384();
+        case TPM_ALG_SHA512: return EVP_sha512();
+        default:             return NULL;
+    }
+}
+
+// Hash up to two buffers back to back with the given algorithm
+int hash_buffers(const EVP_MD *md, const uint8_t *a, size_t a_len,
+                 const uint8_t *b, size_t b_len, uint8_t *out) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    unsigned int len = 0;
+    int ok = ctx && EVP_DigestInit_ex(ctx, md, NULL) &&
+             EVP_DigestUpdate(ctx, a, a_len) &&
+             (b_len == 0 || EVP_DigestUpdate(ctx, b, b_len)) &&
+             EVP_DigestFinal_ex(ctx, out, &len);
+    EVP_MD_CTX_free(ctx);
+    return ok ? (int)len : -1;
+}
+
+void hex_string(const uint8_t *data, size_t len, char *out) {
+    for (size_t i = 0; i < len; i++) {
+        sprintf(out + 2 * i, "%02X", data[i]);
+    }
+    out[2 * len] = '\0';
+}
+
+void format_guid(const uint8_t *g, char *out) {
+    sprintf(out, "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+            rd32(g), rd16(g + 4), rd16(g + 6),
+            g[8], g[9], g[10], g[11], g[12], g[13], g[14], g[15]);
+}
+
+// Convert a UTF-16LE string (BMP only, which covers every UEFI variable name) to UTF-8
+void utf16_to_utf8(const uint8_t *src, size_t chars, char *out, size_t out_len) {
+    size_t o = 0;
+    for (size_t i = 0; i < chars; i++) {
+        uint16_t c = rd16(src + 2 * i);
+        if (c == 0) break;
+        if (c < 0x80 && o + 1 < out_len) {
+            out[o++] = (char)c;
+        } else if (c < 0x800 && o + 2 < out_len) {
+            out[o++] = 0xC0 | (c >> 6);
+            out[o++] = 0x80 | (c & 0x3F);
+        } else if (o + 3 < out_len) {
+            out[o++] = 0xE0 | (c >> 12);
+            out[o++] = 0x80 | ((c >> 6) & 0x3F);
+            out[o++] = 0x80 | (c & 0x3F);
+        }
+    }
+    out[o] = '\0';
+}
+
+void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+// Render a short human readable summary of well-known variables
+void decode_variable(const char *name, const uint8_t *data, size_t len, char *out, size_t out_len) {
+    size_t o = 0;
+    out[0] = '\0';
+
+    if (!strcmp(name, "BootOrder") || !strcmp(name, "DriverOrder")) {
+        for (size_t i = 0; i + 1 < len && o + 6 < out_len; i += 2) {
+            o += snprintf(out + o, out_len - o, "%s%04X", i ? "," : "", rd16(data + i));
+        }
+    } else if ((!strcmp(name, "BootCurrent") || !strcmp(name, "BootNext") ||
+                !strcmp(name, "Timeout")) && len == 2) {
+        snprintf(out, out_len, "%04X", rd16(data));
+    } else if (!strcmp(name, "MTC") && len == 4) {
+        snprintf(out, out_len, "%u", rd32(data));
+    } else if ((!strcmp(name, "SecureBoot") || !strcmp(name, "SetupMode") ||
+                !strcmp(name, "AuditMode") || !strcmp(name, "DeployedMode") ||
+                !strcmp(name, "VarErrorFlag")) && len == 1) {
+        snprintf(out, out_len, "%u", data[0]);
+    } else if ((!strncmp(name, "Boot", 4) || !strncmp(name, "Driver", 6)) && len >= 6) {
+        // EFI_LOAD_OPTION: Attributes(4) FilePathListLength(2) Description(CHAR16[])
+        size_t chars = 0;
+        while (6 + 2 * chars + 1 < len && rd16(data + 6 + 2 * chars) != 0) chars++;
+        char desc[128];
+        utf16_to_utf8(data + 6, chars, desc, sizeof(desc));
+        snprintf(out, out_len, "attr=0x%X desc=%s", rd32(data), desc);
+    } else if (!strcmp(name, "PK") || !strcmp(name, "KEK") || !strcmp(name, "db") ||
+               !strcmp(name, "dbx") || !strcmp(name, "dbt")) {
+        // Sequence of EFI_SIGNATURE_LIST: Type(16) ListSize(4) HeaderSize(4) SigSize(4)
+        size_t lists = 0, sigs = 0, off = 0;
+        while (off + 28 <= len) {
+            uint32_t list_size = rd32(data + off + 16);
+            uint32_t header_size = rd32(data + off + 20);
+            uint32_t sig_size = rd32(data + off + 24);
+            if (list_size < 28 || list_size > len - off) break;
+            if (sig_size && header_size <= list_size - 28) sigs += (list_size - 28 - header_size) / sig_size;
+            lists++;
+            off += list_size;
+        }
+        snprintf(out, out_len, "%zu lists, %zu signatures", lists, sigs);
+    } else {
+        snprintf(out, out_len, "%zu bytes", len);
+    }
+}
+
+// Read a whole file; returns buffer (caller frees) or NULL
+uint8_t *read_file(const char *path, size_t *size_out, size_t max_size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    size_t cap = 4096, size = 0;
+    uint8_t *buf = malloc(cap);
+    while (buf) {
+        size_t n = fread(buf + size, 1, cap - size, f);
+        size += n;
+        if (n == 0 || size >= max_size) break;
+        if (size == cap) {
+            uint8_t *grown = realloc(buf, cap * 2);
+            if (!grown) { free(buf); buf = NULL; break; }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    *size_out = size;
+    return buf;
+}
+
+// Parse UEFI_VARIABLE_DATA: VariableName(16) UnicodeNameLength(8) VariableDataLength(8)
+// UnicodeName(CHAR16[]) VariableData(...)
+int parse_var_event(const uint8_t *data, uint32_t len, efi_var_event_t *ev) {
+    if (len < 32) return -1;
+    uint64_t name_chars = rd64(data + 16);
+    uint64_t data_len = rd64(data + 24);
+    // data_len is untrusted and 64-bit: compare against what is left, never sum it
+    if (name_chars > 64 || 32 + 2 * name_chars > len || data_len > len - 32 - 2 * name_chars) return -1;
+
+    ev->guid = data;
+    utf16_to_utf8(data + 32, name_chars, ev->name, sizeof(ev->name));
+    ev->data = data + 32 + 2 * name_chars;
+    ev->data_len = data_len;
+    ev->raw = data;
+    ev->header_len = 32 + 2 * name_chars;
+    return 0;
+}
+
+// Digest of the variable as firmware would measure it. EDK2 hashes the whole
+// UEFI_VARIABLE_DATA for DRIVER_CONFIG/BOOT2 but only the variable payload for
+// EV_EFI_VARIABLE_BOOT, so both forms are tried.
+int digest_matches(const EVP_MD *md, const uint8_t *digest, const efi_var_event_t *ev,
+                   const uint8_t *var_data, size_t var_len) {
+    uint8_t calc[MAX_DIGEST];
+    int len;
+    uint8_t header[32 + 128];
+
+    memcpy(header, ev->raw, ev->header_len);
+    for (int i = 0; i < 8; i++) header[24 + i] = (uint8_t)((uint64_t)var_len >> (8 * i));
+
+    len = hash_buffers(md, header, ev->header_len, var_data, var_len, calc);
+    if (len > 0 && memcmp(calc, digest, len) == 0) return 1;
+
+    len = hash_buffers(md, var_data, var_len, NULL, 0, calc);
+    return len > 0 && memcmp(calc, digest, len) == 0;
+}
+
+void print_usage(const char *prog_name) {
+    printf("Usage: %s [OPTIONS]\n", prog_name);
+    printf("Options:\n");
+    printf("  -l, --log FILE       CCEL event log (default: %s)\n", DEFAULT_CCEL_PATH);
+    printf("  -e, --efivars DIR    efivarfs mount (default: %s)\n", DEFAULT_EFIVARS_PATH);
+    printf("  -j, --json           Output JSON\n");
+    printf("  -h, --help           Show this help message\n");
+    printf("Exit status: 0 all measured variables match, 2 mismatches found, 1 error\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *log_path = DEFAULT_CCEL_PATH;
+    const char *efivars_path = DEFAULT_EFIVARS_PATH;
+    int json_output = 0;
+
+    static struct option long_options[] = {
+        {"log", required_argument, 0, 'l'},
+        {"efivars", required_argument, 0, 'e'},
+        {"json", no_argument, 0, 'j'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "l:e:jh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'l': log_path = optarg; break;
+            case 'e': efivars_path = optarg; break;
+            case 'j': json_output = 1; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default:  print_usage(argv[0]); return 1;
+        }
+    }
+
+    size_t log_size = 0;
+    uint8_t *log = read_file(log_path, &log_size, SIZE_MAX);
+    if (!log) {
+        fprintf(stderr, "Failed to read event log %s: %s\n", log_path, strerror(errno));
+        return 1;
+    }
+
+    // First event is a legacy TCG_PCR_EVENT carrying the TCG_EfiSpecIdEvent:
+    // PCRIndex(4) EventType(4) Digest(20) EventSize(4) Event
+    if (log_size < 32 + 36 || rd32(log + 4) != EV_NO_ACTION ||
+        memcmp(log + 32, "Spec ID Event03", 16) != 0) {
+        fprintf(stderr, "Invalid event log: missing Spec ID Event03 header\n");
+        free(log);
+        return 1;
+    }
+    uint32_t spec_size = rd32(log + 28);
+    uint32_t num_algs = rd32(log + 32 + 24);
+    if (num_algs == 0 || num_algs > MAX_ALGS || 32 + 28 + 4 * num_algs > log_size) {
+        fprintf(stderr, "Invalid event log: bad algorithm count %u\n", num_algs);
+        free(log);
+        return 1;
+    }
+    digest_alg_t algs[MAX_ALGS];
+    for (uint32_t i = 0; i < num_algs; i++) {
+        algs[i].alg_id = rd16(log + 32 + 28 + 4 * i);
+        algs[i].size = rd16(log + 32 + 30 + 4 * i);
+    }
+
+    // RTMRs are SHA-384; replay them alongside the variable checks
+    uint8_t rtmr[NUM_RTMRS][48] = {{0}};
+    size_t off = 32 + spec_size;
+    int events = 0, var_events = 0, mismatches = 0;
+    char path[4096], guid[40], hex[2 * MAX_DIGEST + 1];
+    char measured_desc[256], current_desc[256];
+
+    if (json_output) printf("{\n  \"variables\": [");
+
+    // TCG_PCR_EVENT2: PCRIndex(4) EventType(4) Digests(TPML_DIGEST_VALUES) EventSize(4) Event
+    while (off + 12 <= log_size) {
+        size_t event_off = off;
+        uint32_t mr_index = rd32(log + off);
+        uint32_t event_type = rd32(log + off + 4);
+        uint32_t digest_count = rd32(log + off + 8);
+        if (mr_index == 0xFFFFFFFF || event_type == 0xFFFFFFFF || digest_count == 0 ||
+            digest_count > num_algs) {
+            break;  // end of log (unused log area is 0xFF / 0x00 filled)
+        }
+
+        size_t p = off + 12;
+        const uint8_t *digest = NULL;
+        uint16_t digest_alg = 0;
+        int truncated = 0;
+        for (uint32_t d = 0; d < digest_count && !truncated; d++) {
+            if (p + 2 > log_size) { truncated = 1; break; }
+            uint16_t alg_id = rd16(log + p);
+            uint16_t size = 0;
+            for (uint32_t a = 0; a < num_algs; a++) {
+                if (algs[a].alg_id == alg_id) size = algs[a].size;
+            }
+            if (size == 0 || p + 2 + size > log_size) { truncated = 1; break; }
+            // Prefer SHA-384 (what the TDX module extends into RTMRs)
+            if (!digest || alg_id == TPM_ALG_SHA384) {
+                digest = log + p + 2;
+                digest_alg = alg_id;
+            }
+            p += 2 + size;
+        }
+        if (truncated || p + 4 > log_size) break;
+        uint32_t event_size = rd32(log + p);
+        const uint8_t *event_data = log + p + 4;
+        if (p + 4 + event_size > log_size) break;
+        off = p + 4 + event_size;
+        events++;
+
+        const EVP_MD *md = alg_to_md(digest_alg);
+        int digest_len = md ? EVP_MD_get_size(md) : 0;
+
+        // CCEL MR index 1..4 map to RTMR0..3
+        if (event_type != EV_NO_ACTION && digest_alg == TPM_ALG_SHA384 &&
+            mr_index >= 1 && mr_index <= NUM_RTMRS) {
+            hash_buffers(EVP_sha384(), rtmr[mr_index - 1], 48, digest, 48, rtmr[mr_index - 1]);
+        }
+
+        if (event_type != EV_EFI_VARIABLE_DRIVER_CONFIG && event_type != EV_EFI_VARIABLE_BOOT &&
+            event_type != EV_EFI_VARIABLE_BOOT2) {
+            continue;
+        }
+
+        efi_var_event_t ev;
+        if (!md || parse_var_event(event_data, event_size, &ev) != 0) {
+            fprintf(stderr, "Skipping malformed variable event at offset %zu\n", event_off);
+            continue;
+        }
+        var_events++;
+        format_guid(ev.guid, guid);
+
+        var_status_t status;
+        size_t cur_size = 0;
+        uint8_t *cur = NULL;
+        snprintf(path, sizeof(path), "%s/%s-%s", efivars_path, ev.name, guid);
+
+        cur = read_file(path, &cur_size, MAX_VAR_SIZE);
+
+        if (!digest_matches(md, digest, &ev, ev.data, ev.data_len)) {
+            status = VAR_LOG_MISMATCH;
+        } else if (cur == NULL || cur_size < 4) {
+            // Unset variables are measured with empty data
+            status = ev.data_len == 0 ? VAR_MATCH : VAR_ABSENT;
+        } else {
+            // efivarfs prefixes the payload with the 4-byte attribute mask
+            status = digest_matches(md, digest, &ev, cur + 4, cur_size - 4) ? VAR_MATCH : VAR_CHANGED;
+        }
+        if (status != VAR_MATCH) mismatches++;
+
+        decode_variable(ev.name, ev.data, ev.data_len, measured_desc, sizeof(measured_desc));
+        if (cur && cur_size >= 4) {
+            decode_variable(ev.name, cur + 4, cur_size - 4, current_desc, sizeof(current_desc));
+        } else {
+            strcpy(current_desc, "(not present)");
+        }
+        hex_string(digest, digest_len, hex);
+
+        if (json_output) {
+            printf("%s\n    {\"name\": ", var_events > 1 ? "," : "");
+            json_string(stdout, ev.name);
+            printf(", \"guid\": \"%s\", \"event_type\": \"0x%08X\", \"rtmr\": %d, "
+                   "\"digest\": \"%s\", \"status\": \"%s\", \"measured\": ",
+                   guid, event_type, (int)mr_index - 1, hex, status_names[status]);
+            json_string(stdout, measured_desc);
+            printf(", \"current\": ");
+            json_string(stdout, current_desc);
+            printf("}");
+        } else {
+            printf("%-12s RTMR%d %-24s %s-%s\n", status_names[status], (int)mr_index - 1,
+                   variable_event_name(event_type), ev.name, guid);
+            if (status != VAR_MATCH) {
+                printf("             measured: %s\n", measured_desc);
+                printf("             current:  %s\n", current_desc);
+            }
+        }
+        free(cur);
+    }
+
+    if (json_output) {
+        printf("\n  ],\n  \"events\": %d,\n  \"variable_events\": %d,\n  \"mismatches\": %d,\n",
+               events, var_events, mismatches);
+        printf("  \"replayed_rtmrs\": {\n");
+        for (int i = 0; i < NUM_RTMRS; i++) {
+            hex_string(rtmr[i], 48, hex);
+            printf("    \"RTMR%d\": \"%s\"%s\n", i, hex, i < NUM_RTMRS - 1 ? "," : "");
+        }
+        printf("  }\n}\n");
+    } else {
+        printf("\n%d events, %d measured EFI variables, %d mismatches\n", events, var_events, mismatches);
+        for (int i = 0; i < NUM_RTMRS; i++) {
+            hex_string(rtmr[i], 48, hex);
+            printf("Replayed RTMR%d: %s\n", i, hex);
+        }
+    }
+
+    free(log);
+    return mismatches ? 2 : 0;
+}